@@ -0,0 +1,70 @@
+#pragma once
+#include "event_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// iniVation (DV) の AEDAT 4.0 ファイル (.aedat4) を読み込む
+// ファイル構成: "#!AER-DAT4.0\r\n" | IOHeader (flatbuffer) | パケット...
+// 各パケットは {stream_id, size} のヘッダと、LZ4 / zstd で圧縮された flatbuffer (EventPacket, Frame など) からなる
+//
+// 開くときにパケットのヘッダを走査し、イベントのパケットだけを並列に展開して各パケットのイベント数と時刻範囲を数える。
+// read_events() は必要なパケットだけをその場で展開するため、ファイルの長さに関係なくメモリ使用量は一定になる
+class Aedat4Reader : public EventSource {
+public:
+    static constexpr const char* EXTENSION = ".aedat4";
+
+    explicit Aedat4Reader(const std::string& filepath) : Aedat4Reader(filepath, true) {}
+    ~Aedat4Reader() override;
+
+    // 最初のイベントの時刻 (Unix 時刻の µs)
+    int64_t load_t_offset() override { return m_t_offset; }
+    size_t num_events() override { return m_num_events; }
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    // 各パケットの時刻範囲を二分探索し、1パケットだけを展開する
+    size_t find_event_index(int64_t t) override;
+    std::optional<Resolution> resolution() override;
+    // パケットの展開が必要なため、ネイティブキャッシュに変換して持つ
+    bool benefits_from_cache() const override { return true; }
+
+    // ファイルに含まれる APS フレーム (Frame ストリーム) をすべて展開して返す (イベントのパケットは展開しない)
+    // timestamp は Unix 時刻の µs (画像ファイルの RGBFrame と同じく t_offset を含む)
+    static std::vector<RGBFrame> load_frames(const std::string& filepath);
+
+    // ファイル上の1パケット
+    struct Packet {
+        uint64_t offset;        // 圧縮データの位置
+        uint32_t stored_bytes;
+        uint64_t first_event = 0; // イベントのパケットのみ: ファイル全体での通し番号
+        uint32_t num_events = 0;
+        int64_t t_first = 0;      // t_offset を含まない µs
+        int64_t t_last = 0;
+    };
+
+private:
+    // index_events = false のときはパケットの位置だけを調べる (フレームだけを読む場合)
+    Aedat4Reader(const std::string& filepath, bool index_events);
+    std::vector<RGBFrame> decode_frames() const;
+
+    enum class Compression { NONE = 0, LZ4 = 1, LZ4_HIGH = 2, ZSTD = 3, ZSTD_HIGH = 4 };
+
+    // パケットの中身を展開し、flatbuffer の先頭を返す (無圧縮なら mmap 上のデータをそのまま返す)
+    const uint8_t* unpack(const Packet& packet, std::vector<uint8_t>& scratch, size_t& bytes) const;
+    // イベントのパケット index の [lo, hi) を stride 個おきに dst へ書き込む
+    void decode_packet(size_t index, size_t lo, size_t hi, size_t stride, unsigned columns,
+                       uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const;
+
+    std::string m_filepath;
+    std::shared_ptr<MappedFile> m_file;
+    Compression m_compression = Compression::NONE;
+    int64_t m_t_offset = 0;
+    size_t m_num_events = 0;
+    std::optional<Resolution> m_resolution;
+    std::vector<Packet> m_event_packets;
+    std::vector<Packet> m_frame_packets;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "event_source.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Arrow IPC ファイル (.arrow / Feather V2 の .feather) の書き込み設定
+struct ArrowWriteOptions {
+    int64_t batch_ms = 1000;                       // レコードバッチの境界を置く時間の間隔 (ms)
+    size_t target_batch_events = size_t(1) << 22;  // 1バッチあたりのイベント数の目安 (短い区間はまとめ、長い区間は分ける)
+    int64_t t_begin = INT64_MIN;                   // 書き出す時間範囲 [t_begin, t_end) (µs、t_offset を除いた時刻)
+    int64_t t_end = INT64_MAX;
+};
+
+// source のイベントを Arrow IPC ファイル形式で path に書き込む
+// 列は x: uint16, y: uint16, p: uint8, t: int64 (µs) で、t_offset と解像度はスキーマのメタデータに持つ
+// レコードバッチは batch_ms の倍数の時刻で区切り、各バッファを64バイト境界に揃えるので、
+// pyarrow.ipc.open_file / pyarrow.feather.read_table などからもコピーせずに mmap で読める
+void write_arrow_file(EventSource& source, const std::string& path, const ArrowWriteOptions& options = {});
+
+// Arrow IPC ファイル (.arrow / .feather / .ipc) のイベントを読み込む
+// 列名は x, y, p, t (p = pol / polarity、t = ts / timestamp なども受け付ける)
+// 受け付ける型:
+//   - x, y, p: 任意の幅の整数 (p は bool も可)
+//   - t: 整数 (µs)、浮動小数 (秒)、timestamp / duration (単位に従って µs に換算)
+// 圧縮されていないバッチで型が列の型 (x, y: uint16, p: uint8, t: int64 µs) と一致する列は、
+// mmap へのビューとしてコピーせずに返す。圧縮 (LZ4 / zstd) されたバッチと型の異なる列は、開くときにバッチごとに並列に展開・変換する
+class ArrowEventReader : public EventSource {
+public:
+    static constexpr const char* EXTENSION = ".arrow";
+    static constexpr const char* FEATHER_EXTENSION = ".feather";
+    static constexpr const char* IPC_EXTENSION = ".ipc";
+
+    explicit ArrowEventReader(const std::string& filepath);
+    ~ArrowEventReader() override;
+
+    int64_t load_t_offset() override { return m_t_offset; }
+    size_t num_events() override { return m_num_events; }
+    // 範囲が1つのバッチに収まり stride == 1 ならビューを返し、それ以外はバッチごとに並列にコピーする
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    // バッチの時間範囲を二分探索し、該当するバッチの中で二分探索する
+    size_t find_event_index(int64_t t) override;
+    std::optional<Resolution> resolution() override { return m_resolution; }
+    bool is_memory_mapped(unsigned columns = EVENT_COLUMNS_ALL) override { return (columns & ~m_mapped_columns) == 0; }
+    // 展開・変換が必要な列があれば、ネイティブキャッシュに変換して持つ
+    bool benefits_from_cache() const override { return true; }
+
+private:
+    std::string m_filepath;
+    std::shared_ptr<MappedFile> m_file;
+    size_t m_num_events = 0;
+    int64_t m_t_offset = 0;
+    std::optional<Resolution> m_resolution;
+    // レコードバッチごとの列 (どの列もビュー。keepalive が mmap または展開・変換済みのバッファを保持する)
+    std::vector<EventStore> m_batches;
+    // 各バッチの先頭のイベント番号 (末尾に総数を置く)
+    std::vector<size_t> m_batch_first;
+    // 全バッチでファイルを直接参照している列 (EventColumn の論理和)
+    unsigned m_mapped_columns = 0;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include "event_store.h"
+#include "time_index.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// 画素ごとの ON/OFF イベント数の累積 (キーフレーム)
+//   K_j: 時刻が time(j) = t_first + j * interval より前のイベントを画素ごとに数えたもの (K_0 = 0)
+// 時間窓 [s, e) の数は K(e) - K(s) なので、s・e に近いキーフレームの差と、キーフレームから窓の端までのイベントだけで求まる
+// (窓の長さやシーク先によらず、ほぼ一定の手間)
+// 数は蓄積テクスチャと同じ並び: [層 (0: ON, 1: OFF)][行 (センサーの下端が0行目)][列]
+// 全数 (uint32) を持つのは FULL_EVERY 個おきのキーフレームだけで、それ以外は直前の区間の数 D_j = K_j - K_{j-1} を
+// uint8 で持つ (1キーフレームあたり 約1.5 B/要素。全数だけの 4 B/要素 の2.5倍以上のキーフレームが上限に収まる)
+// 1区間で 255 を超えた画素 (ホットピクセルなど) は、超えた分を (要素, 数) の組で別に持つ
+class CountKeyframes {
+public:
+    using SliceReader = std::function<EventStore(size_t begin, size_t count)>;
+
+    // 全数を持つキーフレームの間隔 (差を求めるときに足す区間の数は最大で 2 * (FULL_EVERY - 1))
+    static constexpr size_t FULL_EVERY = 8;
+
+    CountKeyframes() = default;
+
+    // 全イベント [0, num_events) のキーフレームを間隔ごとに並列に数えて作る
+    // 全キーフレームが memory_bytes に収まるまで間隔を2倍ずつ広げる (広げたかは interval_us() で分かる)
+    // 2つも収まらなければ空のまま返す
+    static CountKeyframes build(size_t num_events, const SliceReader& read_slice, const TimeIndex& index, int64_t t_offset,
+                                int width, int height, int64_t interval_us, size_t memory_bytes);
+
+    bool empty() const { return m_num_keyframes == 0; }
+    size_t size() const { return m_num_keyframes; }
+    int64_t interval_us() const { return m_interval_us; }
+    int64_t time(size_t j) const { return m_t_first + static_cast<int64_t>(j) * m_interval_us; }
+    // t に最も近いキーフレーム
+    size_t nearest(int64_t t) const;
+    // K_b - K_a を out[0, 2 * width * height) に書き込む (画素ごとに並列)
+    void difference(size_t a, size_t b, uint32_t* out) const;
+    size_t memory_bytes() const { return m_memory_bytes; }
+
+private:
+    // out[lo, hi) に区間の数 D_j (from < j <= to) を足す (subtract なら引く)
+    void add_intervals(size_t from, size_t to, size_t lo, size_t hi, bool subtract, uint32_t* out) const;
+
+    int64_t m_t_first = 0;
+    int64_t m_interval_us = 0;
+    size_t m_num_keyframes = 0;
+    size_t m_frame_size = 0; // 1キーフレームの要素数 (2 * width * height)
+    size_t m_memory_bytes = 0;
+    std::vector<uint32_t> m_full;                // K_(f * FULL_EVERY) を f の順に
+    std::vector<uint8_t> m_intervals;            // min(D_j, 255) を j の順に (D_0 の場所は使わない)
+    std::vector<std::vector<std::pair<size_t, uint32_t>>> m_overflow; // D_j の 255 を超えた分 (要素の順)
+};
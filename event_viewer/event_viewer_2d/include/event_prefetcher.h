@@ -0,0 +1,125 @@
+#pragma once
+#include "event_source.h"
+#include "event_store.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 先読みの単位となる、連続したイベント列
+struct EventSegment {
+    size_t index = 0;       // セグメント番号 (ファイル先頭から segment_events * stride 個ごと)
+    int64_t t_first = 0;    // µs (t_offset を含まない)
+    int64_t t_last = 0;
+    EventStore events;      // stride 個おきに読み込んだイベント
+};
+
+// ストリーミング再生の設定
+struct PrefetchConfig {
+    double lookahead_ms = 500.0;             // 等速再生時に先読みする再生時間。再生速度に比例して伸び縮みする
+    size_t segment_events = size_t(1) << 18; // 1セグメントのイベント数
+    size_t max_buffer_bytes = size_t(512) << 20; // 先読み済みセグメントが使うホストメモリの上限
+    size_t stride = 1;                        // ダウンサンプリング係数
+};
+
+// 再生位置の通知 (描画スレッド -> 先読みスレッド)
+struct PlaybackRequest {
+    int64_t playhead_us = 0; // 現在の再生位置 (µs, t_offset を含まない)
+    int64_t window_us = 0;   // 表示しているタイムウィンドウ [playhead - window, playhead] の幅
+    double speed = 1.0;
+    bool reversed = false;
+};
+
+// [begin, end) の時刻範囲
+struct TimeRange {
+    int64_t begin = 0;
+    int64_t end = 0;
+};
+
+// 再生位置の周辺と進行方向のイベントをバックグラウンドスレッドで読み込み、描画スレッドへ渡す
+// 描画スレッドとのやり取りはロックフリーの SPSC キューだけで行い、描画スレッドは I/O を待たない
+//
+//   描画スレッド: update() で再生位置を通知 -> poll() で読み込み済みセグメントを受け取る
+//                 -> 必要なくなったら release() で返す
+//   先読みスレッド: 表示中のウィンドウ -> 進行方向の先読み範囲の順に、まだ渡していないセグメントを読む
+//
+// セグメントは固定個数のプールから使い回すため、ファイルの長さに関係なくメモリ使用量は一定になる
+// 先読みスレッドの展開 (HDF5 のチャンクや圧縮ブロック) は専用のスレッドプールで並列化し、描画スレッドの並列処理と取り合わない
+class EventPrefetcher {
+public:
+    EventPrefetcher(std::unique_ptr<EventSource> source, const PrefetchConfig& config);
+    ~EventPrefetcher();
+
+    EventPrefetcher(const EventPrefetcher&) = delete;
+    EventPrefetcher& operator=(const EventPrefetcher&) = delete;
+
+    // 以下はすべて描画スレッドから呼ぶ
+    int64_t t_offset() const { return m_t_offset; }
+    int64_t t_first() const { return m_t_first; }
+    int64_t t_last() const { return m_t_last; }
+    size_t segment_events() const { return m_config.segment_events; }
+    // 同時に存在し得るセグメント数 (描画側はこの数だけ GPU 上の領域を確保すればよい)
+    size_t max_segments() const { return m_pool.size(); }
+
+    void update(const PlaybackRequest& request);
+    // 読み込み済みのセグメントがあれば受け取る (ブロックしない)。先読みスレッドで起きた例外はここで再送出する
+    EventSegment* poll();
+    void release(EventSegment* segment);
+
+    // request に対して手元に置いておくべき時刻範囲 (表示中のウィンドウ + 進行方向の先読み)
+    // 先読みスレッドと描画スレッドの両方がこれを使い、読み込み・解放の判断を一致させる
+    TimeRange wanted_range(const PlaybackRequest& request) const;
+
+private:
+    void worker_loop();
+    // 次に読むべきセグメント番号を返す (無ければ false)
+    bool next_segment(const PlaybackRequest& request, size_t& index);
+    void load_segment(size_t index, EventSegment& segment);
+
+    std::unique_ptr<EventSource> m_source;
+    PrefetchConfig m_config;
+    size_t m_num_events = 0;
+    size_t m_num_segments = 0;
+    int64_t m_t_offset = 0;
+    int64_t m_t_first = 0;
+    int64_t m_t_last = 0;
+
+    // セグメントの実体。以下のいずれか1か所にだけ存在する:
+    // m_free (先読みスレッド) / m_ready / 描画スレッド / m_released
+    std::vector<std::unique_ptr<EventSegment>> m_pool;
+    std::vector<EventSegment*> m_free;
+    std::unique_ptr<SpscQueue<EventSegment*>> m_ready;
+    std::unique_ptr<SpscQueue<EventSegment*>> m_released;
+    // 先読みスレッドが渡したまま返却されていないセグメント番号
+    std::vector<bool> m_live;
+
+    // 直前の再生位置に対する読み込み対象のセグメント範囲 (先読みスレッドのみが使う)
+    struct Plan {
+        bool valid = false;
+        bool empty = true;
+        TimeRange range;
+        int64_t playhead_us = 0;
+        size_t first = 0;
+        size_t last = 0;
+        size_t anchor = 0;
+    };
+    Plan m_plan;
+
+    // 再生位置 (描画スレッドが書き、先読みスレッドが読む)
+    std::atomic<int64_t> m_playhead_us{0};
+    std::atomic<int64_t> m_window_us{0};
+    std::atomic<double> m_speed{1.0};
+    std::atomic<bool> m_reversed{false};
+
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_failed{false};
+    std::exception_ptr m_error;
+    // 先読みスレッドの ThreadPool::shared()
+    ThreadPool m_decode_pool;
+    std::thread m_worker;
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include "types.h"
+#include "event_store.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- ライブ入力のパケット形式 (リトルエンディアン) ---
+// UDP では1データグラムが1パケット、TCP / Unix ソケットではパケットを連続して送る
+//   LivePacketHeader | LiveEventRecord x num_events
+constexpr char LIVE_PACKET_MAGIC[4] = {'E', 'V', 'L', 'P'};
+constexpr uint16_t LIVE_PACKET_VERSION = 1;
+// 1パケットあたりのイベント数の上限 (UDP の1データグラムに収まる数)
+constexpr uint32_t LIVE_MAX_PACKET_EVENTS = 8000;
+// 通し番号がこれより大きく戻ったら (または0に戻ったら) 送信側の再起動とみなす。これ以内の戻りは並べ替えで遅れたパケット
+constexpr uint32_t LIVE_RESTART_SEQUENCE_GAP = 1024;
+
+struct LivePacketHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_bytes;  // sizeof(LivePacketHeader)。将来の拡張用
+    uint32_t sequence;      // 送信側の通し番号 (0から。欠落・並べ替え・再起動の検出に使う)
+    uint32_t num_events;
+    uint16_t width;         // センサー解像度
+    uint16_t height;
+    uint32_t reserved;
+    int64_t t_base_us;      // このパケットのイベント時刻の基準 (µs)
+    int64_t send_time_us;   // 送信時刻 (system_clock の µs)。遅延の計測に使う
+};
+static_assert(sizeof(LivePacketHeader) == 40, "LivePacketHeader must be packed");
+
+struct LiveEventRecord {
+    uint16_t x;
+    uint16_t y;
+    uint32_t dt_p;          // (t - t_base_us) << 1 | p
+};
+static_assert(sizeof(LiveEventRecord) == 8, "LiveEventRecord must be packed");
+
+// 接続先の指定: udp://host:port, tcp://host:port, unix:///path/to/socket
+struct LiveEndpoint {
+    enum class Protocol { UDP, TCP, UNIX };
+    Protocol protocol = Protocol::UDP;
+    std::string host;
+    uint16_t port = 0;
+    std::string path;
+
+    // 解釈できない場合は std::runtime_error を投げる
+    static LiveEndpoint parse(const std::string& address);
+    std::string str() const;
+};
+
+// system_clock の現在時刻 (µs)。送信側と受信側で共通の時計として使う
+int64_t live_clock_us();
+
+// 受信したイベントを保持する固定容量のリングバッファ (書き込み1スレッド・読み出し1スレッド)
+// 満杯になると古いイベントから上書きする。読み出し側は書き込みを止めずに最新のイベントを取り出せる
+class LiveEventRing {
+public:
+    explicit LiveEventRing(size_t capacity);
+
+    size_t capacity() const { return m_mask + 1; }
+    // これまでに書き込まれたイベントの総数 (イベント i はスロット i & (capacity - 1) にある)
+    uint64_t head() const { return m_head.load(std::memory_order_acquire); }
+
+    // 書き込み側: events を追加してから head を進める (1回の追加は LIVE_MAX_PACKET_EVENTS 個まで)
+    void push(const LiveEventRecord* records, size_t count, int64_t t_base_us);
+
+    // 読み出し側: [begin, end) を dst にコピーし、上書きされずに読めた先頭のインデックスを返す
+    // 戻り値より前の要素は書き込み側に上書きされた可能性があるため、呼び出し側は使ってはならない
+    uint64_t read(uint64_t begin, uint64_t end, EventStore& dst) const;
+
+private:
+    // head を読んだ時点で、上書き中の可能性がない最古のインデックス
+    uint64_t oldest_valid(uint64_t head) const;
+
+    std::vector<uint16_t> m_x;
+    std::vector<uint16_t> m_y;
+    std::vector<uint8_t> m_p;
+    std::vector<int64_t> m_t;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<uint64_t> m_head{0};
+};
+
+// 受信統計 (受信スレッドが更新し、描画スレッドがいつでも読める)
+struct LiveStats {
+    uint64_t packets = 0;
+    uint64_t events = 0;
+    uint64_t lost_packets = 0;     // 通し番号の欠落 (UDP での取りこぼし)
+    uint64_t late_packets = 0;     // 並べ替えで遅れて届き、捨てたパケット
+    uint64_t invalid_packets = 0;  // 形式が正しくないパケット
+    double latency_mean_ms = 0.0;  // 送信 -> 受信 (リングに書き込むまで)
+    double latency_max_ms = 0.0;
+};
+
+// パケットの受信時刻。描画側がリングから取り出すまでの遅延を計るために使う
+struct LivePacketMark {
+    uint64_t end_index;     // このパケットの最後のイベントの次のインデックス
+    int64_t receive_time_us;
+};
+
+// ソケットからパケットを受信してリングバッファに書き込むスレッド
+// UDP は bind して待ち受け、TCP / Unix ソケットは listen して送信側の接続を1つずつ受け付ける
+class LiveEventReceiver {
+public:
+    LiveEventReceiver(const LiveEndpoint& endpoint, size_t ring_capacity);
+    ~LiveEventReceiver();
+
+    LiveEventReceiver(const LiveEventReceiver&) = delete;
+    LiveEventReceiver& operator=(const LiveEventReceiver&) = delete;
+
+    const LiveEndpoint& endpoint() const { return m_endpoint; }
+    const LiveEventRing& ring() const { return m_ring; }
+
+    // 最初のパケットが届くまで待ち、そのヘッダのセンサー解像度を返す (timeout 経過で nullopt)
+    std::optional<Resolution> wait_for_resolution(std::chrono::milliseconds timeout) const;
+
+    LiveStats stats() const;
+    // 読み出し側: 受信済みパケットの受信時刻を1つ取り出す (無ければ false)
+    bool pop_mark(LivePacketMark& mark) { return m_marks.try_pop(mark); }
+    // 送信側が最後に (再) 開始したリングのインデックス。ここから時刻の基準が変わる (まだ無ければ UINT64_MAX)
+    // 書き込み側はこれを更新してからイベントを追加するので、head() より前なら該当イベントは読める
+    uint64_t restart_index() const { return m_restart_index.load(std::memory_order_acquire); }
+
+private:
+    void open_socket();
+    void receive_loop();
+    void receive_datagrams();
+    void receive_stream();
+    // パケットを検証してリングに書き込む。不正なら false
+    bool handle_packet(const uint8_t* data, size_t bytes);
+
+    LiveEndpoint m_endpoint;
+    LiveEventRing m_ring;
+    SpscQueue<LivePacketMark> m_marks;
+    int m_socket = -1;
+
+    std::atomic<int> m_width{0};
+    std::atomic<int> m_height{0};
+    std::atomic<uint64_t> m_packets{0};
+    std::atomic<uint64_t> m_events{0};
+    std::atomic<uint64_t> m_lost_packets{0};
+    std::atomic<uint64_t> m_late_packets{0};
+    std::atomic<uint64_t> m_invalid_packets{0};
+    std::atomic<double> m_latency_sum_ms{0.0};
+    std::atomic<double> m_latency_max_ms{0.0};
+    bool m_has_sequence = false;
+    uint32_t m_next_sequence = 0;
+    std::atomic<uint64_t> m_restart_index{UINT64_MAX};
+
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+};
+
+// パケットを送信する側 (live_replay ツールなど)。TCP / Unix ソケットは接続できるまで待つ
+class LiveEventSender {
+public:
+    explicit LiveEventSender(const LiveEndpoint& endpoint);
+    ~LiveEventSender();
+
+    LiveEventSender(const LiveEventSender&) = delete;
+    LiveEventSender& operator=(const LiveEventSender&) = delete;
+
+    // events [begin, begin + count) を1パケットとして送る (count は LIVE_MAX_PACKET_EVENTS 以下)
+    void send(const EventStore& events, size_t begin, size_t count, Resolution resolution);
+
+private:
+    LiveEndpoint m_endpoint;
+    int m_socket = -1;
+    uint32_t m_sequence = 0;
+    std::vector<uint8_t> m_buffer;
+};
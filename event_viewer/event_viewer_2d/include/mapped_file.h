@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// ファイル (またはその一部) を読み取り専用で mmap する
+// ページは実際に参照されたときに読み込まれ、OSのページキャッシュは複数のプロセス・起動間で共有される
+class MappedFile {
+public:
+    // ファイル全体をマップする。失敗した場合は std::runtime_error を投げる
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    // ファイルの [offset, offset + length) をマップする (offset はページ境界でなくてもよい)
+    static std::shared_ptr<MappedFile> open(const std::string& path, uint64_t offset, size_t length);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    // [offset, offset + length) を近いうちに読むことをOSに伝え、先読みさせる
+    void prefetch(size_t offset, size_t length) const;
+
+    static size_t page_size();
+
+private:
+    MappedFile() = default;
+
+    void* m_base = nullptr;     // mmap が返したページ境界のアドレス
+    size_t m_mapped_length = 0;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include "event_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// NumPy の .npy / .npz に保存されたイベントを読み込む
+// 対応する配置:
+//   - 構造化配列の .npy (フィールド x, y, p, t)
+//   - 列ごとの .npy (同じディレクトリの x.npy, y.npy, p.npy, t.npy。どれか1つのパスを指定する)
+//   - .npz (np.savez / np.savez_compressed): 列ごとのメンバ x, y, p, t、または構造化配列のメンバ1つ
+// 列名は p = pol / polarity、t = ts / timestamp なども受け付ける。
+// t は整数なら µs、浮動小数なら秒、datetime64 / timedelta64 なら単位に従って µs に換算する
+//
+// ファイル上の型が列の型 (x, y: uint16, p: uint8, t: int64 µs) と一致し、データの位置が整列している列は
+// mmap へのビューとしてコピーせずに返す。それ以外の列 (構造化配列のフィールド、型の異なる列、圧縮された .npz のメンバ) は
+// 開くときに並列に変換・展開してメモリに持つ
+class NumpyReader : public EventSource {
+public:
+    static constexpr const char* NPY_EXTENSION = ".npy";
+    static constexpr const char* NPZ_EXTENSION = ".npz";
+
+    explicit NumpyReader(const std::string& filepath);
+    ~NumpyReader() override;
+
+    int64_t load_t_offset() override { return 0; }
+    size_t num_events() override { return m_num_events; }
+    // 列へのビューを返す (stride == 1 ならコピーしない)
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    bool is_memory_mapped(unsigned columns = EVENT_COLUMNS_ALL) override { return (columns & ~m_mapped_columns) == 0; }
+    // 変換・展開が必要な列があれば、ネイティブキャッシュに変換して持つ
+    bool benefits_from_cache() const override { return true; }
+
+    // 画像フレームを読み込む (無ければ空)
+    //   .npz: メンバ frames (N, H, W) / (N, H, W, 3) の uint8 と frame_timestamps (N,)
+    //   .npy: 同じディレクトリの frames.npy と frame_timestamps.npy
+    static std::vector<RGBFrame> load_frames(const std::string& filepath);
+
+private:
+    std::string m_filepath;
+    size_t m_num_events = 0;
+    // 全イベントの列 (どの列もビュー。keepalive が mmap または変換済みのバッファを保持する)
+    EventStore m_columns;
+    // ファイルを直接参照している列 (EventColumn の論理和)
+    unsigned m_mapped_columns = 0;
+};
@@ -2,23 +2,67 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <functional>
+#include <optional>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "types.h"
+#include "event_store.h"
+#include "compressed_event_store.h"
+#include "time_index.h"
+#include "count_keyframes.h"
+#include "event_prefetcher.h"
+#include "live_event_source.h"
 #include "camera.h"
 #include "shader.h"
 #include "viewer_state.h"
 #include <glm/glm.hpp>
 
-// 頂点データ構造をfloatタイムスタンプに対応
+// 頂点データ構造
+// 時刻は基準時刻 (Renderer::m_base_time) からの µs を下位32bitと上位8bitに分けて持ち、シェーダーで整数のまま比較する
+// (floatでは約16.7秒を超えると1µsを表せないため)。40bitで約12.7日まで表せる
 struct EventVertex {
     float x, y;
-    float timestamp;
+    uint32_t time_lo;
     uint8_t polarity;
-    uint8_t padding[3]; // 16バイトアライメントのためのパディング
+    uint8_t time_hi;
+    uint8_t padding[2]; // 16バイトアライメントのためのパディング
 };
 
+// EventVertex で表せる基準時刻からの最大の µs
+constexpr int64_t MAX_VERTEX_TIME_US = (int64_t(1) << 40) - 1;
+
+// Format of the off-screen texture that accumulates ON/OFF counts per pixel
+enum class AccumulationFormat {
+    RG32F, // exact counts up to 2^24 per pixel
+    RG16F, // exact counts up to 2048, half the memory
+    RGBA8, // counts saturate at 255
+};
+
+// How events in the time window are counted into the accumulation texture
+enum class AccumulationPath {
+    AUTO,    // compute when the GL 4.3 context allows it and the window holds many events, points otherwise
+    POINTS,  // one GL_POINTS primitive per event with additive blending
+    COMPUTE, // compute pass that reads the culled vertices as an SSBO and does imageAtomicAdd into R32UI counts
+};
+
+// Rendering settings from the 'rendering' section of the config
+struct RenderOptions {
+    AccumulationFormat accumulation = AccumulationFormat::RG32F;
+    AccumulationPath path = AccumulationPath::AUTO;
+    // Keep the counts across frames and only add/subtract the events entering/leaving the window
+    bool incremental = true;
+    // Per-pixel count keyframes for loaded recordings (memory 0 disables them)
+    int64_t keyframe_interval_us = 100000;
+    size_t keyframe_memory_mb = 256;
+    Colormap colormap = Colormap::DOMINANCE;
+};
+
+std::optional<AccumulationFormat> parse_accumulation_format(const std::string& name);
+std::optional<AccumulationPath> parse_accumulation_path(const std::string& name);
+std::optional<Colormap> parse_colormap(const std::string& name);
+
 class Renderer {
 public:
     Renderer(int width, int height, const std::string& title);
@@ -27,14 +71,78 @@ public:
     Renderer(const Renderer&) = delete;
     Renderer& operator=(const Renderer&) = delete;
 
-    void run(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
+    // time_index may be empty (it is then built while the events are uploaded)
+    void run(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
+    void run(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
+    // Applies to the next run()
+    void setRenderOptions(const RenderOptions& options);
+
+    // Streaming playback: events around the playhead are fed in by the prefetcher while playing
+    void run(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
+    // Live input: draws the most recent time window straight from the receiver's ring buffer
+    void run(LiveEventReceiver& receiver, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
 
 private:
+    // Returns events [begin, begin + count) from whichever store backs the session
+    using EventSliceReader = std::function<EventStore(size_t begin, size_t count)>;
+    // Vertices [first, first + count) of m_event_vbo
+    struct VertexRange {
+        size_t first;
+        size_t count;
+    };
+
     void init();
     void setupCallbacks();
-    void loadData(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset);
+    void start(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
+    void loadData(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset);
+    void createEventBuffer(size_t capacity);
+    // Converts events to vertices at first_vertex in m_event_vbo; writes their absolute timestamps if timestamps is given
+    void uploadEvents(const EventStore& events, size_t first_vertex, int64_t t_offset, int64_t* timestamps = nullptr);
+    // Advances the playback clock by delta_us, carrying the sub-microsecond remainder to the next frame
+    void advanceClock(double delta_us);
+    // Sets the shader's time window [start_t, end_t) (absolute µs) relative to m_base_time
+    void setTimeWindowUniforms(const Shader& shader, int64_t start_t, int64_t end_t);
+    // Exchanges segments with the prefetcher for the current playhead (streaming only)
+    void streamEvents();
+    // Uploads events that arrived since the last frame into the live ring of m_event_vbo (live only)
+    void receiveLiveEvents();
+    // Reads ring events [begin, end), uploads them to their slots and returns the first index actually read
+    uint64_t uploadLiveEvents(uint64_t begin, uint64_t end);
+    // Appends the vertex ranges holding events in [start_t, end_t) and returns how many events they hold
+    size_t appendRanges(int64_t start_t, int64_t end_t, std::vector<VertexRange>& ranges) const;
+    void appendLiveRanges(int64_t start_t, int64_t end_t, std::vector<VertexRange>& ranges) const;
+    void printLiveStats();
     void mainLoop();
-    void renderScene();
+    // Accumulates and composes what changed since the last frame; returns false when the last frame is still current
+    bool renderScene();
+    // Counts the events of [start_t, end_t) into m_event_texture (and its max reduction when a colormap needs it)
+    void accumulateEvents(int64_t start_t, int64_t end_t);
+    // Draws the image and the counts in m_event_texture to the screen
+    void composeFrame();
+    bool normalizeCounts() const { return m_state.display_mode != DisplayMode::RGB_ONLY && m_state.colormap != Colormap::DOMINANCE; }
+    // Creates the accumulation FBO and the chain of textures that reduce it to its maximum
+    void createAccumulationTargets();
+    // Reduces the accumulated counts to a 1x1 texture holding (max ON+OFF, max |ON-OFF|)
+    void reduceMaxCounts();
+    // Creates the R32UI count texture used by the compute path
+    void createComputeTargets();
+    // Adds (or subtracts) the events of ranges within [start_t, end_t) to the counts of either path
+    void accumulatePoints(const std::vector<VertexRange>& ranges, int64_t start_t, int64_t end_t, bool subtract);
+    void accumulateCompute(const std::vector<VertexRange>& ranges, int64_t start_t, int64_t end_t, bool subtract);
+    // Copies the compute path's counts into m_event_texture
+    void resolveCounts();
+    bool useComputePath(size_t num_events) const;
+    // Collects the events entering and leaving the window since the last frame into m_added_ranges / m_removed_ranges.
+    // Returns false when the counts have to be rebuilt instead
+    bool collectWindowChanges(int64_t start_t, int64_t end_t, size_t window_events);
+    // Drops the kept counts if events in [t_first, t_last] (absolute µs) appeared or disappeared
+    void invalidateAccumulation(int64_t t_first, int64_t t_last);
+    // Collects the events between the keyframes nearest to the window edges and the edges themselves.
+    // Returns false when accumulating the whole window is cheaper
+    bool collectKeyframeEdges(int64_t start_t, int64_t end_t, size_t window_events, bool compute);
+    // Writes K_b - K_a of the chosen keyframes into the counts of either path
+    void uploadKeyframeDifference(bool compute);
+    void printAccumulationStats();
     void cleanup();
 
     glm::vec3 m_bg_color;
@@ -49,28 +157,117 @@ private:
     
     Camera m_camera;
     ViewerState m_state;
-    double m_current_time_us = 0.0;
+    // Playback position in µs after m_base_time (the absolute µs that vertex time 0 stands for)
+    int64_t m_current_time_us = 0;
+    double m_clock_remainder_us = 0.0;
     
+    // Render on demand: set when the composed frame or the accumulated counts are out of date for reasons other
+    // than the clock (camera, window, display settings / data, accumulation settings)
+    bool m_frame_dirty = true;
+    bool m_accum_dirty = true;
+    int64_t m_composed_end_t = 0; // window end of the last composed frame
+
     bool m_is_mouse_dragging = false;
     double m_last_x = 0.0, m_last_y = 0.0;
 
     std::unique_ptr<Shader> m_event_accum_shader;
     std::unique_ptr<Shader> m_quad_shader;
+    std::unique_ptr<Shader> m_reduce_shader;
+    std::unique_ptr<Shader> m_accum_compute_shader;
+    std::unique_ptr<Shader> m_resolve_shader;
 
     GLuint m_event_vao = 0, m_event_vbo = 0;
     GLuint m_quad_vao = 0, m_quad_vbo = 0;
     
     GLuint m_event_fbo = 0;
     GLuint m_event_texture = 0;
+    AccumulationFormat m_accumulation_format = AccumulationFormat::RG32F;
+
+    // Max reduction: each level is 1/4 the size of the previous one, down to 1x1
+    struct ReductionLevel {
+        GLuint fbo = 0;
+        GLuint texture = 0;
+        int width = 0, height = 0;
+    };
+    std::vector<ReductionLevel> m_reduction_levels;
+
+    // Compute path: per-pixel counts in a two-layer R32UI array (layer 0: ON, layer 1: OFF)
+    AccumulationPath m_accumulation_path = AccumulationPath::AUTO;
+    bool m_compute_available = false;
+    GLuint m_count_texture = 0;
+    GLuint m_count_fbo = 0; // layered attachment, only used to clear the counts
+    // Vertex ranges inside the current time window
+    std::vector<VertexRange> m_accum_ranges;
+
+    // Incremental accumulation: the counts of the window [m_accum_start_t, m_accum_end_t) are kept across frames.
+    // Float32 point targets and the R32UI counts subtract exactly; float16/RGBA8 point targets are redrawn every frame
+    bool m_incremental = true;
+    bool m_accum_valid = false;
+    bool m_accum_compute = false; // which path holds the kept counts
+    int64_t m_accum_start_t = 0;
+    int64_t m_accum_end_t = 0;
+    std::vector<VertexRange> m_added_ranges;
+    std::vector<VertexRange> m_removed_ranges;
+    uint64_t m_accum_rebuilds = 0;
+
+    // Count keyframes: a rebuild of a long window starts from K_b - K_a and only accumulates the edges
+    CountKeyframes m_keyframes;
+    int64_t m_keyframe_interval_us = 100000;
+    size_t m_keyframe_memory_bytes = 0;
+    size_t m_keyframe_a = 0, m_keyframe_b = 0; // keyframes of the pending rebuild
+    std::vector<uint32_t> m_keyframe_diff;     // K_b - K_a of the last uploaded pair, kept for repeated rebuilds
+    size_t m_keyframe_diff_a = 0, m_keyframe_diff_b = 0;
+    std::vector<float> m_keyframe_upload;      // the same as interleaved RG floats for the point path
+    uint64_t m_keyframe_rebuilds = 0;
+    // Accumulation timing (T key): GPU time of the accumulation pass from a timer query
+    bool m_report_accumulation = false;
+    GLuint m_accum_query = 0;
+    bool m_accum_query_pending = false;
+    bool m_last_accum_compute = false;
+    size_t m_last_accum_events = 0;
+    double m_accum_time_sum_ms = 0.0;
+    uint64_t m_accum_frames = 0;
+    uint64_t m_accum_events_sum = 0;
+    uint64_t m_accum_compute_frames = 0;
+    double m_accum_last_report_time = 0.0;
 
     std::vector<GLuint> m_image_textures;
     const std::vector<RGBFrame>* m_all_images_ptr = nullptr;
-    
-    size_t m_event_count = 0;
-    double m_base_time = 0.0;
+    TimeIndex m_image_index;
+
+    int64_t m_base_time = 0;
+
+    // A run of vertices in m_event_vbo: the whole recording, or one streamed segment
+    struct EventBatch {
+        size_t first_vertex = 0;
+        // CPUカリング（パフォーマンス改善）のために時刻 → 頂点の索引を保持
+        TimeIndex time_index;
+        EventSegment* segment = nullptr; // streaming only
+    };
+    std::vector<EventBatch> m_event_batches;
+
+    // Streaming: m_event_vbo is split into one slot per prefetcher segment
+    EventPrefetcher* m_prefetcher = nullptr;
+    std::vector<size_t> m_free_slots;
+    std::vector<EventVertex> m_upload_vertices;
 
-    // CPUカリング（パフォーマンス改善）のためにタイムスタンプのリストを保持
-    std::vector<float> m_event_timestamps;
+    // Live input: vertex i of the ring lives in slot (i & (capacity - 1)) of m_event_vbo
+    LiveEventReceiver* m_live = nullptr;
+    bool m_live_started = false;
+    uint64_t m_live_uploaded = 0;    // ring index up to which events have been uploaded
+    uint64_t m_live_valid_begin = 0; // oldest ring index whose slot still holds a drawable vertex
+    int64_t m_live_last_t = 0;
+    uint64_t m_live_restart_seen = UINT64_MAX; // last LiveEventReceiver::restart_index() applied
+    std::vector<int64_t> m_live_timestamps; // absolute µs per ring slot
+    EventStore m_live_staging;
+    // Per-packet latency from receipt to GPU upload, reported with the receiver's counters
+    std::optional<LivePacketMark> m_live_pending_mark;
+    double m_live_upload_latency_sum_ms = 0.0;
+    double m_live_upload_latency_max_ms = 0.0;
+    uint64_t m_live_upload_latency_count = 0;
+    uint64_t m_live_overwritten = 0;
+    double m_live_last_stats_time = 0.0;
+    LiveStats m_live_last_stats;
     
     void onKey(int key, int scancode, int action, int mods);
     void onMouseButton(int button, int action, int mods);
@@ -79,4 +276,7 @@ private:
     void onFramebufferSize(int width, int height);
 };
 
-void run_renderer(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color);
\ No newline at end of file
+void run_renderer(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options);
+void run_renderer(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options);
+void run_renderer(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int width, int height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options);
+void run_renderer(LiveEventReceiver& receiver, const std::vector<RGBFrame>& all_images, int width, int height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options);
\ No newline at end of file
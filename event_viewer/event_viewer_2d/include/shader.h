@@ -1,20 +1,28 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 class Shader {
 public:
     Shader(const std::string& vertexPath, const std::string& fragmentPath);
+    // Compute shader program (GL 4.3)
+    explicit Shader(const std::string& computePath);
     ~Shader();
 
     void use() const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
     void setFloat(const std::string& name, float value) const;
+    void setInt(const std::string& name, int value) const;
+    void setUInt(const std::string& name, GLuint value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const; // ★追加
+    void setUVec2(const std::string& name, GLuint x, GLuint y) const;
+    void setIVec2(const std::string& name, int x, int y) const;
 
 
 private:
     GLuint m_id;
     GLuint loadAndCompile(const std::string& path, GLenum shaderType);
+    void link(const std::vector<GLuint>& shaders);
 };
\ No newline at end of file
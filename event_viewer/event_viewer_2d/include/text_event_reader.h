@@ -0,0 +1,38 @@
+#pragma once
+#include "event_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+// 1行1イベントのテキストファイル (ECD などの events.txt) を読み込む
+// 各行は "t x y p" (区切りは空白・タブ・カンマ)。p は 0 / 1 または -1 / 1
+// 先頭の '#' / '%' で始まる行や列名の行は読み飛ばし、"width height" の2つの整数だけの行があれば解像度とみなす
+//
+// t の単位は自動で判定する:
+//   - 小数点を含む (例: 0.003811) → 秒。小数部を整数のまま µs に丸める (double を経由しない)
+//   - 整数 → µs。ただし値の範囲が µs としては大きすぎる場合 (27時間を超える、または Unix 時刻の ns) は ns とみなす
+//
+// 開いたときにファイルを mmap し、改行位置で区間に分けて並列に解釈する。1パス目で区間ごとの行数を数え、
+// 2パス目で出力の列へ直接書き込む。テキストの解釈は遅いため、結果はネイティブキャッシュに変換して持つ
+// (2回目以降はキャッシュを開くので、テキストは一度しか解釈しない)
+class TextEventReader : public EventSource {
+public:
+    static constexpr const char* EXTENSION = ".txt";
+
+    explicit TextEventReader(const std::string& filepath);
+    ~TextEventReader() override;
+
+    int64_t load_t_offset() override { return 0; }
+    size_t num_events() override;
+    // 解釈済みの列へのビューを返す (stride == 1 ならコピーしない)
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    std::optional<Resolution> resolution() override { return m_resolution; }
+    bool benefits_from_cache() const override { return true; }
+
+private:
+    std::string m_filepath;
+    std::optional<Resolution> m_resolution;
+    std::shared_ptr<const EventStore> m_events;
+};
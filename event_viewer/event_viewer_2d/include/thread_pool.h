@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定サイズのワーカースレッドプール
+// parallel_for() は呼び出しスレッド自身も処理に参加し、全インデックスの処理が終わるまで戻らない
+class ThreadPool {
+public:
+    // num_threads = 0 のときはハードウェアのスレッド数に合わせる
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 呼び出しスレッドを含めた並列度
+    size_t concurrency() const { return m_workers.size() + 1; }
+
+    // [0, n) の各インデックスについて fn を並列に実行する
+    // fn の中からの入れ子の parallel_for は (どのスレッドで実行中でも) その場で逐次実行する
+    // fn が投げた例外は最初の1つだけが呼び出し元で再送出される
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+    // アプリケーション全体で共有するプール (Scope で差し替えたスレッドではそのプール)
+    static ThreadPool& shared();
+
+    // 生存している間、このスレッドの shared() を pool に差し替える
+    // バックグラウンドの読み込みを別のプールで並列化し、描画スレッドの parallel_for がその終わりを待たないようにする
+    class Scope {
+    public:
+        explicit Scope(ThreadPool& pool);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ThreadPool* m_previous;
+    };
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* fn = nullptr;
+        size_t size = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> pending{0};
+        std::exception_ptr error;
+    };
+
+    void worker_loop();
+    void run_job(Job& job);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::mutex m_submit_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    std::shared_ptr<Job> m_job;
+    uint64_t m_generation = 0;
+    bool m_stop = false;
+};
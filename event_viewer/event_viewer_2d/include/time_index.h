@@ -0,0 +1,55 @@
+#pragma once
+#include "event_store.h"
+#include <cstddef>
+#include <cstdint>
+
+// 時刻順に並んだ列 (イベント・画像フレーム) の時刻 → 位置の索引
+// 時刻は t_offset を足した絶対時刻 (µs) で、t_base からの経過時間を幅 2^bucket_shift µs のバケットに分ける
+//   buckets[k]: 時刻が t_base + (k << bucket_shift) 以上となる最初の位置
+//   offsets[i]: i 番目の時刻と、それが入るバケットの先頭時刻との差 (16bit。バケットが 2^16 µs より広ければ上位16bit)
+// バケットは時刻から直接求まり、その中は16bitの差だけを二分探索するので、記録の長さによらず一定時間で位置が引ける
+// (元の時刻の列を参照しないので、圧縮表現のイベントやキャッシュからも同じように使える)
+// バケット数は max(要素数, 2^16) + 1 個までに抑える。収まるまでバケットを広げ、2^16 µs を超えて広げた場合
+// (疎な長時間の記録・外れた時刻) は差を 2^(bucket_shift - 16) µs 単位に丸めるので、その幅の中の位置は区別しない
+// (lower_bound は手前寄り、upper_bound は後ろ寄りになる)
+// メモリは要素ごとに2バイトの差と、上記の数の8バイトのバケット (密な記録では 約2 B/要素、最悪でも 約10 B/要素)
+class TimeIndex {
+public:
+    static constexpr int EVENT_BUCKET_SHIFT = 10;  // イベント: 1.024 ms
+    static constexpr int FRAME_BUCKET_SHIFT = 16;  // 画像フレーム: 65.536 ms
+    static constexpr int OFFSET_BITS = 16;         // バケット内の差のビット数。これより広いバケットでは差を丸める
+    static constexpr int MAX_BUCKET_SHIFT = 62;
+
+    TimeIndex() = default;
+    // [t_first, t_last] の時刻を size 個持つ索引を用意する。append() で先頭から順に埋める
+    // バケット数が max(size, 2^16) + 1 を超える (疎な長時間の記録・外れた時刻) 場合は、収まるまでバケットを広げる
+    TimeIndex(int64_t t_first, int64_t t_last, size_t size, int bucket_shift = EVENT_BUCKET_SHIFT);
+    // キャッシュから読み込んだ索引
+    TimeIndex(int64_t t_base, int bucket_shift, ColumnBuffer<uint64_t> buckets, ColumnBuffer<uint16_t> offsets);
+
+    // 時刻 t[0, count) (t_offset を足すと絶対時刻) を続きに追加する。大きな範囲はブロックごとに並列に処理する
+    void append(const int64_t* t, size_t count, int64_t t_offset = 0);
+    // 時刻順の t[0, count) の索引を並列に作る
+    static TimeIndex build(const int64_t* t, size_t count, int64_t t_offset = 0, int bucket_shift = EVENT_BUCKET_SHIFT);
+
+    size_t size() const { return m_offsets.size(); }
+    bool empty() const { return m_offsets.empty(); }
+    // 時刻が t 以上となる最初の位置 / t より大きい最初の位置 (なければ size())
+    size_t lower_bound(int64_t t) const { return find(t, false); }
+    size_t upper_bound(int64_t t) const { return find(t, true); }
+
+    int64_t t_base() const { return m_t_base; }
+    int bucket_shift() const { return m_bucket_shift; }
+    const ColumnBuffer<uint64_t>& buckets() const { return m_buckets; }
+    const ColumnBuffer<uint16_t>& offsets() const { return m_offsets; }
+
+private:
+    size_t find(int64_t t, bool upper) const;
+
+    int64_t m_t_base = 0;
+    int m_bucket_shift = EVENT_BUCKET_SHIFT;
+    ColumnBuffer<uint64_t> m_buckets;
+    ColumnBuffer<uint16_t> m_offsets;
+    size_t m_filled = 0;          // append() で埋めた要素数
+    int64_t m_last_bucket = -1;   // 最後に追加した要素のバケット
+};
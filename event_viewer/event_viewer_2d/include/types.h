@@ -4,14 +4,8 @@
 #include <string>
 #include <cstdint>
 #include <filesystem>
-
-// HDF5からのイベントデータ
-struct EventCD {
-    uint16_t x;
-    uint16_t y;
-    uint8_t  pol; 
-    uint64_t t;
-};
+#include <memory>
+#include <vector>
 
 // レンダリング用の頂点データ
 struct Vertex {
@@ -21,9 +15,14 @@ struct Vertex {
 };
 
 // RGB画像フレームの情報
+// 画像ファイル (image_path) か、イベントファイルに埋め込まれた画像 (pixels) のどちらかを持つ
 struct RGBFrame {
     int64_t timestamp;
     std::string image_path;
+    // 埋め込み画像: width x height の 8bit RGB を下の行から順に並べたもの (stbi の上下反転読み込みと同じ並び)
+    std::shared_ptr<const std::vector<uint8_t>> pixels;
+    int width = 0;
+    int height = 0;
 };
 
 // ImageLoaderの設定
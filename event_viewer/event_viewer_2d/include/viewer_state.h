@@ -6,12 +6,21 @@ enum class DisplayMode {
     RGB_ONLY = 2,
 };
 
+// イベントの蓄積結果の色付け (quad.frag の u_colormap と同じ番号)
+enum class Colormap {
+    DOMINANCE = 0,    // 多い方の極性の色
+    NET_POLARITY = 1, // ON-OFF の符号と大きさ
+    COUNT = 2,        // ON+OFF の数
+};
+
 struct ViewerState {
     float playback_speed = 1.0f;
     bool is_paused = false;
+    bool is_reversed = false;
 
     DisplayMode display_mode = DisplayMode::EVENTS_AND_RGB;
     float rgb_alpha = 0.7f;
     float event_alpha = 1.0f;
+    Colormap colormap = Colormap::DOMINANCE;
     double time_window_us = 20000.0; // 20ms
 };
\ No newline at end of file
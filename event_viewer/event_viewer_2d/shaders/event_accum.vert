@@ -1,22 +1,28 @@
 #version 330 core
 layout (location = 0) in vec2 a_pos;
-layout (location = 1) in float a_timestamp; 
-layout (location = 2) in uint a_polarity;
+layout (location = 1) in uint a_time_lo;
+layout (location = 2) in uvec2 a_polarity_time_hi; // (極性, 時刻の上位ビット)
 
-uniform float u_current_time;
-uniform float u_time_window;
+// 時間窓 [u_window_begin, u_window_end): 基準時刻からの µs を (上位, 下位32bit) に分けたもの
+uniform uvec2 u_window_begin;
+uniform uvec2 u_window_end;
 
 out float v_polarity;
 
+// (上位, 下位) の組を整数のまま比較する (a < b)
+bool time_less(uvec2 a, uvec2 b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
 void main() {
-    float age = u_current_time - a_timestamp;
+    uvec2 t = uvec2(a_polarity_time_hi.y, a_time_lo);
 
     // 時間窓の外にあるイベントはクリップ空間の外に飛ばして描画を棄却
-    if (age < 0.0 || age > u_time_window) {
+    if (time_less(t, u_window_begin) || !time_less(t, u_window_end)) {
         gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
     } else {
         gl_Position = vec4(a_pos, 0.0, 1.0);
         gl_PointSize = 1.0;
-        v_polarity = float(a_polarity);
+        v_polarity = float(a_polarity_time_hi.x);
     }
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+layout (location = 0) in vec2 a_pos; // 画面全体を覆うクアッド (-1..1)
+
+void main() {
+    gl_Position = vec4(a_pos, 0.0, 1.0);
+}
\ No newline at end of file
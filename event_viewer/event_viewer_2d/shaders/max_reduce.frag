@@ -0,0 +1,26 @@
+#version 330 core
+out vec2 FragColor;
+
+// 1つ前の段 (最初の段は蓄積テクスチャ)
+uniform sampler2D u_source;
+// 1: u_source は (ON, OFF) の数、0: u_source は前の段の (最大の総数, 最大の |ON-OFF|)
+uniform int u_first_pass;
+
+// 出力の1画素が入力の 4x4 画素の最大値を持つ
+const int REDUCE_FACTOR = 4;
+
+void main() {
+    ivec2 size = textureSize(u_source, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * REDUCE_FACTOR;
+    vec2 result = vec2(0.0);
+    for (int dy = 0; dy < REDUCE_FACTOR; ++dy) {
+        for (int dx = 0; dx < REDUCE_FACTOR; ++dx) {
+            ivec2 p = base + ivec2(dx, dy);
+            if (p.x >= size.x || p.y >= size.y) continue;
+            vec4 texel = texelFetch(u_source, p, 0);
+            vec2 value = u_first_pass == 1 ? vec2(texel.r + texel.g, abs(texel.r - texel.g)) : texel.rg;
+            result = max(result, value);
+        }
+    }
+    FragColor = result;
+}
\ No newline at end of file
@@ -3,26 +3,56 @@ in vec2 v_tex_coord;
 out vec4 FragColor;
 
 uniform sampler2D u_texture;
+// 1x1 のテクスチャ: (全画素での最大の ON+OFF, 最大の |ON-OFF|)。GPU上の最大値の縮約で求めたもの
+uniform sampler2D u_max_texture;
+// -1: RGB画像をそのまま表示, 0: 優勢な極性, 1: 符号付きの ON-OFF, 2: 総数 (Colormap と同じ番号)
+uniform int u_colormap;
+uniform float u_alpha;
 
 // ★変更: const定義を削除し、uniform変数を追加
 uniform vec3 u_on_color;
 uniform vec3 u_off_color;
 
+// viridis の多項式近似 (t: 0-1)
+vec3 viridis(float t) {
+    const vec3 c0 = vec3(0.2777273272234177, 0.005407344544966578, 0.3340998053353061);
+    const vec3 c1 = vec3(0.1050930431085774, 1.404613529898575, 1.384590162594685);
+    const vec3 c2 = vec3(-0.3308618287255563, 0.214847559468213, 0.09509516302823659);
+    const vec3 c3 = vec3(-4.634230498983486, -5.799100973351585, -19.33244095627987);
+    const vec3 c4 = vec3(6.228269936347081, 14.17993336680509, 56.69055260068105);
+    const vec3 c5 = vec3(4.776384997670288, -13.74514537774601, -65.35303263337234);
+    const vec3 c6 = vec3(-5.435455855934631, 4.645852612178535, 26.3124352495832);
+    return c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6)))));
+}
+
 void main() {
-    vec4 counts = texture(u_texture, v_tex_coord);
+    vec4 texel = texture(u_texture, v_tex_coord);
+    if (u_colormap < 0) {
+        FragColor = vec4(texel.rgb, u_alpha);
+        return;
+    }
 
-    if (counts.r == 0.0 && counts.g == 0.0) {
+    // r: ONイベントの数, g: OFFイベントの数
+    float on = texel.r;
+    float off = texel.g;
+    if (on == 0.0 && off == 0.0) {
         discard;
-        return;
     }
 
-    if (counts.r > counts.g) {
-        // ONイベントが優位なら u_on_color を使う
-        FragColor = vec4(u_on_color, 1.0);
-    } else if (counts.g > counts.r) {
-        // OFFイベントが優位なら u_off_color を使う
-        FragColor = vec4(u_off_color, 1.0);
+    if (u_colormap == 0) {
+        // 多い方の極性の色 (同数なら描かない)
+        if (on == off) discard;
+        FragColor = vec4(on > off ? u_on_color : u_off_color, u_alpha);
+    } else if (u_colormap == 1) {
+        // ON-OFF を最大の |ON-OFF| で正規化し、符号で色を、大きさで不透明度を決める
+        float net = on - off;
+        float max_net = texture(u_max_texture, vec2(0.5)).g;
+        if (net == 0.0 || max_net <= 0.0) discard;
+        FragColor = vec4(net > 0.0 ? u_on_color : u_off_color, abs(net) / max_net * u_alpha);
     } else {
-        discard;
+        // 総数を最大の総数で正規化する (少数の画素だけが多い場面でも見えるよう対数で)
+        float max_count = texture(u_max_texture, vec2(0.5)).r;
+        float level = log(1.0 + on + off) / log(1.0 + max(max_count, 1.0));
+        FragColor = vec4(viridis(clamp(level, 0.0, 1.0)), u_alpha);
     }
 }
\ No newline at end of file
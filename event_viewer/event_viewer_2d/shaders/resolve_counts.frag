@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+// コンピュートシェーダーで数えた画素ごとの数 (層0: ON, 層1: OFF)
+uniform usampler2DArray u_counts;
+// 蓄積テクスチャの1イベントあたりの値 (float なら 1、rgba8 なら 1/255)
+uniform float u_scale;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    uint on = texelFetch(u_counts, ivec3(p, 0), 0).r;
+    uint off = texelFetch(u_counts, ivec3(p, 1), 0).r;
+    FragColor = vec4(float(on) * u_scale, float(off) * u_scale, 0.0, 1.0);
+}
\ No newline at end of file
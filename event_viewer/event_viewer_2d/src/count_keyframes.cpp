@@ -0,0 +1,129 @@
+#include "count_keyframes.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+// 区間ごとのスレッドが一度に読むイベント数 (スレッドごとの一時領域を小さく保つ)
+constexpr size_t READ_EVENTS = size_t(1) << 15;
+// 累積・差分で1スレッドに割り当てる要素数
+constexpr size_t PIXEL_BLOCK = size_t(1) << 16;
+
+} // namespace
+
+CountKeyframes CountKeyframes::build(size_t num_events, const SliceReader& read_slice, const TimeIndex& index, int64_t t_offset,
+                                     int width, int height, int64_t interval_us, size_t memory_bytes) {
+    CountKeyframes keyframes;
+    if (num_events == 0 || index.size() != num_events || width <= 0 || height <= 0 || interval_us <= 0) return keyframes;
+
+    const int64_t t_first = t_offset + read_slice(0, 1).t.front();
+    const int64_t t_last = t_offset + read_slice(num_events - 1, 1).t.front();
+    const size_t plane = static_cast<size_t>(width) * static_cast<size_t>(height);
+    const size_t frame_size = 2 * plane;
+    // 最後のキーフレームが全イベントを含むよう、t_last より後まで並べる
+    auto keyframes_for = [&](int64_t interval) { return static_cast<size_t>((t_last - t_first) / interval) + 2; };
+    auto full_for = [](size_t n) { return (n - 1) / FULL_EVERY + 1; };
+    // 255 を超えた分は見積もりに含めない (ホットピクセルなど、わずかな画素でしか起きない)
+    auto bytes_for = [&](size_t n) {
+        return (full_for(n) * sizeof(uint32_t) + n * sizeof(uint8_t)) * frame_size;
+    };
+    while (bytes_for(keyframes_for(interval_us)) > memory_bytes) {
+        if (keyframes_for(interval_us) <= 2) return keyframes;
+        interval_us *= 2;
+    }
+
+    keyframes.m_t_first = t_first;
+    keyframes.m_interval_us = interval_us;
+    keyframes.m_num_keyframes = keyframes_for(interval_us);
+    keyframes.m_frame_size = frame_size;
+    const size_t n = keyframes.m_num_keyframes;
+    const size_t num_full = full_for(n);
+    keyframes.m_full.assign(num_full * frame_size, 0);
+    keyframes.m_intervals.assign(n * frame_size, 0);
+    keyframes.m_overflow.resize(n);
+
+    // 1. 区間 [time(j - 1), time(j)) のイベントを D_j に数える (区間ごとに並列)
+    //    255 を超えた分は画素ごとに別に数えておき、最後に要素の順に並べる
+    ThreadPool::shared().parallel_for(n - 1, [&](size_t i) {
+        size_t j = i + 1;
+        size_t first = index.lower_bound(keyframes.time(j - 1));
+        size_t last = index.lower_bound(keyframes.time(j));
+        uint8_t* frame = keyframes.m_intervals.data() + j * frame_size;
+        std::unordered_map<size_t, uint32_t> extra;
+        for (size_t begin = first; begin < last; begin += READ_EVENTS) {
+            const EventStore events = read_slice(begin, std::min(READ_EVENTS, last - begin));
+            const uint16_t* xs = events.x.data();
+            const uint16_t* ys = events.y.data();
+            const uint8_t* ps = events.p.data();
+            for (size_t k = 0; k < events.size(); ++k) {
+                // センサーの外の座標は描画でも捨てられる
+                if (xs[k] >= width || ys[k] >= height) continue;
+                size_t row = static_cast<size_t>(height - 1 - ys[k]);
+                size_t e = (ps[k] != 0 ? 0 : plane) + row * width + xs[k];
+                if (frame[e] == UINT8_MAX) {
+                    extra[e]++;
+                } else {
+                    frame[e]++;
+                }
+            }
+        }
+        auto& overflow = keyframes.m_overflow[j];
+        overflow.assign(extra.begin(), extra.end());
+        std::sort(overflow.begin(), overflow.end());
+    });
+
+    // 2. 全数のキーフレームを、前の全数のキーフレームに間の区間を足して作る (画素のブロックごとに並列)
+    size_t blocks = (frame_size + PIXEL_BLOCK - 1) / PIXEL_BLOCK;
+    ThreadPool::shared().parallel_for(blocks, [&](size_t b) {
+        size_t lo = b * PIXEL_BLOCK;
+        size_t hi = std::min(frame_size, lo + PIXEL_BLOCK);
+        for (size_t f = 1; f < num_full; ++f) {
+            uint32_t* cur = keyframes.m_full.data() + f * frame_size;
+            std::copy(cur - frame_size + lo, cur - frame_size + hi, cur + lo);
+            keyframes.add_intervals((f - 1) * FULL_EVERY, f * FULL_EVERY, lo, hi, false, cur);
+        }
+    });
+
+    keyframes.m_memory_bytes = keyframes.m_full.size() * sizeof(uint32_t) + keyframes.m_intervals.size() * sizeof(uint8_t);
+    for (const auto& overflow : keyframes.m_overflow) keyframes.m_memory_bytes += overflow.size() * sizeof(overflow[0]);
+    return keyframes;
+}
+
+void CountKeyframes::add_intervals(size_t from, size_t to, size_t lo, size_t hi, bool subtract, uint32_t* out) const {
+    for (size_t i = from + 1; i <= to; ++i) {
+        const uint8_t* d = m_intervals.data() + i * m_frame_size;
+        const auto& overflow = m_overflow[i];
+        auto it = std::lower_bound(overflow.begin(), overflow.end(), std::make_pair(lo, uint32_t(0)));
+        if (subtract) {
+            for (size_t k = lo; k < hi; ++k) out[k] -= d[k];
+            for (; it != overflow.end() && it->first < hi; ++it) out[it->first] -= it->second;
+        } else {
+            for (size_t k = lo; k < hi; ++k) out[k] += d[k];
+            for (; it != overflow.end() && it->first < hi; ++it) out[it->first] += it->second;
+        }
+    }
+}
+
+size_t CountKeyframes::nearest(int64_t t) const {
+    if (m_num_keyframes == 0 || t <= m_t_first) return 0;
+    size_t j = static_cast<size_t>((t - m_t_first + m_interval_us / 2) / m_interval_us);
+    return std::min(j, m_num_keyframes - 1);
+}
+
+void CountKeyframes::difference(size_t a, size_t b, uint32_t* out) const {
+    // K_j = K_base + D_(base, j] なので K_b - K_a = (K_base(b) - K_base(a)) + D_(base(b), b] - D_(base(a), a]
+    size_t base_a = a / FULL_EVERY * FULL_EVERY;
+    size_t base_b = b / FULL_EVERY * FULL_EVERY;
+    const uint32_t* fa = m_full.data() + a / FULL_EVERY * m_frame_size;
+    const uint32_t* fb = m_full.data() + b / FULL_EVERY * m_frame_size;
+    size_t blocks = (m_frame_size + PIXEL_BLOCK - 1) / PIXEL_BLOCK;
+    ThreadPool::shared().parallel_for(blocks, [&](size_t block) {
+        size_t lo = block * PIXEL_BLOCK;
+        size_t hi = std::min(m_frame_size, lo + PIXEL_BLOCK);
+        // 符号なしの桁あふれは差を取ると打ち消し合う
+        for (size_t k = lo; k < hi; ++k) out[k] = fb[k] - fa[k];
+        add_intervals(base_b, b, lo, hi, false, out);
+        add_intervals(base_a, a, lo, hi, true, out);
+    });
+}
@@ -0,0 +1,421 @@
+#include "event_file.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#ifdef EV_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr char EVENT_FILE_MAGIC[8] = {'E', 'V', 'B', 'L', 'O', 'C', 'K', '\0'};
+constexpr uint32_t EVENT_FILE_VERSION = 1;
+
+enum BlockCodec : uint32_t {
+    CODEC_BITPACK = 0,      // ビットパックのみ
+    CODEC_BITPACK_ZSTD = 1, // ビットパックした後に zstd で圧縮
+};
+
+struct EventFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t num_events;
+    uint64_t num_blocks;
+    uint64_t seek_table_offset;
+    int64_t t_offset;
+    int32_t width;
+    int32_t height;
+};
+
+// ブロック (展開後) の先頭に置く各列のビット幅
+struct BlockLayout {
+    uint8_t bits_x;
+    uint8_t bits_y;
+    uint8_t bits_p;
+    uint8_t bits_t; // t は2番目以降のイベントの差分 (zigzag符号化) のビット幅
+    uint32_t num_events;
+};
+
+// 展開時に8バイト単位で読めるよう、各列のストリームは8バイト境界に揃え、末尾に余白を置く
+constexpr size_t STREAM_PADDING = 8;
+// これ未満のイベント数の読み込みはスレッドに分けない
+constexpr size_t PARALLEL_DECODE_MIN_EVENTS = size_t(1) << 16;
+
+size_t stream_bytes(size_t count, unsigned bits) {
+    size_t bytes = (count * bits + 7) / 8;
+    return (bytes + 7) / 8 * 8 + STREAM_PADDING;
+}
+
+unsigned bits_needed(uint64_t max_value) {
+    unsigned bits = 0;
+    while (bits < 64 && (max_value >> bits) != 0) ++bits;
+    return bits;
+}
+
+uint64_t zigzag_encode(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t zigzag_decode(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// 値を下位ビットから順に詰めていく (リトルエンディアン前提)
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* dst) : m_dst(dst) {}
+
+    void put(uint64_t value, unsigned bits) {
+        if (bits == 0) return;
+        if (bits < 64) value &= (uint64_t(1) << bits) - 1;
+        m_acc |= value << m_filled;
+        if (m_filled + bits >= 64) {
+            std::memcpy(m_dst, &m_acc, sizeof(m_acc));
+            m_dst += sizeof(m_acc);
+            unsigned used = 64 - m_filled;
+            m_acc = (used < 64) ? (value >> used) : 0;
+            m_filled = m_filled + bits - 64;
+        } else {
+            m_filled += bits;
+        }
+    }
+    void flush() {
+        if (m_filled > 0) std::memcpy(m_dst, &m_acc, (m_filled + 7) / 8);
+    }
+
+private:
+    uint8_t* m_dst;
+    uint64_t m_acc = 0;
+    unsigned m_filled = 0;
+};
+
+// i 番目の値 (bits ビット) を取り出す
+inline uint64_t read_bits(const uint8_t* src, size_t index, unsigned bits) {
+    size_t bit = index * bits;
+    uint64_t word;
+    if (bits <= 56) {
+        // 1回の8バイト読み込みに必ず収まる
+        std::memcpy(&word, src + (bit >> 3), sizeof(word));
+        return (word >> (bit & 7)) & ((uint64_t(1) << bits) - 1);
+    }
+    size_t shift = bit & 63;
+    std::memcpy(&word, src + (bit >> 6) * 8, sizeof(word));
+    uint64_t value = word >> shift;
+    if (shift + bits > 64) {
+        uint64_t next;
+        std::memcpy(&next, src + (bit >> 6) * 8 + 8, sizeof(next));
+        value |= next << (64 - shift);
+    }
+    return (bits == 64) ? value : (value & ((uint64_t(1) << bits) - 1));
+}
+
+template <typename T>
+void unpack_column(const uint8_t* src, unsigned bits, size_t count, T* dst) {
+    if (bits == 0) {
+        std::fill(dst, dst + count, T(0));
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<T>(read_bits(src, i, bits));
+    }
+}
+
+// 1ブロック分のイベントをビットパックした形式 (展開後のペイロード) に変換する
+std::vector<uint8_t> encode_block(const EventStore& events, size_t first, size_t count, uint16_t& max_x, uint16_t& max_y) {
+    BlockLayout layout{};
+    layout.num_events = static_cast<uint32_t>(count);
+    max_x = 0;
+    max_y = 0;
+    uint8_t max_p = 0;
+    uint64_t max_dt = 0;
+    for (size_t i = first; i < first + count; ++i) {
+        max_x = std::max(max_x, events.x[i]);
+        max_y = std::max(max_y, events.y[i]);
+        max_p = std::max(max_p, events.p[i]);
+        if (i > first) max_dt = std::max(max_dt, zigzag_encode(events.t[i] - events.t[i - 1]));
+    }
+    layout.bits_x = static_cast<uint8_t>(bits_needed(max_x));
+    layout.bits_y = static_cast<uint8_t>(bits_needed(max_y));
+    layout.bits_p = static_cast<uint8_t>(bits_needed(max_p));
+    layout.bits_t = static_cast<uint8_t>(bits_needed(max_dt));
+
+    size_t x_bytes = stream_bytes(count, layout.bits_x);
+    size_t y_bytes = stream_bytes(count, layout.bits_y);
+    size_t p_bytes = stream_bytes(count, layout.bits_p);
+    size_t t_bytes = stream_bytes(count - 1, layout.bits_t);
+    std::vector<uint8_t> payload(sizeof(BlockLayout) + x_bytes + y_bytes + p_bytes + t_bytes, 0);
+    std::memcpy(payload.data(), &layout, sizeof(layout));
+
+    uint8_t* dst = payload.data() + sizeof(BlockLayout);
+    BitWriter wx(dst);
+    for (size_t i = first; i < first + count; ++i) wx.put(events.x[i], layout.bits_x);
+    wx.flush();
+    dst += x_bytes;
+    BitWriter wy(dst);
+    for (size_t i = first; i < first + count; ++i) wy.put(events.y[i], layout.bits_y);
+    wy.flush();
+    dst += y_bytes;
+    BitWriter wp(dst);
+    for (size_t i = first; i < first + count; ++i) wp.put(events.p[i], layout.bits_p);
+    wp.flush();
+    dst += p_bytes;
+    BitWriter wt(dst);
+    for (size_t i = first + 1; i < first + count; ++i) wt.put(zigzag_encode(events.t[i] - events.t[i - 1]), layout.bits_t);
+    wt.flush();
+    return payload;
+}
+
+} // namespace
+
+// --- 書き込み ---
+
+void write_event_file(EventSource& source, const std::string& path, const EventFileWriteOptions& options) {
+#ifndef EV_HAVE_ZSTD
+    if (options.use_zstd) {
+        std::cerr << "Warning: zstd なしでビルドされているため、ビットパックのみで書き込みます。" << std::endl;
+    }
+#endif
+    size_t block_size = std::max<size_t>(2, options.block_size);
+    size_t total = source.num_events();
+    ThreadPool& pool = ThreadPool::shared();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot create event file: " + path);
+
+    EventFileHeader header{};
+    std::memcpy(header.magic, EVENT_FILE_MAGIC, sizeof(header.magic));
+    header.version = EVENT_FILE_VERSION;
+    header.block_size = static_cast<uint32_t>(block_size);
+    header.num_events = total;
+    header.t_offset = source.load_t_offset();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<EventFileReader::BlockEntry> seek_table;
+    seek_table.reserve((total + block_size - 1) / block_size);
+    uint64_t offset = sizeof(header);
+    uint16_t max_x = 0, max_y = 0;
+
+    // 数ブロック分ずつ読み込み、その中のブロックを並列に圧縮してから順に書き出す
+    size_t group_events = block_size * pool.concurrency() * 4;
+    for (size_t group_begin = 0; group_begin < total; group_begin += group_events) {
+        const EventStore events = source.read_events(group_begin, group_events);
+        size_t n = events.size();
+        size_t num_blocks = (n + block_size - 1) / block_size;
+        std::vector<std::vector<uint8_t>> payloads(num_blocks);
+        std::vector<EventFileReader::BlockEntry> entries(num_blocks);
+        std::vector<uint16_t> block_max_x(num_blocks), block_max_y(num_blocks);
+
+        pool.parallel_for(num_blocks, [&](size_t b) {
+            size_t first = b * block_size;
+            size_t count = std::min(block_size, n - first);
+            std::vector<uint8_t> payload = encode_block(events, first, count, block_max_x[b], block_max_y[b]);
+
+            EventFileReader::BlockEntry& entry = entries[b];
+            entry.raw_bytes = payload.size();
+            entry.t_first = events.t[first];
+            entry.t_last = events.t[first + count - 1];
+            entry.num_events = static_cast<uint32_t>(count);
+            entry.codec = CODEC_BITPACK;
+#ifdef EV_HAVE_ZSTD
+            if (options.use_zstd) {
+                std::vector<uint8_t> compressed(ZSTD_compressBound(payload.size()));
+                size_t size = ZSTD_compress(compressed.data(), compressed.size(), payload.data(), payload.size(), options.zstd_level);
+                // 小さくならなかったブロックはビットパックのまま保存する
+                if (!ZSTD_isError(size) && size < payload.size()) {
+                    compressed.resize(size);
+                    payload.swap(compressed);
+                    entry.codec = CODEC_BITPACK_ZSTD;
+                }
+            }
+#endif
+            entry.stored_bytes = payload.size();
+            payloads[b] = std::move(payload);
+        });
+
+        for (size_t b = 0; b < num_blocks; ++b) {
+            entries[b].offset = offset;
+            out.write(reinterpret_cast<const char*>(payloads[b].data()), static_cast<std::streamsize>(payloads[b].size()));
+            offset += payloads[b].size();
+            seek_table.push_back(entries[b]);
+            max_x = std::max(max_x, block_max_x[b]);
+            max_y = std::max(max_y, block_max_y[b]);
+        }
+        std::cout << "\r--- " << std::min(total, group_begin + n) << " / " << total << " events" << std::flush;
+    }
+    std::cout << std::endl;
+
+    header.num_blocks = seek_table.size();
+    header.seek_table_offset = offset;
+    std::optional<Resolution> resolution = source.resolution();
+    header.width = resolution ? resolution->width : (total > 0 ? max_x + 1 : 0);
+    header.height = resolution ? resolution->height : (total > 0 ? max_y + 1 : 0);
+    out.write(reinterpret_cast<const char*>(seek_table.data()), static_cast<std::streamsize>(seek_table.size() * sizeof(EventFileReader::BlockEntry)));
+    // シークテーブルの位置が確定したのでヘッダを書き直す
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) throw std::runtime_error("Failed to write event file: " + path);
+}
+
+// --- 読み込み ---
+
+EventFileReader::EventFileReader(const std::string& filepath) : m_filepath(filepath) {
+    m_file = MappedFile::open(filepath);
+    EventFileHeader header{};
+    if (m_file->size() < sizeof(header)) throw std::runtime_error("Not an event file: " + filepath);
+    std::memcpy(&header, m_file->data(), sizeof(header));
+    if (std::memcmp(header.magic, EVENT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not an event file: " + filepath);
+    }
+    if (header.version != EVENT_FILE_VERSION) {
+        throw std::runtime_error("Unsupported event file version " + std::to_string(header.version) + ": " + filepath);
+    }
+    uint64_t table_bytes = header.num_blocks * sizeof(BlockEntry);
+    if (header.seek_table_offset > m_file->size() || table_bytes > m_file->size() - header.seek_table_offset) {
+        throw std::runtime_error("Truncated event file: " + filepath);
+    }
+
+    m_num_events = header.num_events;
+    m_block_size = header.block_size;
+    m_t_offset = header.t_offset;
+    m_resolution = {header.width, header.height};
+    m_blocks.resize(header.num_blocks);
+    std::memcpy(m_blocks.data(), m_file->data() + header.seek_table_offset, table_bytes);
+    // 最後以外のブロックは block_size 個ちょうどなので、イベント番号からブロックを直接求められる
+    uint64_t counted = 0;
+    for (size_t b = 0; b < m_blocks.size(); ++b) {
+        const BlockEntry& block = m_blocks[b];
+        bool size_ok = (b + 1 < m_blocks.size()) ? block.num_events == m_block_size
+                                                 : block.num_events > 0 && block.num_events <= m_block_size;
+        if (!size_ok || block.offset + block.stored_bytes > header.seek_table_offset) {
+            throw std::runtime_error("Corrupt seek table in event file: " + filepath);
+        }
+        counted += block.num_events;
+    }
+    if (counted != m_num_events) throw std::runtime_error("Corrupt seek table in event file: " + filepath);
+    std::cout << "EventFileReader: " << filepath << " を開きました (" << m_num_events << " イベント, "
+              << m_blocks.size() << " ブロック)。" << std::endl;
+}
+
+EventFileReader::~EventFileReader() = default;
+
+std::optional<Resolution> EventFileReader::resolution() {
+    if (m_resolution.width <= 0 || m_resolution.height <= 0) return std::nullopt;
+    return m_resolution;
+}
+
+void EventFileReader::decode_block(size_t block, unsigned columns, uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const {
+    const BlockEntry& entry = m_blocks[block];
+    const uint8_t* payload = m_file->data() + entry.offset;
+
+    if (entry.codec == CODEC_BITPACK_ZSTD) {
+#ifdef EV_HAVE_ZSTD
+        thread_local std::vector<uint8_t> scratch;
+        scratch.resize(entry.raw_bytes);
+        size_t size = ZSTD_decompress(scratch.data(), scratch.size(), payload, entry.stored_bytes);
+        if (ZSTD_isError(size) || size != entry.raw_bytes) {
+            throw std::runtime_error("Corrupt zstd block in event file: " + m_filepath);
+        }
+        payload = scratch.data();
+#else
+        throw std::runtime_error("This event file uses zstd, but the viewer was built without zstd support.");
+#endif
+    } else if (entry.codec != CODEC_BITPACK) {
+        throw std::runtime_error("Unknown block codec in event file: " + m_filepath);
+    }
+
+    BlockLayout layout;
+    std::memcpy(&layout, payload, sizeof(layout));
+    size_t count = layout.num_events;
+    const uint8_t* src = payload + sizeof(BlockLayout);
+    const uint8_t* x_src = src;
+    const uint8_t* y_src = x_src + stream_bytes(count, layout.bits_x);
+    const uint8_t* p_src = y_src + stream_bytes(count, layout.bits_y);
+    const uint8_t* t_src = p_src + stream_bytes(count, layout.bits_p);
+    size_t payload_bytes = sizeof(BlockLayout) + stream_bytes(count, layout.bits_x) + stream_bytes(count, layout.bits_y) +
+                           stream_bytes(count, layout.bits_p) + stream_bytes(count - 1, layout.bits_t);
+    if (count != entry.num_events || payload_bytes > entry.raw_bytes || layout.bits_x > 16 || layout.bits_y > 16 ||
+        layout.bits_p > 8 || layout.bits_t > 64) {
+        throw std::runtime_error("Corrupt block in event file: " + m_filepath);
+    }
+
+    if (columns & EVENT_COLUMN_X) unpack_column(x_src, layout.bits_x, count, x);
+    if (columns & EVENT_COLUMN_Y) unpack_column(y_src, layout.bits_y, count, y);
+    if (columns & EVENT_COLUMN_P) unpack_column(p_src, layout.bits_p, count, p);
+    if (columns & EVENT_COLUMN_T) {
+        int64_t acc = entry.t_first;
+        t[0] = acc;
+        for (size_t i = 1; i < count; ++i) {
+            acc += zigzag_decode(read_bits(t_src, i - 1, layout.bits_t));
+            t[i] = acc;
+        }
+    }
+}
+
+EventStore EventFileReader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    if (begin >= m_num_events) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, m_num_events - begin);
+    size_t out_count = (count + stride - 1) / stride;
+    if (out_count == 0) return events;
+    events.resize(out_count);
+
+    uint16_t* x = events.has(EVENT_COLUMN_X) ? events.x.data() : nullptr;
+    uint16_t* y = events.has(EVENT_COLUMN_Y) ? events.y.data() : nullptr;
+    uint8_t* p = events.has(EVENT_COLUMN_P) ? events.p.data() : nullptr;
+    int64_t* t = events.has(EVENT_COLUMN_T) ? events.t.data() : nullptr;
+
+    size_t end = begin + count;
+    size_t first_block = begin / m_block_size;
+    size_t last_block = (end - 1) / m_block_size;
+    auto decode_one = [&](size_t i) {
+        size_t b = first_block + i;
+        size_t block_begin = b * m_block_size;
+        size_t block_count = m_blocks[b].num_events;
+        size_t lo = std::max(begin, block_begin);
+        size_t hi = std::min(end, block_begin + block_count);
+        // 出力に含まれる最初のイベント (stride の倍数番目) に合わせる
+        size_t skip = (lo - begin) % stride;
+        if (skip) lo += stride - skip;
+        if (lo >= hi) return;
+        size_t out = (lo - begin) / stride;
+
+        if (stride == 1 && lo == block_begin && hi == block_begin + block_count) {
+            // ブロック全体が必要なら出力へ直接展開する
+            decode_block(b, columns, x ? x + out : nullptr, y ? y + out : nullptr, p ? p + out : nullptr, t ? t + out : nullptr);
+            return;
+        }
+        thread_local EventStore scratch;
+        scratch.resize(block_count);
+        decode_block(b, columns, scratch.x.data(), scratch.y.data(), scratch.p.data(), scratch.t.data());
+        for (size_t j = lo; j < hi; j += stride, ++out) {
+            size_t k = j - block_begin;
+            if (x) x[out] = scratch.x[k];
+            if (y) y[out] = scratch.y[k];
+            if (p) p[out] = scratch.p[k];
+            if (t) t[out] = scratch.t[k];
+        }
+    };
+
+    size_t num_blocks = last_block - first_block + 1;
+    if (count >= PARALLEL_DECODE_MIN_EVENTS) {
+        ThreadPool::shared().parallel_for(num_blocks, decode_one);
+    } else {
+        for (size_t i = 0; i < num_blocks; ++i) decode_one(i);
+    }
+    return events;
+}
+
+size_t EventFileReader::find_event_index(int64_t t) {
+    if (m_blocks.empty() || t > m_blocks.back().t_last) return m_num_events;
+    // t_last が t 以上となる最初のブロックに答えがある
+    auto it = std::lower_bound(m_blocks.begin(), m_blocks.end(), t,
+                               [](const BlockEntry& block, int64_t value) { return block.t_last < value; });
+    size_t b = static_cast<size_t>(it - m_blocks.begin());
+    size_t block_begin = b * m_block_size;
+    if (t <= it->t_first) return block_begin;
+
+    const EventStore block = read_events(block_begin, it->num_events, EVENT_COLUMN_T);
+    return block_begin + (std::lower_bound(block.t.begin(), block.t.end(), t) - block.t.begin());
+}
@@ -0,0 +1,252 @@
+#include "hdf5_chunk_reader.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <type_traits>
+#include <zlib.h>
+#ifdef EV_HAVE_BLOSC
+#include <blosc.h>
+#endif
+
+namespace {
+
+// hdf5-blosc プラグインのフィルタID
+constexpr H5Z_filter_t FILTER_BLOSC = 32001;
+
+// 1回にまとめて読み込む生チャンク数 (並列度あたり)
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+struct RawChunk {
+    size_t index = 0;
+    uint32_t filter_mask = 0;
+    std::vector<uint8_t> data;
+};
+
+bool host_is_little_endian() {
+    uint16_t one = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &one, 1);
+    return first_byte == 1;
+}
+
+// shuffle フィルタの逆変換 (バイト平面ごとに並んだデータを要素ごとに戻す)
+void unshuffle(const uint8_t* src, uint8_t* dst, size_t elem_size, size_t nbytes) {
+    size_t num_elems = nbytes / elem_size;
+    for (size_t b = 0; b < elem_size; ++b) {
+        const uint8_t* plane = src + b * num_elems;
+        for (size_t i = 0; i < num_elems; ++i) {
+            dst[i * elem_size + b] = plane[i];
+        }
+    }
+    // 要素サイズで割り切れない末尾はそのまま残されている
+    size_t tail = num_elems * elem_size;
+    std::memcpy(dst + tail, src + tail, nbytes - tail);
+}
+
+// ファイル上の整数型 Src から出力型 T へ変換しながらコピーする
+template <typename Src, typename T>
+void convert_elements(const uint8_t* src, T* dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        Src value;
+        std::memcpy(&value, src + i * sizeof(Src), sizeof(Src));
+        dst[i] = static_cast<T>(value);
+    }
+}
+
+template <typename T>
+void convert_elements(const uint8_t* src, size_t elem_size, bool is_signed, T* dst, size_t n) {
+    switch (elem_size) {
+        case 1: is_signed ? convert_elements<int8_t>(src, dst, n) : convert_elements<uint8_t>(src, dst, n); break;
+        case 2: is_signed ? convert_elements<int16_t>(src, dst, n) : convert_elements<uint16_t>(src, dst, n); break;
+        case 4: is_signed ? convert_elements<int32_t>(src, dst, n) : convert_elements<uint32_t>(src, dst, n); break;
+        case 8: is_signed ? convert_elements<int64_t>(src, dst, n) : convert_elements<uint64_t>(src, dst, n); break;
+    }
+}
+
+} // namespace
+
+HDF5ChunkReader::HDF5ChunkReader(const H5::DataSet& dset) : m_dset(dset) {
+#if H5_VERSION_GE(1, 10, 3)
+    if (!host_is_little_endian()) return;
+
+    H5::DSetCreatPropList dcpl = dset.getCreatePlist();
+    if (dcpl.getLayout() != H5D_CHUNKED) return;
+
+    H5::DataSpace space = dset.getSpace();
+    if (space.getSimpleExtentNdims() != 1) return;
+    hsize_t dims[1] = {0};
+    space.getSimpleExtentDims(dims);
+    hsize_t chunk_dims[1] = {0};
+    dcpl.getChunk(1, chunk_dims);
+    m_num_elements = dims[0];
+    m_chunk_size = chunk_dims[0];
+    if (m_chunk_size == 0) return;
+
+    if (dset.getTypeClass() != H5T_INTEGER) return;
+    H5::IntType type = dset.getIntType();
+    m_elem_size = type.getSize();
+    m_is_signed = (type.getSign() == H5T_SGN_2);
+    if (type.getOrder() != H5T_ORDER_LE) return;
+    if (m_elem_size != 1 && m_elem_size != 2 && m_elem_size != 4 && m_elem_size != 8) return;
+
+    int num_filters = dcpl.getNfilters();
+    for (int i = 0; i < num_filters; ++i) {
+        unsigned int flags = 0, filter_config = 0;
+        size_t cd_nelmts = 16;
+        unsigned int cd_values[16] = {0};
+        char name[64];
+        H5Z_filter_t id = dcpl.getFilter(i, flags, cd_nelmts, cd_values, sizeof(name), name, filter_config);
+        bool known = (id == H5Z_FILTER_DEFLATE || id == H5Z_FILTER_SHUFFLE);
+#ifdef EV_HAVE_BLOSC
+        known = known || (id == FILTER_BLOSC);
+#endif
+        if (!known) return; // 未知のフィルタは HDF5 に任せる
+        m_filters.push_back({id, std::vector<unsigned int>(cd_values, cd_values + std::min<size_t>(cd_nelmts, 16))});
+    }
+    m_supported = true;
+#endif
+}
+
+template <typename T>
+bool HDF5ChunkReader::read(T* dst, size_t begin, size_t count) const {
+    static_assert(std::is_integral<T>::value, "HDF5ChunkReader only reads integer columns");
+#if H5_VERSION_GE(1, 10, 3)
+    if (!m_supported || begin + count > m_num_elements) return false;
+    if (count == 0) return true;
+
+    const size_t end = begin + count;
+    const size_t first_chunk = begin / m_chunk_size;
+    const size_t last_chunk = (end - 1) / m_chunk_size;
+    const size_t chunk_bytes = m_chunk_size * m_elem_size;
+    const bool same_type = (sizeof(T) == m_elem_size && std::is_signed<T>::value == m_is_signed);
+    const hid_t dset_id = m_dset.getId();
+
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t batch_size = pool.concurrency() * CHUNKS_PER_THREAD;
+
+    // 生チャンクの読み込みは HDF5 を触るので呼び出しスレッドだけで行う
+    auto read_batch = [&](size_t batch_first, std::vector<RawChunk>& batch) -> bool {
+        batch.clear();
+        size_t batch_last = std::min(last_chunk, batch_first + batch_size - 1);
+        for (size_t c = batch_first; c <= batch_last; ++c) {
+            RawChunk raw;
+            raw.index = c;
+            hsize_t offset[1] = {static_cast<hsize_t>(c * m_chunk_size)};
+            hsize_t nbytes = 0;
+            herr_t status = -1;
+            H5E_BEGIN_TRY {
+                status = H5Dget_chunk_storage_size(dset_id, offset, &nbytes);
+            } H5E_END_TRY;
+            if (status < 0 || nbytes == 0) return false; // 未割り当てチャンク (フィル値) は通常経路で読む
+            raw.data.resize(nbytes);
+            H5E_BEGIN_TRY {
+                status = H5Dread_chunk(dset_id, H5P_DEFAULT, offset, &raw.filter_mask, raw.data.data());
+            } H5E_END_TRY;
+            if (status < 0) return false;
+            batch.push_back(std::move(raw));
+        }
+        return true;
+    };
+
+    // フィルタを逆順に外して chunk_bytes バイトの生データを out に復元する
+    auto decode_chunk = [&](const RawChunk& raw, uint8_t* out) -> bool {
+        thread_local std::vector<uint8_t> stage_a, stage_b;
+        int last_applied = -1;
+        for (int i = 0; i < static_cast<int>(m_filters.size()); ++i) {
+            if (!(raw.filter_mask & (1u << i))) { last_applied = i; break; }
+        }
+
+        const uint8_t* src = raw.data.data();
+        size_t src_len = raw.data.size();
+        for (int i = static_cast<int>(m_filters.size()) - 1; i >= 0; --i) {
+            if (raw.filter_mask & (1u << i)) continue;
+            uint8_t* stage_dst = out;
+            if (i != last_applied) {
+                std::vector<uint8_t>& buf = (src == stage_a.data()) ? stage_b : stage_a;
+                buf.resize(chunk_bytes);
+                stage_dst = buf.data();
+            }
+
+            const Filter& filter = m_filters[i];
+            if (filter.id == H5Z_FILTER_DEFLATE) {
+                uLongf out_len = static_cast<uLongf>(chunk_bytes);
+                if (uncompress(stage_dst, &out_len, src, static_cast<uLong>(src_len)) != Z_OK || out_len != chunk_bytes) return false;
+            } else if (filter.id == H5Z_FILTER_SHUFFLE) {
+                size_t elem_size = filter.cd_values.empty() ? m_elem_size : filter.cd_values[0];
+                if (src_len != chunk_bytes || elem_size == 0) return false;
+                unshuffle(src, stage_dst, elem_size, chunk_bytes);
+            }
+#ifdef EV_HAVE_BLOSC
+            else if (filter.id == FILTER_BLOSC) {
+                int n = blosc_decompress_ctx(src, stage_dst, chunk_bytes, 1);
+                if (n < 0 || static_cast<size_t>(n) != chunk_bytes) return false;
+            }
+#endif
+            else {
+                return false;
+            }
+            src = stage_dst;
+            src_len = chunk_bytes;
+        }
+
+        if (last_applied < 0) {
+            // フィルタが1つも適用されていないチャンクはそのままコピーする
+            if (src_len < chunk_bytes) return false;
+            std::memcpy(out, src, chunk_bytes);
+        }
+        return true;
+    };
+
+    std::atomic<bool> failed{false};
+    auto decode_batch = [&](const std::vector<RawChunk>& batch) {
+        pool.parallel_for(batch.size(), [&](size_t k) {
+            if (failed) return;
+            const RawChunk& raw = batch[k];
+            size_t chunk_begin = raw.index * m_chunk_size;
+            size_t lo = std::max(begin, chunk_begin);
+            size_t hi = std::min(end, chunk_begin + m_chunk_size);
+
+            // 型が一致し、チャンク全体が出力範囲に収まるなら出力列へ直接展開する
+            if (same_type && lo == chunk_begin && hi == chunk_begin + m_chunk_size) {
+                if (!decode_chunk(raw, reinterpret_cast<uint8_t*>(dst + (chunk_begin - begin)))) failed = true;
+                return;
+            }
+            thread_local std::vector<uint8_t> scratch;
+            scratch.resize(chunk_bytes);
+            if (!decode_chunk(raw, scratch.data())) {
+                failed = true;
+                return;
+            }
+            convert_elements(scratch.data() + (lo - chunk_begin) * m_elem_size, m_elem_size, m_is_signed, dst + (lo - begin), hi - lo);
+        });
+    };
+
+    // 次のバッチの読み込み (I/O) と現在のバッチの展開を重ねて実行する
+    // HDF5 を呼ぶのは常にどちらか一方のスレッドだけなので、スレッドセーフでないビルドでも問題ない
+    std::vector<RawChunk> current, next;
+    if (!read_batch(first_chunk, current)) return false;
+    for (size_t batch_first = first_chunk; !current.empty(); batch_first += batch_size) {
+        size_t next_first = batch_first + batch_size;
+        std::future<bool> reading;
+        if (next_first <= last_chunk) {
+            reading = std::async(std::launch::async, [&, next_first] { return read_batch(next_first, next); });
+        } else {
+            next.clear();
+        }
+        decode_batch(current);
+        bool ok = reading.valid() ? reading.get() : true;
+        if (!ok || failed) return false;
+        std::swap(current, next);
+    }
+    return true;
+#else
+    (void)dst; (void)begin; (void)count;
+    return false;
+#endif
+}
+
+template bool HDF5ChunkReader::read<uint8_t>(uint8_t*, size_t, size_t) const;
+template bool HDF5ChunkReader::read<uint16_t>(uint16_t*, size_t, size_t) const;
+template bool HDF5ChunkReader::read<int64_t>(int64_t*, size_t, size_t) const;
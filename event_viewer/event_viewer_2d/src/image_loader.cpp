@@ -57,7 +57,10 @@ std::vector<RGBFrame> ImageLoader::load_image_data() {
     size_t num_frames = std::min(timestamps.size(), image_paths.size());
     frames.reserve(num_frames);
     for (size_t i = 0; i < num_frames; ++i) {
-        frames.push_back({timestamps[i], image_paths[i]});
+        RGBFrame frame;
+        frame.timestamp = timestamps[i];
+        frame.image_path = image_paths[i];
+        frames.push_back(std::move(frame));
     }
 
     std::cout << "--- Successfully loaded " << frames.size() << " image frames ---" << std::endl;
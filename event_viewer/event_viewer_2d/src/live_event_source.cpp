@@ -0,0 +1,436 @@
+#include "live_event_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// 受信スレッドが停止要求を確認する間隔
+constexpr int POLL_INTERVAL_MS = 100;
+// 受信側のソケットバッファ (UDP の取りこぼしを減らす)
+constexpr int RECEIVE_BUFFER_BYTES = 8 << 20;
+// パケットの受信時刻を描画側へ渡すキューの長さ (溢れた分は遅延の計測から外れるだけ)
+constexpr size_t MARK_QUEUE_CAPACITY = 1 << 12;
+// リングバッファの最小容量 (書き込み中のパケットより十分大きくする)
+constexpr size_t MIN_RING_CAPACITY = size_t(1) << 16;
+constexpr size_t MAX_PACKET_BYTES = sizeof(LivePacketHeader) + LIVE_MAX_PACKET_EVENTS * sizeof(LiveEventRecord);
+
+std::runtime_error socket_error(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+struct AddrInfoDeleter {
+    void operator()(addrinfo* info) const { freeaddrinfo(info); }
+};
+using AddrInfoPtr = std::unique_ptr<addrinfo, AddrInfoDeleter>;
+
+AddrInfoPtr resolve(const LiveEndpoint& endpoint, int socktype, bool passive) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    std::string port = std::to_string(endpoint.port);
+    int rc = getaddrinfo(endpoint.host.empty() ? nullptr : endpoint.host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        throw std::runtime_error("Failed to resolve " + endpoint.str() + ": " + gai_strerror(rc));
+    }
+    return AddrInfoPtr(result);
+}
+
+sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Unix socket path is too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// fd が読めるようになるか timeout_ms が経過するまで待つ
+bool wait_readable(int fd, int timeout_ms) {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, timeout_ms) > 0;
+}
+
+} // namespace
+
+// --- LiveEndpoint ---
+
+LiveEndpoint LiveEndpoint::parse(const std::string& address) {
+    LiveEndpoint endpoint;
+    size_t scheme_end = address.find("://");
+    if (scheme_end == std::string::npos) {
+        throw std::runtime_error("Invalid live address (expected udp://, tcp:// or unix://): " + address);
+    }
+    std::string scheme = address.substr(0, scheme_end);
+    std::string rest = address.substr(scheme_end + 3);
+    if (scheme == "unix") {
+        if (rest.empty()) throw std::runtime_error("Missing socket path in " + address);
+        endpoint.protocol = Protocol::UNIX;
+        endpoint.path = rest;
+        return endpoint;
+    }
+    if (scheme == "udp") {
+        endpoint.protocol = Protocol::UDP;
+    } else if (scheme == "tcp") {
+        endpoint.protocol = Protocol::TCP;
+    } else {
+        throw std::runtime_error("Unsupported live protocol '" + scheme + "' in " + address);
+    }
+    // host:port ([v6addr]:port も可)
+    size_t colon = rest.rfind(':');
+    if (colon == std::string::npos || colon + 1 == rest.size()) {
+        throw std::runtime_error("Missing port in " + address);
+    }
+    endpoint.host = rest.substr(0, colon);
+    if (endpoint.host.size() >= 2 && endpoint.host.front() == '[' && endpoint.host.back() == ']') {
+        endpoint.host = endpoint.host.substr(1, endpoint.host.size() - 2);
+    }
+    int port = std::stoi(rest.substr(colon + 1));
+    if (port <= 0 || port > 65535) throw std::runtime_error("Invalid port in " + address);
+    endpoint.port = static_cast<uint16_t>(port);
+    return endpoint;
+}
+
+std::string LiveEndpoint::str() const {
+    switch (protocol) {
+        case Protocol::UDP: return "udp://" + host + ":" + std::to_string(port);
+        case Protocol::TCP: return "tcp://" + host + ":" + std::to_string(port);
+        case Protocol::UNIX: return "unix://" + path;
+    }
+    return "";
+}
+
+int64_t live_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// --- LiveEventRing ---
+
+LiveEventRing::LiveEventRing(size_t capacity) {
+    size_t size = MIN_RING_CAPACITY;
+    while (size < capacity) size <<= 1;
+    m_x.resize(size);
+    m_y.resize(size);
+    m_p.resize(size);
+    m_t.resize(size);
+    m_mask = size - 1;
+}
+
+void LiveEventRing::push(const LiveEventRecord* records, size_t count, int64_t t_base_us) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        size_t slot = (head + i) & m_mask;
+        m_x[slot] = records[i].x;
+        m_y[slot] = records[i].y;
+        m_p[slot] = static_cast<uint8_t>(records[i].dt_p & 1u);
+        m_t[slot] = t_base_us + static_cast<int64_t>(records[i].dt_p >> 1);
+    }
+    m_head.store(head + count, std::memory_order_release);
+}
+
+uint64_t LiveEventRing::oldest_valid(uint64_t head) const {
+    // head 以降に書き込み中のパケット (最大 LIVE_MAX_PACKET_EVENTS 個) が上書きし得る範囲を除く
+    uint64_t reach = head + LIVE_MAX_PACKET_EVENTS;
+    return reach > capacity() ? reach - capacity() : 0;
+}
+
+uint64_t LiveEventRing::read(uint64_t begin, uint64_t end, EventStore& dst) const {
+    begin = std::min(std::max(begin, oldest_valid(head())), end);
+    size_t count = static_cast<size_t>(end - begin);
+    dst.columns = EVENT_COLUMNS_ALL;
+    dst.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t slot = (begin + i) & m_mask;
+        dst.x[i] = m_x[slot];
+        dst.y[i] = m_y[slot];
+        dst.p[i] = m_p[slot];
+        dst.t[i] = m_t[slot];
+    }
+
+    // コピー中に追い越されていたら、上書きされた可能性のある先頭部分を捨てる (seqlock と同じ考え方)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t valid = std::min(std::max(begin, oldest_valid(head())), end);
+    if (valid > begin) {
+        size_t skip = static_cast<size_t>(valid - begin);
+        size_t remaining = count - skip;
+        std::memmove(dst.x.data(), dst.x.data() + skip, remaining * sizeof(uint16_t));
+        std::memmove(dst.y.data(), dst.y.data() + skip, remaining * sizeof(uint16_t));
+        std::memmove(dst.p.data(), dst.p.data() + skip, remaining * sizeof(uint8_t));
+        std::memmove(dst.t.data(), dst.t.data() + skip, remaining * sizeof(int64_t));
+        dst.resize(remaining);
+    }
+    return valid;
+}
+
+// --- LiveEventReceiver ---
+
+LiveEventReceiver::LiveEventReceiver(const LiveEndpoint& endpoint, size_t ring_capacity)
+    : m_endpoint(endpoint), m_ring(ring_capacity), m_marks(MARK_QUEUE_CAPACITY) {
+    open_socket();
+    std::cout << "--- Listening for live events on " << m_endpoint.str() << " (buffer: "
+              << m_ring.capacity() << " events) ---" << std::endl;
+    m_thread = std::thread(&LiveEventReceiver::receive_loop, this);
+}
+
+LiveEventReceiver::~LiveEventReceiver() {
+    m_stop.store(true, std::memory_order_relaxed);
+    if (m_thread.joinable()) m_thread.join();
+    if (m_socket >= 0) close(m_socket);
+    if (m_endpoint.protocol == LiveEndpoint::Protocol::UNIX) unlink(m_endpoint.path.c_str());
+}
+
+void LiveEventReceiver::open_socket() {
+    if (m_endpoint.protocol == LiveEndpoint::Protocol::UNIX) {
+        sockaddr_un address = unix_address(m_endpoint.path);
+        m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_socket < 0) throw socket_error("socket");
+        unlink(m_endpoint.path.c_str()); // 前回の実行で残ったソケットファイル
+        if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(m_socket, 1) < 0) {
+            throw socket_error("Failed to listen on " + m_endpoint.str());
+        }
+        return;
+    }
+
+    bool udp = (m_endpoint.protocol == LiveEndpoint::Protocol::UDP);
+    AddrInfoPtr info = resolve(m_endpoint, udp ? SOCK_DGRAM : SOCK_STREAM, true);
+    m_socket = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (m_socket < 0) throw socket_error("socket");
+    int enable = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (udp) {
+        int buffer_bytes = RECEIVE_BUFFER_BYTES;
+        setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &buffer_bytes, sizeof(buffer_bytes));
+    }
+    if (bind(m_socket, info->ai_addr, info->ai_addrlen) < 0 || (!udp && listen(m_socket, 1) < 0)) {
+        throw socket_error("Failed to listen on " + m_endpoint.str());
+    }
+}
+
+std::optional<Resolution> LiveEventReceiver::wait_for_resolution(std::chrono::milliseconds timeout) const {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (m_packets.load(std::memory_order_acquire) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) return std::nullopt;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return Resolution{m_width.load(std::memory_order_relaxed), m_height.load(std::memory_order_relaxed)};
+}
+
+LiveStats LiveEventReceiver::stats() const {
+    LiveStats stats;
+    stats.packets = m_packets.load(std::memory_order_relaxed);
+    stats.events = m_events.load(std::memory_order_relaxed);
+    stats.lost_packets = m_lost_packets.load(std::memory_order_relaxed);
+    stats.late_packets = m_late_packets.load(std::memory_order_relaxed);
+    stats.invalid_packets = m_invalid_packets.load(std::memory_order_relaxed);
+    stats.latency_mean_ms = stats.packets ? m_latency_sum_ms.load(std::memory_order_relaxed) / stats.packets : 0.0;
+    stats.latency_max_ms = m_latency_max_ms.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void LiveEventReceiver::receive_loop() {
+    try {
+        if (m_endpoint.protocol == LiveEndpoint::Protocol::UDP) {
+            receive_datagrams();
+        } else {
+            receive_stream();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Live receiver stopped: " << e.what() << std::endl;
+    }
+}
+
+void LiveEventReceiver::receive_datagrams() {
+    // 受信バッファの先頭を8バイト境界に揃え、ヘッダ直後のイベント列をそのまま参照できるようにする
+    std::vector<uint64_t> buffer((MAX_PACKET_BYTES + sizeof(uint64_t)) / sizeof(uint64_t) + 1);
+    uint8_t* data = reinterpret_cast<uint8_t*>(buffer.data());
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        if (!wait_readable(m_socket, POLL_INTERVAL_MS)) continue;
+        ssize_t bytes = recv(m_socket, data, buffer.size() * sizeof(uint64_t), 0);
+        if (bytes < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            throw socket_error("recv");
+        }
+        if (!handle_packet(data, static_cast<size_t>(bytes))) {
+            m_invalid_packets.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void LiveEventReceiver::receive_stream() {
+    std::vector<uint64_t> buffer((MAX_PACKET_BYTES + sizeof(uint64_t)) / sizeof(uint64_t) + 1);
+    uint8_t* data = reinterpret_cast<uint8_t*>(buffer.data());
+
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        if (!wait_readable(m_socket, POLL_INTERVAL_MS)) continue;
+        int client = accept(m_socket, nullptr, nullptr);
+        if (client < 0) continue;
+        std::cout << "--- Live producer connected on " << m_endpoint.str() << " ---" << std::endl;
+        m_has_sequence = false;
+
+        // 停止要求を確認しながら n バイトを読み切る (切断されたら false)
+        auto read_exact = [&](uint8_t* dst, size_t n) {
+            size_t done = 0;
+            while (done < n) {
+                if (m_stop.load(std::memory_order_relaxed)) return false;
+                if (!wait_readable(client, POLL_INTERVAL_MS)) continue;
+                ssize_t bytes = recv(client, dst + done, n - done, 0);
+                if (bytes == 0) return false;
+                if (bytes < 0) {
+                    if (errno == EINTR || errno == EAGAIN) continue;
+                    return false;
+                }
+                done += static_cast<size_t>(bytes);
+            }
+            return true;
+        };
+
+        while (read_exact(data, sizeof(LivePacketHeader))) {
+            LivePacketHeader header;
+            std::memcpy(&header, data, sizeof(header));
+            size_t total = header.header_bytes + static_cast<size_t>(header.num_events) * sizeof(LiveEventRecord);
+            // ストリームでは境界を失うと復帰できないため、不正なヘッダを受けたら切断する
+            if (std::memcmp(header.magic, LIVE_PACKET_MAGIC, sizeof(header.magic)) != 0 ||
+                header.header_bytes < sizeof(LivePacketHeader) || total > MAX_PACKET_BYTES) {
+                m_invalid_packets.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (!read_exact(data + sizeof(LivePacketHeader), total - sizeof(LivePacketHeader))) break;
+            if (!handle_packet(data, total)) {
+                m_invalid_packets.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        close(client);
+        std::cout << "--- Live producer disconnected ---" << std::endl;
+    }
+}
+
+bool LiveEventReceiver::handle_packet(const uint8_t* data, size_t bytes) {
+    int64_t receive_time_us = live_clock_us();
+    if (bytes < sizeof(LivePacketHeader)) return false;
+    LivePacketHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, LIVE_PACKET_MAGIC, sizeof(header.magic)) != 0 || header.version != LIVE_PACKET_VERSION ||
+        header.header_bytes < sizeof(LivePacketHeader) || header.header_bytes % alignof(LiveEventRecord) != 0 ||
+        header.num_events > LIVE_MAX_PACKET_EVENTS ||
+        bytes != header.header_bytes + static_cast<size_t>(header.num_events) * sizeof(LiveEventRecord)) {
+        return false;
+    }
+
+    bool restart = !m_has_sequence;
+    if (m_has_sequence && header.sequence != m_next_sequence) {
+        uint32_t gap = header.sequence - m_next_sequence;
+        if (gap < (1u << 31)) {
+            m_lost_packets.fetch_add(gap, std::memory_order_relaxed);
+        } else if (header.sequence == 0 || m_next_sequence - header.sequence > LIVE_RESTART_SEQUENCE_GAP) {
+            restart = true;
+        } else {
+            // 並べ替えで遅れて届いたものは、時刻が戻らないよう捨てる (期待する通し番号は戻さない)
+            m_late_packets.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    m_has_sequence = true;
+    m_next_sequence = header.sequence + 1;
+    // 接続し直し・送信側の再起動では時刻が戻るので、描画側に新しい時刻の基準の始まりを知らせる
+    if (restart) m_restart_index.store(m_ring.head(), std::memory_order_release);
+
+    m_width.store(header.width, std::memory_order_relaxed);
+    m_height.store(header.height, std::memory_order_relaxed);
+    m_ring.push(reinterpret_cast<const LiveEventRecord*>(data + header.header_bytes), header.num_events, header.t_base_us);
+    m_marks.try_push({m_ring.head(), receive_time_us});
+
+    double latency_ms = (receive_time_us - header.send_time_us) / 1000.0;
+    m_latency_sum_ms.store(m_latency_sum_ms.load(std::memory_order_relaxed) + latency_ms, std::memory_order_relaxed);
+    if (latency_ms > m_latency_max_ms.load(std::memory_order_relaxed)) {
+        m_latency_max_ms.store(latency_ms, std::memory_order_relaxed);
+    }
+    m_events.fetch_add(header.num_events, std::memory_order_relaxed);
+    m_packets.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+// --- LiveEventSender ---
+
+LiveEventSender::LiveEventSender(const LiveEndpoint& endpoint) : m_endpoint(endpoint) {
+    bool waiting_logged = false;
+    while (true) {
+        int rc = -1;
+        if (m_endpoint.protocol == LiveEndpoint::Protocol::UNIX) {
+            sockaddr_un address = unix_address(m_endpoint.path);
+            m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (m_socket < 0) throw socket_error("socket");
+            rc = connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        } else {
+            bool udp = (m_endpoint.protocol == LiveEndpoint::Protocol::UDP);
+            AddrInfoPtr info = resolve(m_endpoint, udp ? SOCK_DGRAM : SOCK_STREAM, false);
+            m_socket = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            if (m_socket < 0) throw socket_error("socket");
+            rc = connect(m_socket, info->ai_addr, info->ai_addrlen);
+        }
+        if (rc == 0) break;
+
+        // 受信側 (ビューア) がまだ起動していなければ、起動するまで待つ
+        close(m_socket);
+        m_socket = -1;
+        if (!waiting_logged) {
+            std::cout << "--- Waiting for a receiver on " << m_endpoint.str() << "..." << std::endl;
+            waiting_logged = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    m_buffer.resize(MAX_PACKET_BYTES);
+}
+
+LiveEventSender::~LiveEventSender() {
+    if (m_socket >= 0) close(m_socket);
+}
+
+void LiveEventSender::send(const EventStore& events, size_t begin, size_t count, Resolution resolution) {
+    count = std::min<size_t>(count, LIVE_MAX_PACKET_EVENTS);
+    LivePacketHeader header{};
+    std::memcpy(header.magic, LIVE_PACKET_MAGIC, sizeof(header.magic));
+    header.version = LIVE_PACKET_VERSION;
+    header.header_bytes = sizeof(LivePacketHeader);
+    header.sequence = m_sequence++;
+    header.num_events = static_cast<uint32_t>(count);
+    header.width = static_cast<uint16_t>(resolution.width);
+    header.height = static_cast<uint16_t>(resolution.height);
+    header.t_base_us = count > 0 ? events.t[begin] : 0;
+
+    LiveEventRecord* records = reinterpret_cast<LiveEventRecord*>(m_buffer.data() + sizeof(header));
+    for (size_t i = 0; i < count; ++i) {
+        int64_t dt = events.t[begin + i] - header.t_base_us;
+        if (dt < 0 || dt >= (int64_t(1) << 31)) {
+            throw std::runtime_error("Events in one live packet must be sorted and span less than 2^31 us.");
+        }
+        records[i].x = events.x[begin + i];
+        records[i].y = events.y[begin + i];
+        records[i].dt_p = (static_cast<uint32_t>(dt) << 1) | (events.p[begin + i] & 1u);
+    }
+    header.send_time_us = live_clock_us();
+    std::memcpy(m_buffer.data(), &header, sizeof(header));
+
+    size_t total = sizeof(header) + count * sizeof(LiveEventRecord);
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t bytes = ::send(m_socket, m_buffer.data() + sent, total - sent, MSG_NOSIGNAL);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            // UDP で受信側がいない場合 (ECONNREFUSED) はパケットを捨てて続ける
+            if (m_endpoint.protocol == LiveEndpoint::Protocol::UDP && errno == ECONNREFUSED) return;
+            throw socket_error("send");
+        }
+        sent += static_cast<size_t>(bytes);
+    }
+}
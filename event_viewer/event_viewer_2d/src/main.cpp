@@ -1,7 +1,13 @@
-#include "hdf5_loader.h"
+#include "event_source.h"
+#include "event_cache.h"
+#include "time_index.h"
+#include "compressed_event_store.h"
+#include "event_prefetcher.h"
+#include "live_event_source.h"
 #include "renderer.h" 
 #include "image_loader.h"
 #include "yaml-cpp/yaml.h"
+#include <H5Cpp.h>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <string>
@@ -9,9 +15,9 @@
 #include <stdexcept>
 #include <algorithm>
 #include <filesystem>
+#include <optional>
 
 // Forward declarations
-struct EventCD;
 struct RGBFrame;
 
 namespace fs = std::filesystem;
@@ -22,10 +28,34 @@ struct CLIConfig {
     int downsample_factor = 1;
 };
 
+// Events plus the metadata the renderer needs
+struct LoadedEvents {
+    EventStore events;
+    TimeIndex time_index; // Empty unless it came with the cache or was built while compressing; the renderer builds it otherwise
+    int64_t t_offset = 0;
+    Resolution resolution;
+    std::optional<CompressedEventStore> compressed; // Set (and events left empty) when compressed chunk by chunk while loading
+};
+
 // Function prototypes
 CLIConfig parse_arguments(int argc, char* argv[]);
-std::vector<EventCD> downsample_events(const std::vector<EventCD>& all_events, int factor);
-Resolution calculate_resolution(const std::vector<EventCD>& events);
+EventCacheConfig load_cache_config(const YAML::Node& master_config, const fs::path& config_dir);
+HDF5Schema load_hdf5_schema(const YAML::Node& master_config);
+RenderOptions load_render_options(const YAML::Node& master_config);
+std::optional<PrefetchConfig> load_prefetch_config(const YAML::Node& master_config, int factor);
+LoadedEvents load_events(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const EventCacheConfig& cache_config, int factor, bool compress);
+bool load_events_compressed(EventSource& source, int factor, LoadedEvents& loaded);
+std::optional<Resolution> load_streaming_resolution(const YAML::Node& master_config);
+std::unique_ptr<EventPrefetcher> open_streaming(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const PrefetchConfig& prefetch_config, const std::optional<Resolution>& configured, Resolution& resolution);
+std::unique_ptr<LiveEventReceiver> open_live_input(const YAML::Node& master_config);
+Resolution wait_for_live_resolution(const LiveEventReceiver& receiver);
+EventStore load_events_downsampled(EventSource& source, int factor);
+EventStore downsample_events(EventStore events, int factor);
+Resolution calculate_resolution(const EventStore& events);
+Resolution estimate_resolution(EventSource& source);
+bool compression_requested(const YAML::Node& master_config);
+bool should_compress_events(const YAML::Node& master_config, const EventStore& events);
+CompressedEventStore compress_events(const EventStore& events);
 
 
 // --- Main Function ---
@@ -38,30 +68,40 @@ int main(int argc, char* argv[]) {
         std::cout << "--- Loading master config from: " << cli_config.config_filepath.string() << " ---" << std::endl;
         YAML::Node master_config = YAML::LoadFile(cli_config.config_filepath.string());
 
-        // 3. Load events from HDF5 file
-        if (!master_config["event_file"]) {
-            throw std::runtime_error("'event_file' not found in master config.");
+        // 3. Resolve the event file (HDF5, native .evb, Prophesee .raw, AEDAT4, NumPy .npy/.npz, text events.txt or Arrow .arrow/.feather), or listen on the live input socket
+        std::unique_ptr<LiveEventReceiver> live_receiver = open_live_input(master_config);
+        fs::path event_filepath;
+        if (!live_receiver) {
+            if (!master_config["event_file"]) {
+                throw std::runtime_error("'event_file' not found in master config.");
+            }
+            event_filepath = cli_config.config_filepath.parent_path() / master_config["event_file"].as<std::string>();
         }
-        fs::path h5_filepath = cli_config.config_filepath.parent_path() / master_config["event_file"].as<std::string>();
         
-        HDF5Loader h5_loader(h5_filepath.string());
-        int64_t t_offset = h5_loader.load_t_offset();
-        std::vector<EventCD> all_events = h5_loader.load_all_events();
-
-        if (all_events.empty()) {
-            std::cerr << "Error: No events found in the HDF5 file." << std::endl;
-            return -1;
-        }
-
-        // 4. Downsample event data if requested
-        std::vector<EventCD> events_to_render = downsample_events(all_events, cli_config.downsample_factor);
+        // 4. Open the native event cache (mmap), or load columns from the event file.
+        //    In streaming mode only the file is opened; events are prefetched while playing.
+        //    In live mode the sensor resolution comes from the first packet.
+        //    HDF5 files use the layout from 'hdf5_schema' (DSEC or Metavision is detected when it is absent).
+        std::optional<PrefetchConfig> prefetch_config = load_prefetch_config(master_config, cli_config.downsample_factor);
+        HDF5Schema hdf5_schema = load_hdf5_schema(master_config);
+        std::unique_ptr<EventPrefetcher> prefetcher;
+        LoadedEvents loaded;
+        if (live_receiver) {
+            loaded.resolution = wait_for_live_resolution(*live_receiver);
+        } else if (prefetch_config) {
+            prefetcher = open_streaming(event_filepath, hdf5_schema, *prefetch_config, load_streaming_resolution(master_config), loaded.resolution);
+        } else {
+            EventCacheConfig cache_config = load_cache_config(master_config, cli_config.config_filepath.parent_path());
+            cache_config.source_variant = hdf5_schema.describe();
+            loaded = load_events(event_filepath, hdf5_schema, cache_config, cli_config.downsample_factor, compression_requested(master_config));
 
-        if (events_to_render.empty()) {
-             std::cerr << "Error: No events to render after downsampling." << std::endl;
-             return -1;
+            if (loaded.compressed ? loaded.compressed->empty() : loaded.events.empty()) {
+                 std::cerr << "Error: No events to render after downsampling." << std::endl;
+                 return -1;
+            }
         }
 
-        // 5. Load RGB image data if specified
+        // 5. Load RGB image data if specified, otherwise frames embedded in the event file (AEDAT4 APS frames, NumPy frames)
         std::vector<RGBFrame> all_images;
         if (master_config["rgb_images"]) {
             YAML::Node rgb_config_node = master_config["rgb_images"];
@@ -74,6 +114,8 @@ int main(int argc, char* argv[]) {
 
             ImageLoader image_loader(image_loader_config);
             all_images = image_loader.load_image_data();
+        } else if (!live_receiver) {
+            all_images = load_embedded_frames(event_filepath.string());
         }
 
         // 6. Load color configuration from YAML, with defaults
@@ -88,12 +130,28 @@ int main(int argc, char* argv[]) {
             if (colors["event_off"])  off_color = glm::vec3(colors["event_off"][0].as<float>(), colors["event_off"][1].as<float>(), colors["event_off"][2].as<float>());
         }
 
-        // 7. Calculate sensor resolution from data
-        Resolution resolution = calculate_resolution(events_to_render);
+        // Accumulation target and colormap for the event image
+        RenderOptions render_options = load_render_options(master_config);
+
+        // 7. Sensor resolution (from cache metadata, or calculated from the data)
+        const Resolution& resolution = loaded.resolution;
         std::cout << "--- Detected resolution: " << resolution.width << "x" << resolution.height << " ---" << std::endl;
 
-        // 8. Run the renderer with all loaded data and configuration
-        run_renderer(events_to_render, all_images, resolution.width, resolution.height, t_offset, bg_color, on_color, off_color);
+        // 8. Run the renderer with all loaded data and configuration,
+        //    optionally keeping the events in the compressed in-memory form
+        if (live_receiver) {
+            run_renderer(*live_receiver, all_images, resolution.width, resolution.height, bg_color, on_color, off_color, render_options);
+        } else if (prefetcher) {
+            run_renderer(*prefetcher, all_images, resolution.width, resolution.height, bg_color, on_color, off_color, render_options);
+        } else if (loaded.compressed) {
+            run_renderer(*loaded.compressed, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, bg_color, on_color, off_color, render_options);
+        } else if (should_compress_events(master_config, loaded.events)) {
+            CompressedEventStore compressed = compress_events(loaded.events);
+            loaded.events.clear();
+            run_renderer(compressed, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, bg_color, on_color, off_color, render_options);
+        } else {
+            run_renderer(loaded.events, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, bg_color, on_color, off_color, render_options);
+        }
 
     } catch (const H5::Exception& err) {
         std::cerr << "A fatal HDF5 error occurred." << std::endl;
@@ -132,31 +190,325 @@ CLIConfig parse_arguments(int argc, char* argv[]) {
     return config;
 }
 
-std::vector<EventCD> downsample_events(const std::vector<EventCD>& all_events, int factor) {
+EventCacheConfig load_cache_config(const YAML::Node& master_config, const fs::path& config_dir) {
+    EventCacheConfig config;
+    if (!master_config["cache"]) {
+        return config;
+    }
+    YAML::Node cache_node = master_config["cache"];
+    if (cache_node["enabled"]) config.enabled = cache_node["enabled"].as<bool>();
+    if (cache_node["directory"]) {
+        std::string directory = cache_node["directory"].as<std::string>();
+        // Relative paths are resolved against the YAML file's directory
+        if (!directory.empty()) config.directory = config_dir / directory;
+    }
+    if (cache_node["max_size_gb"]) {
+        config.max_size_bytes = static_cast<uint64_t>(cache_node["max_size_gb"].as<double>() * (1ull << 30));
+    }
+    return config;
+}
+
+RenderOptions load_render_options(const YAML::Node& master_config) {
+    RenderOptions options;
+    if (!master_config["rendering"]) return options;
+    YAML::Node rendering = master_config["rendering"];
+    if (rendering["accumulation"]) {
+        std::optional<AccumulationFormat> format = parse_accumulation_format(rendering["accumulation"].as<std::string>());
+        if (!format) throw std::runtime_error("'rendering.accumulation' must be float32, float16 or rgba8.");
+        options.accumulation = *format;
+    }
+    if (rendering["accumulation_path"]) {
+        std::optional<AccumulationPath> path = parse_accumulation_path(rendering["accumulation_path"].as<std::string>());
+        if (!path) throw std::runtime_error("'rendering.accumulation_path' must be auto, points or compute.");
+        options.path = *path;
+    }
+    if (rendering["incremental"]) options.incremental = rendering["incremental"].as<bool>();
+    if (rendering["keyframe_interval_ms"]) {
+        double interval_ms = rendering["keyframe_interval_ms"].as<double>();
+        if (interval_ms <= 0.0) throw std::runtime_error("'rendering.keyframe_interval_ms' must be positive.");
+        options.keyframe_interval_us = std::max<int64_t>(1, static_cast<int64_t>(interval_ms * 1000.0));
+    }
+    if (rendering["keyframe_memory_mb"]) options.keyframe_memory_mb = rendering["keyframe_memory_mb"].as<size_t>();
+    if (rendering["colormap"]) {
+        std::optional<Colormap> colormap = parse_colormap(rendering["colormap"].as<std::string>());
+        if (!colormap) throw std::runtime_error("'rendering.colormap' must be dominance, net or count.");
+        options.colormap = *colormap;
+    }
+    return options;
+}
+
+HDF5Schema load_hdf5_schema(const YAML::Node& master_config) {
+    if (!master_config["hdf5_schema"]) {
+        return {};
+    }
+    YAML::Node schema_node = master_config["hdf5_schema"];
+    // Start from the preset for the layout, then override the entries that are given
+    std::string layout = schema_node["layout"] ? schema_node["layout"].as<std::string>()
+                                               : (schema_node["events"] ? "compound" : "columns");
+    HDF5Schema schema;
+    if (layout == "columns") {
+        schema = HDF5Schema::dsec();
+    } else if (layout == "compound") {
+        schema = HDF5Schema::metavision();
+    } else {
+        throw std::runtime_error("'hdf5_schema.layout' must be 'columns' or 'compound'.");
+    }
+    auto set = [&](const char* key, std::string& value) {
+        if (schema_node[key]) value = schema_node[key].as<std::string>();
+    };
+    set("events", schema.events);
+    set("x", schema.x);
+    set("y", schema.y);
+    set("p", schema.p);
+    set("t", schema.t);
+    set("t_offset", schema.t_offset);
+    set("ms_to_idx", schema.ms_to_idx);
+    if (schema_node["time_unit"]) {
+        std::optional<TimeUnit> unit = parse_time_unit(schema_node["time_unit"].as<std::string>());
+        if (!unit) throw std::runtime_error("'hdf5_schema.time_unit' must be one of s, ms, us, ns.");
+        schema.time_unit = *unit;
+    }
+    return schema;
+}
+
+std::optional<PrefetchConfig> load_prefetch_config(const YAML::Node& master_config, int factor) {
+    if (!master_config["streaming"] || !master_config["streaming"]["enabled"] ||
+        !master_config["streaming"]["enabled"].as<bool>()) {
+        return std::nullopt;
+    }
+    YAML::Node streaming_node = master_config["streaming"];
+    PrefetchConfig config;
+    if (streaming_node["lookahead_ms"]) config.lookahead_ms = streaming_node["lookahead_ms"].as<double>();
+    if (streaming_node["buffer_mb"]) {
+        config.max_buffer_bytes = static_cast<size_t>(streaming_node["buffer_mb"].as<double>() * (1ull << 20));
+    }
+    config.stride = static_cast<size_t>(factor);
+    return config;
+}
+
+// Sensor resolution from 'streaming.resolution' ([width, height]), if given
+std::optional<Resolution> load_streaming_resolution(const YAML::Node& master_config) {
+    if (!master_config["streaming"] || !master_config["streaming"]["resolution"]) {
+        return std::nullopt;
+    }
+    YAML::Node node = master_config["streaming"]["resolution"];
+    Resolution resolution{node[0].as<int>(), node[1].as<int>()};
+    if (resolution.width <= 0 || resolution.height <= 0) {
+        throw std::runtime_error("'streaming.resolution' must be [width, height].");
+    }
+    return resolution;
+}
+
+std::unique_ptr<EventPrefetcher> open_streaming(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const PrefetchConfig& prefetch_config, const std::optional<Resolution>& configured, Resolution& resolution) {
+    std::unique_ptr<EventSource> source = open_event_source(event_filepath.string(), hdf5_schema);
+    if (source->num_events() == 0) {
+        throw std::runtime_error("No events found in the event file.");
+    }
+    // Prefer the config, then the resolution stored in the file; otherwise estimate it from a sample instead of scanning the whole file
+    std::optional<Resolution> stored = configured ? configured : source->resolution();
+    resolution = stored ? *stored : estimate_resolution(*source);
+    return std::make_unique<EventPrefetcher>(std::move(source), prefetch_config);
+}
+
+std::unique_ptr<LiveEventReceiver> open_live_input(const YAML::Node& master_config) {
+    if (!master_config["live"] || !master_config["live"]["enabled"] || !master_config["live"]["enabled"].as<bool>()) {
+        return nullptr;
+    }
+    YAML::Node live_node = master_config["live"];
+    if (!live_node["address"]) {
+        throw std::runtime_error("'live.address' not found in master config.");
+    }
+    size_t buffer_events = live_node["buffer_events"] ? live_node["buffer_events"].as<size_t>() : size_t(1) << 22;
+    return std::make_unique<LiveEventReceiver>(LiveEndpoint::parse(live_node["address"].as<std::string>()), buffer_events);
+}
+
+Resolution wait_for_live_resolution(const LiveEventReceiver& receiver) {
+    std::cout << "--- Waiting for the first packet on " << receiver.endpoint().str() << " (Ctrl+C to quit) ---" << std::endl;
+    while (true) {
+        if (std::optional<Resolution> resolution = receiver.wait_for_resolution(std::chrono::seconds(1))) {
+            return *resolution;
+        }
+    }
+}
+
+LoadedEvents load_events(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const EventCacheConfig& cache_config, int factor, bool compress) {
+    LoadedEvents loaded;
+    EventCache cache(cache_config);
+
+    if (std::optional<CachedRecording> cached = cache.open(event_filepath)) {
+        std::cout << "--- Original event count: " << cached->events.size() << std::endl;
+        loaded.events = downsample_events(std::move(cached->events), factor);
+        if (factor <= 1) loaded.time_index = std::move(cached->time_index);
+        loaded.t_offset = cached->t_offset;
+        loaded.resolution = cached->resolution;
+        return loaded;
+    }
+
+    std::unique_ptr<EventSource> source = open_event_source(event_filepath.string(), hdf5_schema);
+    loaded.t_offset = source->load_t_offset();
+    if (source->num_events() == 0) {
+        throw std::runtime_error("No events found in the event file.");
+    }
+
+    // With compression on, encode chunk by chunk so the uncompressed recording never has to fit in memory.
+    // The native cache is written from a full in-memory recording, so it is not written in this mode.
+    if (compress && load_events_compressed(*source, factor, loaded)) return loaded;
+
+    // Only slow-to-decode formats such as HDF5 get a native cache. Uncompressed
+    // contiguous datasets are already mmap views of the source file.
+    if (!cache.enabled() || !source->benefits_from_cache() || source->is_memory_mapped()) {
+        loaded.events = load_events_downsampled(*source, factor);
+        std::optional<Resolution> stored = source->resolution();
+        loaded.resolution = stored ? *stored : calculate_resolution(loaded.events);
+        return loaded;
+    }
+
+    // The cache always holds the full recording; downsampling happens after loading.
+    CachedRecording recording;
+    recording.events = load_events_downsampled(*source, 1);
+    recording.ms_to_idx = source->ms_to_idx();
+    recording.index_base_ms = source->time_index_base_ms();
+    recording.t_offset = loaded.t_offset;
+    // Read through a const view so a cache-loaded recording's mmap'd t column is not copied
+    const EventStore& events = recording.events;
+    recording.time_index = TimeIndex::build(events.t.data(), events.size(), recording.t_offset);
+    std::optional<Resolution> stored = source->resolution();
+    recording.resolution = stored ? *stored : calculate_resolution(recording.events);
+    cache.store(event_filepath, recording);
+
+    loaded.events = downsample_events(std::move(recording.events), factor);
+    if (factor <= 1) loaded.time_index = std::move(recording.time_index);
+    loaded.resolution = recording.resolution;
+    return loaded;
+}
+
+bool load_events_compressed(EventSource& source, int factor, LoadedEvents& loaded) {
+    size_t total = source.num_events();
+    size_t stride = static_cast<size_t>(std::max(1, factor));
+    size_t count = (total + stride - 1) / stride;
+    std::cout << "--- Original event count: " << total << std::endl;
+    std::cout << "--- Compressing events while loading..." << std::endl;
+
+    // Chunks are whole compression blocks, so each one continues the block sequence of the previous one
+    constexpr size_t CHUNK_EVENTS = EventSource::DEFAULT_CHUNK_SIZE;
+    static_assert(CHUNK_EVENTS % CompressedEventStore::BLOCK_SIZE == 0, "chunks must be whole compression blocks");
+    CompressedEventStore compressed;
+    compressed.reserve(count);
+    int64_t t_first = source.read_events(0, 1, EVENT_COLUMN_T).t.front();
+    int64_t t_last = source.read_events((count - 1) * stride, 1, EVENT_COLUMN_T).t.front();
+    TimeIndex time_index(loaded.t_offset + t_first, loaded.t_offset + t_last, count);
+    std::optional<Resolution> stored = source.resolution();
+    uint16_t max_x = 0;
+    uint16_t max_y = 0;
+    for (size_t out = 0; out < count; out += CHUNK_EVENTS) {
+        size_t begin = out * stride;
+        const EventStore chunk = source.read_events(begin, std::min(CHUNK_EVENTS * stride, total - begin), EVENT_COLUMNS_ALL, stride);
+        if (!CompressedEventStore::can_encode(chunk)) {
+            std::cerr << "Warning: Events cannot be compressed (coordinates over 15 bits or polarity not 0/1); loading them uncompressed." << std::endl;
+            return false;
+        }
+        compressed.append(chunk);
+        time_index.append(chunk.t.data(), chunk.size(), loaded.t_offset);
+        if (!stored && !chunk.empty()) {
+            max_x = std::max(max_x, *std::max_element(chunk.x.begin(), chunk.x.end()));
+            max_y = std::max(max_y, *std::max_element(chunk.y.begin(), chunk.y.end()));
+        }
+    }
+    loaded.resolution = stored ? *stored : Resolution{static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
+    loaded.time_index = std::move(time_index);
+    std::cout << "--- Compressed " << compressed.size() << " events to " << compressed.memory_bytes() / (1024 * 1024) << " MB ("
+              << static_cast<double>(compressed.memory_bytes()) / std::max<size_t>(1, compressed.size()) << " B/event) ---" << std::endl;
+    loaded.compressed = std::move(compressed);
+    return true;
+}
+
+EventStore load_events_downsampled(EventSource& source, int factor) {
+    size_t total = source.num_events();
+    std::cout << "--- Original event count: " << total << std::endl;
+    if (factor > 1) {
+        std::cout << "--- Downsampling by a factor of " << factor << "..." << std::endl;
+    }
+
+    // Read straight into the output columns; a strided read skips the
+    // intermediate full-resolution copy when downsampling.
+    EventStore events = source.read_events(0, total, EVENT_COLUMNS_ALL, factor);
+    std::cout << "--- Loaded event count: " << events.size() << std::endl;
+    return events;
+}
+
+EventStore downsample_events(EventStore events, int factor) {
     if (factor <= 1) {
-        return all_events;
+        // Share the columns instead of copying (cache-backed columns stay mmap views)
+        return events;
     }
-    std::cout << "--- Original event count: " << all_events.size() << std::endl;
     std::cout << "--- Downsampling by a factor of " << factor << "..." << std::endl;
-    std::vector<EventCD> downsampled;
-    downsampled.reserve(all_events.size() / factor + 1);
-    for (size_t i = 0; i < all_events.size(); i += factor) {
-        downsampled.push_back(all_events[i]);
+    size_t count = (events.size() + factor - 1) / factor;
+    // Read through a const reference: non-const element access would copy mmap'd columns to the heap
+    const EventStore& source = events;
+    EventStore sampled;
+    sampled.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t src = i * factor;
+        sampled.x[i] = source.x[src];
+        sampled.y[i] = source.y[src];
+        sampled.p[i] = source.p[src];
+        sampled.t[i] = source.t[src];
     }
-    std::cout << "--- Downsampled event count: " << downsampled.size() << std::endl;
-    return downsampled;
+    std::cout << "--- Loaded event count: " << sampled.size() << std::endl;
+    return sampled;
 }
 
-Resolution calculate_resolution(const std::vector<EventCD>& events) {
+Resolution calculate_resolution(const EventStore& events) {
     if (events.empty()) {
         return {0, 0};
     }
+    std::cout << "--- Calculating sensor resolution from data..." << std::endl;
+    uint16_t max_x = *std::max_element(events.x.begin(), events.x.end());
+    uint16_t max_y = *std::max_element(events.y.begin(), events.y.end());
+    return {static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
+}
+
+Resolution estimate_resolution(EventSource& source) {
+    std::cout << "--- Estimating sensor resolution from a sample of the data (set 'streaming.resolution' to skip this)..." << std::endl;
+    // Read the x/y columns of a fixed number of blocks spread evenly over the file, so the cost does not grow with its length
+    constexpr size_t SAMPLE_BLOCKS = 64;
+    constexpr size_t SAMPLE_BLOCK_EVENTS = size_t(1) << 16;
+    size_t num_events = source.num_events();
+    size_t block = std::min(SAMPLE_BLOCK_EVENTS, num_events);
+    size_t blocks = std::min(SAMPLE_BLOCKS, (num_events + block - 1) / block);
     uint16_t max_x = 0;
     uint16_t max_y = 0;
-    std::cout << "--- Calculating sensor resolution from data..." << std::endl;
-    for (const auto& event : events) {
-        max_x = std::max(max_x, event.x);
-        max_y = std::max(max_y, event.y);
+    for (size_t i = 0; i < blocks; ++i) {
+        size_t begin = blocks > 1 ? (num_events - block) / (blocks - 1) * i : 0;
+        const EventStore columns = source.read_events(begin, block, EVENT_COLUMN_X | EVENT_COLUMN_Y);
+        if (columns.empty()) continue;
+        max_x = std::max(max_x, *std::max_element(columns.x.begin(), columns.x.end()));
+        max_y = std::max(max_y, *std::max_element(columns.y.begin(), columns.y.end()));
     }
     return {static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
-}
\ No newline at end of file
+}
+
+// Whether 'memory.compress_events' is on
+bool compression_requested(const YAML::Node& master_config) {
+    return master_config["memory"] && master_config["memory"]["compress_events"] &&
+           master_config["memory"]["compress_events"].as<bool>();
+}
+
+bool should_compress_events(const YAML::Node& master_config, const EventStore& events) {
+    if (!compression_requested(master_config)) {
+        return false;
+    }
+    if (!CompressedEventStore::can_encode(events)) {
+        std::cerr << "Warning: Events cannot be compressed (coordinates over 15 bits or polarity not 0/1); keeping them uncompressed." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CompressedEventStore compress_events(const EventStore& events) {
+    std::cout << "--- Compressing events..." << std::endl;
+    CompressedEventStore compressed = CompressedEventStore::encode(events);
+    std::cout << "--- Compressed " << compressed.size() << " events to " << compressed.memory_bytes() / (1024 * 1024) << " MB ("
+              << static_cast<double>(compressed.memory_bytes()) / std::max<size_t>(1, compressed.size()) << " B/event) ---" << std::endl;
+    return compressed;
+}
@@ -0,0 +1,585 @@
+#include "numpy_reader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 型変換を1スレッドに割り当てる単位 (要素数)
+constexpr size_t CONVERT_BLOCK = size_t(1) << 20;
+
+// dtype の1フィールド (構造化でない配列では名前なしの1つ)
+struct NpyField {
+    std::string name;
+    char kind = 0;       // 'i', 'u', 'f', 'b', 'M' (datetime64), 'm' (timedelta64), 'V' (パディング)
+    size_t size = 0;
+    size_t offset = 0;   // 要素内の位置
+    int64_t us_mul = 1;  // datetime64 / timedelta64 の値を µs に換算する係数 (us_mul / us_div)
+    int64_t us_div = 1;
+};
+
+// .npy の配列 (データはファイルの mmap、または展開したバッファを参照する)
+struct NpyArray {
+    std::string name;
+    std::vector<NpyField> fields;
+    bool structured = false;
+    size_t itemsize = 0;
+    std::vector<size_t> shape;
+    size_t count = 0;              // 要素数 (shape の積)
+    const uint8_t* data = nullptr; // 先頭要素
+    std::shared_ptr<const void> keepalive;
+    bool mapped = false;           // ファイルを直接参照している (展開していない)
+};
+
+// 配列を含むバイト列 (.npy ファイル全体、または .npz のメンバ)
+struct NpyBlob {
+    std::string name;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> keepalive;
+    bool mapped = false;
+};
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+template <typename T>
+T read_le(const uint8_t* src) {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+bool is_frame_name(const std::string& name) {
+    std::string n = lower(name);
+    return n == "frames" || n == "images";
+}
+
+bool is_frame_time_name(const std::string& name) {
+    std::string n = lower(name);
+    return n == "frame_timestamps" || n == "image_timestamps" || n == "frame_ts" || n == "frame_t";
+}
+
+// --- .npy ヘッダ ---
+
+// 型文字列 ('<u2', '|b1', '<f8', '<M8[us]' など) を解釈する
+NpyField parse_type(const std::string& descr, const std::string& source) {
+    NpyField field;
+    size_t i = 0;
+    if (!descr.empty() && std::strchr("<>|=", descr[0])) {
+        if (descr[0] == '>') throw std::runtime_error("Big-endian NumPy arrays are not supported: " + source);
+        i = 1;
+    }
+    if (i >= descr.size()) throw std::runtime_error("Invalid NumPy dtype '" + descr + "': " + source);
+    field.kind = descr[i++];
+    size_t digits = i;
+    while (i < descr.size() && std::isdigit(static_cast<unsigned char>(descr[i]))) ++i;
+    if (digits == i) throw std::runtime_error("Invalid NumPy dtype '" + descr + "': " + source);
+    field.size = std::stoul(descr.substr(digits, i - digits));
+
+    if (field.kind == 'M' || field.kind == 'm') {
+        size_t open = descr.find('[', i);
+        size_t close = descr.find(']', i);
+        std::string unit = (open != std::string::npos && close != std::string::npos) ? descr.substr(open + 1, close - open - 1) : "";
+        if (unit == "ns") field.us_div = 1000;
+        else if (unit == "us") field.us_mul = 1;
+        else if (unit == "ms") field.us_mul = 1000;
+        else if (unit == "s") field.us_mul = 1000000;
+        else throw std::runtime_error("Unsupported time unit in NumPy dtype '" + descr + "': " + source);
+    }
+    bool ok = false;
+    switch (field.kind) {
+    case 'i': case 'u': ok = field.size == 1 || field.size == 2 || field.size == 4 || field.size == 8; break;
+    case 'b': ok = field.size == 1; break;
+    case 'f': ok = field.size == 4 || field.size == 8; break;
+    case 'M': case 'm': ok = field.size == 8; break;
+    case 'V': ok = true; break;
+    default: break;
+    }
+    if (!ok) throw std::runtime_error("Unsupported NumPy dtype '" + descr + "': " + source);
+    return field;
+}
+
+// pos 以降で最初の 'quoted' 文字列を取り出す
+std::string next_quoted(const std::string& s, size_t& pos) {
+    size_t open = s.find_first_of("'\"", pos);
+    if (open == std::string::npos) throw std::runtime_error("Invalid NumPy header");
+    size_t close = s.find(s[open], open + 1);
+    if (close == std::string::npos) throw std::runtime_error("Invalid NumPy header");
+    pos = close + 1;
+    return s.substr(open + 1, close - open - 1);
+}
+
+// ヘッダ辞書 {'descr': ..., 'fortran_order': ..., 'shape': (...), } を読む
+NpyArray parse_npy(const NpyBlob& blob) {
+    static const char MAGIC[] = "\x93NUMPY";
+    if (blob.size < 10 || std::memcmp(blob.data, MAGIC, 6) != 0) throw std::runtime_error("Not a NumPy array: " + blob.name);
+    uint8_t major = blob.data[6];
+    size_t header_len = major == 1 ? read_le<uint16_t>(blob.data + 8) : read_le<uint32_t>(blob.data + 8);
+    size_t header_start = major == 1 ? 10 : 12;
+    if (header_start + header_len > blob.size) throw std::runtime_error("Truncated NumPy header: " + blob.name);
+    std::string header(reinterpret_cast<const char*>(blob.data + header_start), header_len);
+
+    NpyArray array;
+    array.name = blob.name;
+    size_t pos = header.find("descr");
+    if (pos == std::string::npos) throw std::runtime_error("NumPy header has no dtype: " + blob.name);
+    pos = header.find(':', pos) + 1;
+    while (pos < header.size() && std::isspace(static_cast<unsigned char>(header[pos]))) ++pos;
+    if (pos < header.size() && header[pos] == '[') {
+        // 構造化: [('x', '<u2'), ('y', '<u2'), ...]
+        array.structured = true;
+        size_t end = header.find(']', pos);
+        while (true) {
+            size_t tuple = header.find('(', pos);
+            if (tuple == std::string::npos || tuple > end) break;
+            pos = tuple + 1;
+            std::string name = next_quoted(header, pos);
+            NpyField field = parse_type(next_quoted(header, pos), blob.name);
+            size_t close = header.find(')', pos);
+            if (header.find_first_not_of(" ,", pos) < close) {
+                throw std::runtime_error("NumPy sub-array fields are not supported: " + blob.name);
+            }
+            pos = close + 1;
+            field.name = name;
+            field.offset = array.itemsize;
+            array.itemsize += field.size;
+            array.fields.push_back(field);
+            end = header.find(']', pos);
+        }
+    } else {
+        array.fields.push_back(parse_type(next_quoted(header, pos), blob.name));
+        array.itemsize = array.fields.back().size;
+    }
+
+    size_t fortran = header.find("fortran_order");
+    bool fortran_order = fortran != std::string::npos && header.compare(header.find(':', fortran) + 1,
+                                                                       header.find_first_of(",}", fortran) - header.find(':', fortran) - 1,
+                                                                       " True") == 0;
+    size_t shape = header.find("shape");
+    if (shape == std::string::npos) throw std::runtime_error("NumPy header has no shape: " + blob.name);
+    size_t open = header.find('(', shape);
+    size_t close = header.find(')', open);
+    std::string dims = header.substr(open + 1, close - open - 1);
+    array.count = 1;
+    for (size_t d = 0; d < dims.size();) {
+        size_t comma = dims.find(',', d);
+        std::string item = dims.substr(d, comma == std::string::npos ? std::string::npos : comma - d);
+        if (item.find_first_not_of(" ") != std::string::npos) {
+            array.shape.push_back(std::stoull(item));
+            array.count *= array.shape.back();
+        }
+        if (comma == std::string::npos) break;
+        d = comma + 1;
+    }
+    if (fortran_order && array.shape.size() > 1) throw std::runtime_error("Fortran-ordered NumPy arrays are not supported: " + blob.name);
+
+    size_t data_offset = header_start + header_len;
+    if (array.itemsize == 0 || array.count > (blob.size - data_offset) / array.itemsize) {
+        throw std::runtime_error("Truncated NumPy array: " + blob.name);
+    }
+    array.data = blob.data + data_offset;
+    array.keepalive = blob.keepalive;
+    array.mapped = blob.mapped;
+    return array;
+}
+
+// --- .npz (zip) ---
+
+struct ZipMember {
+    std::string name;   // ".npy" を除いたメンバ名
+    uint16_t method = 0; // 0: 無圧縮 (np.savez), 8: deflate (np.savez_compressed)
+    uint64_t compressed = 0;
+    uint64_t uncompressed = 0;
+    uint64_t local_offset = 0;
+};
+
+std::vector<ZipMember> read_zip_directory(const MappedFile& file, const std::string& path) {
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    // End of central directory はコメント (最大 64KB) の前にある
+    size_t eocd = std::string::npos;
+    for (size_t i = size >= 22 ? size - 22 : 0, stop = size > 22 + 65535 ? size - 22 - 65535 : 0; size >= 22; --i) {
+        if (read_le<uint32_t>(data + i) == 0x06054b50) { eocd = i; break; }
+        if (i == stop) break;
+    }
+    if (eocd == std::string::npos) throw std::runtime_error("Not a zip (.npz) file: " + path);
+    uint64_t entries = read_le<uint16_t>(data + eocd + 10);
+    uint64_t cd_offset = read_le<uint32_t>(data + eocd + 16);
+    if ((entries == 0xFFFF || cd_offset == 0xFFFFFFFF) && eocd >= 20 && read_le<uint32_t>(data + eocd - 20) == 0x07064b50) {
+        // ZIP64 (np.savez は常に ZIP64 で書く)
+        uint64_t eocd64 = read_le<uint64_t>(data + eocd - 20 + 8);
+        if (eocd64 + 56 > size || read_le<uint32_t>(data + eocd64) != 0x06064b50) throw std::runtime_error("Corrupt zip64 directory: " + path);
+        entries = read_le<uint64_t>(data + eocd64 + 32);
+        cd_offset = read_le<uint64_t>(data + eocd64 + 48);
+    }
+
+    std::vector<ZipMember> members;
+    size_t pos = cd_offset;
+    for (uint64_t e = 0; e < entries; ++e) {
+        if (pos + 46 > size || read_le<uint32_t>(data + pos) != 0x02014b50) throw std::runtime_error("Corrupt zip directory: " + path);
+        ZipMember member;
+        member.method = read_le<uint16_t>(data + pos + 10);
+        member.compressed = read_le<uint32_t>(data + pos + 20);
+        member.uncompressed = read_le<uint32_t>(data + pos + 24);
+        size_t name_len = read_le<uint16_t>(data + pos + 28);
+        size_t extra_len = read_le<uint16_t>(data + pos + 30);
+        size_t comment_len = read_le<uint16_t>(data + pos + 32);
+        member.local_offset = read_le<uint32_t>(data + pos + 42);
+        if (pos + 46 + name_len + extra_len > size) throw std::runtime_error("Corrupt zip directory: " + path);
+        member.name.assign(reinterpret_cast<const char*>(data + pos + 46), name_len);
+
+        // ZIP64 拡張フィールド: 0xFFFFFFFF になっている値だけがこの順に入る
+        const uint8_t* extra = data + pos + 46 + name_len;
+        for (size_t x = 0; x + 4 <= extra_len;) {
+            uint16_t id = read_le<uint16_t>(extra + x);
+            uint16_t len = read_le<uint16_t>(extra + x + 2);
+            if (id == 0x0001) {
+                const uint8_t* v = extra + x + 4;
+                const uint8_t* v_end = v + std::min<size_t>(len, extra_len - x - 4);
+                if (member.uncompressed == 0xFFFFFFFF && v + 8 <= v_end) { member.uncompressed = read_le<uint64_t>(v); v += 8; }
+                if (member.compressed == 0xFFFFFFFF && v + 8 <= v_end) { member.compressed = read_le<uint64_t>(v); v += 8; }
+                if (member.local_offset == 0xFFFFFFFF && v + 8 <= v_end) { member.local_offset = read_le<uint64_t>(v); }
+            }
+            x += 4 + len;
+        }
+        pos += 46 + name_len + extra_len + comment_len;
+
+        if (member.name.size() > 4 && lower(member.name.substr(member.name.size() - 4)) == ".npy") {
+            member.name.resize(member.name.size() - 4);
+            members.push_back(member);
+        }
+    }
+    return members;
+}
+
+NpyBlob open_member(const std::shared_ptr<MappedFile>& file, const ZipMember& member, const std::string& path) {
+    const uint8_t* data = file->data();
+    size_t size = file->size();
+    uint64_t local = member.local_offset;
+    if (local + 30 > size || read_le<uint32_t>(data + local) != 0x04034b50) throw std::runtime_error("Corrupt zip member '" + member.name + "': " + path);
+    uint64_t begin = local + 30 + read_le<uint16_t>(data + local + 26) + read_le<uint16_t>(data + local + 28);
+    if (begin > size || member.compressed > size - begin) throw std::runtime_error("Truncated zip member '" + member.name + "': " + path);
+
+    NpyBlob blob;
+    blob.name = path + ":" + member.name;
+    if (member.method == 0) {
+        // 無圧縮のメンバはファイルの mmap をそのまま参照する
+        blob.data = data + begin;
+        blob.size = member.compressed;
+        blob.keepalive = file;
+        blob.mapped = true;
+        return blob;
+    }
+    if (member.method != 8) throw std::runtime_error("Unsupported compression in zip member '" + member.name + "': " + path);
+
+    auto buffer = std::make_shared<std::vector<uint8_t>>(member.uncompressed);
+    z_stream zs{};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) throw std::runtime_error("inflateInit2 failed");
+    const uint8_t* in = data + begin;
+    uint64_t in_left = member.compressed;
+    uint8_t* out = buffer->data();
+    uint64_t out_left = buffer->size();
+    int ret = Z_OK;
+    // avail_in / avail_out は32bitなので、4GB を超えるメンバは区切って渡す
+    while (ret == Z_OK) {
+        if (zs.avail_in == 0 && in_left > 0) {
+            zs.next_in = const_cast<Bytef*>(in);
+            zs.avail_in = static_cast<uInt>(std::min<uint64_t>(in_left, UINT_MAX));
+            in += zs.avail_in;
+            in_left -= zs.avail_in;
+        }
+        if (zs.avail_out == 0 && out_left > 0) {
+            zs.next_out = out;
+            zs.avail_out = static_cast<uInt>(std::min<uint64_t>(out_left, UINT_MAX));
+            out += zs.avail_out;
+            out_left -= zs.avail_out;
+        }
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_BUF_ERROR && (zs.avail_in > 0 || in_left > 0) && (zs.avail_out > 0 || out_left > 0)) ret = Z_OK;
+    }
+    inflateEnd(&zs);
+    if (ret != Z_STREAM_END || zs.total_out != buffer->size()) throw std::runtime_error("Corrupt deflate data in zip member '" + member.name + "': " + path);
+    blob.data = buffer->data();
+    blob.size = buffer->size();
+    blob.keepalive = buffer;
+    return blob;
+}
+
+// path (.npz のメンバ、または .npy と同じディレクトリの .npy) のうち、wanted が true を返す名前の配列を開く
+// 圧縮されたメンバはメンバごとに並列に展開する
+std::vector<NpyArray> open_arrays(const std::string& path, const std::function<bool(const std::string&)>& wanted) {
+    std::vector<NpyBlob> blobs;
+    if (lower(fs::path(path).extension().string()) == NumpyReader::NPZ_EXTENSION) {
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        std::vector<ZipMember> members;
+        for (const ZipMember& member : read_zip_directory(*file, path)) {
+            if (wanted(member.name)) members.push_back(member);
+        }
+        blobs.resize(members.size());
+        ThreadPool::shared().parallel_for(members.size(), [&](size_t i) { blobs[i] = open_member(file, members[i], path); });
+        for (size_t i = 0; i < members.size(); ++i) blobs[i].name = members[i].name;
+    } else {
+        fs::path dir = fs::path(path).parent_path();
+        if (dir.empty()) dir = ".";
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            if (!entry.is_regular_file() || lower(entry.path().extension().string()) != NumpyReader::NPY_EXTENSION) continue;
+            std::string name = entry.path().stem().string();
+            if (!wanted(name)) continue;
+            std::shared_ptr<MappedFile> file = MappedFile::open(entry.path().string());
+            blobs.push_back({name, file->data(), file->size(), file, true});
+        }
+    }
+    std::vector<NpyArray> arrays;
+    for (const NpyBlob& blob : blobs) {
+        arrays.push_back(parse_npy(blob));
+        arrays.back().name = blob.name;
+    }
+    return arrays;
+}
+
+// --- 型変換 ---
+
+// field の値を Src 型として読み、fn で変換して dst に書き込む
+template <typename Src, typename Dst, typename Fn>
+void convert_typed(const uint8_t* src, size_t stride, size_t n, Dst* dst, const Fn& fn) {
+    for (size_t i = 0; i < n; ++i) dst[i] = fn(read_le<Src>(src + i * stride));
+}
+
+template <typename Dst, typename Fn>
+void convert_field(const NpyField& field, const uint8_t* src, size_t stride, size_t n, Dst* dst, const Fn& fn) {
+    switch (field.kind) {
+    case 'b':
+    case 'u':
+        switch (field.size) {
+        case 1: return convert_typed<uint8_t>(src, stride, n, dst, fn);
+        case 2: return convert_typed<uint16_t>(src, stride, n, dst, fn);
+        case 4: return convert_typed<uint32_t>(src, stride, n, dst, fn);
+        default: return convert_typed<uint64_t>(src, stride, n, dst, fn);
+        }
+    case 'i':
+        switch (field.size) {
+        case 1: return convert_typed<int8_t>(src, stride, n, dst, fn);
+        case 2: return convert_typed<int16_t>(src, stride, n, dst, fn);
+        case 4: return convert_typed<int32_t>(src, stride, n, dst, fn);
+        default: return convert_typed<int64_t>(src, stride, n, dst, fn);
+        }
+    case 'f':
+        if (field.size == 4) return convert_typed<float>(src, stride, n, dst, fn);
+        return convert_typed<double>(src, stride, n, dst, fn);
+    case 'M':
+    case 'm':
+        return convert_typed<int64_t>(src, stride, n, dst, [&](int64_t v) { return fn(v * field.us_mul / field.us_div); });
+    default:
+        throw std::runtime_error("Unsupported NumPy dtype for an event column: " + field.name);
+    }
+}
+
+// 列 column を作る。exact (ファイル上の型が T と同じ) かつ連続・整列していればビューにし、それ以外は並列に変換する
+template <typename T, typename Fn>
+bool build_column(ColumnBuffer<T>& column, const NpyArray& array, const NpyField& field, bool exact, const Fn& fn) {
+    const uint8_t* src = array.data + field.offset;
+    if (exact && array.itemsize == sizeof(T) && reinterpret_cast<uintptr_t>(src) % alignof(T) == 0) {
+        column.assign_view(reinterpret_cast<const T*>(src), array.count, array.keepalive);
+        return array.mapped;
+    }
+    auto buffer = std::make_shared<std::vector<T>>(array.count);
+    size_t blocks = (array.count + CONVERT_BLOCK - 1) / CONVERT_BLOCK;
+    ThreadPool::shared().parallel_for(blocks, [&](size_t b) {
+        size_t lo = b * CONVERT_BLOCK;
+        size_t hi = std::min(array.count, lo + CONVERT_BLOCK);
+        convert_field(field, src + lo * array.itemsize, array.itemsize, hi - lo, buffer->data() + lo, fn);
+    });
+    column.assign_view(buffer->data(), array.count, buffer);
+    return false;
+}
+
+// 浮動小数の時刻は秒、整数は µs とみなす
+template <typename V>
+int64_t to_microseconds(V v) {
+    if constexpr (std::is_floating_point_v<V>) {
+        return static_cast<int64_t>(std::llround(static_cast<double>(v) * 1e6));
+    } else {
+        return static_cast<int64_t>(v);
+    }
+}
+
+} // namespace
+
+NumpyReader::NumpyReader(const std::string& filepath) : m_filepath(filepath) {
+    bool is_npz = lower(fs::path(filepath).extension().string()) == NPZ_EXTENSION;
+
+    // 1. イベントの列を持つ配列を探す
+    //    列ごとの配列 (x, y, p, t) があればそれを使い、無ければ構造化配列を1つ使う
+    std::vector<NpyArray> arrays;
+    if (is_npz) {
+        arrays = open_arrays(filepath, [](const std::string& name) { return event_column_from_name(name) != 0; });
+        if (arrays.empty()) {
+            std::vector<NpyArray> candidates = open_arrays(filepath, [](const std::string& name) {
+                return !is_frame_name(name) && !is_frame_time_name(name);
+            });
+            auto events = std::find_if(candidates.begin(), candidates.end(), [](const NpyArray& a) { return lower(a.name) == "events"; });
+            if (events == candidates.end()) {
+                events = std::find_if(candidates.begin(), candidates.end(), [](const NpyArray& a) { return a.structured; });
+            }
+            if (events != candidates.end()) arrays.push_back(*events);
+        }
+    } else {
+        std::shared_ptr<MappedFile> file = MappedFile::open(filepath);
+        NpyArray array = parse_npy({filepath, file->data(), file->size(), file, true});
+        if (array.structured) {
+            arrays.push_back(array);
+        } else {
+            arrays = open_arrays(filepath, [](const std::string& name) { return event_column_from_name(name) != 0; });
+        }
+    }
+
+    // 2. 列ごとにフィールドを割り当てる
+    struct Source {
+        const NpyArray* array = nullptr;
+        const NpyField* field = nullptr;
+    };
+    Source x, y, p, t;
+    for (const NpyArray& array : arrays) {
+        if (array.structured) {
+            if (array.shape.size() != 1) throw std::runtime_error("Structured event array must be 1-D: " + array.name);
+            for (const NpyField& field : array.fields) {
+                switch (event_column_from_name(field.name)) {
+                case EVENT_COLUMN_X: x = {&array, &field}; break;
+                case EVENT_COLUMN_Y: y = {&array, &field}; break;
+                case EVENT_COLUMN_P: p = {&array, &field}; break;
+                case EVENT_COLUMN_T: t = {&array, &field}; break;
+                default: break;
+                }
+            }
+        } else {
+            if (array.shape.size() != 1 && !(array.shape.size() == 2 && array.shape[1] == 1)) {
+                throw std::runtime_error("Event column must be 1-D: " + array.name);
+            }
+            Source source{&array, &array.fields.front()};
+            switch (event_column_from_name(array.name)) {
+            case EVENT_COLUMN_X: x = source; break;
+            case EVENT_COLUMN_Y: y = source; break;
+            case EVENT_COLUMN_P: p = source; break;
+            case EVENT_COLUMN_T: t = source; break;
+            default: break;
+            }
+        }
+    }
+    if (!x.array || !y.array || !p.array || !t.array) {
+        throw std::runtime_error("NumPy file must provide x, y, p and t (as separate arrays or fields of a structured array): " + filepath);
+    }
+    m_num_events = t.array->count;
+    for (const Source& s : {x, y, p}) {
+        if (s.array->count != m_num_events) throw std::runtime_error("NumPy event columns have different lengths: " + filepath);
+    }
+
+    // 3. 列を作る (型が一致する列はゼロコピー)
+    auto is_int = [](const NpyField& f) { return f.kind == 'i' || f.kind == 'u'; };
+    m_columns.columns = EVENT_COLUMNS_ALL;
+    if (build_column(m_columns.x, *x.array, *x.field, is_int(*x.field) && x.field->size == 2,
+                     [](auto v) { return static_cast<uint16_t>(v); })) m_mapped_columns |= EVENT_COLUMN_X;
+    if (build_column(m_columns.y, *y.array, *y.field, is_int(*y.field) && y.field->size == 2,
+                     [](auto v) { return static_cast<uint16_t>(v); })) m_mapped_columns |= EVENT_COLUMN_Y;
+    // 極性は 0/1、-1/1、bool のいずれも正なら ON とする
+    if (build_column(m_columns.p, *p.array, *p.field, (p.field->kind == 'u' || p.field->kind == 'b') && p.field->size == 1,
+                     [](auto v) { return static_cast<uint8_t>(v > 0 ? 1 : 0); })) m_mapped_columns |= EVENT_COLUMN_P;
+    bool t_exact = t.field->size == 8 && (is_int(*t.field) || ((t.field->kind == 'M' || t.field->kind == 'm') && t.field->us_mul == 1 && t.field->us_div == 1));
+    if (build_column(m_columns.t, *t.array, *t.field, t_exact,
+                     [](auto v) { return to_microseconds(v); })) m_mapped_columns |= EVENT_COLUMN_T;
+
+    std::cout << "NumpyReader: " << filepath << " を開きました (" << m_num_events << " イベント, "
+              << (m_mapped_columns == EVENT_COLUMNS_ALL ? "mmap (ゼロコピー)" : "変換・展開あり") << ")。" << std::endl;
+}
+
+NumpyReader::~NumpyReader() = default;
+
+EventStore NumpyReader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    if (begin >= m_num_events) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, m_num_events - begin);
+
+    if (stride == 1) {
+        if (events.has(EVENT_COLUMN_X)) events.x = m_columns.x.view(begin, count);
+        if (events.has(EVENT_COLUMN_Y)) events.y = m_columns.y.view(begin, count);
+        if (events.has(EVENT_COLUMN_P)) events.p = m_columns.p.view(begin, count);
+        if (events.has(EVENT_COLUMN_T)) events.t = m_columns.t.view(begin, count);
+        return events;
+    }
+
+    size_t out_count = (count + stride - 1) / stride;
+    events.resize(out_count);
+    auto gather = [&](auto& dst, const auto& src) {
+        auto* out = dst.data();
+        for (size_t i = 0, j = begin; i < out_count; ++i, j += stride) out[i] = src[j];
+    };
+    const EventStore& all = m_columns;
+    if (events.has(EVENT_COLUMN_X)) gather(events.x, all.x);
+    if (events.has(EVENT_COLUMN_Y)) gather(events.y, all.y);
+    if (events.has(EVENT_COLUMN_P)) gather(events.p, all.p);
+    if (events.has(EVENT_COLUMN_T)) gather(events.t, all.t);
+    return events;
+}
+
+std::vector<RGBFrame> NumpyReader::load_frames(const std::string& filepath) {
+    std::vector<NpyArray> arrays = open_arrays(filepath, [](const std::string& name) {
+        return is_frame_name(name) || is_frame_time_name(name);
+    });
+    auto images = std::find_if(arrays.begin(), arrays.end(), [](const NpyArray& a) { return is_frame_name(a.name); });
+    auto times = std::find_if(arrays.begin(), arrays.end(), [](const NpyArray& a) { return is_frame_time_name(a.name); });
+    if (images == arrays.end() || times == arrays.end()) return {};
+
+    // (N, H, W) または (N, H, W, C) の uint8。C = 3 / 4 は RGB(A) とみなす
+    const std::vector<size_t>& shape = images->shape;
+    size_t channels = shape.size() == 4 ? shape[3] : 1;
+    const NpyField& pixel = images->fields.front();
+    if (images->structured || pixel.kind != 'u' || pixel.size != 1 || (shape.size() != 3 && shape.size() != 4) ||
+        (channels != 1 && channels != 3 && channels != 4)) {
+        std::cerr << "Warning: frames must be a uint8 array of shape (N, H, W) or (N, H, W, C): " << filepath << std::endl;
+        return {};
+    }
+    size_t num_frames = std::min(shape[0], times->count);
+    int height = static_cast<int>(shape[1]);
+    int width = static_cast<int>(shape[2]);
+    std::vector<int64_t> timestamps(times->count);
+    convert_field(times->fields.front(), times->data, times->itemsize, times->count, timestamps.data(),
+                  [](auto v) { return to_microseconds(v); });
+
+    std::vector<RGBFrame> frames(num_frames);
+    size_t frame_bytes = size_t(width) * height * channels;
+    ThreadPool::shared().parallel_for(num_frames, [&](size_t i) {
+        auto rgb = std::make_shared<std::vector<uint8_t>>(size_t(width) * height * 3);
+        const uint8_t* src = images->data + i * frame_bytes;
+        for (int row = 0; row < height; ++row) {
+            const uint8_t* s = src + size_t(row) * width * channels;
+            uint8_t* d = rgb->data() + size_t(height - 1 - row) * width * 3;
+            for (int col = 0; col < width; ++col, s += channels, d += 3) {
+                d[0] = s[0];
+                d[1] = s[channels == 1 ? 0 : 1];
+                d[2] = s[channels == 1 ? 0 : 2];
+            }
+        }
+        frames[i].timestamp = timestamps[i];
+        frames[i].pixels = std::move(rgb);
+        frames[i].width = width;
+        frames[i].height = height;
+    });
+    std::cout << "--- Loaded " << frames.size() << " frames from " << filepath << " ---" << std::endl;
+    return frames;
+}
@@ -0,0 +1,465 @@
+#include "prophesee_raw.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// 1区間の最小サイズ (これより小さいファイルは分割しない)
+constexpr size_t MIN_PIECE_BYTES = size_t(4) << 20;
+// スレッド数に対する区間数の倍率 (区間ごとの再同期点の位置のばらつきを均す)
+constexpr size_t PIECES_PER_THREAD = 4;
+
+// 展開したイベントの書き込み先 (EMIT == false のパスでは count だけを数える)
+struct EventSink {
+    uint16_t* x = nullptr;
+    uint16_t* y = nullptr;
+    uint8_t* p = nullptr;
+    int64_t* t = nullptr;
+    size_t count = 0;
+};
+
+template <typename Word>
+inline Word load_word(const uint8_t* src) {
+    Word w;
+    std::memcpy(&w, src, sizeof(w)); // ヘッダの長さによってはワード境界に揃っていない
+    return w;
+}
+
+// --- EVT 2.0 ---
+// 32bitワード。上位4bitが種別
+//   CD_OFF / CD_ON (0x0 / 0x1): [27:22] 時刻の下位6bit, [21:11] x, [10:0] y
+//   EVT_TIME_HIGH  (0x8):       [27:0]  時刻の上位28bit
+// 再同期点: EVT_TIME_HIGH の直後 (以降のイベントの時刻がすべて決まる)
+struct Evt2Decoder {
+    static constexpr size_t WORD_BYTES = 4;
+    static constexpr int64_t TIME_PERIOD = int64_t(1) << 34; // 時刻 (34bit) が一周する長さ
+
+    enum : uint32_t { CD_OFF = 0x0, CD_ON = 0x1, EVT_TIME_HIGH = 0x8 };
+
+    struct State {
+        int64_t loops = 0; // 時刻が一周した回数
+        uint32_t time_high = 0;
+        int64_t time_base = 0; // loops * TIME_PERIOD + (time_high << 6)
+    };
+
+    static void update_time(State& state) {
+        state.time_base = state.loops * TIME_PERIOD + (int64_t(state.time_high) << 6);
+    }
+
+    static void set_time_high(State& state, uint32_t time_high) {
+        // 大きく戻ったときだけ一周とみなす (わずかな逆行はそのまま)
+        if (time_high < state.time_high && state.time_high - time_high > (1u << 27)) ++state.loops;
+        state.time_high = time_high;
+        update_time(state);
+    }
+
+    static const uint8_t* find_sync(const uint8_t* begin, const uint8_t* end, State& state) {
+        for (const uint8_t* ptr = begin; ptr + WORD_BYTES <= end; ptr += WORD_BYTES) {
+            uint32_t w = load_word<uint32_t>(ptr);
+            if ((w >> 28) == EVT_TIME_HIGH) {
+                state = State{};
+                state.time_high = w & 0x0FFFFFFF;
+                update_time(state);
+                return ptr + WORD_BYTES;
+            }
+        }
+        return nullptr;
+    }
+
+    template <bool EMIT>
+    static void run(State& state, const uint8_t* ptr, const uint8_t* end, EventSink& sink) {
+        size_t n = sink.count;
+        while (ptr < end) {
+            // 8ワードがすべて CD イベント (上位3bitが0) なら、種別の分岐なしでまとめて展開する
+            if (end - ptr >= static_cast<ptrdiff_t>(8 * WORD_BYTES)) {
+                uint32_t w[8];
+                std::memcpy(w, ptr, sizeof(w));
+                uint32_t types = 0;
+                for (int i = 0; i < 8; ++i) types |= w[i];
+                if ((types >> 29) == 0) {
+                    if constexpr (EMIT) {
+                        for (int i = 0; i < 8; ++i) {
+                            sink.x[n + i] = static_cast<uint16_t>((w[i] >> 11) & 0x7FF);
+                            sink.y[n + i] = static_cast<uint16_t>(w[i] & 0x7FF);
+                            sink.p[n + i] = static_cast<uint8_t>(w[i] >> 28);
+                            sink.t[n + i] = state.time_base + ((w[i] >> 22) & 0x3F);
+                        }
+                    }
+                    n += 8;
+                    ptr += sizeof(w);
+                    continue;
+                }
+            }
+            uint32_t w = load_word<uint32_t>(ptr);
+            ptr += WORD_BYTES;
+            switch (w >> 28) {
+            case CD_OFF:
+            case CD_ON:
+                if constexpr (EMIT) {
+                    sink.x[n] = static_cast<uint16_t>((w >> 11) & 0x7FF);
+                    sink.y[n] = static_cast<uint16_t>(w & 0x7FF);
+                    sink.p[n] = static_cast<uint8_t>(w >> 28);
+                    sink.t[n] = state.time_base + ((w >> 22) & 0x3F);
+                }
+                ++n;
+                break;
+            case EVT_TIME_HIGH:
+                set_time_high(state, w & 0x0FFFFFFF);
+                break;
+            default: // 外部トリガーなどは読み飛ばす
+                break;
+            }
+        }
+        sink.count = n;
+    }
+};
+
+// --- EVT 3.0 ---
+// 16bitワード。上位4bitが種別で、y・時刻・x の基準位置を状態として持ち、以降のワードがそれを使う
+//   EVT_ADDR_Y    (0x0): [10:0] y
+//   EVT_ADDR_X    (0x2): [11] 極性, [10:0] x       -> イベント1個
+//   VECT_BASE_X   (0x3): [11] 極性, [10:0] x の基準
+//   VECT_12       (0x4): [11:0] 基準から12画素分の有効ビット -> 基準 += 12
+//   VECT_8        (0x5): [7:0]  基準から8画素分の有効ビット  -> 基準 += 8
+//   EVT_TIME_LOW  (0x6): [11:0] 時刻の下位12bit
+//   EVT_TIME_HIGH (0x8): [11:0] 時刻の上位12bit
+// 再同期点: 時刻の上位・下位が決まった後の最初の EVT_ADDR_Y (新しい行の先頭。x の基準は行ごとに送り直される)
+struct Evt3Decoder {
+    static constexpr size_t WORD_BYTES = 2;
+    static constexpr int64_t TIME_PERIOD = int64_t(1) << 24; // 時刻 (24bit) が一周する長さ
+
+    enum : uint16_t {
+        EVT_ADDR_Y = 0x0,
+        EVT_ADDR_X = 0x2,
+        VECT_BASE_X = 0x3,
+        VECT_12 = 0x4,
+        VECT_8 = 0x5,
+        EVT_TIME_LOW = 0x6,
+        EVT_TIME_HIGH = 0x8,
+    };
+
+    struct State {
+        int64_t loops = 0;
+        uint32_t time_high = 0;
+        uint32_t time_low = 0;
+        int64_t time = 0; // loops * TIME_PERIOD + (time_high << 12 | time_low)
+        uint16_t y = 0;
+        uint16_t base_x = 0;
+        uint8_t polarity = 0;
+        bool has_high = false;
+        bool has_low = false;
+        bool has_y = false;
+        bool has_base = false;
+    };
+
+    static void update_time(State& state) {
+        state.time = state.loops * TIME_PERIOD + ((int64_t(state.time_high) << 12) | state.time_low);
+    }
+
+    // 時刻とアドレスの状態だけを更新する (イベントを出すワードは無視する)
+    static void apply_state_word(State& state, uint16_t w) {
+        switch (w >> 12) {
+        case EVT_ADDR_Y:
+            state.y = w & 0x7FF;
+            state.has_y = true;
+            break;
+        case VECT_BASE_X:
+            state.base_x = w & 0x7FF;
+            state.polarity = (w >> 11) & 1;
+            state.has_base = true;
+            break;
+        case VECT_12:
+            state.base_x += 12;
+            break;
+        case VECT_8:
+            state.base_x += 8;
+            break;
+        case EVT_TIME_LOW:
+            state.time_low = w & 0xFFF;
+            state.has_low = true;
+            update_time(state);
+            break;
+        case EVT_TIME_HIGH: {
+            uint32_t time_high = w & 0xFFF;
+            if (state.has_high && time_high < state.time_high && state.time_high - time_high > (1u << 11)) ++state.loops;
+            state.time_high = time_high;
+            state.has_high = true;
+            update_time(state);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    static const uint8_t* find_sync(const uint8_t* begin, const uint8_t* end, State& state) {
+        State scan;
+        for (const uint8_t* ptr = begin; ptr + WORD_BYTES <= end; ptr += WORD_BYTES) {
+            uint16_t w = load_word<uint16_t>(ptr);
+            if ((w >> 12) == EVT_ADDR_Y && scan.has_high && scan.has_low) {
+                // この区間の一周回数は 0 から数える (区間の先頭までの分は後で足す)
+                state = State{};
+                state.time_high = scan.time_high;
+                state.time_low = scan.time_low;
+                state.has_high = state.has_low = true;
+                update_time(state);
+                return ptr;
+            }
+            apply_state_word(scan, w);
+        }
+        return nullptr;
+    }
+
+    template <bool EMIT>
+    static void emit_mask(State& state, uint32_t mask, EventSink& sink, size_t& n) {
+        if (!state.has_base || !state.has_y) return;
+        if constexpr (EMIT) {
+            while (mask) {
+                int bit = __builtin_ctz(mask);
+                sink.x[n] = static_cast<uint16_t>(state.base_x + bit);
+                sink.y[n] = state.y;
+                sink.p[n] = state.polarity;
+                sink.t[n] = state.time;
+                ++n;
+                mask &= mask - 1;
+            }
+        } else {
+            n += static_cast<size_t>(__builtin_popcount(mask));
+        }
+    }
+
+    template <bool EMIT>
+    static void run(State& state, const uint8_t* ptr, const uint8_t* end, EventSink& sink) {
+        size_t n = sink.count;
+        for (; ptr < end; ptr += WORD_BYTES) {
+            uint16_t w = load_word<uint16_t>(ptr);
+            switch (w >> 12) {
+            case EVT_ADDR_X:
+                if (state.has_y) {
+                    if constexpr (EMIT) {
+                        sink.x[n] = w & 0x7FF;
+                        sink.y[n] = state.y;
+                        sink.p[n] = (w >> 11) & 1;
+                        sink.t[n] = state.time;
+                    }
+                    ++n;
+                }
+                break;
+            case VECT_12:
+                emit_mask<EMIT>(state, w & 0xFFF, sink, n);
+                state.base_x += 12;
+                break;
+            case VECT_8:
+                emit_mask<EMIT>(state, w & 0xFF, sink, n);
+                state.base_x += 8;
+                break;
+            default:
+                apply_state_word(state, w);
+                break;
+            }
+        }
+        sink.count = n;
+    }
+};
+
+std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+} // namespace
+
+PropheseeRawReader::PropheseeRawReader(const std::string& filepath) : m_filepath(filepath) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(filepath);
+    parse_header(*file);
+
+    auto start = std::chrono::steady_clock::now();
+    if (m_format == Format::EVT2) {
+        decode<Evt2Decoder>(*file);
+    } else {
+        decode<Evt3Decoder>(*file);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "PropheseeRawReader: " << filepath << " を展開しました (" << m_events->size() << " イベント, "
+              << (m_format == Format::EVT2 ? "EVT 2.0" : "EVT 3.0") << ", " << seconds << " 秒)。" << std::endl;
+}
+
+PropheseeRawReader::~PropheseeRawReader() = default;
+
+void PropheseeRawReader::parse_header(const MappedFile& file) {
+    // ヘッダは "% key value" 形式のテキスト行の並びで、"% end" または % で始まらない行で終わる
+    //   % evt 3.0
+    //   % format EVT3;height=720;width=1280
+    //   % geometry 1280x720        (古いファイル)
+    const char* data = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+    size_t pos = 0;
+    bool has_format = false;
+    int width = 0;
+    int height = 0;
+    auto set_format = [&](const std::string& name) {
+        if (name == "2.0" || name == "EVT2") {
+            m_format = Format::EVT2;
+        } else if (name == "3.0" || name == "EVT3") {
+            m_format = Format::EVT3;
+        } else {
+            throw std::runtime_error("Unsupported RAW event format '" + name + "' (EVT2 / EVT3 only): " + m_filepath);
+        }
+        has_format = true;
+    };
+
+    while (pos < size && data[pos] == '%') {
+        const char* eol = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t line_end = eol ? static_cast<size_t>(eol - data) : size;
+        std::string line = trim(std::string(data + pos + 1, line_end - pos - 1));
+        pos = std::min(size, line_end + 1);
+        if (line == "end") break;
+
+        size_t space = line.find_first_of(" \t");
+        std::string key = line.substr(0, space);
+        std::string value = space == std::string::npos ? "" : trim(line.substr(space));
+        if (key == "evt") {
+            set_format(value);
+        } else if (key == "format") {
+            // 先頭が形式名で、以降は ; 区切りの key=value
+            size_t begin = 0;
+            for (bool first = true; begin <= value.size(); first = false) {
+                size_t sep = value.find(';', begin);
+                std::string item = value.substr(begin, sep == std::string::npos ? std::string::npos : sep - begin);
+                if (first) {
+                    set_format(item);
+                } else if (item.rfind("width=", 0) == 0) {
+                    width = std::stoi(item.substr(6));
+                } else if (item.rfind("height=", 0) == 0) {
+                    height = std::stoi(item.substr(7));
+                }
+                if (sep == std::string::npos) break;
+                begin = sep + 1;
+            }
+        } else if (key == "geometry") {
+            size_t x = value.find('x');
+            if (x != std::string::npos) {
+                width = std::stoi(value.substr(0, x));
+                height = std::stoi(value.substr(x + 1));
+            }
+        }
+    }
+    if (!has_format) throw std::runtime_error("RAW header does not specify the event format: " + m_filepath);
+    if (width > 0 && height > 0) m_resolution = Resolution{width, height};
+    m_data_offset = pos;
+}
+
+template <typename Decoder>
+void PropheseeRawReader::decode(const MappedFile& file) {
+    using State = typename Decoder::State;
+    constexpr size_t WORD = Decoder::WORD_BYTES;
+    const uint8_t* data = file.data() + m_data_offset;
+    size_t num_words = (file.size() - m_data_offset) / WORD; // 末尾の不完全なワードは捨てる
+    const uint8_t* data_end = data + num_words * WORD;
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t num_pieces = std::clamp<size_t>(num_words * WORD / MIN_PIECE_BYTES, 1, pool.concurrency() * PIECES_PER_THREAD);
+
+    // 1. 各区間の再同期点を探す
+    //    区間 i は再同期点から次の区間の再同期点の手前までを展開する。再同期点では両側の状態が一致するため、
+    //    隣の区間の展開結果を待たずに独立に展開できる (時刻の一周回数だけは後で前の区間から累積する)
+    struct Piece {
+        const uint8_t* begin = nullptr;
+        const uint8_t* end = nullptr;
+        State state;
+        size_t first_event = 0;
+        size_t num_events = 0;
+        int64_t loops = 0;
+    };
+    std::vector<Piece> found(num_pieces);
+    pool.parallel_for(num_pieces, [&](size_t i) {
+        const uint8_t* lo = data + num_words * i / num_pieces * WORD;
+        const uint8_t* hi = data + num_words * (i + 1) / num_pieces * WORD;
+        found[i].begin = Decoder::find_sync(lo, hi, found[i].state);
+    });
+    // 再同期点が見つからなかった区間は、前の区間がまとめて展開する
+    // (ファイル先頭の再同期点より前のワードは時刻が決まらないため捨てる)
+    std::vector<Piece> pieces;
+    for (const Piece& piece : found) {
+        if (piece.begin) pieces.push_back(piece);
+    }
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        pieces[i].end = (i + 1 < pieces.size()) ? pieces[i + 1].begin : data_end;
+    }
+
+    // 2. 各区間のイベント数と時刻の一周回数を数える
+    pool.parallel_for(pieces.size(), [&](size_t i) {
+        State state = pieces[i].state;
+        EventSink sink;
+        Decoder::template run<false>(state, pieces[i].begin, pieces[i].end, sink);
+        pieces[i].num_events = sink.count;
+        pieces[i].loops = state.loops;
+    });
+    size_t total = 0;
+    int64_t loops = 0;
+    for (Piece& piece : pieces) {
+        piece.first_event = total;
+        total += piece.num_events;
+        // 区間の先頭までに時刻が一周した回数から数え直す
+        piece.state.loops = loops;
+        Decoder::update_time(piece.state);
+        loops += piece.loops;
+    }
+
+    // 3. 出力の列に直接展開する
+    auto events = std::make_shared<EventStore>();
+    events->resize(total);
+    pool.parallel_for(pieces.size(), [&](size_t i) {
+        State state = pieces[i].state;
+        size_t first = pieces[i].first_event;
+        EventSink sink{events->x.data() + first, events->y.data() + first, events->p.data() + first, events->t.data() + first, 0};
+        Decoder::template run<true>(state, pieces[i].begin, pieces[i].end, sink);
+        if (sink.count != pieces[i].num_events) {
+            throw std::logic_error("RAW decoder produced an inconsistent event count: " + m_filepath);
+        }
+    });
+    m_events = std::move(events);
+}
+
+size_t PropheseeRawReader::num_events() {
+    return m_events->size();
+}
+
+EventStore PropheseeRawReader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    size_t total = m_events->size();
+    if (begin >= total) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, total - begin);
+    const EventStore& all = *m_events;
+
+    if (stride == 1) {
+        // 展開済みの列をそのまま参照する (この Reader が破棄されても m_events は残る)
+        if (events.has(EVENT_COLUMN_X)) events.x.assign_view(all.x.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_Y)) events.y.assign_view(all.y.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_P)) events.p.assign_view(all.p.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_T)) events.t.assign_view(all.t.data() + begin, count, m_events);
+        return events;
+    }
+
+    size_t out_count = (count + stride - 1) / stride;
+    events.resize(out_count);
+    auto gather = [&](auto& dst, const auto& src) {
+        auto* out = dst.data();
+        for (size_t i = 0, j = begin; i < out_count; ++i, j += stride) out[i] = src[j];
+    };
+    if (events.has(EVENT_COLUMN_X)) gather(events.x, all.x);
+    if (events.has(EVENT_COLUMN_Y)) gather(events.y, all.y);
+    if (events.has(EVENT_COLUMN_P)) gather(events.p, all.p);
+    if (events.has(EVENT_COLUMN_T)) gather(events.t, all.t);
+    return events;
+}
@@ -5,18 +5,100 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <glm/gtc/matrix_transform.hpp>
 
-// Wrapper function to start the renderer
-void run_renderer(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+namespace {
+// Vertices are built and uploaded this many events at a time to bound the staging buffer
+constexpr size_t UPLOAD_SLICE_EVENTS = size_t(1) << 20;
+// Each max-reduction pass shrinks the texture by this factor per axis (matches max_reduce.frag)
+constexpr int MAX_REDUCE_FACTOR = 4;
+// How often the live receive/latency counters are printed
+constexpr double LIVE_STATS_INTERVAL_S = 2.0;
+// While the last frame is still current the loop sleeps until input arrives, waking up this often to pick up
+// prefetched segments; live input is checked much more often since new packets do not wake the loop
+constexpr double IDLE_WAIT_S = 0.1;
+constexpr double LIVE_IDLE_WAIT_S = 0.005;
+// In AUTO mode the compute path takes over at this many events in the window; below it the point draw is cheaper
+constexpr size_t COMPUTE_MIN_EVENTS = size_t(1) << 20;
+// Work group size of event_accum.comp, and the guaranteed minimum of GL_MAX_COMPUTE_WORK_GROUP_COUNT
+constexpr size_t COMPUTE_GROUP_SIZE = 256;
+constexpr size_t MAX_COMPUTE_GROUPS = 65535;
+// How often the accumulation timings are printed (T key)
+constexpr double ACCUM_STATS_INTERVAL_S = 2.0;
+
+const char* accumulation_path_name(AccumulationPath path) {
+    switch (path) {
+        case AccumulationPath::POINTS: return "points";
+        case AccumulationPath::COMPUTE: return "compute";
+        default: return "auto";
+    }
+}
+}
+
+// Wrapper functions to start the renderer
+void run_renderer(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options) {
+    try {
+        Renderer app(1280, 960, "2D Event Viewer");
+        app.setRenderOptions(options);
+        app.run(all_events, std::move(time_index), all_images, width, height, t_offset, bg_color, on_color, off_color);
+    } catch (const std::exception& e) {
+        std::cerr << "A critical error occurred: " << e.what() << std::endl;
+    }
+}
+
+void run_renderer(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options) {
     try {
         Renderer app(1280, 960, "2D Event Viewer");
-        app.run(all_events, all_images, width, height, t_offset, bg_color, on_color, off_color);
+        app.setRenderOptions(options);
+        app.run(all_events, std::move(time_index), all_images, width, height, t_offset, bg_color, on_color, off_color);
     } catch (const std::exception& e) {
         std::cerr << "A critical error occurred: " << e.what() << std::endl;
     }
 }
 
+void run_renderer(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int width, int height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options) {
+    try {
+        Renderer app(1280, 960, "2D Event Viewer");
+        app.setRenderOptions(options);
+        app.run(prefetcher, all_images, width, height, bg_color, on_color, off_color);
+    } catch (const std::exception& e) {
+        std::cerr << "A critical error occurred: " << e.what() << std::endl;
+    }
+}
+
+void run_renderer(LiveEventReceiver& receiver, const std::vector<RGBFrame>& all_images, int width, int height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color, const RenderOptions& options) {
+    try {
+        Renderer app(1280, 960, "2D Event Viewer (live)");
+        app.setRenderOptions(options);
+        app.run(receiver, all_images, width, height, bg_color, on_color, off_color);
+    } catch (const std::exception& e) {
+        std::cerr << "A critical error occurred: " << e.what() << std::endl;
+    }
+}
+
+std::optional<AccumulationFormat> parse_accumulation_format(const std::string& name) {
+    if (name == "float32") return AccumulationFormat::RG32F;
+    if (name == "float16") return AccumulationFormat::RG16F;
+    if (name == "rgba8") return AccumulationFormat::RGBA8;
+    return std::nullopt;
+}
+
+std::optional<AccumulationPath> parse_accumulation_path(const std::string& name) {
+    if (name == "auto") return AccumulationPath::AUTO;
+    if (name == "points") return AccumulationPath::POINTS;
+    if (name == "compute") return AccumulationPath::COMPUTE;
+    return std::nullopt;
+}
+
+std::optional<Colormap> parse_colormap(const std::string& name) {
+    if (name == "dominance") return Colormap::DOMINANCE;
+    if (name == "net") return Colormap::NET_POLARITY;
+    if (name == "count") return Colormap::COUNT;
+    return std::nullopt;
+}
+
 // --- Renderer Class Implementation ---
 
 Renderer::Renderer(int width, int height, const std::string& title) 
@@ -26,24 +108,61 @@ Renderer::~Renderer() {
     cleanup();
 }
 
-void Renderer::run(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+void Renderer::setRenderOptions(const RenderOptions& options) {
+    m_accumulation_format = options.accumulation;
+    m_accumulation_path = options.path;
+    m_incremental = options.incremental;
+    m_keyframe_interval_us = options.keyframe_interval_us;
+    m_keyframe_memory_bytes = options.keyframe_memory_mb << 20;
+    m_state.colormap = options.colormap;
+}
+
+void Renderer::run(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+    EventSliceReader read_slice = [&](size_t begin, size_t count) { return all_events.slice(begin, count); };
+    start(all_events.size(), read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset, bg_color, on_color, off_color);
+}
+
+void Renderer::run(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+    EventSliceReader read_slice = [&](size_t begin, size_t count) { return all_events.decode(begin, count); };
+    start(all_events.size(), read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset, bg_color, on_color, off_color);
+}
+
+void Renderer::run(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+    m_prefetcher = &prefetcher;
+    start(0, EventSliceReader(), TimeIndex(), all_images, sensor_width, sensor_height, prefetcher.t_offset(), bg_color, on_color, off_color);
+}
+
+void Renderer::run(LiveEventReceiver& receiver, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
+    m_live = &receiver;
+    start(0, EventSliceReader(), TimeIndex(), all_images, sensor_width, sensor_height, 0, bg_color, on_color, off_color);
+}
+
+void Renderer::start(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const glm::vec3& bg_color, const glm::vec3& on_color, const glm::vec3& off_color) {
     m_bg_color = bg_color;
     m_on_color = on_color;
     m_off_color = off_color;
 
     init();
     setupCallbacks();
-    loadData(all_events, all_images, sensor_width, sensor_height, t_offset);
+    loadData(num_events, read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset);
     mainLoop();
 }
 
 void Renderer::init() {
     if (!glfwInit()) throw std::runtime_error("Failed to initialize GLFW");
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), NULL, NULL);
+    // The compute path needs GL 4.3; drivers without it (e.g. macOS) still get the 3.3 point path
+    if (m_accumulation_path != AccumulationPath::POINTS) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), NULL, NULL);
+    }
+    if (!m_window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), NULL, NULL);
+    }
     if (!m_window) { 
         glfwTerminate(); 
         throw std::runtime_error("Failed to create GLFW window");
@@ -59,13 +178,27 @@ void Renderer::init() {
 
     m_event_accum_shader = std::make_unique<Shader>("shaders/event_accum.vert", "shaders/event_accum.frag");
     m_quad_shader = std::make_unique<Shader>("shaders/quad.vert", "shaders/quad.frag");
+    m_reduce_shader = std::make_unique<Shader>("shaders/fullscreen.vert", "shaders/max_reduce.frag");
+
+    m_compute_available = GLEW_VERSION_4_3;
+    if (m_compute_available) {
+        m_accum_compute_shader = std::make_unique<Shader>("shaders/event_accum.comp");
+        m_resolve_shader = std::make_unique<Shader>("shaders/fullscreen.vert", "shaders/resolve_counts.frag");
+    } else if (m_accumulation_path == AccumulationPath::COMPUTE) {
+        std::cerr << "Warning: OpenGL 4.3 is not available; accumulating events with the point path." << std::endl;
+        m_accumulation_path = AccumulationPath::POINTS;
+    }
+    glGenQueries(1, &m_accum_query);
+    printf("--- Event accumulation: %s%s ---\n", accumulation_path_name(m_accumulation_path),
+        m_compute_available ? "" : " (OpenGL 4.3 compute unavailable)");
 
     std::cout << "\n--- 2D Viewer Controls ---\n"
               << "Mouse Drag: Pan | Mouse Wheel: Zoom\n"
               << "M: Cycle display mode\n"
-              << "SPACE: Pause/Resume | LEFT/RIGHT: Speed\n"
+              << "SPACE: Pause/Resume | LEFT/RIGHT: Speed | R: Reverse\n"
               << "[ / ]: RGB Alpha | ' / ;: Event Alpha\n"
-              << ", / .: Time Window\n"
+              << ", / .: Time Window | C: Cycle colormap\n"
+              << "P: Cycle accumulation path | I: Toggle incremental accumulation | T: Toggle accumulation timing\n"
               << "ESC: Exit\n" << std::endl;
 }
 
@@ -75,61 +208,161 @@ void Renderer::setupCallbacks() {
     glfwSetCursorPosCallback(m_window, [](GLFWwindow* w, double x, double y) { static_cast<Renderer*>(glfwGetWindowUserPointer(w))->onCursorPosition(x, y); });
     glfwSetScrollCallback(m_window, [](GLFWwindow* w, double x, double y) { static_cast<Renderer*>(glfwGetWindowUserPointer(w))->onScroll(x, y); });
     glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* w, int width, int height) { static_cast<Renderer*>(glfwGetWindowUserPointer(w))->onFramebufferSize(width, height); });
+    // The window system asks for a redraw (e.g. after being uncovered); the frame is composed again from the kept counts
+    glfwSetWindowRefreshCallback(m_window, [](GLFWwindow* w) { static_cast<Renderer*>(glfwGetWindowUserPointer(w))->m_frame_dirty = true; });
 }
 
 void Renderer::mainLoop() {
     double last_frame_time = glfwGetTime();
+    bool idle = false;
 
     while (!glfwWindowShouldClose(m_window)) {
+        if (idle) {
+            glfwWaitEventsTimeout(m_live && !m_state.is_paused ? LIVE_IDLE_WAIT_S : IDLE_WAIT_S);
+        } else {
+            glfwPollEvents();
+        }
+
         double current_frame_time = glfwGetTime();
         double delta_time = current_frame_time - last_frame_time;
         last_frame_time = current_frame_time;
-
-        glfwPollEvents();
         
-        if (!m_state.is_paused) {
-            m_current_time_us += delta_time * 1000000.0 * m_state.playback_speed;
+        if (m_live) {
+            // Live time follows the newest received event
+            receiveLiveEvents();
+            if (current_frame_time - m_live_last_stats_time >= LIVE_STATS_INTERVAL_S) printLiveStats();
+        } else if (!m_state.is_paused) {
+            double direction = m_state.is_reversed ? -1.0 : 1.0;
+            advanceClock(direction * delta_time * 1000000.0 * m_state.playback_speed);
         }
+
+        if (m_prefetcher) streamEvents();
         
-        renderScene();
+        // Nothing is drawn or swapped while the last frame is still current
+        idle = !renderScene();
+        if (!idle) glfwSwapBuffers(m_window);
+    }
+}
 
-        glfwSwapBuffers(m_window);
+void Renderer::advanceClock(double delta_us) {
+    double step = delta_us + m_clock_remainder_us;
+    int64_t whole = static_cast<int64_t>(std::floor(step));
+    m_clock_remainder_us = step - static_cast<double>(whole);
+    m_current_time_us += whole;
+    if (m_current_time_us < 0) {
+        m_current_time_us = 0;
+        m_clock_remainder_us = 0.0;
     }
 }
 
-void Renderer::renderScene() {
-    // === 1. Event Accumulation Pass (Off-screen) ===
-    glBindFramebuffer(GL_FRAMEBUFFER, m_event_fbo);
-    glViewport(0, 0, m_sensor_width, m_sensor_height);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+void Renderer::setTimeWindowUniforms(const Shader& shader, int64_t start_t, int64_t end_t) {
+    // Offsets outside the vertex range are clamped; the window end may sit one past the last representable time
+    auto set = [&](const char* name, int64_t t) {
+        uint64_t offset = static_cast<uint64_t>(std::clamp<int64_t>(t - m_base_time, 0, MAX_VERTEX_TIME_US + 1));
+        shader.setUVec2(name, static_cast<GLuint>(offset >> 32), static_cast<GLuint>(offset & 0xffffffffu));
+    };
+    set("u_window_begin", start_t);
+    set("u_window_end", end_t);
+}
 
-    if (m_event_count > 0 && m_state.display_mode != DisplayMode::RGB_ONLY) {
-        glBlendFunc(GL_ONE, GL_ONE); // Use additive blending for counters
+bool Renderer::renderScene() {
+    // Time is kept in integer microseconds end to end, so the window [start_t, end_t) is exact at any playback position
+    int64_t end_t = m_base_time + m_current_time_us;
+    int64_t start_t = end_t - static_cast<int64_t>(m_state.time_window_us);
 
-        m_event_accum_shader->use();
-        m_event_accum_shader->setFloat("u_current_time", static_cast<float>(m_current_time_us));
-        m_event_accum_shader->setFloat("u_time_window", static_cast<float>(m_state.time_window_us));
-        
-        // CPU Culling: determine which part of the buffer to draw
-        float end_time = static_cast<float>(m_current_time_us);
-        float start_time = end_time - static_cast<float>(m_state.time_window_us);
+    // The counts stay in m_event_texture apart from the composed frame: they are only accumulated again when the window,
+    // the data or the accumulation settings changed, and a pan or zoom only composes the frame again
+    bool accumulate_events = m_accum_dirty || start_t != m_accum_start_t || end_t != m_accum_end_t;
+    if (!accumulate_events && !m_frame_dirty && end_t == m_composed_end_t) return false;
+    if (accumulate_events) accumulateEvents(start_t, end_t);
+    composeFrame();
+    m_frame_dirty = false;
+    m_composed_end_t = end_t;
+    return true;
+}
 
-        auto start_it = std::lower_bound(m_event_timestamps.begin(), m_event_timestamps.end(), start_time);
-        auto end_it = std::lower_bound(start_it, m_event_timestamps.end(), end_time);
+void Renderer::accumulateEvents(int64_t start_t, int64_t end_t) {
+    // === 1. Event Accumulation Pass (Off-screen) ===
+    m_accum_dirty = false;
 
-        if (start_it != m_event_timestamps.end()) {
-            GLint first = std::distance(m_event_timestamps.begin(), start_it);
-            GLsizei count = std::distance(start_it, end_it);
-        
-            if (count > 0) {
-                glBindVertexArray(m_event_vao);
-                glDrawArrays(GL_POINTS, first, count);
-            }
+    // CPU Culling: determine which part of the buffer to accumulate
+    m_accum_ranges.clear();
+    size_t window_events = 0;
+    bool accumulate = (!m_event_batches.empty() || m_live) && m_state.display_mode != DisplayMode::RGB_ONLY;
+    if (accumulate) window_events = appendRanges(start_t, end_t, m_accum_ranges);
+
+    // While the window slides, the kept counts only need the events that entered or left it since the last frame
+    bool incremental = accumulate && m_accum_valid && collectWindowChanges(start_t, end_t, window_events);
+    bool compute = incremental ? m_accum_compute : useComputePath(window_events);
+    // A rebuild of a long window starts from the count keyframes nearest to its edges
+    bool from_keyframes = !incremental && accumulate && collectKeyframeEdges(start_t, end_t, window_events, compute);
+    size_t num_events = window_events;
+    if (incremental || from_keyframes) {
+        num_events = 0;
+        for (const VertexRange& range : m_added_ranges) num_events += range.count;
+        for (const VertexRange& range : m_removed_ranges) num_events += range.count;
+    }
+    bool timed = m_report_accumulation && !m_accum_query_pending;
+    if (timed) glBeginQuery(GL_TIME_ELAPSED, m_accum_query);
+    if (from_keyframes) {
+        uploadKeyframeDifference(compute);
+        // The edge ranges hold exactly the events to add or subtract, so the window test lets every vertex through
+        int64_t all_begin = m_base_time, all_end = m_base_time + MAX_VERTEX_TIME_US + 1;
+        if (compute) {
+            accumulateCompute(m_removed_ranges, all_begin, all_end, true);
+            accumulateCompute(m_added_ranges, all_begin, all_end, false);
+            resolveCounts();
+        } else {
+            accumulatePoints(m_removed_ranges, all_begin, all_end, true);
+            accumulatePoints(m_added_ranges, all_begin, all_end, false);
+        }
+        ++m_accum_rebuilds;
+        ++m_keyframe_rebuilds;
+    } else if (incremental) {
+        if (compute) {
+            accumulateCompute(m_removed_ranges, m_accum_start_t, m_accum_end_t, true);
+            accumulateCompute(m_added_ranges, start_t, end_t, false);
+            resolveCounts();
+        } else {
+            accumulatePoints(m_removed_ranges, m_accum_start_t, m_accum_end_t, true);
+            accumulatePoints(m_added_ranges, start_t, end_t, false);
+        }
+    } else {
+        // Rebuild from cleared counts
+        const GLuint zero[4] = {0, 0, 0, 0};
+        if (compute) {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_count_fbo);
+            glClearBufferuiv(GL_COLOR, 0, zero);
+            accumulateCompute(m_accum_ranges, start_t, end_t, false);
+            resolveCounts();
+        } else {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_event_fbo);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            accumulatePoints(m_accum_ranges, start_t, end_t, false);
         }
+        if (accumulate) ++m_accum_rebuilds;
     }
+    // Only exact counts can be kept: subtracting from half floats or saturated bytes would drift
+    m_accum_valid = accumulate && m_incremental && (compute || m_accumulation_format == AccumulationFormat::RG32F);
+    m_accum_compute = compute;
+    m_accum_start_t = start_t;
+    m_accum_end_t = end_t;
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_accum_query_pending = true;
+        m_last_accum_compute = compute;
+        m_last_accum_events = num_events;
+    }
+    if (m_report_accumulation) printAccumulationStats();
+
+    // The net and count colormaps are normalized by the maximum over the whole texture, found on the GPU
+    if (normalizeCounts()) reduceMaxCounts();
+}
 
+void Renderer::composeFrame() {
     // === 2. Composition Pass (To Screen) ===
+    bool normalize = normalizeCounts();
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, m_width, m_height);
     glClearColor(m_bg_color.r, m_bg_color.g, m_bg_color.b, 1.0f); // Use configured background color
@@ -146,18 +379,19 @@ void Renderer::renderScene() {
     // Pass configured colors to the final shader
     m_quad_shader->setVec3("u_on_color", m_on_color);
     m_quad_shader->setVec3("u_off_color", m_off_color);
+    m_quad_shader->setInt("u_max_texture", 1);
 
     glBindVertexArray(m_quad_vao);
 
     // 2a. Draw background RGB image
     if (m_all_images_ptr && !m_all_images_ptr->empty() && m_state.display_mode != DisplayMode::EVENTS_ONLY) {
-        double absolute_current_time = m_current_time_us + m_base_time;
-        auto it = std::upper_bound(m_all_images_ptr->begin(), m_all_images_ptr->end(), absolute_current_time, 
-            [](double time, const RGBFrame& frame){ return time < frame.timestamp; });
-        if (it != m_all_images_ptr->begin()) {
-            --it;
-            size_t image_idx = std::distance(m_all_images_ptr->begin(), it);
+        // The latest frame at or before the current time
+        int64_t absolute_current_time = m_base_time + m_current_time_us;
+        size_t next_idx = m_image_index.upper_bound(absolute_current_time);
+        if (next_idx > 0) {
+            size_t image_idx = next_idx - 1;
             if(image_idx < m_image_textures.size()) {
+                m_quad_shader->setInt("u_colormap", -1);
                 m_quad_shader->setFloat("u_alpha", m_state.rgb_alpha);
                 glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, m_image_textures[image_idx]);
@@ -168,7 +402,12 @@ void Renderer::renderScene() {
 
     // 2b. Draw accumulated event image
     if (m_state.display_mode != DisplayMode::RGB_ONLY) {
+        m_quad_shader->setInt("u_colormap", static_cast<int>(m_state.colormap));
         m_quad_shader->setFloat("u_alpha", m_state.event_alpha);
+        if (normalize) {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, m_reduction_levels.empty() ? m_event_texture : m_reduction_levels.back().texture);
+        }
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, m_event_texture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -177,38 +416,238 @@ void Renderer::renderScene() {
     glBindVertexArray(0);
 }
 
-void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset) {
+bool Renderer::useComputePath(size_t num_events) const {
+    if (!m_compute_available || m_accumulation_path == AccumulationPath::POINTS) return false;
+    return m_accumulation_path == AccumulationPath::COMPUTE || num_events >= COMPUTE_MIN_EVENTS;
+}
+
+void Renderer::accumulatePoints(const std::vector<VertexRange>& ranges, int64_t start_t, int64_t end_t, bool subtract) {
+    if (ranges.empty()) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_event_fbo);
+    glViewport(0, 0, m_sensor_width, m_sensor_height);
+    glBlendFunc(GL_ONE, GL_ONE); // Use additive blending for counters
+    if (subtract) glBlendEquation(GL_FUNC_REVERSE_SUBTRACT); // counts - 1 per event
+    m_event_accum_shader->use();
+    setTimeWindowUniforms(*m_event_accum_shader, start_t, end_t);
+    glBindVertexArray(m_event_vao);
+    for (const VertexRange& range : ranges) {
+        glDrawArrays(GL_POINTS, static_cast<GLint>(range.first), static_cast<GLsizei>(range.count));
+    }
+    if (subtract) glBlendEquation(GL_FUNC_ADD);
+}
+
+void Renderer::accumulateCompute(const std::vector<VertexRange>& ranges, int64_t start_t, int64_t end_t, bool subtract) {
+    // Count into the R32UI array with atomics; resolveCounts() then copies them into the texture the composition reads
+    if (ranges.empty()) return;
+    m_accum_compute_shader->use();
+    setTimeWindowUniforms(*m_accum_compute_shader, start_t, end_t);
+    m_accum_compute_shader->setIVec2("u_sensor_size", m_sensor_width, m_sensor_height);
+    // Adding 2^32 - 1 wraps around to subtracting one, which is exact
+    m_accum_compute_shader->setUInt("u_increment", subtract ? 0xffffffffu : 1u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_event_vbo);
+    glBindImageTexture(0, m_count_texture, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+    for (const VertexRange& range : ranges) {
+        for (size_t done = 0; done < range.count;) {
+            size_t count = std::min(range.count - done, MAX_COMPUTE_GROUPS * COMPUTE_GROUP_SIZE);
+            m_accum_compute_shader->setUInt("u_first", static_cast<GLuint>(range.first + done));
+            m_accum_compute_shader->setUInt("u_count", static_cast<GLuint>(count));
+            glDispatchCompute(static_cast<GLuint>((count + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE), 1, 1);
+            done += count;
+        }
+    }
+    // The resolve samples the counts, and a later rebuild clears or uploads them
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+void Renderer::resolveCounts() {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_event_fbo);
+    glViewport(0, 0, m_sensor_width, m_sensor_height);
+    glDisable(GL_BLEND);
+    m_resolve_shader->use();
+    m_resolve_shader->setInt("u_counts", 0);
+    // RGBA8 targets hold n/255 per event under the point path; match it so the colormaps read the same values
+    m_resolve_shader->setFloat("u_scale", m_accumulation_format == AccumulationFormat::RGBA8 ? 1.0f / 255.0f : 1.0f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_count_texture);
+    glBindVertexArray(m_quad_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glEnable(GL_BLEND);
+}
+
+bool Renderer::collectWindowChanges(int64_t start_t, int64_t end_t, size_t window_events) {
+    // A path switched by hand needs its own counts; AUTO keeps the path of the last rebuild
+    if (m_accumulation_path != AccumulationPath::AUTO && m_accum_compute != (m_accumulation_path == AccumulationPath::COMPUTE)) return false;
+    if (m_live) {
+        // Events leaving the window can only be subtracted while the ring still holds them
+        size_t capacity = m_live->ring().capacity();
+        uint64_t oldest = std::max(m_live_valid_begin, m_live_uploaded > capacity ? m_live_uploaded - capacity : 0);
+        if (oldest < m_live_uploaded && m_live_timestamps[oldest & (capacity - 1)] >= m_accum_start_t) return false;
+    }
+
+    // Added: the new window minus the kept one. Removed: the kept window minus the new one
+    m_added_ranges.clear();
+    m_removed_ranges.clear();
+    size_t changed = 0;
+    if (start_t < m_accum_start_t) changed += appendRanges(start_t, std::min(end_t, m_accum_start_t), m_added_ranges);
+    if (end_t > m_accum_end_t) changed += appendRanges(std::max(start_t, m_accum_end_t), end_t, m_added_ranges);
+    if (m_accum_start_t < start_t) changed += appendRanges(m_accum_start_t, std::min(m_accum_end_t, start_t), m_removed_ranges);
+    if (m_accum_end_t > end_t) changed += appendRanges(std::max(m_accum_start_t, end_t), m_accum_end_t, m_removed_ranges);
+    // After a seek or a big jump, redrawing the window touches fewer events
+    return changed <= window_events;
+}
+
+void Renderer::invalidateAccumulation(int64_t t_first, int64_t t_last) {
+    if (t_first < m_accum_end_t && t_last >= m_accum_start_t) {
+        m_accum_valid = false;
+        m_accum_dirty = true;
+    }
+}
+
+bool Renderer::collectKeyframeEdges(int64_t start_t, int64_t end_t, size_t window_events, bool compute) {
+    // The difference is exact only in the R32UI counts and float32 targets
+    if (m_keyframes.empty() || !(compute || m_accumulation_format == AccumulationFormat::RG32F)) return false;
+    size_t a = m_keyframes.nearest(start_t);
+    size_t b = m_keyframes.nearest(end_t);
+    int64_t t_a = m_keyframes.time(a), t_b = m_keyframes.time(b);
+
+    // counts[start, end) = K_b - K_a + [t_b, end) - [t_a, start), where a span running backwards flips its sign
+    m_added_ranges.clear();
+    m_removed_ranges.clear();
+    size_t edges = 0;
+    if (t_b <= end_t) {
+        edges += appendRanges(t_b, end_t, m_added_ranges);
+    } else {
+        edges += appendRanges(end_t, t_b, m_removed_ranges);
+    }
+    if (t_a <= start_t) {
+        edges += appendRanges(t_a, start_t, m_removed_ranges);
+    } else {
+        edges += appendRanges(start_t, t_a, m_added_ranges);
+    }
+    // Uploading the difference costs about as much as accumulating one event per pixel
+    size_t upload_cost = static_cast<size_t>(m_sensor_width) * m_sensor_height;
+    if (edges + upload_cost >= window_events) return false;
+    m_keyframe_a = a;
+    m_keyframe_b = b;
+    return true;
+}
+
+void Renderer::uploadKeyframeDifference(bool compute) {
+    size_t plane = static_cast<size_t>(m_sensor_width) * m_sensor_height;
+    if (m_keyframe_diff.empty() || m_keyframe_a != m_keyframe_diff_a || m_keyframe_b != m_keyframe_diff_b) {
+        m_keyframe_diff.resize(2 * plane);
+        m_keyframes.difference(m_keyframe_a, m_keyframe_b, m_keyframe_diff.data());
+        m_keyframe_diff_a = m_keyframe_a;
+        m_keyframe_diff_b = m_keyframe_b;
+        m_keyframe_upload.clear();
+    }
+
+    if (compute) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_count_texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, m_sensor_width, m_sensor_height, 2, GL_RED_INTEGER, GL_UNSIGNED_INT, m_keyframe_diff.data());
+    } else {
+        // The keyframes store ON and OFF as separate planes; the float target interleaves them
+        if (m_keyframe_upload.empty()) {
+            m_keyframe_upload.resize(2 * plane);
+            for (size_t i = 0; i < plane; ++i) {
+                m_keyframe_upload[2 * i] = static_cast<float>(m_keyframe_diff[i]);
+                m_keyframe_upload[2 * i + 1] = static_cast<float>(m_keyframe_diff[plane + i]);
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, m_event_texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_sensor_width, m_sensor_height, GL_RG, GL_FLOAT, m_keyframe_upload.data());
+    }
+}
+
+void Renderer::printAccumulationStats() {
+    // The query result is read a frame or more later so the CPU never waits on the GPU
+    GLint available = GL_FALSE;
+    if (m_accum_query_pending) glGetQueryObjectiv(m_accum_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(m_accum_query, GL_QUERY_RESULT, &elapsed_ns);
+        m_accum_query_pending = false;
+        m_accum_time_sum_ms += elapsed_ns / 1e6;
+        m_accum_events_sum += m_last_accum_events;
+        if (m_last_accum_compute) ++m_accum_compute_frames;
+        ++m_accum_frames;
+    }
+
+    double now = glfwGetTime();
+    if (now - m_accum_last_report_time < ACCUM_STATS_INTERVAL_S || m_accum_frames == 0) return;
+    double mean_ms = m_accum_time_sum_ms / m_accum_frames;
+    double mean_events = static_cast<double>(m_accum_events_sum) / m_accum_frames;
+    printf("--- Accumulation (%s%s): %.3f ms/frame on GPU | %.0f events/frame | %.1f Mev/s | compute %llu / %llu frames | rebuilds %llu (from keyframes %llu) ---\n",
+        accumulation_path_name(m_accumulation_path), m_incremental ? ", incremental" : "", mean_ms, mean_events,
+        mean_ms > 0.0 ? mean_events / mean_ms / 1e3 : 0.0, static_cast<unsigned long long>(m_accum_compute_frames),
+        static_cast<unsigned long long>(m_accum_frames), static_cast<unsigned long long>(m_accum_rebuilds),
+        static_cast<unsigned long long>(m_keyframe_rebuilds));
+    m_accum_last_report_time = now;
+    m_accum_time_sum_ms = 0.0;
+    m_accum_events_sum = 0;
+    m_accum_compute_frames = 0;
+    m_accum_frames = 0;
+    m_accum_rebuilds = 0;
+    m_keyframe_rebuilds = 0;
+}
+
+void Renderer::loadData(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset) {
     m_sensor_width = sensor_width;
     m_sensor_height = sensor_height;
 
     // Event Data
-    if (!all_events.empty()) {
-        m_base_time = static_cast<double>(t_offset) + all_events.front().t;
-        m_current_time_us = 0.0;
-
-        m_event_timestamps.resize(all_events.size());
-        std::vector<EventVertex> vertices(all_events.size());
-        for(size_t i = 0; i < all_events.size(); ++i) {
-            vertices[i].x = (static_cast<float>(all_events[i].x) / sensor_width) * 2.0f - 1.0f;
-            vertices[i].y = (static_cast<float>(all_events[i].y) / sensor_height) * -2.0f + 1.0f;
-            vertices[i].timestamp = static_cast<float>((static_cast<double>(t_offset) + all_events[i].t) - m_base_time);
-            vertices[i].polarity = all_events[i].pol;
-            m_event_timestamps[i] = vertices[i].timestamp;
+    if (m_prefetcher) {
+        // Streaming: reserve one slot per segment; the slots are filled while playing
+        m_base_time = t_offset + m_prefetcher->t_first();
+        m_current_time_us = 0;
+        createEventBuffer(m_prefetcher->max_segments() * m_prefetcher->segment_events());
+        for (size_t slot = m_prefetcher->max_segments(); slot-- > 0;) {
+            m_free_slots.push_back(slot * m_prefetcher->segment_events());
         }
-        m_event_count = vertices.size();
+    } else if (m_live) {
+        // Live: one slot per ring entry, so the newest events can always be drawn
+        size_t capacity = m_live->ring().capacity();
+        createEventBuffer(capacity);
+        m_live_timestamps.assign(capacity, 0);
+    } else if (num_events > 0) {
+        m_base_time = t_offset + read_slice(0, 1).t.front();
+        m_current_time_us = 0;
+        createEventBuffer(num_events);
 
-        glGenBuffers(1, &m_event_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, m_event_vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(EventVertex), vertices.data(), GL_STATIC_DRAW);
+        // Index the event times alongside the upload unless the cache already had the index
+        EventBatch batch;
+        bool build_index = time_index.size() != num_events;
+        if (build_index) {
+            int64_t t_last = t_offset + read_slice(num_events - 1, 1).t.front();
+            batch.time_index = TimeIndex(m_base_time, t_last, num_events);
+        } else {
+            batch.time_index = std::move(time_index);
+        }
+        for (size_t begin = 0; begin < num_events; begin += UPLOAD_SLICE_EVENTS) {
+            const EventStore slice = read_slice(begin, std::min(UPLOAD_SLICE_EVENTS, num_events - begin));
+            uploadEvents(slice, begin, t_offset);
+            if (build_index) batch.time_index.append(slice.t.data(), slice.size(), t_offset);
+        }
 
-        glGenVertexArrays(1, &m_event_vao);
-        glBindVertexArray(m_event_vao);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(EventVertex), (void*)offsetof(EventVertex, x));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(EventVertex), (void*)offsetof(EventVertex, timestamp));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(EventVertex), (void*)offsetof(EventVertex, polarity));
+        // Count keyframes let seeks and long windows be rebuilt from two keyframes and the events at the window edges
+        if (m_keyframe_memory_bytes > 0) {
+            double build_start = glfwGetTime();
+            m_keyframes = CountKeyframes::build(num_events, read_slice, batch.time_index, t_offset, m_sensor_width, m_sensor_height,
+                                                m_keyframe_interval_us, m_keyframe_memory_bytes);
+            if (m_keyframes.empty()) {
+                printf("--- Count keyframes: disabled (two keyframes exceed %zu MB) ---\n", m_keyframe_memory_bytes >> 20);
+            } else {
+                printf("--- Count keyframes: %zu every %.1f ms (%.1f MB, built in %.2f s) ---\n", m_keyframes.size(),
+                    m_keyframes.interval_us() / 1000.0, m_keyframes.memory_bytes() / 1048576.0, glfwGetTime() - build_start);
+            }
+            // A wider interval leaves longer edges, so more windows fall back to counting every event
+            if (!m_keyframes.empty() && m_keyframes.interval_us() > m_keyframe_interval_us) {
+                std::cerr << "Warning: count keyframe interval widened from " << m_keyframe_interval_us / 1000.0 << " ms to "
+                          << m_keyframes.interval_us() / 1000.0 << " ms to fit " << (m_keyframe_memory_bytes >> 20)
+                          << " MB; raise rendering.keyframe_memory_mb to keep the configured interval." << std::endl;
+            }
+        }
+        m_event_batches.push_back(std::move(batch));
     }
 
     // Quad for displaying textures
@@ -225,25 +664,22 @@ void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vecto
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
     // Framebuffer Object (FBO) for accumulating events
-    glGenFramebuffers(1, &m_event_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_event_fbo);
-    glGenTextures(1, &m_event_texture);
-    glBindTexture(GL_TEXTURE_2D, m_event_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sensor_width, sensor_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_event_texture, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        throw std::runtime_error("Framebuffer is not complete!");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    createAccumulationTargets();
+    if (m_compute_available) createComputeTargets();
 
     // Image Textures
     m_all_images_ptr = &all_images;
+    std::vector<int64_t> frame_times(all_images.size());
+    for (size_t i = 0; i < all_images.size(); ++i) frame_times[i] = all_images[i].timestamp;
+    m_image_index = TimeIndex::build(frame_times.data(), frame_times.size(), 0, TimeIndex::FRAME_BUCKET_SHIFT);
     if (!all_images.empty()) {
         stbi_set_flip_vertically_on_load(true);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows are not 4-byte aligned for odd widths
         for (const auto& frame : all_images) {
-            int w, h, ch;
-            unsigned char* data = stbi_load(frame.image_path.c_str(), &w, &h, &ch, 0);
+            // Frames embedded in the event file (e.g. AEDAT4 APS frames) are already decoded to bottom-up RGB
+            int w = frame.width, h = frame.height, ch = 3;
+            unsigned char* file_data = frame.pixels ? nullptr : stbi_load(frame.image_path.c_str(), &w, &h, &ch, 0);
+            const unsigned char* data = frame.pixels ? frame.pixels->data() : file_data;
             if (data) {
                 GLuint texID;
                 glGenTextures(1, &texID);
@@ -252,13 +688,294 @@ void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vecto
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                 m_image_textures.push_back(texID);
-                stbi_image_free(data);
             }
+            if (file_data) stbi_image_free(file_data);
         }
     }
     glBindVertexArray(0);
 }
 
+void Renderer::createAccumulationTargets() {
+    // Float targets keep exact counts under additive blending; RGBA8 saturates at 255
+    GLint internal_format = GL_RG32F;
+    GLenum format = GL_RG, type = GL_FLOAT;
+    if (m_accumulation_format == AccumulationFormat::RG16F) {
+        internal_format = GL_RG16F;
+        type = GL_HALF_FLOAT;
+    } else if (m_accumulation_format == AccumulationFormat::RGBA8) {
+        internal_format = GL_RGBA8;
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+    }
+
+    auto create_target = [](GLuint& fbo, GLuint& texture, GLint internal_format, GLenum format, GLenum type, int width, int height) {
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("Framebuffer is not complete!");
+    };
+    create_target(m_event_fbo, m_event_texture, internal_format, format, type, m_sensor_width, m_sensor_height);
+
+    int width = m_sensor_width, height = m_sensor_height;
+    while (width > 1 || height > 1) {
+        ReductionLevel level;
+        level.width = (width + MAX_REDUCE_FACTOR - 1) / MAX_REDUCE_FACTOR;
+        level.height = (height + MAX_REDUCE_FACTOR - 1) / MAX_REDUCE_FACTOR;
+        create_target(level.fbo, level.texture, GL_RG32F, GL_RG, GL_FLOAT, level.width, level.height);
+        m_reduction_levels.push_back(level);
+        width = level.width;
+        height = level.height;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::createComputeTargets() {
+    // Layer 0 counts ON events, layer 1 OFF events; attached layered so one clear resets both
+    glGenTextures(1, &m_count_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_count_texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32UI, m_sensor_width, m_sensor_height, 2);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &m_count_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_count_fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_count_texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Count framebuffer is not complete!");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::reduceMaxCounts() {
+    glDisable(GL_BLEND);
+    m_reduce_shader->use();
+    glBindVertexArray(m_quad_vao);
+    glActiveTexture(GL_TEXTURE0);
+    GLuint source = m_event_texture;
+    for (size_t i = 0; i < m_reduction_levels.size(); ++i) {
+        const ReductionLevel& level = m_reduction_levels[i];
+        glBindFramebuffer(GL_FRAMEBUFFER, level.fbo);
+        glViewport(0, 0, level.width, level.height);
+        m_reduce_shader->setInt("u_first_pass", i == 0 ? 1 : 0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        source = level.texture;
+    }
+    glEnable(GL_BLEND);
+}
+
+void Renderer::createEventBuffer(size_t capacity) {
+    glGenBuffers(1, &m_event_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_event_vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(EventVertex), nullptr, (m_prefetcher || m_live) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &m_event_vao);
+    glBindVertexArray(m_event_vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(EventVertex), (void*)offsetof(EventVertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(EventVertex), (void*)offsetof(EventVertex, time_lo));
+    glEnableVertexAttribArray(2);
+    // polarity and time_hi are adjacent bytes, read together as a uvec2
+    glVertexAttribIPointer(2, 2, GL_UNSIGNED_BYTE, sizeof(EventVertex), (void*)offsetof(EventVertex, polarity));
+}
+
+void Renderer::uploadEvents(const EventStore& events, size_t first_vertex, int64_t t_offset, int64_t* timestamps) {
+    m_upload_vertices.resize(events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        EventVertex& vertex = m_upload_vertices[i];
+        int64_t t = t_offset + events.t[i];
+        uint64_t offset = static_cast<uint64_t>(std::clamp<int64_t>(t - m_base_time, 0, MAX_VERTEX_TIME_US));
+        // Pixel centers, so the point covers exactly the pixel the compute path and the keyframes count it in
+        vertex.x = ((static_cast<float>(events.x[i]) + 0.5f) / m_sensor_width) * 2.0f - 1.0f;
+        vertex.y = ((static_cast<float>(events.y[i]) + 0.5f) / m_sensor_height) * -2.0f + 1.0f;
+        vertex.time_lo = static_cast<uint32_t>(offset);
+        vertex.time_hi = static_cast<uint8_t>(offset >> 32);
+        vertex.polarity = events.p[i];
+        if (timestamps) timestamps[i] = t;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_event_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(EventVertex), m_upload_vertices.size() * sizeof(EventVertex), m_upload_vertices.data());
+}
+
+void Renderer::streamEvents() {
+    PlaybackRequest request;
+    request.playhead_us = m_prefetcher->t_first() + m_current_time_us;
+    request.window_us = static_cast<int64_t>(m_state.time_window_us);
+    request.speed = m_state.playback_speed;
+    request.reversed = m_state.is_reversed;
+    m_prefetcher->update(request);
+
+    // Hand segments that left the window and the lookahead back to the prefetcher
+    TimeRange wanted = m_prefetcher->wanted_range(request);
+    for (auto it = m_event_batches.begin(); it != m_event_batches.end();) {
+        if (it->segment->t_last < wanted.begin || it->segment->t_first >= wanted.end) {
+            invalidateAccumulation(m_prefetcher->t_offset() + it->segment->t_first, m_prefetcher->t_offset() + it->segment->t_last);
+            m_free_slots.push_back(it->first_vertex);
+            m_prefetcher->release(it->segment);
+            it = m_event_batches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Upload newly prefetched segments; there is always a free slot since slots match the pool size
+    while (!m_free_slots.empty()) {
+        EventSegment* segment = m_prefetcher->poll();
+        if (!segment) break;
+        // Read through a const view; non-const access would copy the mmap'd columns to the heap
+        const EventStore& events = segment->events;
+        EventBatch batch;
+        batch.first_vertex = m_free_slots.back();
+        batch.segment = segment;
+        batch.time_index = TimeIndex::build(events.t.data(), events.size(), m_prefetcher->t_offset());
+        m_free_slots.pop_back();
+        // A segment that arrives late holds events the kept counts never saw
+        invalidateAccumulation(m_prefetcher->t_offset() + segment->t_first, m_prefetcher->t_offset() + segment->t_last);
+        uploadEvents(events, batch.first_vertex, m_prefetcher->t_offset());
+        m_event_batches.push_back(std::move(batch));
+    }
+}
+
+void Renderer::receiveLiveEvents() {
+    const LiveEventRing& ring = m_live->ring();
+    uint64_t head = ring.head();
+
+    if (!m_state.is_paused && head > m_live_uploaded) {
+        uint64_t oldest = head > ring.capacity() ? head - ring.capacity() : 0;
+        uint64_t valid = uploadLiveEvents(std::max(m_live_uploaded, oldest), head);
+        if (valid > m_live_uploaded) {
+            // The ring was overwritten before we got to it; older slots are no longer contiguous
+            m_live_overwritten += valid - m_live_uploaded;
+            m_live_valid_begin = std::max(m_live_valid_begin, valid);
+        }
+        m_live_uploaded = head;
+        m_current_time_us = m_live_last_t - m_base_time;
+    }
+
+    // Per-packet latency from receipt to upload (discarded while paused)
+    int64_t now_us = live_clock_us();
+    LivePacketMark mark;
+    while (m_live_pending_mark || m_live->pop_mark(mark)) {
+        if (m_live_pending_mark) {
+            mark = *m_live_pending_mark;
+            m_live_pending_mark.reset();
+        }
+        if (m_state.is_paused) continue;
+        if (mark.end_index > m_live_uploaded) {
+            m_live_pending_mark = mark;
+            break;
+        }
+        double latency_ms = (now_us - mark.receive_time_us) / 1000.0;
+        m_live_upload_latency_sum_ms += latency_ms;
+        m_live_upload_latency_max_ms = std::max(m_live_upload_latency_max_ms, latency_ms);
+        ++m_live_upload_latency_count;
+    }
+}
+
+uint64_t Renderer::uploadLiveEvents(uint64_t begin, uint64_t end) {
+    const LiveEventRing& ring = m_live->ring();
+    uint64_t valid = ring.read(begin, end, m_live_staging);
+    const EventStore& events = m_live_staging;
+    if (events.empty()) return valid;
+
+    if (!m_live_started) {
+        m_base_time = events.t[0];
+        m_live_last_t = events.t[0];
+        m_live_valid_begin = valid;
+        m_live_started = true;
+        m_accum_valid = false;
+        m_accum_dirty = true;
+    }
+    // A reconnect or producer restart sends time backwards: drop everything before it and start a new time base.
+    // The receiver drops late packets, so within one run time never decreases with the ring index.
+    size_t first = 0;
+    uint64_t restart = m_live->restart_index();
+    if (restart != m_live_restart_seen && restart < end) {
+        m_live_restart_seen = restart;
+        first = restart > valid ? static_cast<size_t>(restart - valid) : 0;
+        m_base_time = events.t[first];
+        m_live_valid_begin = valid + first;
+        m_accum_valid = false;
+        m_accum_dirty = true;
+    }
+    m_live_last_t = events.t[events.size() - 1];
+
+    // Upload in at most two pieces, split where the ring wraps around
+    size_t capacity = ring.capacity();
+    for (size_t i = first; i < events.size();) {
+        size_t slot = (valid + i) & (capacity - 1);
+        size_t count = std::min(events.size() - i, capacity - slot);
+        uploadEvents(events.slice(i, count), slot, 0, m_live_timestamps.data() + slot);
+        i += count;
+    }
+    return valid;
+}
+
+size_t Renderer::appendRanges(int64_t start_t, int64_t end_t, std::vector<VertexRange>& ranges) const {
+    size_t begin = ranges.size();
+    if (m_live) appendLiveRanges(start_t, end_t, ranges);
+    for (const EventBatch& batch : m_event_batches) {
+        size_t first = batch.time_index.lower_bound(start_t);
+        size_t last = batch.time_index.lower_bound(end_t);
+        if (last > first) ranges.push_back({batch.first_vertex + first, last - first});
+    }
+    size_t count = 0;
+    for (size_t i = begin; i < ranges.size(); ++i) count += ranges[i].count;
+    return count;
+}
+
+void Renderer::appendLiveRanges(int64_t start_t, int64_t end_t, std::vector<VertexRange>& ranges) const {
+    size_t capacity = m_live->ring().capacity();
+    uint64_t valid_begin = std::max(m_live_valid_begin, m_live_uploaded > capacity ? m_live_uploaded - capacity : 0);
+
+    // Binary search over ring indices; timestamps increase with the index
+    auto lower_bound = [&](int64_t t) {
+        uint64_t first = valid_begin;
+        uint64_t count = m_live_uploaded - first;
+        while (count > 0) {
+            uint64_t half = count / 2;
+            if (m_live_timestamps[(first + half) & (capacity - 1)] < t) {
+                first += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        return first;
+    };
+    uint64_t end = lower_bound(end_t);
+
+    for (uint64_t i = lower_bound(start_t); i < end;) {
+        size_t slot = i & (capacity - 1);
+        size_t count = static_cast<size_t>(std::min<uint64_t>(end - i, capacity - slot));
+        ranges.push_back({slot, count});
+        i += count;
+    }
+}
+
+void Renderer::printLiveStats() {
+    double now = glfwGetTime();
+    LiveStats stats = m_live->stats();
+    double elapsed = now - m_live_last_stats_time;
+    double rate = (m_live_last_stats_time > 0.0 && elapsed > 0.0) ? (stats.events - m_live_last_stats.events) / elapsed : 0.0;
+    double upload_mean_ms = m_live_upload_latency_count ? m_live_upload_latency_sum_ms / m_live_upload_latency_count : 0.0;
+    printf("--- Live: %.2f Mev/s | packets %llu (lost %llu, late %llu, invalid %llu) | latency send->recv %.2f ms (max %.2f), recv->GPU %.2f ms (max %.2f) | overwritten %llu ---\n",
+        rate / 1e6, static_cast<unsigned long long>(stats.packets), static_cast<unsigned long long>(stats.lost_packets),
+        static_cast<unsigned long long>(stats.late_packets), static_cast<unsigned long long>(stats.invalid_packets), stats.latency_mean_ms, stats.latency_max_ms,
+        upload_mean_ms, m_live_upload_latency_max_ms, static_cast<unsigned long long>(m_live_overwritten));
+    m_live_last_stats = stats;
+    m_live_last_stats_time = now;
+    m_live_upload_latency_sum_ms = 0.0;
+    m_live_upload_latency_max_ms = 0.0;
+    m_live_upload_latency_count = 0;
+}
+
 void Renderer::cleanup() {
     glDeleteVertexArrays(1, &m_event_vao);
     glDeleteBuffers(1, &m_event_vbo);
@@ -267,6 +984,13 @@ void Renderer::cleanup() {
     
     glDeleteFramebuffers(1, &m_event_fbo);
     glDeleteTextures(1, &m_event_texture);
+    for (const ReductionLevel& level : m_reduction_levels) {
+        glDeleteFramebuffers(1, &level.fbo);
+        glDeleteTextures(1, &level.texture);
+    }
+    glDeleteFramebuffers(1, &m_count_fbo);
+    glDeleteTextures(1, &m_count_texture);
+    glDeleteQueries(1, &m_accum_query);
 
     if (!m_image_textures.empty()) {
         glDeleteTextures(m_image_textures.size(), m_image_textures.data());
@@ -278,6 +1002,9 @@ void Renderer::cleanup() {
 
 // --- Callback Handlers ---
 void Renderer::onKey(int key, int scancode, int action, int mods) {
+    // Display settings only need the frame composed again; M, P, I and C change how the counts are accumulated
+    if (action != GLFW_RELEASE) m_frame_dirty = true;
+    if (action == GLFW_PRESS && (key == GLFW_KEY_M || key == GLFW_KEY_P || key == GLFW_KEY_I || key == GLFW_KEY_C)) m_accum_dirty = true;
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(m_window, true);
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         m_state.is_paused = !m_state.is_paused;
@@ -290,6 +1017,34 @@ void Renderer::onKey(int key, int scancode, int action, int mods) {
         printf("--- Mode: %s ---\n", modes[static_cast<int>(m_state.display_mode)]);
     }
     
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        if (m_compute_available) {
+            m_accumulation_path = static_cast<AccumulationPath>((static_cast<int>(m_accumulation_path) + 1) % 3);
+        }
+        printf("--- Accumulation path: %s%s ---\n", accumulation_path_name(m_accumulation_path),
+            m_compute_available ? "" : " (OpenGL 4.3 compute unavailable)");
+    }
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        m_incremental = !m_incremental;
+        printf("--- Incremental accumulation: %s ---\n", m_incremental ? "on" : "off");
+    }
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        // Restart the averages so each report covers only frames of the current path
+        m_report_accumulation = !m_report_accumulation;
+        m_accum_last_report_time = glfwGetTime();
+        m_accum_time_sum_ms = 0.0;
+        m_accum_events_sum = 0;
+        m_accum_compute_frames = 0;
+        m_accum_frames = 0;
+        m_accum_rebuilds = 0;
+        m_keyframe_rebuilds = 0;
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        m_state.colormap = static_cast<Colormap>((static_cast<int>(m_state.colormap) + 1) % 3);
+        const char* colormaps[] = {"Dominant polarity", "Net polarity (ON - OFF)", "Event count"};
+        printf("--- Colormap: %s ---\n", colormaps[static_cast<int>(m_state.colormap)]);
+    }
+
     if (action == GLFW_PRESS || action == GLFW_REPEAT) {
         bool updated = false;
         switch(key) {
@@ -301,11 +1056,12 @@ void Renderer::onKey(int key, int scancode, int action, int mods) {
             case GLFW_KEY_COMMA: m_state.time_window_us = std::max(1000.0, m_state.time_window_us / 1.2); updated = true; break;
             case GLFW_KEY_RIGHT: m_state.playback_speed *= 1.2f; updated = true; break;
             case GLFW_KEY_LEFT: m_state.playback_speed /= 1.2f; updated = true; break;
+            case GLFW_KEY_R: if (action == GLFW_PRESS) { m_state.is_reversed = !m_state.is_reversed; updated = true; } break;
         }
 
         if (updated) {
-            printf("Speed: %.2fx, RGB-α: %.2f, Evt-α: %.2f, Win: %.2fms\n", 
-                m_state.playback_speed, m_state.rgb_alpha, m_state.event_alpha, m_state.time_window_us / 1e3);
+            printf("Speed: %s%.2fx, RGB-α: %.2f, Evt-α: %.2f, Win: %.2fms\n", 
+                m_state.is_reversed ? "-" : "", m_state.playback_speed, m_state.rgb_alpha, m_state.event_alpha, m_state.time_window_us / 1e3);
         }
     }
 }
@@ -324,14 +1080,17 @@ void Renderer::onCursorPosition(double xpos, double ypos) {
     m_last_x = xpos;
     m_last_y = ypos;
     m_camera.processMouseMovement(xoffset, yoffset, m_width, m_height);
+    m_frame_dirty = true;
 }
 
 void Renderer::onScroll(double xoffset, double yoffset) {
     m_camera.processMouseScroll(static_cast<float>(yoffset));
+    m_frame_dirty = true;
 }
 
 void Renderer::onFramebufferSize(int width, int height) {
     m_width = width;
     m_height = height;
     glViewport(0, 0, width, height);
+    m_frame_dirty = true;
 }
\ No newline at end of file
@@ -6,12 +6,16 @@
 #include <glm/gtc/type_ptr.hpp>
 
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
-    GLuint vertexShader = loadAndCompile(vertexPath, GL_VERTEX_SHADER);
-    GLuint fragmentShader = loadAndCompile(fragmentPath, GL_FRAGMENT_SHADER);
+    link({loadAndCompile(vertexPath, GL_VERTEX_SHADER), loadAndCompile(fragmentPath, GL_FRAGMENT_SHADER)});
+}
+
+Shader::Shader(const std::string& computePath) {
+    link({loadAndCompile(computePath, GL_COMPUTE_SHADER)});
+}
 
+void Shader::link(const std::vector<GLuint>& shaders) {
     m_id = glCreateProgram();
-    glAttachShader(m_id, vertexShader);
-    glAttachShader(m_id, fragmentShader);
+    for (GLuint shader : shaders) glAttachShader(m_id, shader);
     glLinkProgram(m_id);
 
     GLint success;
@@ -24,8 +28,7 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
         std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << log.data() << std::endl;
     }
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    for (GLuint shader : shaders) glDeleteShader(shader);
 }
 
 Shader::~Shader() {
@@ -76,6 +79,22 @@ void Shader::setFloat(const std::string& name, float value) const {
     glUniform1f(glGetUniformLocation(m_id, name.c_str()), value);
 }
 
+void Shader::setUInt(const std::string& name, GLuint value) const {
+    glUniform1ui(glGetUniformLocation(m_id, name.c_str()), value);
+}
+
+void Shader::setInt(const std::string& name, int value) const {
+    glUniform1i(glGetUniformLocation(m_id, name.c_str()), value);
+}
+
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
     glUniform3fv(glGetUniformLocation(m_id, name.c_str()), 1, &value[0]);
+}
+
+void Shader::setUVec2(const std::string& name, GLuint x, GLuint y) const {
+    glUniform2ui(glGetUniformLocation(m_id, name.c_str()), x, y);
+}
+
+void Shader::setIVec2(const std::string& name, int x, int y) const {
+    glUniform2i(glGetUniformLocation(m_id, name.c_str()), x, y);
 }
\ No newline at end of file
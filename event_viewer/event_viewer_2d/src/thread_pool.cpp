@@ -0,0 +1,109 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+// ジョブの処理中 (ワーカースレッド、または parallel_for で処理に参加している呼び出しスレッド) なら true
+// その中からの入れ子の parallel_for はその場で逐次実行する (投入用のロックを二重に取るデッドロックの防止)
+thread_local bool t_in_job = false;
+// ThreadPool::Scope で差し替えたこのスレッドのプール
+thread_local ThreadPool* t_scoped_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // 呼び出しスレッドも処理に参加するので、ワーカーは1つ少なく作る
+    for (size_t i = 1; i < num_threads; ++i) {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    if (t_scoped_pool) return *t_scoped_pool;
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::Scope::Scope(ThreadPool& pool) : m_previous(t_scoped_pool) {
+    t_scoped_pool = &pool;
+}
+
+ThreadPool::Scope::~Scope() {
+    t_scoped_pool = m_previous;
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+    if (m_workers.empty() || n == 1 || t_in_job) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+
+    // 別スレッドからの同時投入は1ジョブずつ順番に処理する
+    std::lock_guard<std::mutex> submit_lock(m_submit_mutex);
+    auto job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->size = n;
+    job->pending = n;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = job;
+        ++m_generation;
+    }
+    m_work_cv.notify_all();
+
+    t_in_job = true;
+    run_job(*job);
+    t_in_job = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cv.wait(lock, [&] { return job->pending == 0; });
+        m_job.reset();
+    }
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+void ThreadPool::worker_loop() {
+    t_in_job = true;
+    uint64_t seen_generation = 0;
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cv.wait(lock, [&] { return m_stop || (m_job && m_generation != seen_generation); });
+            if (m_stop) return;
+            seen_generation = m_generation;
+            job = m_job;
+        }
+        run_job(*job);
+    }
+}
+
+void ThreadPool::run_job(Job& job) {
+    while (true) {
+        size_t i = job.next.fetch_add(1);
+        if (i >= job.size) break;
+        try {
+            (*job.fn)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!job.error) job.error = std::current_exception();
+        }
+        if (job.pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done_cv.notify_all();
+        }
+    }
+}
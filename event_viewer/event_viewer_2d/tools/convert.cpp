@@ -0,0 +1,111 @@
+// イベントファイルをネイティブのブロック形式 (.evb)、または Arrow IPC / Feather (.arrow / .feather) に変換するツール
+// 使い方: convert <input (.h5 / .evb / .raw / .aedat4 / .npy / .npz / .txt / .arrow / .feather)> <output (.evb / .arrow / .feather)>
+//         [--block-size N] [--zstd [level]]          (.evb)
+//         [--batch-ms MS] [--range BEGIN_MS END_MS]  (.arrow / .feather: レコードバッチの時間間隔、先頭のイベントからの書き出す範囲)
+#include "event_source.h"
+#include "arrow_ipc.h"
+#include "event_file.h"
+#include <H5Cpp.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct ConvertConfig {
+    std::string input_path;
+    std::string output_path;
+    bool arrow_output = false;
+    EventFileWriteOptions options;
+    ArrowWriteOptions arrow_options;
+    // --range (先頭のイベントからの ms)
+    std::optional<std::pair<int64_t, int64_t>> range_ms;
+};
+
+bool is_arrow_path(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ArrowEventReader::EXTENSION || ext == ArrowEventReader::FEATHER_EXTENSION || ext == ArrowEventReader::IPC_EXTENSION;
+}
+
+ConvertConfig parse_arguments(int argc, char* argv[]) {
+    if (argc < 3) {
+        throw std::runtime_error("Usage: " + std::string(argv[0]) + " <input (.h5/.evb/.raw/.aedat4/.npy/.npz/.txt/.arrow/.feather)> <output (.evb/.arrow/.feather)>"
+                                 " [--block-size N] [--zstd [level]] [--batch-ms MS] [--range BEGIN_MS END_MS]");
+    }
+    ConvertConfig config;
+    config.input_path = argv[1];
+    config.output_path = argv[2];
+    config.arrow_output = is_arrow_path(config.output_path);
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch-ms" && i + 1 < argc) {
+            config.arrow_options.batch_ms = std::stoll(argv[++i]);
+        } else if (arg == "--range" && i + 2 < argc) {
+            int64_t begin_ms = std::stoll(argv[++i]);
+            int64_t end_ms = std::stoll(argv[++i]);
+            config.range_ms = std::make_pair(begin_ms, end_ms);
+        } else if (arg == "--block-size" && i + 1 < argc) {
+            config.options.block_size = std::stoul(argv[++i]);
+        } else if (arg == "--zstd") {
+            config.options.use_zstd = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                config.options.zstd_level = std::stoi(argv[++i]);
+            }
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (config.range_ms && !config.arrow_output) throw std::runtime_error("--range is only supported for Arrow output.");
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        ConvertConfig config = parse_arguments(argc, argv);
+        if (fs::exists(config.output_path) && fs::equivalent(config.input_path, config.output_path)) {
+            throw std::runtime_error("Input and output must be different files.");
+        }
+
+        std::unique_ptr<EventSource> source = open_event_source(config.input_path);
+        std::cout << "--- Converting " << source->num_events() << " events to " << config.output_path << " ---" << std::endl;
+
+        auto start = std::chrono::steady_clock::now();
+        if (config.arrow_output) {
+            if (config.range_ms && source->num_events() > 0) {
+                const EventStore first = source->read_events(0, 1, EVENT_COLUMN_T);
+                config.arrow_options.t_begin = first.t[0] + config.range_ms->first * 1000;
+                config.arrow_options.t_end = first.t[0] + config.range_ms->second * 1000;
+            }
+            write_arrow_file(*source, config.output_path, config.arrow_options);
+        } else {
+            write_event_file(*source, config.output_path, config.options);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uintmax_t input_bytes = fs::file_size(config.input_path);
+        uintmax_t output_bytes = fs::file_size(config.output_path);
+        std::cout << "--- Done in " << seconds << " s: " << input_bytes / (1024 * 1024) << " MB -> "
+                  << output_bytes / (1024 * 1024) << " MB ("
+                  << static_cast<double>(output_bytes) / std::max<size_t>(1, source->num_events()) << " B/event) ---" << std::endl;
+    } catch (const H5::Exception& err) {
+        std::cerr << "A fatal HDF5 error occurred." << std::endl;
+        err.printErrorStack();
+        return -1;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+// イベントファイルを実時間で再生し、ライブ入力のパケットとして送信するツール (実機の代わりのプロデューサー)
+// 使い方: live_replay <input (.h5 / .evb / .raw / .aedat4 / .npy / .npz / .txt / .arrow / .feather)> <udp://host:port | tcp://host:port | unix:///path>
+//                     [--speed S] [--loop] [--packet-events N] [--resolution WxH]
+#include "event_source.h"
+#include "live_event_source.h"
+#include <H5Cpp.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// 1パケットに入れるイベントの時間幅の上限 (イベントレートが低いときの遅延を抑える)
+constexpr int64_t PACKET_SPAN_US = 1000;
+
+struct ReplayConfig {
+    std::string input_path;
+    std::string address;
+    double speed = 1.0;
+    bool loop = false;
+    size_t packet_events = 4096;
+    std::optional<Resolution> resolution;
+};
+
+ReplayConfig parse_arguments(int argc, char* argv[]) {
+    if (argc < 3) {
+        throw std::runtime_error("Usage: " + std::string(argv[0]) +
+                                 " <input (.h5/.evb/.raw/.aedat4/.npy/.npz/.txt/.arrow/.feather)> <udp://host:port|tcp://host:port|unix:///path> [--speed S] [--loop] [--packet-events N] [--resolution WxH]");
+    }
+    ReplayConfig config;
+    config.input_path = argv[1];
+    config.address = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--speed" && i + 1 < argc) {
+            config.speed = std::stod(argv[++i]);
+        } else if (arg == "--loop") {
+            config.loop = true;
+        } else if (arg == "--packet-events" && i + 1 < argc) {
+            config.packet_events = std::clamp<size_t>(std::stoul(argv[++i]), 1, LIVE_MAX_PACKET_EVENTS);
+        } else if (arg == "--resolution" && i + 1 < argc) {
+            std::string value = argv[++i];
+            size_t x = value.find('x');
+            if (x == std::string::npos) throw std::runtime_error("Invalid resolution: " + value);
+            config.resolution = Resolution{std::stoi(value.substr(0, x)), std::stoi(value.substr(x + 1))};
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (config.speed <= 0.0) throw std::runtime_error("--speed must be positive.");
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        ReplayConfig config = parse_arguments(argc, argv);
+        std::unique_ptr<EventSource> source = open_event_source(config.input_path);
+        if (source->num_events() == 0) throw std::runtime_error("No events found in the event file.");
+
+        // 解像度はファイルに記録されていればそれを使い、無ければ DSEC (640x480) とみなす
+        Resolution resolution = config.resolution ? *config.resolution : source->resolution().value_or(Resolution{640, 480});
+        LiveEventSender sender(LiveEndpoint::parse(config.address));
+        std::cout << "--- Replaying " << source->num_events() << " events to " << config.address << " at "
+                  << config.speed << "x (" << resolution.width << "x" << resolution.height << ") ---" << std::endl;
+
+        do {
+            auto start = std::chrono::steady_clock::now();
+            int64_t t_start = 0;
+            bool first = true;
+            size_t packets = 0;
+            EventChunkIterator chunks = source->chunks();
+            EventStore chunk;
+            while (chunks.next(chunk)) {
+                const EventStore& events = chunk;
+                if (first) {
+                    t_start = events.t[0];
+                    first = false;
+                }
+                for (size_t begin = 0; begin < events.size();) {
+                    // packet_events 個、または PACKET_SPAN_US の範囲までを1パケットにする
+                    size_t end = std::min(events.size(), begin + config.packet_events);
+                    end = std::upper_bound(events.t.begin() + begin, events.t.begin() + end, events.t[begin] + PACKET_SPAN_US - 1) - events.t.begin();
+
+                    // パケットの最後のイベントの時刻まで待ってから送る (実機と同じ遅れ方になる)
+                    auto due = start + std::chrono::microseconds(static_cast<int64_t>((events.t[end - 1] - t_start) / config.speed));
+                    std::this_thread::sleep_until(due);
+                    sender.send(events, begin, end - begin, resolution);
+                    ++packets;
+                    begin = end;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "--- Sent " << packets << " packets in " << seconds << " s ---" << std::endl;
+        } while (config.loop);
+    } catch (const H5::Exception& err) {
+        std::cerr << "A fatal HDF5 error occurred." << std::endl;
+        err.printErrorStack();
+        return -1;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
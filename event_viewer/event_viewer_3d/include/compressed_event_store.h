@@ -0,0 +1,58 @@
+#pragma once
+#include "event_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 長時間の記録をメモリに常駐させるための圧縮表現 (約5バイト/イベント)
+// - x/y/p は1イベント32bitに詰める (x: 15bit, y: 15bit, p: 1bit)
+// - t は BLOCK_SIZE 個ごとのブロックに分け、先頭の時刻とブロック内で固定幅 (1/2/4/8バイト) の差分で表す
+// ブロックごとのオフセット表を持つので、任意の区間をそのブロックだけ展開して取り出せる
+class CompressedEventStore {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+    static constexpr uint16_t MAX_COORDINATE = (1u << 15) - 1;
+
+    CompressedEventStore() = default;
+
+    // 全列がそろっていて、座標が15bitに収まり、極性が0/1であれば圧縮できる
+    static bool can_encode(const EventStore& events);
+    // ブロック単位で並列に圧縮する。can_encode() が false の場合は std::invalid_argument を投げる
+    static CompressedEventStore encode(const EventStore& events);
+
+    // 全体を展開した列を持たずにチャンクごとに圧縮するための追加 (events は時刻順に続くもの)
+    // それまでの要素数が BLOCK_SIZE の倍数でなければ std::logic_error、can_encode() が false なら std::invalid_argument を投げる
+    void append(const EventStore& events);
+    // append() で追加する予定のイベント数の分だけ領域を確保しておく
+    void reserve(size_t num_events);
+
+    size_t size() const { return m_num_events; }
+    bool empty() const { return m_num_events == 0; }
+    // 圧縮後のメモリ使用量 (バイト)
+    size_t memory_bytes() const;
+
+    int64_t front_t() const { return m_blocks.empty() ? 0 : m_blocks.front().t_first; }
+    int64_t back_t() const { return m_back_t; }
+
+    // [begin, begin + count) を展開して返す (範囲が大きければブロック単位で並列に展開する)
+    EventStore decode(size_t begin, size_t count) const;
+    // t 以上となる最初のイベントのインデックスを返す (存在しなければ size())
+    size_t find_event_index(int64_t t) const;
+
+private:
+    struct Block {
+        int64_t t_first;        // ブロック先頭のイベントの時刻
+        uint64_t delta_offset;  // m_deltas 内での差分列の開始位置 (バイト)
+        uint8_t delta_bytes;    // 差分1つあたりのバイト数 (8 のときは符号付き)
+    };
+
+    // ブロック block の [first, first + count) を各列の dst から書き込む
+    void decode_block(size_t block, size_t first, size_t count,
+                      uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const;
+
+    size_t m_num_events = 0;
+    int64_t m_back_t = 0;
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_xyp;
+    std::vector<uint8_t> m_deltas;
+};
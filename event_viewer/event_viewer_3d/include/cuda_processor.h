@@ -1,10 +1,15 @@
 #pragma once
 #include "types.h"
+#include "event_store.h"
 #include <vector>
 #include <GL/glew.h>
 
-void init_cuda_for_gl();
-void register_gl_buffer(GLuint vbo);
-void unregister_gl_buffer();
+// CUDA による頂点の生成 (EV_HAVE_CUDA でビルドした場合のみ。vertex_processor から呼ばれる)
 
-unsigned int process_all_events(const std::vector<EventCD>& all_events, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors);
\ No newline at end of file
+// CUDA デバイスを初期化する。使えるデバイスが無ければ false
+bool init_cuda_for_gl();
+void cuda_register_gl_buffer(GLuint vbo);
+void cuda_unregister_gl_buffer();
+
+// all_events を頂点に変換し、VBOの vertex_offset 番目以降にイベントと同じ順で書き込む。書き込んだ頂点数を返す
+unsigned int cuda_process_all_events(const EventStore& all_events, size_t vertex_offset, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors);
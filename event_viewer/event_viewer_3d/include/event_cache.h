@@ -0,0 +1,53 @@
+#pragma once
+#include "types.h"
+#include "event_store.h"
+#include "time_index.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// キャッシュの設定 (data.yaml の cache セクション)
+struct EventCacheConfig {
+    bool enabled = true;
+    fs::path directory;                              // 空なら default_directory() を使う
+    uint64_t max_size_bytes = uint64_t(20) << 30;    // 合計サイズの上限 (0 なら無制限)
+    std::string source_variant;                      // 読み込み結果を変える設定 (HDF5 のスキーマなど)。キーに含める
+};
+
+// キャッシュに保存される1つの記録
+struct CachedRecording {
+    EventStore events;
+    ColumnBuffer<uint64_t> ms_to_idx; // DSEC形式の時間インデックス
+    int64_t index_base_ms = 0;
+    TimeIndex time_index;             // 全イベントの時刻 → 位置の索引 (絶対時刻)
+    int64_t t_offset = 0;
+    Resolution resolution;
+};
+
+// 変換済みイベントのネイティブキャッシュ
+// ページ境界に揃えた列ブロック・時間インデックス・メタデータを1ファイルにまとめ、2回目以降は mmap で開く
+// キャッシュは元ファイルのパス・サイズ・更新時刻をキーにしており、元ファイルが変われば自動的に作り直される
+class EventCache {
+public:
+    explicit EventCache(EventCacheConfig config);
+
+    bool enabled() const { return m_config.enabled; }
+
+    // source_path に対応する有効なキャッシュがあれば mmap して返す
+    std::optional<CachedRecording> open(const fs::path& source_path) const;
+
+    // recording をキャッシュに書き込み、上限を超えた分を最後に使われた時刻が古い順に削除する
+    void store(const fs::path& source_path, const CachedRecording& recording) const;
+
+    // $XDG_CACHE_HOME/event_viewer (未設定なら ~/.cache/event_viewer)
+    static fs::path default_directory();
+
+private:
+    fs::path cache_path_for(const fs::path& source_path) const;
+    void evict(const fs::path& keep) const;
+
+    EventCacheConfig m_config;
+};
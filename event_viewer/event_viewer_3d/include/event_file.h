@@ -0,0 +1,63 @@
+#pragma once
+#include "event_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// ネイティブのイベントファイル (.evb) の書き込み設定
+struct EventFileWriteOptions {
+    size_t block_size = size_t(1) << 16; // 1ブロックあたりのイベント数
+    bool use_zstd = false;               // EV_HAVE_ZSTD でビルドした場合のみ有効
+    int zstd_level = 3;
+};
+
+// source の全イベントを .evb 形式で path に書き込む (可逆)
+// ファイル構成: ヘッダ | ブロック... | シークテーブル
+// 各ブロックは時刻順の block_size 個のイベントを持ち、t は前のイベントとの差分 (zigzag)、
+// x/y/p/t の各列はブロックごとに必要最小限のビット幅で詰める。必要なら zstd で更に圧縮する
+// ブロックは独立しているため、圧縮も展開もブロック単位で並列に行う
+void write_event_file(EventSource& source, const std::string& path, const EventFileWriteOptions& options = {});
+
+// .evb 形式のファイルを mmap して読み込む
+class EventFileReader : public EventSource {
+public:
+    static constexpr const char* EXTENSION = ".evb";
+
+    explicit EventFileReader(const std::string& filepath);
+    ~EventFileReader() override;
+
+    int64_t load_t_offset() override { return m_t_offset; }
+    size_t num_events() override { return m_num_events; }
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    // シークテーブル (各ブロックの先頭時刻) を二分探索し、1ブロックの t だけを展開する
+    size_t find_event_index(int64_t t) override;
+    std::optional<Resolution> resolution() override;
+
+    // シークテーブルの1要素
+    struct BlockEntry {
+        uint64_t offset;       // ファイル先頭からの位置
+        uint64_t stored_bytes; // ファイル上のバイト数
+        uint64_t raw_bytes;    // zstd 展開後のバイト数 (codec が無圧縮なら stored_bytes と同じ)
+        int64_t t_first;
+        int64_t t_last;
+        uint32_t num_events;
+        uint32_t codec;
+    };
+
+private:
+    // ブロック block の全イベントを、columns で指定した列の dst に展開する
+    void decode_block(size_t block, unsigned columns, uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const;
+
+    std::string m_filepath;
+    std::shared_ptr<MappedFile> m_file;
+    size_t m_num_events = 0;
+    size_t m_block_size = 0;
+    int64_t m_t_offset = 0;
+    Resolution m_resolution;
+    std::vector<BlockEntry> m_blocks;
+};
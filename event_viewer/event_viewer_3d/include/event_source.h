@@ -0,0 +1,98 @@
+#pragma once
+#include "types.h"
+#include "event_store.h"
+#include "hdf5_schema.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class EventChunkIterator;
+
+// イベントファイルの読み込みインターフェース
+// ファイル形式 (HDF5, ネイティブのイベントファイルなど) ごとの実装を、ビューアと変換ツールが同じ方法で扱えるようにする
+// 時刻はすべて t_offset を含まない µs で指定する
+class EventSource {
+public:
+    // ストリーミング読み込み時に1回で読むイベント数のデフォルト値 (約1Mイベント)
+    static constexpr size_t DEFAULT_CHUNK_SIZE = size_t(1) << 20;
+
+    virtual ~EventSource() = default;
+
+    virtual int64_t load_t_offset() = 0;
+    virtual size_t num_events() = 0;
+    // [begin, begin + count) のイベントを各列に読み込む
+    // stride > 1 のときは stride 個おきに読み込む (ダウンサンプリング用)
+    virtual EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) = 0;
+
+    virtual EventStore load_all_events(unsigned columns = EVENT_COLUMNS_ALL);
+    // t 以上となる最初のイベントのインデックスを返す (存在しなければ num_events())
+    // デフォルトでは ms_to_idx でミリ秒単位のバケットを O(1) で引き、バケット内だけを探索する
+    virtual size_t find_event_index(int64_t t);
+    // [t_begin, t_end) のイベントを読み込む
+    EventStore read_range(int64_t t_begin, int64_t t_end, unsigned columns = EVENT_COLUMNS_ALL);
+    // [t_begin, t_end) を chunk_size 個ずつ読み込むイテレータを返す
+    EventChunkIterator chunks(size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                              int64_t t_begin = std::numeric_limits<int64_t>::min(),
+                              int64_t t_end = std::numeric_limits<int64_t>::max(),
+                              unsigned columns = EVENT_COLUMNS_ALL);
+
+    // DSEC形式の時間インデックス: ms_to_idx()[ms] は t >= (time_index_base_ms() + ms) * 1000 となる最初のイベント
+    const std::vector<uint64_t>& ms_to_idx();
+    int64_t time_index_base_ms();
+
+    // ファイルに記録されているセンサー解像度 (無ければ呼び出し側でデータから求める)
+    virtual std::optional<Resolution> resolution() { return std::nullopt; }
+    // 指定した列がすべてファイルの mmap で直接参照できる (読み込みが不要な) 場合に true
+    virtual bool is_memory_mapped(unsigned /*columns*/ = EVENT_COLUMNS_ALL) { return false; }
+    // 読み込みが遅く、ネイティブキャッシュ (EventCache) に変換して持つ価値がある形式なら true
+    virtual bool benefits_from_cache() const { return false; }
+
+protected:
+    // 異常なタイムスタンプで巨大なインデックスを作らないための上限 (約24日分)
+    static constexpr uint64_t MAX_TIME_INDEX_ENTRIES = uint64_t(1) << 31;
+
+    // m_ms_to_idx / m_index_base_ms を用意する。デフォルトでは t 列を1パスで走査して構築する
+    virtual void load_time_index();
+    void build_time_index();
+
+    std::vector<uint64_t> m_ms_to_idx;
+    int64_t m_index_base_ms = 0;
+    bool m_time_index_ready = false;
+};
+
+// 拡張子からファイル形式を判定して EventSource を開く
+// 対応形式: .h5 / .hdf5 (DSEC形式), .evb (ネイティブのイベントファイル), .raw (Prophesee EVT 2.0 / 3.0),
+//           .aedat4 (iniVation AEDAT 4.0), .npy / .npz (NumPy),
+//           .txt (1行1イベント "t x y p" のテキスト)
+// HDF5 のイベントの配置は hdf5_schema で指定する (既定では DSEC形式と Metavision の /CD/events を判定する)
+std::unique_ptr<EventSource> open_event_source(const std::string& filepath, const HDF5Schema& hdf5_schema = {});
+// 列名 (x, y, p / pol / polarity, t / ts / timestamp など。大文字小文字は区別しない) から EventColumn を求める
+// 対象外の名前なら 0 (列ごとに名前の付いた形式 (NumPy, Arrow) で使う)
+unsigned event_column_from_name(const std::string& name);
+// イベントファイルに埋め込まれた画像フレーム (AEDAT4 の APS フレーム、.npz の frames など) を読み込む (無い形式なら空)
+std::vector<RGBFrame> load_embedded_frames(const std::string& filepath);
+
+// EventSource::chunks() が返すチャンク単位の読み込みイテレータ
+// 1チャンク分のバッファしか保持しないため、ファイル長に関係なくピークメモリが一定になる
+class EventChunkIterator {
+public:
+    EventChunkIterator(EventSource& source, size_t begin, size_t end, size_t chunk_size, unsigned columns);
+
+    // 次のチャンクを chunk に読み込む。読み終わっていれば false を返す
+    bool next(EventStore& chunk);
+
+    // 次に読むチャンクの先頭インデックス (ファイル全体での通し番号)
+    size_t position() const { return m_pos; }
+    size_t end() const { return m_end; }
+
+private:
+    EventSource& m_source;
+    size_t m_pos;
+    size_t m_end;
+    size_t m_chunk_size;
+    unsigned m_columns;
+};
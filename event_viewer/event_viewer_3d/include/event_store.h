@@ -0,0 +1,182 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// 読み込む列を指定するビットフラグ (列射影)
+// 例: レート統計のように t しか使わない処理は EVENT_COLUMN_T だけを読めば x/y/p に触れずに済む
+enum EventColumn : unsigned {
+    EVENT_COLUMN_X = 1u << 0,
+    EVENT_COLUMN_Y = 1u << 1,
+    EVENT_COLUMN_P = 1u << 2,
+    EVENT_COLUMN_T = 1u << 3,
+    EVENT_COLUMNS_ALL = EVENT_COLUMN_X | EVENT_COLUMN_Y | EVENT_COLUMN_P | EVENT_COLUMN_T,
+};
+
+// 1列分のデータ
+// 自前のメモリ (std::vector) を持つか、mmap したファイルなど外部メモリへの読み取り専用ビューになる
+// ビューに書き込もうとした場合は、その時点で自前のメモリへコピーする (コピーオンライト)
+template <typename T>
+class ColumnBuffer {
+public:
+    using value_type = T;
+
+    ColumnBuffer() = default;
+    ColumnBuffer(const ColumnBuffer& other) { *this = other; }
+    ColumnBuffer(ColumnBuffer&& other) noexcept { *this = std::move(other); }
+
+    ColumnBuffer& operator=(const ColumnBuffer& other) {
+        if (this == &other) return *this;
+        m_owned = other.m_owned;
+        m_keepalive = other.m_keepalive;
+        m_size = other.m_size;
+        m_view = other.m_view;
+        m_data = m_view ? other.m_data : m_owned.data();
+        return *this;
+    }
+    ColumnBuffer& operator=(ColumnBuffer&& other) noexcept {
+        if (this == &other) return *this;
+        m_owned = std::move(other.m_owned);
+        m_keepalive = std::move(other.m_keepalive);
+        m_size = other.m_size;
+        m_view = other.m_view;
+        m_data = m_view ? other.m_data : m_owned.data();
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_view = false;
+        return *this;
+    }
+    ColumnBuffer& operator=(std::vector<T> values) {
+        m_keepalive.reset();
+        m_owned = std::move(values);
+        m_view = false;
+        m_data = m_owned.data();
+        m_size = m_owned.size();
+        return *this;
+    }
+
+    // keepalive が生きている間有効な外部メモリ [data, data + size) を参照する
+    void assign_view(const T* data, size_t size, std::shared_ptr<const void> keepalive) {
+        m_owned.clear();
+        m_owned.shrink_to_fit();
+        m_keepalive = std::move(keepalive);
+        m_data = const_cast<T*>(data);
+        m_size = size;
+        m_view = true;
+    }
+    bool is_view() const { return m_view; }
+
+    // [begin, begin + count) を参照するビューを返す (コピーしない)
+    // 自前のメモリを持つ列のビューは、元の ColumnBuffer が生きている間だけ有効
+    ColumnBuffer view(size_t begin, size_t count) const {
+        ColumnBuffer result;
+        result.assign_view(m_data + begin, count, m_keepalive);
+        return result;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const T* data() const { return m_data; }
+    T* data() { make_owned(); return m_data; }
+
+    const T& operator[](size_t i) const { return m_data[i]; }
+    T& operator[](size_t i) { make_owned(); return m_data[i]; }
+
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+    T* begin() { make_owned(); return m_data; }
+    T* end() { make_owned(); return m_data + m_size; }
+    const T& front() const { return m_data[0]; }
+    const T& back() const { return m_data[m_size - 1]; }
+
+    void resize(size_t n) {
+        make_owned();
+        m_owned.resize(n);
+        m_data = m_owned.data();
+        m_size = n;
+    }
+    void reserve(size_t n) {
+        make_owned();
+        m_owned.reserve(n);
+        m_data = m_owned.data();
+    }
+    void push_back(const T& value) {
+        make_owned();
+        m_owned.push_back(value);
+        m_data = m_owned.data();
+        m_size = m_owned.size();
+    }
+    void clear() {
+        m_owned.clear();
+        m_keepalive.reset();
+        m_data = m_owned.data();
+        m_size = 0;
+        m_view = false;
+    }
+
+private:
+    void make_owned() {
+        if (!m_view) return;
+        m_owned.assign(m_data, m_data + m_size);
+        m_keepalive.reset();
+        m_data = m_owned.data();
+        m_view = false;
+    }
+
+    std::vector<T> m_owned;
+    std::shared_ptr<const void> m_keepalive;
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_view = false;
+};
+
+// イベントデータを列ごとに保持する (Struct of Arrays)
+// HDF5の各データセットを直接読み込めるため、構造体への詰め替えやパディングが発生しない
+struct EventStore {
+    ColumnBuffer<uint16_t> x;
+    ColumnBuffer<uint16_t> y;
+    ColumnBuffer<uint8_t>  p;
+    ColumnBuffer<int64_t>  t; // µs (t_offset を含まない)。uint32 の範囲を超える長時間記録にも対応
+
+    // 読み込まれている列 (EventColumn の論理和)
+    unsigned columns = EVENT_COLUMNS_ALL;
+
+    bool has(EventColumn column) const { return (columns & column) != 0; }
+
+    size_t size() const {
+        if (has(EVENT_COLUMN_T)) return t.size();
+        if (has(EVENT_COLUMN_X)) return x.size();
+        if (has(EVENT_COLUMN_Y)) return y.size();
+        if (has(EVENT_COLUMN_P)) return p.size();
+        return 0;
+    }
+    bool empty() const { return size() == 0; }
+
+    // 読み込まれている列だけを n 要素に揃える
+    void resize(size_t n) {
+        if (has(EVENT_COLUMN_X)) x.resize(n);
+        if (has(EVENT_COLUMN_Y)) y.resize(n);
+        if (has(EVENT_COLUMN_P)) p.resize(n);
+        if (has(EVENT_COLUMN_T)) t.resize(n);
+    }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        p.clear();
+        t.clear();
+    }
+
+    // [begin, begin + count) の各列をビューとして返す (寿命は ColumnBuffer::view と同じ)
+    EventStore slice(size_t begin, size_t count) const {
+        EventStore result;
+        result.columns = columns;
+        if (has(EVENT_COLUMN_X)) result.x = x.view(begin, count);
+        if (has(EVENT_COLUMN_Y)) result.y = y.view(begin, count);
+        if (has(EVENT_COLUMN_P)) result.p = p.view(begin, count);
+        if (has(EVENT_COLUMN_T)) result.t = t.view(begin, count);
+        return result;
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// flatbuffer の最小限の読み書き (AEDAT4 のパケット、Arrow IPC のメタデータ)
+// スキーマコンパイラ (flatc) は使わず、スキーマのフィールド番号で値を読み書きする
+
+template <typename T>
+inline T flat_read(const uint8_t* src) {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+// テーブルを読む
+class FlatTable {
+public:
+    // buf の先頭のルートテーブル
+    FlatTable(const uint8_t* buf, size_t size) : m_buf(buf), m_size(size) {
+        check(0, 4);
+        init(flat_read<uint32_t>(buf));
+    }
+    // identifier (4文字) 付きのルートテーブル。サイズ前置きの有無はどちらも受け付ける
+    FlatTable(const uint8_t* buf, size_t size, const char* identifier) {
+        if (size >= 12 && std::memcmp(buf + 8, identifier, 4) == 0) {
+            buf += 4; // FinishSizePrefixed で書かれたバッファ
+            size -= 4;
+        } else if (size < 8 || std::memcmp(buf + 4, identifier, 4) != 0) {
+            throw std::runtime_error(std::string("Unexpected flatbuffer type (expected ") + identifier + ")");
+        }
+        m_buf = buf;
+        m_size = size;
+        init(flat_read<uint32_t>(buf));
+    }
+
+    template <typename T>
+    T scalar(int field, T default_value) const {
+        size_t pos = field_pos(field, sizeof(T));
+        return pos ? flat_read<T>(m_buf + pos) : default_value;
+    }
+    // ベクタのフィールド: 要素の先頭を返し、要素数を length に入れる (無ければ nullptr)
+    const uint8_t* vector(int field, size_t element_bytes, size_t& length) const {
+        length = 0;
+        size_t pos = field_pos(field, 4);
+        if (!pos) return nullptr;
+        size_t vec = pos + flat_read<uint32_t>(m_buf + pos);
+        check(vec, 4);
+        length = flat_read<uint32_t>(m_buf + vec);
+        check(vec + 4, length * element_bytes);
+        return m_buf + vec + 4;
+    }
+    std::string string(int field) const {
+        size_t length = 0;
+        const uint8_t* data = vector(field, 1, length);
+        return data ? std::string(reinterpret_cast<const char*>(data), length) : std::string();
+    }
+    // 子テーブル (共用体の値も同じ) のフィールド
+    std::optional<FlatTable> table(int field) const {
+        size_t pos = field_pos(field, 4);
+        if (!pos) return std::nullopt;
+        return FlatTable(m_buf, m_size, pos + flat_read<uint32_t>(m_buf + pos));
+    }
+    // テーブルのベクタのフィールド
+    std::vector<FlatTable> tables(int field) const {
+        size_t length = 0;
+        const uint8_t* elements = vector(field, 4, length);
+        std::vector<FlatTable> result;
+        for (size_t i = 0; i < length; ++i) {
+            size_t pos = static_cast<size_t>(elements - m_buf) + 4 * i;
+            result.push_back(FlatTable(m_buf, m_size, pos + flat_read<uint32_t>(m_buf + pos)));
+        }
+        return result;
+    }
+
+private:
+    FlatTable(const uint8_t* buf, size_t size, size_t table) : m_buf(buf), m_size(size) { init(table); }
+
+    void init(size_t table) {
+        check(table, 4);
+        m_table = table;
+        size_t vtable = table - static_cast<size_t>(static_cast<int64_t>(flat_read<int32_t>(m_buf + table)));
+        check(vtable, 4);
+        m_vtable = vtable;
+        m_vtable_bytes = flat_read<uint16_t>(m_buf + vtable);
+        check(vtable, m_vtable_bytes);
+    }
+    size_t field_pos(int field, size_t bytes) const {
+        size_t entry = 4 + 2 * static_cast<size_t>(field);
+        if (entry + 2 > m_vtable_bytes) return 0;
+        uint16_t offset = flat_read<uint16_t>(m_buf + m_vtable + entry);
+        if (offset == 0) return 0;
+        check(m_table + offset, bytes);
+        return m_table + offset;
+    }
+    void check(size_t pos, size_t bytes) const {
+        if (pos > m_size || bytes > m_size - pos) throw std::runtime_error("Corrupt flatbuffer");
+    }
+
+    const uint8_t* m_buf = nullptr;
+    size_t m_size = 0;
+    size_t m_table = 0;
+    size_t m_vtable = 0;
+    uint16_t m_vtable_bytes = 0;
+};
+
+// バッファを先頭から順に書く (親を先に書き、子へのオフセットは子を書いた後に patch() で埋める)
+// flatbuffer のオフセットは前方 (後ろの位置) を指せばよいので、flatc の生成コードのように逆順に組み立てる必要はない
+class FlatBuilder {
+public:
+    // テーブルの1フィールド: スカラー、または子 (テーブル・ベクタ・文字列) へのオフセット
+    struct Field {
+        int id;
+        size_t size;
+        uint64_t bits;
+        bool is_offset;
+
+        template <typename T>
+        static Field scalar(int id, T value) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            return {id, sizeof(T), bits, false};
+        }
+        static Field offset(int id) { return {id, 4, 0, true}; }
+    };
+
+    FlatBuilder() : m_buf(4, 0) {} // 先頭はルートテーブルへのオフセット
+
+    const std::vector<uint8_t>& data() const { return m_buf; }
+
+    // vtable とテーブルを書き、fields の順に各フィールドの位置を返す
+    // 返り値の [0] はテーブル自身の位置 (fields の位置は [1] から)
+    std::vector<size_t> table(const std::vector<Field>& fields) {
+        int max_id = -1;
+        for (const Field& f : fields) max_id = std::max(max_id, f.id);
+        // 大きいフィールドから並べて、それぞれの大きさの境界に揃える
+        std::vector<size_t> order(fields.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fields[a].size > fields[b].size; });
+        std::vector<size_t> field_offset(fields.size());
+        size_t table_bytes = 4;
+        for (size_t i : order) {
+            table_bytes = align(table_bytes, fields[i].size);
+            field_offset[i] = table_bytes;
+            table_bytes += fields[i].size;
+        }
+        table_bytes = align(table_bytes, 4);
+
+        size_t vtable_bytes = 4 + 2 * static_cast<size_t>(max_id + 1);
+        size_t vtable = align(m_buf.size(), 2);
+        size_t table = align(vtable + vtable_bytes, 8);
+        m_buf.resize(table + table_bytes, 0);
+        put<uint16_t>(vtable, static_cast<uint16_t>(vtable_bytes));
+        put<uint16_t>(vtable + 2, static_cast<uint16_t>(table_bytes));
+        put<int32_t>(table, static_cast<int32_t>(table - vtable));
+
+        std::vector<size_t> positions{table};
+        for (size_t i = 0; i < fields.size(); ++i) {
+            put<uint16_t>(vtable + 4 + 2 * fields[i].id, static_cast<uint16_t>(field_offset[i]));
+            std::memcpy(m_buf.data() + table + field_offset[i], &fields[i].bits, fields[i].size);
+            positions.push_back(table + field_offset[i]);
+        }
+        return positions;
+    }
+
+    // 構造体のベクタ (要素を詰めたバイト列)。要素を align バイト境界に揃え、長さの位置を返す
+    size_t struct_vector(const void* elements, size_t count, size_t element_bytes, size_t alignment = 8) {
+        size_t vec = align(m_buf.size() + 4, alignment) - 4;
+        m_buf.resize(vec + 4 + count * element_bytes, 0);
+        put<uint32_t>(vec, static_cast<uint32_t>(count));
+        if (count) std::memcpy(m_buf.data() + vec + 4, elements, count * element_bytes);
+        return vec;
+    }
+    // オフセットのベクタ。長さの位置を返し、各要素の位置を slots に入れる (patch() で埋める)
+    size_t offset_vector(size_t count, std::vector<size_t>& slots) {
+        size_t vec = align(m_buf.size(), 4);
+        m_buf.resize(vec + 4 + 4 * count, 0);
+        put<uint32_t>(vec, static_cast<uint32_t>(count));
+        slots.clear();
+        for (size_t i = 0; i < count; ++i) slots.push_back(vec + 4 + 4 * i);
+        return vec;
+    }
+    size_t string(const std::string& s) {
+        size_t str = align(m_buf.size(), 4);
+        m_buf.resize(str + 4 + s.size() + 1, 0);
+        put<uint32_t>(str, static_cast<uint32_t>(s.size()));
+        std::memcpy(m_buf.data() + str + 4, s.data(), s.size());
+        return str;
+    }
+
+    // slot (オフセットのフィールド・ベクタの要素) に target への相対位置を書く
+    void patch(size_t slot, size_t target) { put<uint32_t>(slot, static_cast<uint32_t>(target - slot)); }
+    void set_root(size_t table) { patch(0, table); }
+
+private:
+    static size_t align(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+    template <typename T>
+    void put(size_t pos, T value) { std::memcpy(m_buf.data() + pos, &value, sizeof(T)); }
+
+    std::vector<uint8_t> m_buf;
+};
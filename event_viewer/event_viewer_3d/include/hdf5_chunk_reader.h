@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <H5Cpp.h>
+
+// チャンク化された1次元データセットを HDF5 のフィルタパイプラインを通さずに読み込む
+// H5Dread_chunk で圧縮されたままのチャンクを取得し、展開と型変換をスレッドプール上で並列に行う
+// (HDF5 は内部のグローバルロックでチャンクを1つずつ展開するため、通常の読み込みは1コアしか使えない)
+class HDF5ChunkReader {
+public:
+    explicit HDF5ChunkReader(const H5::DataSet& dset);
+
+    // 既知のフィルタ (deflate, shuffle, blosc) と整数型のみで構成されていれば true
+    bool supported() const { return m_supported; }
+
+    // [begin, begin + count) を dst に読み込む
+    // 非対応のデータセットや未割り当てチャンクを含む場合は false を返すので、呼び出し側で通常の読み込みを行う
+    template <typename T>
+    bool read(T* dst, size_t begin, size_t count) const;
+
+private:
+    struct Filter {
+        H5Z_filter_t id;
+        std::vector<unsigned int> cd_values;
+    };
+
+    H5::DataSet m_dset;
+    bool m_supported = false;
+    size_t m_chunk_size = 0;   // 1チャンクあたりの要素数
+    size_t m_num_elements = 0;
+    size_t m_elem_size = 0;    // ファイル上の要素のバイト数
+    bool m_is_signed = false;
+    std::vector<Filter> m_filters;
+};
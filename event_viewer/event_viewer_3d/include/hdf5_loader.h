@@ -1,16 +1,68 @@
 #pragma once
 #include "types.h"
+#include "event_store.h"
+#include "event_source.h"
+#include "hdf5_chunk_reader.h"
+#include "hdf5_schema.h"
+#include <optional>
 #include <string>
 #include <vector>
+#include <memory>
 #include <H5Cpp.h>
 
-class HDF5Loader {
+class MappedFile;
+
+// HDF5ファイルのイベントを読み込む
+// 既定では DSEC形式 (/events/{x,y,p,t}, /t_offset, /ms_to_idx) と Metavision の /CD/events (compound) を判定し、
+// それ以外の配置は HDF5Schema (data.yaml の hdf5_schema) で指定する
+class HDF5Loader : public EventSource {
 public:
-    HDF5Loader(const std::string& filepath);
-    ~HDF5Loader();
-    int64_t load_t_offset();
-    std::vector<EventCD> load_all_events();
+    explicit HDF5Loader(const std::string& filepath, const HDF5Schema& schema = {});
+    ~HDF5Loader() override;
+    int64_t load_t_offset() override;
+    // 整数の属性 width / height を、イベントのデータセット・それを含むグループ・ルートの順に探す
+    std::optional<Resolution> resolution() override;
+    EventStore load_all_events(unsigned columns = EVENT_COLUMNS_ALL) override;
+
+    // --- ストリーミング読み込みAPI ---
+    size_t num_events() override;
+    // [begin, begin + count) のイベントをハイパースラブで各列に直接読み込む
+    // 連続配置・非圧縮の列は mmap したファイルへのビューとして返すため、ページは実際に参照されたときに読み込まれる
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    // 指定した列がすべてファイルの mmap で直接参照できる (読み込みが不要な) 場合に true
+    bool is_memory_mapped(unsigned columns = EVENT_COLUMNS_ALL) override;
+    // HDF5 の展開は遅いため、2回目以降はネイティブキャッシュから開く
+    bool benefits_from_cache() const override { return true; }
+
+protected:
+    // ファイル内の /ms_to_idx を優先し、無ければサイドカーファイル (<file>.ms_to_idx) を読むか、1パスで構築して保存する
+    void load_time_index() override;
 
 private:
+    void open_event_datasets();
+    void open_compound_dataset();
+    // compound のデータセットからレコードをまとめて読み、要求された列に並列に展開する
+    void read_compound(size_t begin, size_t count, size_t stride, EventStore& events);
+    // t が µs の整数でなければ (浮動小数・別の単位) 変換しながら読み込む
+    void read_converted_time(ColumnBuffer<int64_t>& column, size_t begin, size_t count, size_t stride);
+    bool load_time_index_sidecar();
+    void save_time_index_sidecar() const;
+
+    std::string m_filepath;
     H5::H5File file;
-};
\ No newline at end of file
+    HDF5Schema m_schema;
+    H5::DataSet m_x_dset, m_y_dset, m_t_dset, m_p_dset;
+    // 圧縮チャンクを並列展開する高速経路 (非対応のデータセットでは通常の読み込みに戻る)
+    std::unique_ptr<HDF5ChunkReader> m_x_reader, m_y_reader, m_t_reader, m_p_reader;
+    // 連続配置・非圧縮のデータセットを直接 mmap したもの (対象外の列は nullptr)
+    std::shared_ptr<MappedFile> m_x_map, m_y_map, m_t_map, m_p_map;
+    // COMPOUND: ファイル上のレコードと同じ並びのメモリ上の型と、メンバごとに選んだ変換
+    H5::DataSet m_events_dset;
+    struct CompoundLayout;
+    std::unique_ptr<CompoundLayout> m_compound;
+    // COLUMNS: t が µs の整数でない場合に選んだ変換 (ファイル上の型と単位の組み合わせごとに特殊化したもの)
+    struct TimeConversion;
+    std::unique_ptr<TimeConversion> m_t_conversion;
+    bool m_datasets_open = false;
+    size_t m_num_events = 0;
+};
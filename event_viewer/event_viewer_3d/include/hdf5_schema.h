@@ -0,0 +1,64 @@
+#pragma once
+#include <optional>
+#include <string>
+
+// ファイル上の時刻の単位 (読み込み時に µs に換算する)
+enum class TimeUnit { SECONDS, MILLISECONDS, MICROSECONDS, NANOSECONDS };
+
+inline std::optional<TimeUnit> parse_time_unit(const std::string& name) {
+    if (name == "s") return TimeUnit::SECONDS;
+    if (name == "ms") return TimeUnit::MILLISECONDS;
+    if (name == "us") return TimeUnit::MICROSECONDS;
+    if (name == "ns") return TimeUnit::NANOSECONDS;
+    return std::nullopt;
+}
+
+// HDF5 ファイル内のイベントの配置 (data.yaml の hdf5_schema セクション)
+// データ型はファイルのものをそのまま使い、開いたときに型の組み合わせごとの読み込み経路を選ぶ
+struct HDF5Schema {
+    enum class Layout {
+        AUTO,     // /events/{x,y,p,t} (DSEC) または /CD/events (Metavision) を判定する
+        COLUMNS,  // 列ごとの1次元データセット
+        COMPOUND, // 構造体 (compound 型) の1次元データセット1つ
+    };
+
+    Layout layout = Layout::AUTO;
+    std::string events;               // COMPOUND: データセットのパス
+    std::string x, y, p, t;           // COLUMNS: データセットのパス / COMPOUND: メンバ名
+    TimeUnit time_unit = TimeUnit::MICROSECONDS;
+    std::string t_offset = "/t_offset";   // 無い、または空なら 0
+    std::string ms_to_idx = "/ms_to_idx"; // 無い、または空なら構築する
+
+    static HDF5Schema dsec() {
+        HDF5Schema schema;
+        schema.layout = Layout::COLUMNS;
+        schema.x = "/events/x";
+        schema.y = "/events/y";
+        schema.p = "/events/p";
+        schema.t = "/events/t";
+        return schema;
+    }
+
+    // Metavision SDK の HDF5 (/CD/events: {x: u16, y: u16, p: i16, t: i64 µs})
+    static HDF5Schema metavision() {
+        HDF5Schema schema;
+        schema.layout = Layout::COMPOUND;
+        schema.events = "/CD/events";
+        schema.x = "x";
+        schema.y = "y";
+        schema.p = "p";
+        schema.t = "t";
+        schema.t_offset = "";
+        schema.ms_to_idx = "";
+        return schema;
+    }
+
+    // 読み込み結果を左右する設定の識別子 (キャッシュのキーに使う。AUTO なら空)
+    std::string describe() const {
+        if (layout == Layout::AUTO) return "";
+        static const char* const UNITS[] = {"s", "ms", "us", "ns"};
+        return std::string(layout == Layout::COMPOUND ? "compound:" + events : "columns") + ";x=" + x + ";y=" + y +
+               ";p=" + p + ";t=" + t + ";unit=" + UNITS[static_cast<int>(time_unit)] + ";t_offset=" + t_offset +
+               ";ms_to_idx=" + ms_to_idx;
+    }
+};
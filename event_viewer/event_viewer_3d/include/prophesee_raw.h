@@ -0,0 +1,48 @@
+#pragma once
+#include "event_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+class MappedFile;
+
+// Prophesee (Metavision) のカメラが出力する RAW ファイル (.raw) を読み込む
+// 対応形式: EVT 2.0 (32bitワード) / EVT 3.0 (16bitワード)
+//
+// RAW はイベント番号から位置を引けないため、開いたときにファイル全体を展開してメモリに持つ。
+// 展開はファイルを区間に分け、各区間の先頭から時刻などの状態が確定する位置 (再同期点) を探して
+// 区間ごとに並列に行う。1パス目で各区間のイベント数と時刻の桁あふれ回数を数え、
+// 2パス目で出力の列へ直接書き込む (区間ごとの一時バッファを持たない)
+class PropheseeRawReader : public EventSource {
+public:
+    static constexpr const char* EXTENSION = ".raw";
+
+    enum class Format { EVT2, EVT3 };
+
+    explicit PropheseeRawReader(const std::string& filepath);
+    ~PropheseeRawReader() override;
+
+    // RAW の時刻はカメラ起動からの µs なので t_offset は持たない
+    int64_t load_t_offset() override { return 0; }
+    size_t num_events() override;
+    // 展開済みの列へのビューを返す (stride == 1 ならコピーしない)
+    EventStore read_events(size_t begin, size_t count, unsigned columns = EVENT_COLUMNS_ALL, size_t stride = 1) override;
+    std::optional<Resolution> resolution() override { return m_resolution; }
+    // 毎回ファイル全体の展開が必要なため、ネイティブキャッシュに変換して持つ
+    bool benefits_from_cache() const override { return true; }
+
+    Format format() const { return m_format; }
+
+private:
+    void parse_header(const MappedFile& file);
+    template <typename Decoder>
+    void decode(const MappedFile& file);
+
+    std::string m_filepath;
+    Format m_format = Format::EVT3;
+    std::optional<Resolution> m_resolution;
+    size_t m_data_offset = 0; // ヘッダ (% で始まる行) の後のバイナリデータの位置
+    std::shared_ptr<const EventStore> m_events;
+};
@@ -2,10 +2,15 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <functional>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#include "types.h" // EventCD, RGBFrame, Vertex, ColorConfig
+#include "types.h" // RGBFrame, Vertex, ColorConfig
+#include "event_store.h"
+#include "compressed_event_store.h"
+#include "time_index.h"
+#include "event_prefetcher.h"
 #include "camera.h"
 #include "shader.h"
 #include "viewer_state.h"
@@ -20,13 +25,23 @@ public:
     Renderer(const Renderer&) = delete;
     Renderer& operator=(const Renderer&) = delete;
 
-    void run(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    // time_index が空なら、頂点化と同時に作る
+    void run(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    void run(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    // ストリーミング再生: 再生位置周辺のイベントを先読みスレッドから受け取りながら描画する
+    void run(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const ColorConfig& colors);
 
 private:
+    // イベント [begin, begin + count) を取り出す (EventStore / CompressedEventStore の違いを吸収する)
+    using EventSliceReader = std::function<EventStore(size_t begin, size_t count)>;
+
     void init();
     void setupCallbacks();
-    // 👇 この行を修正
-    void loadData(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    void start(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    void loadData(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors);
+    void createPointBuffer(size_t capacity);
+    // 先読みスレッドとセグメントをやり取りし、新しいセグメントを空きスロットに書き込む (ストリーミング時のみ)
+    void streamEvents();
     void mainLoop();
     void renderScene();
     void cleanup();
@@ -41,6 +56,9 @@ private:
     ViewerState m_state;
     ColorConfig m_colors;
     double m_current_time_us = 0.0;
+    // 描画し直しが必要なとき (時刻以外: カメラ・表示設定・データの変化) に立てる
+    bool m_frame_dirty = true;
+    double m_drawn_time_us = 0.0; // 最後に描画したフレームの時刻
     
     // マウス入力用
     bool m_is_mouse_dragging = false;
@@ -59,8 +77,24 @@ private:
 
     // データ参照
     const std::vector<RGBFrame>* m_all_images_ptr = nullptr;
-    unsigned int m_point_count = 0;
+    TimeIndex m_image_index; // 画像フレームの時刻 → 番号
     double m_base_time = 0.0;
+
+    // m_point_vbo 上の連続した頂点 (全イベント、またはストリーミングで受け取った1セグメント)
+    struct PointBatch {
+        size_t first_vertex = 0;
+        size_t count = 0;
+        // 各頂点の時刻 (絶対時刻) の索引。頂点は時刻順なので、タイムウィンドウに入る範囲を索引で求めて描画する
+        TimeIndex time_index;
+        EventSegment* segment = nullptr; // ストリーミング時のみ
+    };
+    std::vector<PointBatch> m_point_batches;
+
+    // ストリーミング: m_point_vbo をセグメント1つ分ずつのスロットに分けて使う
+    EventPrefetcher* m_prefetcher = nullptr;
+    std::vector<size_t> m_free_slots;
+    int m_sensor_width = 0, m_sensor_height = 0;
+    int64_t m_t_offset = 0;
     
     // コールバックハンドラ
     void onKey(int key, int scancode, int action, int mods);
@@ -69,4 +103,6 @@ private:
     void onScroll(double xoffset, double yoffset);
 };
 
-void run_renderer(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors);
\ No newline at end of file
+void run_renderer(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors);
+void run_renderer(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors);
+void run_renderer(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int width, int height, const ColorConfig& colors);
\ No newline at end of file
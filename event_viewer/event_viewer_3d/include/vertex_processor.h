@@ -0,0 +1,30 @@
+#pragma once
+#include "types.h"
+#include "event_store.h"
+#include <optional>
+#include <string>
+#include <GL/glew.h>
+
+// イベントを頂点に変換して点群のVBOに書き込む処理
+// CUDA (EV_HAVE_CUDA でビルドした場合) と CPU の2つの実装があり、どちらも頂点をイベントと同じ時刻順に並べる
+enum class VertexBackend {
+    AUTO, // CUDA でビルドされ、デバイスが使えれば CUDA、それ以外は CPU
+    CPU,
+    CUDA,
+};
+
+std::optional<VertexBackend> parse_vertex_backend(const std::string& name);
+
+// 使うバックエンドを選ぶ (レンダラの初期化より前に呼ぶ)
+void set_vertex_backend(VertexBackend backend);
+// GLコンテキストの作成後に呼ぶ。CUDA が使えなければ CPU に切り替える
+void init_vertex_processor();
+void register_gl_buffer(GLuint vbo);
+void unregister_gl_buffer();
+
+// all_events を頂点に変換し、VBOの vertex_offset 番目以降に書き込む。書き込んだ頂点数を返す
+unsigned int process_all_events(const EventStore& all_events, size_t vertex_offset, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors);
+
+// CPU 実装の本体: events を頂点に変換して out[0, events.size()) に書き込む
+// ブロックごとにスレッドに分け、ブロック内は座標の計算 (ベクトル化される) と頂点への詰め込みを分けて行う
+void events_to_vertices_cpu(const EventStore& events, Vertex* out, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors);
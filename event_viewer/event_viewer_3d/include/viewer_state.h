@@ -11,6 +11,7 @@ struct ViewerState {
     // 再生制御
     float playback_speed = 1.0f;
     bool is_paused = false;
+    bool is_reversed = false;
 
     // 表示制御
     bool show_bounding_box = true;
@@ -0,0 +1,374 @@
+#include "aedat4_reader.h"
+#include "flatbuffer.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+#ifdef EV_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef EV_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr char AEDAT4_MAGIC[] = "#!AER-DAT4.0\r\n";
+constexpr size_t AEDAT4_MAGIC_BYTES = sizeof(AEDAT4_MAGIC) - 1;
+// パケットのヘッダ: int32 stream_id, int32 size
+constexpr size_t PACKET_HEADER_BYTES = 8;
+// EventPacket の要素 (flatbuffer の struct): int64 timestamp, int16 x, int16 y, bool polarity + パディング
+constexpr size_t EVENT_STRUCT_BYTES = 16;
+// これ未満のイベント数の読み込みはスレッドに分けない
+constexpr size_t PARALLEL_DECODE_MIN_EVENTS = size_t(1) << 16;
+
+// DV の Frame.format
+enum FrameFormat : int8_t { FRAME_GRAY = 0, FRAME_BGR = 16, FRAME_BGRA = 24 };
+
+template <typename T>
+T read_le(const uint8_t* src) {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+// IOHeader.infoNode (XML) に書かれた出力ストリームの情報
+struct StreamInfo {
+    int id = -1;
+    std::string type; // "EVTS", "FRME", "IMUS", "TRIG" など
+    int size_x = 0;
+    int size_y = 0;
+};
+
+std::vector<StreamInfo> parse_streams(const std::string& xml) {
+    //   <node name="0" path="/mainloop/Recorder/outInfo/0/">
+    //       <attr key="typeIdentifier" type="string">EVTS</attr>
+    //       <node name="info" ...><attr key="sizeX" type="int">346</attr> ...
+    static const std::regex node_re(R"re(<node name="(\d+)" path="[^"]*outInfo/\d+/">)re");
+    static const std::regex type_re(R"re(key="typeIdentifier"[^>]*>([^<]*)<)re");
+    static const std::regex size_x_re(R"re(key="sizeX"[^>]*>(\d+)<)re");
+    static const std::regex size_y_re(R"re(key="sizeY"[^>]*>(\d+)<)re");
+
+    std::vector<std::pair<size_t, int>> nodes;
+    for (auto it = std::sregex_iterator(xml.begin(), xml.end(), node_re); it != std::sregex_iterator(); ++it) {
+        nodes.emplace_back(static_cast<size_t>(it->position(0)), std::stoi((*it)[1].str()));
+    }
+    std::vector<StreamInfo> streams;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        size_t end = (i + 1 < nodes.size()) ? nodes[i + 1].first : xml.size();
+        std::string block = xml.substr(nodes[i].first, end - nodes[i].first);
+        StreamInfo info;
+        info.id = nodes[i].second;
+        std::smatch m;
+        if (std::regex_search(block, m, type_re)) info.type = m[1].str();
+        if (std::regex_search(block, m, size_x_re)) info.size_x = std::stoi(m[1].str());
+        if (std::regex_search(block, m, size_y_re)) info.size_y = std::stoi(m[1].str());
+        streams.push_back(info);
+    }
+    return streams;
+}
+
+} // namespace
+
+Aedat4Reader::Aedat4Reader(const std::string& filepath, bool index_events) : m_filepath(filepath) {
+    m_file = MappedFile::open(filepath);
+    const uint8_t* data = m_file->data();
+    size_t size = m_file->size();
+    if (size < AEDAT4_MAGIC_BYTES + 4 || std::memcmp(data, AEDAT4_MAGIC, AEDAT4_MAGIC_BYTES) != 0) {
+        throw std::runtime_error("Not an AEDAT 4.0 file: " + filepath);
+    }
+
+    // 1. IOHeader: 圧縮方式とストリームの情報
+    size_t pos = AEDAT4_MAGIC_BYTES;
+    uint32_t header_bytes = read_le<uint32_t>(data + pos);
+    pos += 4;
+    if (header_bytes > size - pos) throw std::runtime_error("Truncated AEDAT4 header: " + filepath);
+    FlatTable header(data + pos, header_bytes, "IOHE");
+    int32_t compression = header.scalar<int32_t>(0, 0);
+    int64_t data_table_position = header.scalar<int64_t>(1, -1);
+    std::vector<StreamInfo> streams = parse_streams(header.string(2));
+    pos += header_bytes;
+    if (compression < 0 || compression > static_cast<int32_t>(Compression::ZSTD_HIGH)) {
+        throw std::runtime_error("Unknown AEDAT4 compression type " + std::to_string(compression) + ": " + filepath);
+    }
+    m_compression = static_cast<Compression>(compression);
+
+    // イベントとフレームは、それぞれ最初に見つかったストリームを使う
+    int event_stream = -1;
+    int frame_stream = -1;
+    for (const StreamInfo& stream : streams) {
+        if (stream.type == "EVTS" && event_stream < 0) {
+            event_stream = stream.id;
+            if (stream.size_x > 0 && stream.size_y > 0) m_resolution = Resolution{stream.size_x, stream.size_y};
+        } else if (stream.type == "FRME" && frame_stream < 0) {
+            frame_stream = stream.id;
+        }
+    }
+    if (event_stream < 0 && index_events) throw std::runtime_error("No event stream in AEDAT4 file: " + filepath);
+
+    // 2. パケットのヘッダを走査する (末尾のデータテーブルは使わない)
+    size_t packets_end = (data_table_position > 0 && static_cast<uint64_t>(data_table_position) <= size)
+                             ? static_cast<size_t>(data_table_position) : size;
+    while (pos + PACKET_HEADER_BYTES <= packets_end) {
+        int32_t stream_id = read_le<int32_t>(data + pos);
+        uint32_t stored_bytes = read_le<uint32_t>(data + pos + 4);
+        pos += PACKET_HEADER_BYTES;
+        if (stored_bytes > packets_end - pos) {
+            std::cerr << "Warning: AEDAT4 file is truncated; ignoring the last packet: " << filepath << std::endl;
+            break;
+        }
+        if (stream_id == event_stream) m_event_packets.push_back({pos, stored_bytes});
+        if (stream_id == frame_stream) m_frame_packets.push_back({pos, stored_bytes});
+        pos += stored_bytes;
+    }
+    if (!index_events) return;
+
+    // 3. イベントのパケットを並列に展開し、イベント数と時刻範囲を数える (展開結果は捨てる)
+    ThreadPool::shared().parallel_for(m_event_packets.size(), [&](size_t i) {
+        thread_local std::vector<uint8_t> scratch;
+        Packet& packet = m_event_packets[i];
+        size_t bytes = 0;
+        const uint8_t* buf = unpack(packet, scratch, bytes);
+        size_t count = 0;
+        const uint8_t* elements = FlatTable(buf, bytes, "EVTS").vector(0, EVENT_STRUCT_BYTES, count);
+        packet.num_events = static_cast<uint32_t>(count);
+        if (count > 0) {
+            packet.t_first = read_le<int64_t>(elements);
+            packet.t_last = read_le<int64_t>(elements + (count - 1) * EVENT_STRUCT_BYTES);
+        }
+    });
+    m_event_packets.erase(std::remove_if(m_event_packets.begin(), m_event_packets.end(),
+                                         [](const Packet& packet) { return packet.num_events == 0; }),
+                          m_event_packets.end());
+    if (!m_event_packets.empty()) m_t_offset = m_event_packets.front().t_first;
+    for (Packet& packet : m_event_packets) {
+        packet.first_event = m_num_events;
+        m_num_events += packet.num_events;
+        packet.t_first -= m_t_offset;
+        packet.t_last -= m_t_offset;
+    }
+    std::cout << "Aedat4Reader: " << filepath << " を開きました (" << m_num_events << " イベント, "
+              << m_event_packets.size() << " パケット, " << m_frame_packets.size() << " フレーム)。" << std::endl;
+}
+
+Aedat4Reader::~Aedat4Reader() = default;
+
+std::optional<Resolution> Aedat4Reader::resolution() {
+    return m_resolution;
+}
+
+const uint8_t* Aedat4Reader::unpack(const Packet& packet, std::vector<uint8_t>& scratch, size_t& bytes) const {
+    const uint8_t* src = m_file->data() + packet.offset;
+    switch (m_compression) {
+    case Compression::NONE:
+        bytes = packet.stored_bytes;
+        return src;
+    case Compression::LZ4:
+    case Compression::LZ4_HIGH: {
+#ifdef EV_HAVE_LZ4
+        // LZ4 フレーム形式。展開後のサイズはヘッダに無いことがあるため、足りなければバッファを広げる
+        struct ContextDeleter {
+            void operator()(LZ4F_dctx* ctx) const { LZ4F_freeDecompressionContext(ctx); }
+        };
+        thread_local std::unique_ptr<LZ4F_dctx, ContextDeleter> context;
+        if (!context) {
+            LZ4F_dctx* ctx = nullptr;
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) throw std::bad_alloc();
+            context.reset(ctx);
+        }
+        LZ4F_resetDecompressionContext(context.get());
+        scratch.resize(std::max<size_t>(scratch.size(), size_t(packet.stored_bytes) * 4));
+        size_t in = 0;
+        size_t out = 0;
+        for (;;) {
+            if (out == scratch.size()) scratch.resize(scratch.size() * 2);
+            size_t dst_size = scratch.size() - out;
+            size_t src_size = packet.stored_bytes - in;
+            size_t ret = LZ4F_decompress(context.get(), scratch.data() + out, &dst_size, src + in, &src_size, nullptr);
+            if (LZ4F_isError(ret)) throw std::runtime_error("Corrupt LZ4 packet in AEDAT4 file: " + m_filepath);
+            in += src_size;
+            out += dst_size;
+            if (ret == 0) break;
+            if (src_size == 0 && dst_size == 0) throw std::runtime_error("Truncated LZ4 packet in AEDAT4 file: " + m_filepath);
+        }
+        bytes = out;
+        return scratch.data();
+#else
+        (void)scratch;
+        throw std::runtime_error("This AEDAT4 file uses LZ4, but the viewer was built without LZ4 support.");
+#endif
+    }
+    case Compression::ZSTD:
+    case Compression::ZSTD_HIGH: {
+#ifdef EV_HAVE_ZSTD
+        unsigned long long content = ZSTD_getFrameContentSize(src, packet.stored_bytes);
+        if (content == ZSTD_CONTENTSIZE_ERROR) throw std::runtime_error("Corrupt zstd packet in AEDAT4 file: " + m_filepath);
+        if (content != ZSTD_CONTENTSIZE_UNKNOWN) {
+            scratch.resize(content);
+            size_t size = ZSTD_decompress(scratch.data(), scratch.size(), src, packet.stored_bytes);
+            if (ZSTD_isError(size) || size != content) throw std::runtime_error("Corrupt zstd packet in AEDAT4 file: " + m_filepath);
+            bytes = size;
+            return scratch.data();
+        }
+        // 展開後のサイズが書かれていないフレームはストリーミングで展開する
+        struct StreamDeleter {
+            void operator()(ZSTD_DStream* stream) const { ZSTD_freeDStream(stream); }
+        };
+        thread_local std::unique_ptr<ZSTD_DStream, StreamDeleter> stream(ZSTD_createDStream());
+        ZSTD_initDStream(stream.get());
+        scratch.resize(std::max<size_t>(scratch.size(), size_t(packet.stored_bytes) * 4));
+        ZSTD_inBuffer input{src, packet.stored_bytes, 0};
+        ZSTD_outBuffer output{scratch.data(), scratch.size(), 0};
+        for (;;) {
+            size_t ret = ZSTD_decompressStream(stream.get(), &output, &input);
+            if (ZSTD_isError(ret)) throw std::runtime_error("Corrupt zstd packet in AEDAT4 file: " + m_filepath);
+            if (ret == 0) break;
+            if (output.pos == output.size) {
+                scratch.resize(scratch.size() * 2);
+                output.dst = scratch.data();
+                output.size = scratch.size();
+            } else if (input.pos == input.size) {
+                throw std::runtime_error("Truncated zstd packet in AEDAT4 file: " + m_filepath);
+            }
+        }
+        bytes = output.pos;
+        return scratch.data();
+#else
+        (void)scratch;
+        throw std::runtime_error("This AEDAT4 file uses zstd, but the viewer was built without zstd support.");
+#endif
+    }
+    }
+    throw std::logic_error("Unknown AEDAT4 compression");
+}
+
+void Aedat4Reader::decode_packet(size_t index, size_t lo, size_t hi, size_t stride, unsigned columns,
+                                 uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const {
+    thread_local std::vector<uint8_t> scratch;
+    const Packet& packet = m_event_packets[index];
+    size_t bytes = 0;
+    const uint8_t* buf = unpack(packet, scratch, bytes);
+    size_t count = 0;
+    const uint8_t* elements = FlatTable(buf, bytes, "EVTS").vector(0, EVENT_STRUCT_BYTES, count);
+    if (count != packet.num_events) throw std::runtime_error("AEDAT4 packet changed while reading: " + m_filepath);
+
+    size_t out = 0;
+    for (size_t k = lo; k < hi; k += stride, ++out) {
+        const uint8_t* e = elements + k * EVENT_STRUCT_BYTES;
+        if (columns & EVENT_COLUMN_T) t[out] = read_le<int64_t>(e) - m_t_offset;
+        if (columns & EVENT_COLUMN_X) x[out] = static_cast<uint16_t>(read_le<int16_t>(e + 8));
+        if (columns & EVENT_COLUMN_Y) y[out] = static_cast<uint16_t>(read_le<int16_t>(e + 10));
+        if (columns & EVENT_COLUMN_P) p[out] = e[12] ? 1 : 0;
+    }
+}
+
+EventStore Aedat4Reader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    if (begin >= m_num_events) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, m_num_events - begin);
+    size_t out_count = (count + stride - 1) / stride;
+    if (out_count == 0) return events;
+    events.resize(out_count);
+
+    uint16_t* x = events.has(EVENT_COLUMN_X) ? events.x.data() : nullptr;
+    uint16_t* y = events.has(EVENT_COLUMN_Y) ? events.y.data() : nullptr;
+    uint8_t* p = events.has(EVENT_COLUMN_P) ? events.p.data() : nullptr;
+    int64_t* t = events.has(EVENT_COLUMN_T) ? events.t.data() : nullptr;
+
+    size_t end = begin + count;
+    auto packet_of = [&](size_t event) {
+        auto it = std::upper_bound(m_event_packets.begin(), m_event_packets.end(), event,
+                                   [](size_t value, const Packet& packet) { return value < packet.first_event; });
+        return static_cast<size_t>(it - m_event_packets.begin()) - 1;
+    };
+    size_t first_packet = packet_of(begin);
+    size_t last_packet = packet_of(end - 1);
+    auto decode_one = [&](size_t i) {
+        size_t index = first_packet + i;
+        const Packet& packet = m_event_packets[index];
+        size_t lo = std::max<size_t>(begin, packet.first_event);
+        size_t hi = std::min<size_t>(end, packet.first_event + packet.num_events);
+        // 出力に含まれる最初のイベント (stride の倍数番目) に合わせる
+        size_t skip = (lo - begin) % stride;
+        if (skip) lo += stride - skip;
+        if (lo >= hi) return;
+        size_t out = (lo - begin) / stride;
+        decode_packet(index, lo - packet.first_event, hi - packet.first_event, stride, columns,
+                      x ? x + out : nullptr, y ? y + out : nullptr, p ? p + out : nullptr, t ? t + out : nullptr);
+    };
+
+    size_t num_packets = last_packet - first_packet + 1;
+    if (count >= PARALLEL_DECODE_MIN_EVENTS) {
+        ThreadPool::shared().parallel_for(num_packets, decode_one);
+    } else {
+        for (size_t i = 0; i < num_packets; ++i) decode_one(i);
+    }
+    return events;
+}
+
+size_t Aedat4Reader::find_event_index(int64_t t) {
+    if (m_event_packets.empty() || t > m_event_packets.back().t_last) return m_num_events;
+    // t_last が t 以上となる最初のパケットに答えがある
+    auto it = std::lower_bound(m_event_packets.begin(), m_event_packets.end(), t,
+                               [](const Packet& packet, int64_t value) { return packet.t_last < value; });
+    if (t <= it->t_first) return it->first_event;
+
+    const EventStore packet = read_events(it->first_event, it->num_events, EVENT_COLUMN_T);
+    return it->first_event + (std::lower_bound(packet.t.begin(), packet.t.end(), t) - packet.t.begin());
+}
+
+std::vector<RGBFrame> Aedat4Reader::load_frames(const std::string& filepath) {
+    return Aedat4Reader(filepath, false).decode_frames();
+}
+
+std::vector<RGBFrame> Aedat4Reader::decode_frames() const {
+    // Frame テーブルのフィールド: 0 timestamp, 5 format, 6 sizeX, 7 sizeY, 10 pixels
+    // 画像ファイルと同じく下の行から順の 8bit RGB に変換する (stbi の上下反転読み込みと揃える)
+    std::vector<RGBFrame> frames(m_frame_packets.size());
+    ThreadPool::shared().parallel_for(m_frame_packets.size(), [&](size_t i) {
+        thread_local std::vector<uint8_t> scratch;
+        size_t bytes = 0;
+        const uint8_t* buf = unpack(m_frame_packets[i], scratch, bytes);
+        FlatTable frame(buf, bytes, "FRME");
+        int8_t format = frame.scalar<int8_t>(5, FRAME_GRAY);
+        int width = frame.scalar<int16_t>(6, 0);
+        int height = frame.scalar<int16_t>(7, 0);
+        int channels = format == FRAME_BGRA ? 4 : format == FRAME_BGR ? 3 : format == FRAME_GRAY ? 1 : 0;
+        size_t length = 0;
+        const uint8_t* pixels = frame.vector(10, 1, length);
+        if (channels == 0 || width <= 0 || height <= 0 || length < size_t(width) * height * channels) return;
+
+        auto rgb = std::make_shared<std::vector<uint8_t>>(size_t(width) * height * 3);
+        for (int row = 0; row < height; ++row) {
+            const uint8_t* src = pixels + size_t(row) * width * channels;
+            uint8_t* dst = rgb->data() + size_t(height - 1 - row) * width * 3;
+            for (int col = 0; col < width; ++col, src += channels, dst += 3) {
+                if (channels == 1) {
+                    dst[0] = dst[1] = dst[2] = src[0];
+                } else {
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                }
+            }
+        }
+        frames[i].timestamp = frame.scalar<int64_t>(0, 0);
+        frames[i].pixels = std::move(rgb);
+        frames[i].width = width;
+        frames[i].height = height;
+    });
+
+    std::vector<RGBFrame> result;
+    result.reserve(frames.size());
+    for (RGBFrame& frame : frames) {
+        if (frame.pixels) result.push_back(std::move(frame)); // 形式を解釈できなかったフレームは除く
+    }
+    std::stable_sort(result.begin(), result.end(), [](const RGBFrame& a, const RGBFrame& b) { return a.timestamp < b.timestamp; });
+    std::cout << "--- Loaded " << result.size() << " APS frames from " << m_filepath << " ---" << std::endl;
+    return result;
+}
@@ -0,0 +1,731 @@
+#include "arrow_ipc.h"
+#include "flatbuffer.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#ifdef EV_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef EV_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// ファイルの先頭 ("ARROW1" + 2バイトのパディング) と末尾 ("ARROW1") のマジック
+constexpr char ARROW_MAGIC[] = "ARROW1";
+constexpr size_t ARROW_MAGIC_BYTES = sizeof(ARROW_MAGIC) - 1;
+constexpr size_t FILE_HEADER_BYTES = 8;
+// メッセージの先頭の継続マーカー (0.15 より前の形式には無い)
+constexpr uint32_t CONTINUATION_MARKER = 0xFFFFFFFF;
+// MetadataVersion::V5
+constexpr int16_t METADATA_V5 = 4;
+// ボディとバッファの境界 (SIMD で読めるように Arrow が推奨する64バイト)
+constexpr size_t BODY_ALIGNMENT = 64;
+// 型変換を1スレッドに割り当てる単位 (要素数)
+constexpr size_t CONVERT_BLOCK = size_t(1) << 20;
+
+// t_offset と解像度を持つスキーマのメタデータのキー
+constexpr char META_T_OFFSET[] = "event_viewer.t_offset";
+constexpr char META_WIDTH[] = "event_viewer.width";
+constexpr char META_HEIGHT[] = "event_viewer.height";
+
+// MessageHeader 共用体
+enum MessageHeader : uint8_t { HEADER_SCHEMA = 1, HEADER_RECORD_BATCH = 3 };
+
+// Type 共用体
+enum ArrowTypeId : uint8_t {
+    TYPE_NULL = 1,
+    TYPE_INT = 2,
+    TYPE_FLOATING_POINT = 3,
+    TYPE_BINARY = 4,
+    TYPE_UTF8 = 5,
+    TYPE_BOOL = 6,
+    TYPE_TIMESTAMP = 10,
+    TYPE_LIST = 12,
+    TYPE_STRUCT = 13,
+    TYPE_UNION = 14,
+    TYPE_FIXED_SIZE_LIST = 16,
+    TYPE_MAP = 17,
+    TYPE_DURATION = 18,
+    TYPE_LARGE_BINARY = 19,
+    TYPE_LARGE_UTF8 = 20,
+    TYPE_LARGE_LIST = 21,
+    TYPE_RUN_END_ENCODED = 22,
+    TYPE_BINARY_VIEW = 23,
+    TYPE_UTF8_VIEW = 24,
+    TYPE_LIST_VIEW = 25,
+    TYPE_LARGE_LIST_VIEW = 26,
+};
+
+// BodyCompression.codec
+enum CompressionCodec : int8_t { CODEC_NONE = -1, CODEC_LZ4_FRAME = 0, CODEC_ZSTD = 1 };
+
+// flatbuffer の struct
+struct FieldNode {
+    int64_t length;
+    int64_t null_count;
+};
+struct BufferSpec {
+    int64_t offset; // ボディの先頭からの位置
+    int64_t length;
+};
+struct Block {
+    int64_t offset;          // メッセージ (継続マーカー) のファイル上の位置
+    int32_t metadata_length; // 継続マーカー・長さ・flatbuffer・パディングの合計
+    int32_t padding;
+    int64_t body_length;
+};
+static_assert(sizeof(FieldNode) == 16 && sizeof(BufferSpec) == 16 && sizeof(Block) == 24, "Arrow struct layout");
+
+size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+// --- 書き込み ---
+
+// 書き出す列 (名前と Int 型)
+struct ColumnSpec {
+    const char* name;
+    unsigned column;
+    int32_t bit_width;
+    bool is_signed;
+};
+constexpr ColumnSpec COLUMN_SPECS[] = {
+    {"x", EVENT_COLUMN_X, 16, false},
+    {"y", EVENT_COLUMN_Y, 16, false},
+    {"p", EVENT_COLUMN_P, 8, false},
+    {"t", EVENT_COLUMN_T, 64, true},
+};
+constexpr size_t NUM_COLUMNS = sizeof(COLUMN_SPECS) / sizeof(COLUMN_SPECS[0]);
+
+using Metadata = std::vector<std::pair<std::string, std::string>>;
+using Field = FlatBuilder::Field;
+
+// Schema テーブルを書き、その位置を返す
+size_t build_schema(FlatBuilder& builder, const Metadata& metadata) {
+    std::vector<size_t> schema = builder.table({Field::scalar<int16_t>(0, 0), Field::offset(1), Field::offset(2)});
+    std::vector<size_t> field_slots;
+    builder.patch(schema[2], builder.offset_vector(NUM_COLUMNS, field_slots));
+    for (size_t i = 0; i < NUM_COLUMNS; ++i) {
+        const ColumnSpec& spec = COLUMN_SPECS[i];
+        // name, nullable, type_type, type, children (pyarrow は children が無いスキーマを受け付けない)
+        std::vector<size_t> field = builder.table({Field::offset(0), Field::scalar<uint8_t>(1, 0),
+                                                   Field::scalar<uint8_t>(2, TYPE_INT), Field::offset(3), Field::offset(5)});
+        builder.patch(field_slots[i], field[0]);
+        builder.patch(field[1], builder.string(spec.name));
+        std::vector<size_t> type = builder.table({Field::scalar<int32_t>(0, spec.bit_width),
+                                                  Field::scalar<uint8_t>(1, spec.is_signed ? 1 : 0)});
+        builder.patch(field[4], type[0]);
+        std::vector<size_t> no_children;
+        builder.patch(field[5], builder.offset_vector(0, no_children));
+    }
+    std::vector<size_t> entry_slots;
+    builder.patch(schema[3], builder.offset_vector(metadata.size(), entry_slots));
+    for (size_t i = 0; i < metadata.size(); ++i) {
+        std::vector<size_t> entry = builder.table({Field::offset(0), Field::offset(1)});
+        builder.patch(entry_slots[i], entry[0]);
+        builder.patch(entry[1], builder.string(metadata[i].first));
+        builder.patch(entry[2], builder.string(metadata[i].second));
+    }
+    return schema[0];
+}
+
+// Message テーブル (header は header_type に応じた Schema / RecordBatch を書いて位置を返す関数)
+template <typename BuildHeader>
+std::vector<uint8_t> build_message(uint8_t header_type, int64_t body_length, const BuildHeader& build_header) {
+    FlatBuilder builder;
+    std::vector<size_t> message = builder.table({Field::scalar<int16_t>(0, METADATA_V5), Field::scalar<uint8_t>(1, header_type),
+                                                 Field::offset(2), Field::scalar<int64_t>(3, body_length)});
+    builder.set_root(message[0]);
+    builder.patch(message[3], build_header(builder));
+    return builder.data();
+}
+
+class ArrowFileWriter {
+public:
+    explicit ArrowFileWriter(const std::string& path) : m_out(path, std::ios::binary | std::ios::trunc), m_path(path) {
+        if (!m_out) throw std::runtime_error("Cannot create Arrow file: " + path);
+        write(ARROW_MAGIC, ARROW_MAGIC_BYTES);
+        pad_to(FILE_HEADER_BYTES);
+    }
+
+    // メッセージのメタデータを書く。ボディが64バイト境界から始まるようにパディングし、Block.metaDataLength を返す
+    int32_t write_metadata(const std::vector<uint8_t>& flatbuffer) {
+        size_t start = m_offset;
+        size_t padded = align_up(start + 8 + flatbuffer.size(), BODY_ALIGNMENT) - start - 8;
+        uint32_t marker = CONTINUATION_MARKER;
+        int32_t length = static_cast<int32_t>(padded);
+        write(&marker, sizeof(marker));
+        write(&length, sizeof(length));
+        write(flatbuffer.data(), flatbuffer.size());
+        pad_to(start + 8 + padded);
+        return static_cast<int32_t>(8 + padded);
+    }
+
+    void write(const void* data, size_t bytes) {
+        m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        m_offset += bytes;
+    }
+    void pad_to(size_t offset) {
+        static const char zeros[BODY_ALIGNMENT] = {};
+        while (m_offset < offset) write(zeros, std::min(BODY_ALIGNMENT, offset - m_offset));
+    }
+    size_t offset() const { return m_offset; }
+    void finish() {
+        m_out.flush();
+        if (!m_out) throw std::runtime_error("Failed to write Arrow file: " + m_path);
+    }
+
+private:
+    std::ofstream m_out;
+    std::string m_path;
+    size_t m_offset = 0;
+};
+
+// --- 読み込み ---
+
+// イベントの列に使うフィールドの型
+struct ArrowType {
+    char kind = 0;      // 'i', 'u', 'f', 'b' (bool、ビット詰め), 'M' (timestamp / duration の int64)
+    size_t size = 0;    // 要素のバイト数 (bool は 0)
+    int64_t us_mul = 1; // timestamp / duration の値を µs に換算する係数 (us_mul / us_div)
+    int64_t us_div = 1;
+
+    size_t bytes_for(size_t n) const { return kind == 'b' ? (n + 7) / 8 : n * size; }
+};
+
+// スキーマ上のイベントの列
+struct ColumnField {
+    ArrowType type;
+    size_t node = 0;   // レコードバッチの nodes の番号
+    size_t buffer = 0; // buffers の番号 (検証ビットマップ。データはその次)
+    bool found = false;
+};
+
+// フィールド (と子) がレコードバッチで使う FieldNode とバッファの数を足す
+void count_layout(const FlatTable& field, size_t& nodes, size_t& buffers, const std::string& path) {
+    nodes += 1;
+    if (field.table(4)) { // 辞書符号化: 検証ビットマップと添字
+        buffers += 2;
+        return;
+    }
+    switch (field.scalar<uint8_t>(2, 0)) {
+    case TYPE_NULL:
+    case TYPE_RUN_END_ENCODED:
+        break;
+    case TYPE_BINARY:
+    case TYPE_UTF8:
+    case TYPE_LARGE_BINARY:
+    case TYPE_LARGE_UTF8:
+        buffers += 3;
+        break;
+    case TYPE_STRUCT:
+    case TYPE_FIXED_SIZE_LIST:
+        buffers += 1;
+        break;
+    case TYPE_UNION: { // Sparse: 型番号 / Dense: 型番号と位置
+        std::optional<FlatTable> type = field.table(3);
+        buffers += (type && type->scalar<int16_t>(0, 0) == 1) ? 2 : 1;
+        break;
+    }
+    case TYPE_BINARY_VIEW:
+    case TYPE_UTF8_VIEW:
+    case TYPE_LIST_VIEW:
+    case TYPE_LARGE_LIST_VIEW:
+        throw std::runtime_error("Arrow view types are not supported (column '" + field.string(0) + "'): " + path);
+    default: // プリミティブ型、List / LargeList / Map (検証ビットマップと位置)
+        buffers += 2;
+        break;
+    }
+    for (const FlatTable& child : field.tables(5)) count_layout(child, nodes, buffers, path);
+}
+
+ArrowType parse_column_type(const FlatTable& field, const std::string& path) {
+    std::string name = field.string(0);
+    if (field.table(4)) throw std::runtime_error("Dictionary-encoded Arrow column '" + name + "' is not supported: " + path);
+    std::optional<FlatTable> type = field.table(3);
+    ArrowType result;
+    switch (field.scalar<uint8_t>(2, 0)) {
+    case TYPE_INT: {
+        int32_t bits = type ? type->scalar<int32_t>(0, 0) : 0;
+        if (bits != 8 && bits != 16 && bits != 32 && bits != 64) break;
+        result.kind = (type->scalar<uint8_t>(1, 0) != 0) ? 'i' : 'u';
+        result.size = static_cast<size_t>(bits / 8);
+        return result;
+    }
+    case TYPE_FLOATING_POINT: { // precision: HALF, SINGLE, DOUBLE
+        int16_t precision = type ? type->scalar<int16_t>(0, 0) : 0;
+        if (precision != 1 && precision != 2) break;
+        result.kind = 'f';
+        result.size = precision == 1 ? 4 : 8;
+        return result;
+    }
+    case TYPE_BOOL:
+        result.kind = 'b';
+        return result;
+    case TYPE_TIMESTAMP:
+    case TYPE_DURATION: { // unit: SECOND, MILLISECOND, MICROSECOND, NANOSECOND (既定値は Timestamp が秒、Duration が ms)
+        int16_t unit = type ? type->scalar<int16_t>(0, field.scalar<uint8_t>(2, 0) == TYPE_TIMESTAMP ? 0 : 1) : 0;
+        result.kind = 'M';
+        result.size = 8;
+        switch (unit) {
+        case 0: result.us_mul = 1000000; break;
+        case 1: result.us_mul = 1000; break;
+        case 2: break;
+        default: result.us_div = 1000; break;
+        }
+        return result;
+    }
+    default:
+        break;
+    }
+    throw std::runtime_error("Unsupported Arrow type for event column '" + name + "': " + path);
+}
+
+// バッファの中身 (mmap、または展開したバッファを参照する)
+struct ArrowBuffer {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> keepalive;
+    bool mapped = false;
+};
+
+// 圧縮されたバッファを展開する (先頭8バイトは展開後の長さ。-1 なら圧縮されていない)
+ArrowBuffer decompress_buffer(int8_t codec, const uint8_t* src, size_t size, const std::string& path) {
+    if (size == 0) return {};
+    if (size < 8) throw std::runtime_error("Corrupt compressed buffer in Arrow file: " + path);
+    int64_t raw_bytes = flat_read<int64_t>(src);
+    if (raw_bytes == -1) return {src + 8, size - 8, nullptr, true};
+    if (raw_bytes < 0) throw std::runtime_error("Corrupt compressed buffer in Arrow file: " + path);
+    auto buffer = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(raw_bytes));
+    src += 8;
+    size -= 8;
+    if (codec == CODEC_LZ4_FRAME) {
+#ifdef EV_HAVE_LZ4
+        struct ContextDeleter {
+            void operator()(LZ4F_dctx* ctx) const { LZ4F_freeDecompressionContext(ctx); }
+        };
+        thread_local std::unique_ptr<LZ4F_dctx, ContextDeleter> context;
+        if (!context) {
+            LZ4F_dctx* ctx = nullptr;
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) throw std::bad_alloc();
+            context.reset(ctx);
+        }
+        LZ4F_resetDecompressionContext(context.get());
+        size_t in = 0;
+        size_t out = 0;
+        for (;;) {
+            size_t dst_size = buffer->size() - out;
+            size_t src_size = size - in;
+            size_t ret = LZ4F_decompress(context.get(), buffer->data() + out, &dst_size, src + in, &src_size, nullptr);
+            if (LZ4F_isError(ret)) throw std::runtime_error("Corrupt LZ4 buffer in Arrow file: " + path);
+            in += src_size;
+            out += dst_size;
+            if (ret == 0) break;
+            if (src_size == 0 && dst_size == 0) throw std::runtime_error("Truncated LZ4 buffer in Arrow file: " + path);
+        }
+        if (out != buffer->size()) throw std::runtime_error("Corrupt LZ4 buffer in Arrow file: " + path);
+#else
+        throw std::runtime_error("This Arrow file uses LZ4, but the viewer was built without LZ4 support.");
+#endif
+    } else if (codec == CODEC_ZSTD) {
+#ifdef EV_HAVE_ZSTD
+        size_t bytes = ZSTD_decompress(buffer->data(), buffer->size(), src, size);
+        if (ZSTD_isError(bytes) || bytes != buffer->size()) throw std::runtime_error("Corrupt zstd buffer in Arrow file: " + path);
+#else
+        throw std::runtime_error("This Arrow file uses zstd, but the viewer was built without zstd support.");
+#endif
+    } else {
+        throw std::runtime_error("Unsupported Arrow compression codec " + std::to_string(codec) + ": " + path);
+    }
+    return {buffer->data(), buffer->size(), buffer, false};
+}
+
+// 値を Src 型として読み、fn で変換して dst[begin, end) に書き込む
+template <typename Src, typename Dst, typename Fn>
+void convert_typed(const uint8_t* src, size_t begin, size_t end, Dst* dst, const Fn& fn) {
+    for (size_t i = begin; i < end; ++i) dst[i] = fn(flat_read<Src>(src + i * sizeof(Src)));
+}
+
+template <typename Dst, typename Fn>
+void convert_values(const ArrowType& type, const uint8_t* src, size_t begin, size_t end, Dst* dst, const Fn& fn) {
+    switch (type.kind) {
+    case 'b':
+        for (size_t i = begin; i < end; ++i) dst[i] = fn(static_cast<uint8_t>((src[i >> 3] >> (i & 7)) & 1));
+        return;
+    case 'u':
+        switch (type.size) {
+        case 1: return convert_typed<uint8_t>(src, begin, end, dst, fn);
+        case 2: return convert_typed<uint16_t>(src, begin, end, dst, fn);
+        case 4: return convert_typed<uint32_t>(src, begin, end, dst, fn);
+        default: return convert_typed<uint64_t>(src, begin, end, dst, fn);
+        }
+    case 'i':
+        switch (type.size) {
+        case 1: return convert_typed<int8_t>(src, begin, end, dst, fn);
+        case 2: return convert_typed<int16_t>(src, begin, end, dst, fn);
+        case 4: return convert_typed<int32_t>(src, begin, end, dst, fn);
+        default: return convert_typed<int64_t>(src, begin, end, dst, fn);
+        }
+    case 'f':
+        if (type.size == 4) return convert_typed<float>(src, begin, end, dst, fn);
+        return convert_typed<double>(src, begin, end, dst, fn);
+    default: // 'M'
+        return convert_typed<int64_t>(src, begin, end, dst, [&](int64_t v) { return fn(v * type.us_mul / type.us_div); });
+    }
+}
+
+// 浮動小数の時刻は秒、整数は µs とみなす
+template <typename V>
+int64_t to_microseconds(V v) {
+    if constexpr (std::is_floating_point_v<V>) {
+        return static_cast<int64_t>(std::llround(static_cast<double>(v) * 1e6));
+    } else {
+        return static_cast<int64_t>(v);
+    }
+}
+
+// レコードバッチ1つの位置
+struct BatchInfo {
+    size_t length = 0;
+    int8_t codec = CODEC_NONE;
+    // 列ごと (x, y, p, t の順) のデータバッファのボディ上の位置
+    const uint8_t* data[NUM_COLUMNS] = {};
+    size_t bytes[NUM_COLUMNS] = {};
+};
+
+} // namespace
+
+void write_arrow_file(EventSource& source, const std::string& path, const ArrowWriteOptions& options) {
+    size_t total = source.num_events();
+    size_t begin = options.t_begin == INT64_MIN ? 0 : source.find_event_index(options.t_begin);
+    size_t end = options.t_end == INT64_MAX ? total : std::max(begin, source.find_event_index(options.t_end));
+    int64_t batch_us = std::max<int64_t>(1, options.batch_ms) * 1000;
+    size_t target = std::max<size_t>(1, options.target_batch_events);
+
+    // 1. バッチの境界を決める: batch_ms の倍数の時刻で区切った区間を target 個程度までまとめ、1区間で超える場合は個数で分ける
+    auto time_at = [&](size_t index) {
+        const EventStore event = source.read_events(index, 1, EVENT_COLUMN_T);
+        return event.t[0];
+    };
+    auto window_end = [&](size_t index) {
+        int64_t next = (floor_div(time_at(index), batch_us) + 1) * batch_us;
+        return std::min(end, std::max(index + 1, source.find_event_index(next)));
+    };
+    std::vector<size_t> bounds{begin};
+    for (size_t pos = begin; pos < end;) {
+        size_t next = window_end(pos);
+        while (next < end) {
+            size_t candidate = window_end(next);
+            if (candidate - pos > target) break;
+            next = candidate;
+        }
+        if (next - pos > target) next = pos + target;
+        bounds.push_back(next);
+        pos = next;
+    }
+
+    // 2. スキーマ
+    Metadata metadata{{META_T_OFFSET, std::to_string(source.load_t_offset())}};
+    if (std::optional<Resolution> resolution = source.resolution()) {
+        metadata.push_back({META_WIDTH, std::to_string(resolution->width)});
+        metadata.push_back({META_HEIGHT, std::to_string(resolution->height)});
+    }
+    ArrowFileWriter writer(path);
+    writer.write_metadata(build_message(HEADER_SCHEMA, 0, [&](FlatBuilder& builder) { return build_schema(builder, metadata); }));
+
+    // 3. レコードバッチ (列ごとに空の検証ビットマップとデータのバッファ)
+    std::vector<Block> blocks;
+    for (size_t b = 0; b + 1 < bounds.size(); ++b) {
+        size_t n = bounds[b + 1] - bounds[b];
+        const EventStore events = source.read_events(bounds[b], n);
+        const void* data[NUM_COLUMNS] = {events.x.data(), events.y.data(), events.p.data(), events.t.data()};
+        std::vector<FieldNode> nodes;
+        std::vector<BufferSpec> buffers;
+        size_t body = 0;
+        for (const ColumnSpec& spec : COLUMN_SPECS) {
+            nodes.push_back({static_cast<int64_t>(n), 0});
+            buffers.push_back({static_cast<int64_t>(body), 0});
+            buffers.push_back({static_cast<int64_t>(body), static_cast<int64_t>(n * spec.bit_width / 8)});
+            body = align_up(body + n * spec.bit_width / 8, BODY_ALIGNMENT);
+        }
+
+        Block block{static_cast<int64_t>(writer.offset()), 0, 0, static_cast<int64_t>(body)};
+        block.metadata_length = writer.write_metadata(build_message(HEADER_RECORD_BATCH, block.body_length, [&](FlatBuilder& builder) {
+            std::vector<size_t> batch = builder.table({Field::scalar<int64_t>(0, static_cast<int64_t>(n)), Field::offset(1), Field::offset(2)});
+            builder.patch(batch[2], builder.struct_vector(nodes.data(), nodes.size(), sizeof(FieldNode)));
+            builder.patch(batch[3], builder.struct_vector(buffers.data(), buffers.size(), sizeof(BufferSpec)));
+            return batch[0];
+        }));
+        size_t body_start = writer.offset();
+        for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+            const BufferSpec& buffer = buffers[2 * c + 1];
+            writer.pad_to(body_start + static_cast<size_t>(buffer.offset));
+            writer.write(data[c], static_cast<size_t>(buffer.length));
+        }
+        writer.pad_to(body_start + body);
+        blocks.push_back(block);
+        std::cout << "\r--- " << bounds[b + 1] - begin << " / " << end - begin << " events" << std::flush;
+    }
+    std::cout << std::endl;
+
+    // 4. フッタ (スキーマとバッチの位置の一覧)
+    FlatBuilder footer;
+    std::vector<size_t> table = footer.table({Field::scalar<int16_t>(0, METADATA_V5), Field::offset(1), Field::offset(2), Field::offset(3)});
+    footer.set_root(table[0]);
+    footer.patch(table[2], build_schema(footer, metadata));
+    footer.patch(table[3], footer.struct_vector(nullptr, 0, sizeof(Block)));
+    footer.patch(table[4], footer.struct_vector(blocks.data(), blocks.size(), sizeof(Block)));
+    int32_t footer_bytes = static_cast<int32_t>(footer.data().size());
+    writer.write(footer.data().data(), footer.data().size());
+    writer.write(&footer_bytes, sizeof(footer_bytes));
+    writer.write(ARROW_MAGIC, ARROW_MAGIC_BYTES);
+    writer.finish();
+}
+
+ArrowEventReader::ArrowEventReader(const std::string& filepath) : m_filepath(filepath) {
+    m_file = MappedFile::open(filepath);
+    const uint8_t* data = m_file->data();
+    size_t size = m_file->size();
+    if (size < FILE_HEADER_BYTES + 4 + ARROW_MAGIC_BYTES || std::memcmp(data, ARROW_MAGIC, ARROW_MAGIC_BYTES) != 0 ||
+        std::memcmp(data + size - ARROW_MAGIC_BYTES, ARROW_MAGIC, ARROW_MAGIC_BYTES) != 0) {
+        throw std::runtime_error("Not an Arrow IPC file (the stream format is not supported): " + filepath);
+    }
+
+    // 1. フッタとスキーマ
+    int32_t footer_bytes = flat_read<int32_t>(data + size - ARROW_MAGIC_BYTES - 4);
+    if (footer_bytes <= 0 || static_cast<size_t>(footer_bytes) > size - FILE_HEADER_BYTES - 4 - ARROW_MAGIC_BYTES) {
+        throw std::runtime_error("Corrupt Arrow file footer: " + filepath);
+    }
+    FlatTable footer(data + size - ARROW_MAGIC_BYTES - 4 - footer_bytes, static_cast<size_t>(footer_bytes));
+    std::optional<FlatTable> schema = footer.table(1);
+    if (!schema) throw std::runtime_error("Arrow file has no schema: " + filepath);
+    if (schema->scalar<int16_t>(0, 0) != 0) throw std::runtime_error("Big-endian Arrow files are not supported: " + filepath);
+
+    std::optional<int> width, height;
+    for (const FlatTable& entry : schema->tables(2)) {
+        std::string key = entry.string(0);
+        std::string value = entry.string(1);
+        try {
+            if (key == META_T_OFFSET) m_t_offset = std::stoll(value);
+            if (key == META_WIDTH) width = std::stoi(value);
+            if (key == META_HEIGHT) height = std::stoi(value);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid Arrow schema metadata " + key + "='" + value + "': " + filepath);
+        }
+    }
+    if (width && height) m_resolution = Resolution{*width, *height};
+
+    ColumnField fields[NUM_COLUMNS];
+    size_t num_nodes = 0;
+    size_t num_buffers = 0;
+    for (const FlatTable& field : schema->tables(1)) {
+        unsigned column = event_column_from_name(field.string(0));
+        for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+            if (COLUMN_SPECS[c].column != column || fields[c].found) continue;
+            fields[c] = {parse_column_type(field, filepath), num_nodes, num_buffers, true};
+        }
+        count_layout(field, num_nodes, num_buffers, filepath);
+    }
+    for (const ColumnField& field : fields) {
+        if (!field.found) throw std::runtime_error("Arrow file must have columns x, y, p and t: " + filepath);
+    }
+
+    // 2. レコードバッチの位置
+    size_t num_blocks = 0;
+    const uint8_t* block_data = footer.vector(3, sizeof(Block), num_blocks);
+    std::vector<BatchInfo> batches;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        Block block = flat_read<Block>(block_data + i * sizeof(Block));
+        if (block.offset < 0 || block.metadata_length < 8 || block.body_length < 0 ||
+            static_cast<uint64_t>(block.offset) + block.metadata_length + block.body_length > size) {
+            throw std::runtime_error("Corrupt Arrow record batch block: " + filepath);
+        }
+        const uint8_t* message = data + block.offset;
+        size_t prefix = flat_read<uint32_t>(message) == CONTINUATION_MARKER ? 8 : 4;
+        FlatTable header(message + prefix, static_cast<size_t>(block.metadata_length) - prefix);
+        std::optional<FlatTable> batch = header.table(2);
+        if (header.scalar<uint8_t>(1, 0) != HEADER_RECORD_BATCH || !batch) {
+            throw std::runtime_error("Unexpected Arrow message in record batch block: " + filepath);
+        }
+
+        BatchInfo info;
+        info.length = static_cast<size_t>(batch->scalar<int64_t>(0, 0));
+        if (std::optional<FlatTable> compression = batch->table(3)) info.codec = compression->scalar<int8_t>(0, CODEC_LZ4_FRAME);
+        size_t node_count = 0;
+        size_t buffer_count = 0;
+        const uint8_t* nodes = batch->vector(1, sizeof(FieldNode), node_count);
+        const uint8_t* buffers = batch->vector(2, sizeof(BufferSpec), buffer_count);
+        if (node_count != num_nodes || buffer_count != num_buffers) {
+            throw std::runtime_error("Arrow record batch does not match the schema: " + filepath);
+        }
+        const uint8_t* body = message + block.metadata_length;
+        for (size_t c = 0; c < NUM_COLUMNS; ++c) {
+            FieldNode node = flat_read<FieldNode>(nodes + fields[c].node * sizeof(FieldNode));
+            if (static_cast<size_t>(node.length) != info.length) throw std::runtime_error("Arrow record batch has columns of different lengths: " + filepath);
+            if (node.null_count > 0) {
+                throw std::runtime_error(std::string("Arrow column '") + COLUMN_SPECS[c].name + "' contains null values: " + filepath);
+            }
+            BufferSpec buffer = flat_read<BufferSpec>(buffers + (fields[c].buffer + 1) * sizeof(BufferSpec));
+            if (buffer.offset < 0 || buffer.length < 0 || buffer.offset + buffer.length > block.body_length) {
+                throw std::runtime_error("Corrupt Arrow buffer position: " + filepath);
+            }
+            info.data[c] = body + buffer.offset;
+            info.bytes[c] = static_cast<size_t>(buffer.length);
+        }
+        if (info.length > 0) batches.push_back(info);
+    }
+
+    // 3. 圧縮されたバッファをバッチ・列ごとに並列に展開する
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<ArrowBuffer> sources(batches.size() * NUM_COLUMNS);
+    pool.parallel_for(sources.size(), [&](size_t i) {
+        const BatchInfo& batch = batches[i / NUM_COLUMNS];
+        size_t c = i % NUM_COLUMNS;
+        sources[i] = batch.codec == CODEC_NONE ? ArrowBuffer{batch.data[c], batch.bytes[c], m_file, true}
+                                               : decompress_buffer(batch.codec, batch.data[c], batch.bytes[c], filepath);
+        if (sources[i].size < fields[c].type.bytes_for(batch.length)) {
+            throw std::runtime_error(std::string("Arrow column '") + COLUMN_SPECS[c].name + "' is shorter than its record batch: " + filepath);
+        }
+        if (!sources[i].keepalive) sources[i].keepalive = m_file;
+    });
+
+    // 4. 列を作る。型が一致して整列している列はビューにし、それ以外は変換先を確保してブロックごとに並列に変換する
+    struct ConvertTask {
+        size_t source;
+        size_t begin;
+        size_t end;
+        void* dst;
+    };
+    std::vector<ConvertTask> tasks;
+    m_batches.resize(batches.size());
+    m_batch_first.assign(1, 0);
+    for (size_t b = 0; b < batches.size(); ++b) {
+        m_batches[b].columns = EVENT_COLUMNS_ALL;
+        m_batch_first.push_back(m_batch_first.back() + batches[b].length);
+    }
+    m_num_events = m_batch_first.back();
+    auto build_column = [&](auto member, size_t c, bool exact) {
+        using T = typename std::remove_reference_t<decltype(m_batches[0].*member)>::value_type;
+        bool mapped = true;
+        for (size_t b = 0; b < batches.size(); ++b) {
+            const ArrowBuffer& source = sources[b * NUM_COLUMNS + c];
+            size_t n = batches[b].length;
+            if (exact && reinterpret_cast<uintptr_t>(source.data) % alignof(T) == 0) {
+                (m_batches[b].*member).assign_view(reinterpret_cast<const T*>(source.data), n, source.keepalive);
+                mapped = mapped && source.mapped;
+                continue;
+            }
+            auto buffer = std::make_shared<std::vector<T>>(n);
+            (m_batches[b].*member).assign_view(buffer->data(), n, buffer);
+            for (size_t lo = 0; lo < n; lo += CONVERT_BLOCK) {
+                tasks.push_back({b * NUM_COLUMNS + c, lo, std::min(n, lo + CONVERT_BLOCK), buffer->data()});
+            }
+            mapped = false;
+        }
+        if (mapped) m_mapped_columns |= COLUMN_SPECS[c].column;
+    };
+    auto is_int = [](const ArrowType& type) { return type.kind == 'i' || type.kind == 'u'; };
+    const ArrowType& tt = fields[3].type;
+    build_column(&EventStore::x, 0, is_int(fields[0].type) && fields[0].type.size == 2);
+    build_column(&EventStore::y, 1, is_int(fields[1].type) && fields[1].type.size == 2);
+    build_column(&EventStore::p, 2, fields[2].type.kind == 'u' && fields[2].type.size == 1);
+    build_column(&EventStore::t, 3, tt.size == 8 && (is_int(tt) || (tt.kind == 'M' && tt.us_mul == 1 && tt.us_div == 1)));
+
+    pool.parallel_for(tasks.size(), [&](size_t i) {
+        const ConvertTask& task = tasks[i];
+        const ArrowBuffer& source = sources[task.source];
+        const ArrowType& type = fields[task.source % NUM_COLUMNS].type;
+        switch (task.source % NUM_COLUMNS) {
+        case 0:
+        case 1:
+            convert_values(type, source.data, task.begin, task.end, static_cast<uint16_t*>(task.dst),
+                           [](auto v) { return static_cast<uint16_t>(v); });
+            break;
+        case 2: // 極性は 0/1、-1/1、bool のいずれも正なら ON とする
+            convert_values(type, source.data, task.begin, task.end, static_cast<uint8_t*>(task.dst),
+                           [](auto v) { return static_cast<uint8_t>(v > 0 ? 1 : 0); });
+            break;
+        default:
+            convert_values(type, source.data, task.begin, task.end, static_cast<int64_t*>(task.dst),
+                           [](auto v) { return to_microseconds(v); });
+            break;
+        }
+    });
+
+    std::cout << "ArrowEventReader: " << filepath << " を開きました (" << m_num_events << " イベント, "
+              << m_batches.size() << " バッチ, "
+              << (m_mapped_columns == EVENT_COLUMNS_ALL ? "mmap (ゼロコピー)" : "変換・展開あり") << ")。" << std::endl;
+}
+
+ArrowEventReader::~ArrowEventReader() = default;
+
+EventStore ArrowEventReader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    if (begin >= m_num_events) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, m_num_events - begin);
+    size_t end = begin + count;
+    size_t first = std::upper_bound(m_batch_first.begin(), m_batch_first.end(), begin) - m_batch_first.begin() - 1;
+
+    // 1つのバッチに収まる範囲はコピーしない
+    if (stride == 1 && end <= m_batch_first[first + 1]) {
+        const EventStore& batch = m_batches[first];
+        size_t offset = begin - m_batch_first[first];
+        if (events.has(EVENT_COLUMN_X)) events.x = batch.x.view(offset, count);
+        if (events.has(EVENT_COLUMN_Y)) events.y = batch.y.view(offset, count);
+        if (events.has(EVENT_COLUMN_P)) events.p = batch.p.view(offset, count);
+        if (events.has(EVENT_COLUMN_T)) events.t = batch.t.view(offset, count);
+        return events;
+    }
+
+    // バッチをまたぐ範囲は、バッチごとに並列に集める
+    size_t last = std::upper_bound(m_batch_first.begin(), m_batch_first.end(), end - 1) - m_batch_first.begin() - 1;
+    size_t out_count = (count + stride - 1) / stride;
+    events.resize(out_count);
+    uint16_t* x = events.has(EVENT_COLUMN_X) ? events.x.data() : nullptr;
+    uint16_t* y = events.has(EVENT_COLUMN_Y) ? events.y.data() : nullptr;
+    uint8_t* p = events.has(EVENT_COLUMN_P) ? events.p.data() : nullptr;
+    int64_t* t = events.has(EVENT_COLUMN_T) ? events.t.data() : nullptr;
+    ThreadPool::shared().parallel_for(last - first + 1, [&](size_t k) {
+        size_t b = first + k;
+        const EventStore& batch = m_batches[b];
+        size_t lo = std::max(begin, m_batch_first[b]);
+        size_t hi = std::min(end, m_batch_first[b + 1]);
+        // このバッチに入る出力の番号 [i_lo, i_hi)
+        size_t i_lo = (lo - begin + stride - 1) / stride;
+        size_t i_hi = (hi - begin + stride - 1) / stride;
+        auto gather = [&](auto* dst, const auto& src) {
+            if (!dst) return;
+            for (size_t i = i_lo, j = begin + i_lo * stride - m_batch_first[b]; i < i_hi; ++i, j += stride) dst[i] = src[j];
+        };
+        gather(x, batch.x);
+        gather(y, batch.y);
+        gather(p, batch.p);
+        gather(t, batch.t);
+    });
+    return events;
+}
+
+size_t ArrowEventReader::find_event_index(int64_t t) {
+    // t 以上の時刻を含む最初のバッチ
+    auto batch = std::lower_bound(m_batches.begin(), m_batches.end(), t,
+                                  [](const EventStore& b, int64_t value) { return b.t.back() < value; });
+    if (batch == m_batches.end()) return m_num_events;
+    size_t b = batch - m_batches.begin();
+    const EventStore& events = *batch;
+    return m_batch_first[b] + (std::lower_bound(events.t.begin(), events.t.end(), t) - events.t.begin());
+}
@@ -0,0 +1,214 @@
+#include "compressed_event_store.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t COORDINATE_BITS = 15;
+constexpr uint32_t COORDINATE_MASK = (1u << COORDINATE_BITS) - 1;
+
+// これ未満のイベント数の展開はスレッドに分けない
+constexpr size_t PARALLEL_DECODE_MIN_EVENTS = size_t(1) << 16;
+
+uint32_t pack_xyp(uint16_t x, uint16_t y, uint8_t p) {
+    return uint32_t(x) | (uint32_t(y) << COORDINATE_BITS) | (uint32_t(p) << (2 * COORDINATE_BITS));
+}
+
+// ブロック内の差分がすべて収まる最小のバイト数 (負の差分を含む場合は8バイトの符号付き)
+uint8_t delta_width(const int64_t* t, size_t count) {
+    int64_t max_delta = 0;
+    for (size_t i = 1; i < count; ++i) {
+        int64_t delta = t[i] - t[i - 1];
+        if (delta < 0) return 8;
+        max_delta = std::max(max_delta, delta);
+    }
+    if (max_delta <= 0xFF) return 1;
+    if (max_delta <= 0xFFFF) return 2;
+    if (max_delta <= 0xFFFFFFFFll) return 4;
+    return 8;
+}
+
+template <typename D>
+void write_deltas(const int64_t* t, size_t count, uint8_t* dst) {
+    for (size_t i = 1; i < count; ++i) {
+        D delta = static_cast<D>(t[i] - t[i - 1]);
+        std::memcpy(dst + (i - 1) * sizeof(D), &delta, sizeof(D));
+    }
+}
+
+// 差分列を累積して t を復元する。first 番目より前の差分も累積が必要なので先頭から足し込む
+template <typename D>
+void read_deltas(const uint8_t* src, int64_t t_first, size_t first, size_t count, int64_t* t) {
+    int64_t acc = t_first;
+    for (size_t i = 1; i <= first; ++i) {
+        D delta;
+        std::memcpy(&delta, src + (i - 1) * sizeof(D), sizeof(D));
+        acc += static_cast<int64_t>(delta);
+    }
+    if (count == 0) return;
+    t[0] = acc;
+    for (size_t i = 1; i < count; ++i) {
+        D delta;
+        std::memcpy(&delta, src + (first + i - 1) * sizeof(D), sizeof(D));
+        acc += static_cast<int64_t>(delta);
+        t[i] = acc;
+    }
+}
+
+} // namespace
+
+bool CompressedEventStore::can_encode(const EventStore& events) {
+    if (events.columns != EVENT_COLUMNS_ALL) return false;
+    size_t n = events.size();
+    if (events.x.size() != n || events.y.size() != n || events.p.size() != n) return false;
+    for (size_t i = 0; i < n; ++i) {
+        if (events.x[i] > MAX_COORDINATE || events.y[i] > MAX_COORDINATE || events.p[i] > 1) return false;
+    }
+    return true;
+}
+
+CompressedEventStore CompressedEventStore::encode(const EventStore& events) {
+    CompressedEventStore store;
+    store.append(events);
+    return store;
+}
+
+void CompressedEventStore::append(const EventStore& events) {
+    if (!can_encode(events)) {
+        throw std::invalid_argument("Events cannot be compressed: coordinates must fit in 15 bits and polarity must be 0/1.");
+    }
+    size_t n = events.size();
+    if (n == 0) return;
+    // ブロックは BLOCK_SIZE 個ごとに区切るので、途中までのブロックの後ろには続けられない
+    if (m_num_events % BLOCK_SIZE != 0) {
+        throw std::logic_error("CompressedEventStore: append after a partial block");
+    }
+
+    const size_t base = m_num_events;
+    const size_t first_block = m_blocks.size();
+    size_t num_blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    m_blocks.resize(first_block + num_blocks);
+    m_xyp.resize(base + n);
+    const int64_t* t = events.t.data();
+    ThreadPool& pool = ThreadPool::shared();
+
+    // 1. ブロックごとに差分の幅を決める
+    pool.parallel_for(num_blocks, [&](size_t b) {
+        size_t first = b * BLOCK_SIZE;
+        size_t count = std::min(BLOCK_SIZE, n - first);
+        m_blocks[first_block + b].t_first = t[first];
+        m_blocks[first_block + b].delta_bytes = delta_width(t + first, count);
+    });
+
+    // 2. 差分列の配置 (オフセット表) を決める
+    uint64_t offset = m_deltas.size();
+    for (size_t b = 0; b < num_blocks; ++b) {
+        size_t count = std::min(BLOCK_SIZE, n - b * BLOCK_SIZE);
+        m_blocks[first_block + b].delta_offset = offset;
+        offset += (count - 1) * m_blocks[first_block + b].delta_bytes;
+    }
+    m_deltas.resize(offset);
+
+    // 3. x/y/p の詰め込みと差分の書き込み
+    pool.parallel_for(num_blocks, [&](size_t b) {
+        size_t first = b * BLOCK_SIZE;
+        size_t count = std::min(BLOCK_SIZE, n - first);
+        for (size_t i = first; i < first + count; ++i) {
+            m_xyp[base + i] = pack_xyp(events.x[i], events.y[i], events.p[i]);
+        }
+        const Block& block = m_blocks[first_block + b];
+        uint8_t* dst = m_deltas.data() + block.delta_offset;
+        switch (block.delta_bytes) {
+            case 1: write_deltas<uint8_t>(t + first, count, dst); break;
+            case 2: write_deltas<uint16_t>(t + first, count, dst); break;
+            case 4: write_deltas<uint32_t>(t + first, count, dst); break;
+            default: write_deltas<int64_t>(t + first, count, dst); break;
+        }
+    });
+    m_num_events += n;
+    m_back_t = events.t.back();
+}
+
+void CompressedEventStore::reserve(size_t num_events) {
+    m_blocks.reserve((num_events + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    m_xyp.reserve(num_events);
+}
+
+size_t CompressedEventStore::memory_bytes() const {
+    return m_blocks.size() * sizeof(Block) + m_xyp.size() * sizeof(uint32_t) + m_deltas.size();
+}
+
+void CompressedEventStore::decode_block(size_t block, size_t first, size_t count,
+                                        uint16_t* x, uint16_t* y, uint8_t* p, int64_t* t) const {
+    const uint32_t* xyp = m_xyp.data() + block * BLOCK_SIZE + first;
+    // 単純なループにしておき、コンパイラの自動ベクトル化に任せる
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v = xyp[i];
+        x[i] = static_cast<uint16_t>(v & COORDINATE_MASK);
+        y[i] = static_cast<uint16_t>((v >> COORDINATE_BITS) & COORDINATE_MASK);
+        p[i] = static_cast<uint8_t>(v >> (2 * COORDINATE_BITS));
+    }
+    const Block& b = m_blocks[block];
+    const uint8_t* src = m_deltas.data() + b.delta_offset;
+    switch (b.delta_bytes) {
+        case 1: read_deltas<uint8_t>(src, b.t_first, first, count, t); break;
+        case 2: read_deltas<uint16_t>(src, b.t_first, first, count, t); break;
+        case 4: read_deltas<uint32_t>(src, b.t_first, first, count, t); break;
+        default: read_deltas<int64_t>(src, b.t_first, first, count, t); break;
+    }
+}
+
+EventStore CompressedEventStore::decode(size_t begin, size_t count) const {
+    EventStore events;
+    if (begin >= m_num_events) return events;
+    count = std::min(count, m_num_events - begin);
+    events.resize(count);
+    if (count == 0) return events;
+
+    uint16_t* x = events.x.data();
+    uint16_t* y = events.y.data();
+    uint8_t* p = events.p.data();
+    int64_t* t = events.t.data();
+    size_t first_block = begin / BLOCK_SIZE;
+    size_t last_block = (begin + count - 1) / BLOCK_SIZE;
+    auto decode_one = [&](size_t i) {
+        size_t b = first_block + i;
+        size_t block_begin = std::max(begin, b * BLOCK_SIZE);
+        size_t block_end = std::min(begin + count, (b + 1) * BLOCK_SIZE);
+        size_t out = block_begin - begin;
+        decode_block(b, block_begin - b * BLOCK_SIZE, block_end - block_begin, x + out, y + out, p + out, t + out);
+    };
+
+    size_t num_blocks = last_block - first_block + 1;
+    if (count >= PARALLEL_DECODE_MIN_EVENTS) {
+        ThreadPool::shared().parallel_for(num_blocks, decode_one);
+    } else {
+        for (size_t i = 0; i < num_blocks; ++i) decode_one(i);
+    }
+    return events;
+}
+
+size_t CompressedEventStore::find_event_index(int64_t t) const {
+    if (m_blocks.empty() || t > m_back_t) return m_num_events;
+    // t_first が t 以上となる最初のブロックの1つ前から探せばよい
+    auto it = std::lower_bound(m_blocks.begin(), m_blocks.end(), t,
+                               [](const Block& block, int64_t value) { return block.t_first < value; });
+    if (it == m_blocks.begin()) return 0;
+    size_t block = static_cast<size_t>(it - m_blocks.begin()) - 1;
+    size_t first = block * BLOCK_SIZE;
+    size_t count = std::min(BLOCK_SIZE, m_num_events - first);
+
+    // ブロック内の t だけを復元して二分探索する
+    int64_t t_block[BLOCK_SIZE];
+    const Block& b = m_blocks[block];
+    const uint8_t* src = m_deltas.data() + b.delta_offset;
+    switch (b.delta_bytes) {
+        case 1: read_deltas<uint8_t>(src, b.t_first, 0, count, t_block); break;
+        case 2: read_deltas<uint16_t>(src, b.t_first, 0, count, t_block); break;
+        case 4: read_deltas<uint32_t>(src, b.t_first, 0, count, t_block); break;
+        default: read_deltas<int64_t>(src, b.t_first, 0, count, t_block); break;
+    }
+    return first + (std::lower_bound(t_block, t_block + count, t) - t_block);
+}
@@ -16,38 +16,46 @@
 
 static struct cudaGraphicsResource* vbo_resource_cu = nullptr;
 
-void register_gl_buffer(GLuint vbo) {
-    CUDA_CHECK(cudaGraphicsGLRegisterBuffer(&vbo_resource_cu, vbo, cudaGraphicsRegisterFlagsWriteDiscard));
+void cuda_register_gl_buffer(GLuint vbo) {
+    // WriteDiscard だと map のたびにバッファ全体が捨てられ得る。スライスやセグメントごとに vertex_offset へ部分的に書くので None で登録する
+    CUDA_CHECK(cudaGraphicsGLRegisterBuffer(&vbo_resource_cu, vbo, cudaGraphicsRegisterFlagsNone));
 }
-void unregister_gl_buffer() {
+void cuda_unregister_gl_buffer() {
     if (vbo_resource_cu) {
         CUDA_CHECK(cudaGraphicsUnregisterResource(vbo_resource_cu));
         vbo_resource_cu = nullptr;
     }
 }
-void init_cuda_for_gl() {
+bool init_cuda_for_gl() {
+    int device_count = 0;
+    if (cudaGetDeviceCount(&device_count) != cudaSuccess || device_count == 0) {
+        cudaGetLastError(); // エラー状態を消しておく
+        std::cout << "CUDA device not available." << std::endl;
+        return false;
+    }
     CUDA_CHECK(cudaSetDevice(0));
     CUDA_CHECK(cudaFree(0));
     std::cout << "CUDA initialized for OpenGL Interop on Device 0." << std::endl;
+    return true;
 }
 
-__global__ void events_to_vertices(const EventCD* d_in, Vertex* d_out, int total_events, unsigned int* d_count, int width, int height, int64_t t_offset, double base_time, float3 color_on, float3 color_off) {
+__global__ void events_to_vertices(const uint16_t* d_x, const uint16_t* d_y, const uint8_t* d_p, const int64_t* d_t, Vertex* d_out, int total_events, int width, int height, int64_t t_offset, double base_time, float3 color_on, float3 color_off) {
     int idx = blockIdx.x * blockDim.x + threadIdx.x;
     if (idx >= total_events) return;
 
-    unsigned int write_idx = atomicAdd(d_count, 1);
+    // 入力と同じ位置に書き、頂点を時刻順に保つ
+    int write_idx = idx;
 
-    EventCD event = d_in[idx];
     Vertex v;
     // ... 座標計算は同じ ...
-    v.x = (static_cast<float>(event.x) / static_cast<float>(width) - 0.5f) * 2.0f;
-    v.y = (static_cast<float>(event.y) / static_cast<float>(height) - 0.5f) * -2.0f;
-    double absolute_time = static_cast<double>(t_offset) + event.t;
+    v.x = (static_cast<float>(d_x[idx]) / static_cast<float>(width) - 0.5f) * 2.0f;
+    v.y = (static_cast<float>(d_y[idx]) / static_cast<float>(height) - 0.5f) * -2.0f;
+    double absolute_time = static_cast<double>(t_offset) + d_t[idx];
     v.z = static_cast<float>(absolute_time - base_time);
 
     // ★★★ 色を設定から適用 ★★★
     // 0.0-1.0のfloatを0-255のuint8_tに変換
-    if (event.pol == 1) {
+    if (d_p[idx] == 1) {
         v.r = static_cast<uint8_t>(color_on.x * 255.0f);
         v.g = static_cast<uint8_t>(color_on.y * 255.0f);
         v.b = static_cast<uint8_t>(color_on.z * 255.0f);
@@ -58,29 +66,34 @@ __global__ void events_to_vertices(const EventCD* d_in, Vertex* d_out, int total
     }
     v.a = 255;
     
+    v.timestamp = v.z;
+
     d_out[write_idx] = v;
 }
 // ★★★ process_all_events関数も t_offset と base_time を受け取るように修正 ★★★
-unsigned int process_all_events(const std::vector<EventCD>& all_events, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors) {
+unsigned int cuda_process_all_events(const EventStore& all_events, size_t vertex_offset, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors) {
     if (all_events.empty() || !vbo_resource_cu) return 0;
-    
-    std::cout << "--- 全イベントのCUDA処理を開始..." << std::endl;
-    EventCD* d_events = nullptr;
-    size_t data_size = all_events.size() * sizeof(EventCD);
-    CUDA_CHECK(cudaMalloc(&d_events, data_size));
 
-    std::cout << "--- CPUからGPUへのデータ転送を開始 (" 
-              << data_size / (1024 * 1024) << " MB)... ---" << std::endl;
-    CUDA_CHECK(cudaMemcpy(d_events, all_events.data(), data_size, cudaMemcpyHostToDevice));
-    std::cout << "--- データ転送完了。カーネルを実行します ---" << std::endl;
-
-    unsigned int* d_count = nullptr;
-    CUDA_CHECK(cudaMalloc(&d_count, sizeof(unsigned int)));
-    CUDA_CHECK(cudaMemset(d_count, 0, sizeof(unsigned int)));
+    // SoAの各列をそのままGPUへ転送する (AoSへの詰め替えは不要)
+    size_t n = all_events.size();
+    uint16_t* d_x = nullptr;
+    uint16_t* d_y = nullptr;
+    uint8_t* d_p = nullptr;
+    int64_t* d_t = nullptr;
+    CUDA_CHECK(cudaMalloc(&d_x, n * sizeof(uint16_t)));
+    CUDA_CHECK(cudaMalloc(&d_y, n * sizeof(uint16_t)));
+    CUDA_CHECK(cudaMalloc(&d_p, n * sizeof(uint8_t)));
+    CUDA_CHECK(cudaMalloc(&d_t, n * sizeof(int64_t)));
+
+    CUDA_CHECK(cudaMemcpy(d_x, all_events.x.data(), n * sizeof(uint16_t), cudaMemcpyHostToDevice));
+    CUDA_CHECK(cudaMemcpy(d_y, all_events.y.data(), n * sizeof(uint16_t), cudaMemcpyHostToDevice));
+    CUDA_CHECK(cudaMemcpy(d_p, all_events.p.data(), n * sizeof(uint8_t), cudaMemcpyHostToDevice));
+    CUDA_CHECK(cudaMemcpy(d_t, all_events.t.data(), n * sizeof(int64_t), cudaMemcpyHostToDevice));
 
     Vertex* d_vbo_ptr = nullptr;
     CUDA_CHECK(cudaGraphicsMapResources(1, &vbo_resource_cu, 0));
     CUDA_CHECK(cudaGraphicsResourceGetMappedPointer((void**)&d_vbo_ptr, nullptr, vbo_resource_cu));
+    d_vbo_ptr += vertex_offset;
 
     int threads = 256;
     int blocks = (all_events.size() + threads - 1) / threads;
@@ -90,17 +103,17 @@ unsigned int process_all_events(const std::vector<EventCD>& all_events, int widt
     float3 color_off = make_float3(colors.event_off.r, colors.event_off.g, colors.event_off.b);
 
     // ★★★ カーネル呼び出し時に色情報を渡す ★★★
-    events_to_vertices<<<blocks, threads>>>(d_events, d_vbo_ptr, all_events.size(), d_count, width, height, t_offset, base_time, color_on, color_off);
+    events_to_vertices<<<blocks, threads>>>(d_x, d_y, d_p, d_t, d_vbo_ptr, n, width, height, t_offset, base_time, color_on, color_off);
     CUDA_CHECK(cudaDeviceSynchronize());
 
     CUDA_CHECK(cudaGraphicsUnmapResources(1, &vbo_resource_cu, 0));
 
-    unsigned int final_count = 0;
-    CUDA_CHECK(cudaMemcpy(&final_count, d_count, sizeof(unsigned int), cudaMemcpyDeviceToHost));
-    
-    CUDA_CHECK(cudaFree(d_count));
-    CUDA_CHECK(cudaFree(d_events));
+    unsigned int final_count = static_cast<unsigned int>(n);
+
+    CUDA_CHECK(cudaFree(d_x));
+    CUDA_CHECK(cudaFree(d_y));
+    CUDA_CHECK(cudaFree(d_p));
+    CUDA_CHECK(cudaFree(d_t));
 
-    std::cout << "--- CUDA処理完了: " << final_count << "個の頂点を生成 ---" << std::endl;
     return final_count;
 }
\ No newline at end of file
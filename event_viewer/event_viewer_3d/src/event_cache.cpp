@@ -0,0 +1,276 @@
+#include "event_cache.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = {'E', 'V', 'C', 'A', 'C', 'H', 'E', '\0'};
+constexpr uint32_t CACHE_VERSION = 2;
+// 列ブロックの配置単位。実行環境のページサイズに依存しないよう固定値にする
+constexpr uint64_t CACHE_ALIGNMENT = 4096;
+constexpr const char* CACHE_EXTENSION = ".evcache";
+
+enum CacheSectionId {
+    SECTION_X = 0, SECTION_Y, SECTION_P, SECTION_T, SECTION_MS_TO_IDX,
+    SECTION_TIME_BUCKETS, SECTION_TIME_OFFSETS, // TimeIndex
+    NUM_SECTIONS
+};
+
+struct CacheSection {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// ファイル先頭の1ページに置くヘッダ
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+    uint64_t num_events;
+    int64_t t_offset;
+    int64_t t_first;
+    int64_t t_last;
+    int32_t width;
+    int32_t height;
+    int64_t index_base_ms;
+    int64_t time_index_base;
+    int32_t time_index_shift;
+    uint32_t reserved;
+    uint64_t source_size;
+    int64_t source_mtime;
+    CacheSection sections[NUM_SECTIONS];
+    char source_path[2048];
+};
+static_assert(sizeof(CacheHeader) <= CACHE_ALIGNMENT, "CacheHeader must fit in the first page");
+
+struct SourceKey {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+// variant (読み込み方法の設定) が違えば同じファイルでも別のキャッシュになる
+SourceKey make_source_key(const fs::path& source_path, const std::string& variant) {
+    SourceKey key;
+    key.path = fs::canonical(source_path).string();
+    if (!variant.empty()) key.path += "#" + variant;
+    key.size = fs::file_size(source_path);
+    key.mtime = static_cast<int64_t>(fs::last_write_time(source_path).time_since_epoch().count());
+    return key;
+}
+
+uint64_t fnv1a(const std::string& text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t align_up(uint64_t value) {
+    return (value + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+// 現在位置を次のブロック境界までゼロで埋めてからデータを書き込む
+CacheSection write_section(std::ofstream& out, const void* data, uint64_t bytes) {
+    static const char zeros[CACHE_ALIGNMENT] = {};
+    uint64_t pos = static_cast<uint64_t>(out.tellp());
+    uint64_t aligned = align_up(pos);
+    out.write(zeros, static_cast<std::streamsize>(aligned - pos));
+    if (bytes > 0) out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    return {aligned, bytes};
+}
+
+template <typename T>
+bool assign_section(ColumnBuffer<T>& column, const CacheHeader& header, CacheSectionId id, uint64_t expected_count,
+                    const std::shared_ptr<MappedFile>& mapped) {
+    const CacheSection& section = header.sections[id];
+    if (section.bytes != expected_count * sizeof(T) || section.offset % CACHE_ALIGNMENT != 0 ||
+        section.offset + section.bytes > mapped->size()) {
+        return false;
+    }
+    column.assign_view(reinterpret_cast<const T*>(mapped->data() + section.offset), expected_count, mapped);
+    return true;
+}
+
+} // namespace
+
+EventCache::EventCache(EventCacheConfig config) : m_config(std::move(config)) {
+    if (m_config.directory.empty()) {
+        m_config.directory = default_directory();
+    }
+}
+
+fs::path EventCache::default_directory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return fs::path(xdg) / "event_viewer";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return fs::path(home) / ".cache" / "event_viewer";
+    }
+    return fs::temp_directory_path() / "event_viewer_cache";
+}
+
+fs::path EventCache::cache_path_for(const fs::path& source_path) const {
+    SourceKey key = make_source_key(source_path, m_config.source_variant);
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0')
+         << fnv1a(key.path + '\n' + std::to_string(key.size) + '\n' + std::to_string(key.mtime)) << CACHE_EXTENSION;
+    return m_config.directory / name.str();
+}
+
+std::optional<CachedRecording> EventCache::open(const fs::path& source_path) const {
+    if (!m_config.enabled) return std::nullopt;
+    try {
+        SourceKey key = make_source_key(source_path, m_config.source_variant);
+        fs::path path = cache_path_for(source_path);
+        if (!fs::exists(path)) return std::nullopt;
+
+        std::shared_ptr<MappedFile> mapped = MappedFile::open(path.string());
+        if (mapped->size() < sizeof(CacheHeader)) return std::nullopt;
+        CacheHeader header;
+        std::memcpy(&header, mapped->data(), sizeof(header));
+        header.source_path[sizeof(header.source_path) - 1] = '\0';
+
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+            header.alignment != CACHE_ALIGNMENT || header.source_size != key.size || header.source_mtime != key.mtime ||
+            key.path != header.source_path) {
+            return std::nullopt;
+        }
+
+        CachedRecording recording;
+        uint64_t n = header.num_events;
+        uint64_t index_count = header.sections[SECTION_MS_TO_IDX].bytes / sizeof(uint64_t);
+        uint64_t bucket_count = header.sections[SECTION_TIME_BUCKETS].bytes / sizeof(uint64_t);
+        ColumnBuffer<uint64_t> time_buckets;
+        ColumnBuffer<uint16_t> time_offsets;
+        if (!assign_section(recording.events.x, header, SECTION_X, n, mapped) ||
+            !assign_section(recording.events.y, header, SECTION_Y, n, mapped) ||
+            !assign_section(recording.events.p, header, SECTION_P, n, mapped) ||
+            !assign_section(recording.events.t, header, SECTION_T, n, mapped) ||
+            !assign_section(recording.ms_to_idx, header, SECTION_MS_TO_IDX, index_count, mapped) ||
+            !assign_section(time_buckets, header, SECTION_TIME_BUCKETS, bucket_count, mapped) ||
+            !assign_section(time_offsets, header, SECTION_TIME_OFFSETS, n, mapped) || bucket_count == 0 ||
+            header.time_index_shift < 0 || header.time_index_shift > TimeIndex::MAX_BUCKET_SHIFT) {
+            std::cerr << "Warning: Ignoring corrupt event cache: " << path << std::endl;
+            return std::nullopt;
+        }
+        recording.index_base_ms = header.index_base_ms;
+        recording.time_index = TimeIndex(header.time_index_base, header.time_index_shift, std::move(time_buckets), std::move(time_offsets));
+        recording.t_offset = header.t_offset;
+        recording.resolution = {header.width, header.height};
+
+        // 最後に使われた時刻を更新し、容量超過時に削除されにくくする
+        std::error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+        std::cout << "--- Opened event cache: " << path.string() << " (" << n << " events, "
+                  << (header.t_last - header.t_first) / 1e6 << " s) ---" << std::endl;
+        return recording;
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Could not open event cache: " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
+void EventCache::store(const fs::path& source_path, const CachedRecording& recording) const {
+    if (!m_config.enabled) return;
+    const EventStore& events = recording.events;
+    if (events.empty() || events.columns != EVENT_COLUMNS_ALL || recording.time_index.size() != events.size()) return;
+
+    fs::path tmp_path;
+    try {
+        SourceKey key = make_source_key(source_path, m_config.source_variant);
+        fs::create_directories(m_config.directory);
+        fs::path path = cache_path_for(source_path);
+        tmp_path = path;
+        tmp_path += ".tmp." + std::to_string(::getpid());
+
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.alignment = CACHE_ALIGNMENT;
+        header.num_events = events.size();
+        header.t_offset = recording.t_offset;
+        header.t_first = events.t.front();
+        header.t_last = events.t.back();
+        header.width = recording.resolution.width;
+        header.height = recording.resolution.height;
+        header.index_base_ms = recording.index_base_ms;
+        header.time_index_base = recording.time_index.t_base();
+        header.time_index_shift = recording.time_index.bucket_shift();
+        header.source_size = key.size;
+        header.source_mtime = key.mtime;
+        if (key.path.size() >= sizeof(header.source_path)) return;
+        std::strncpy(header.source_path, key.path.c_str(), sizeof(header.source_path) - 1);
+
+        std::cout << "--- Writing event cache: " << path.string() << " ---" << std::endl;
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("cannot create " + tmp_path.string());
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            size_t n = events.size();
+            header.sections[SECTION_X] = write_section(out, events.x.data(), n * sizeof(uint16_t));
+            header.sections[SECTION_Y] = write_section(out, events.y.data(), n * sizeof(uint16_t));
+            header.sections[SECTION_P] = write_section(out, events.p.data(), n * sizeof(uint8_t));
+            header.sections[SECTION_T] = write_section(out, events.t.data(), n * sizeof(int64_t));
+            header.sections[SECTION_MS_TO_IDX] = write_section(out, recording.ms_to_idx.data(), recording.ms_to_idx.size() * sizeof(uint64_t));
+            const TimeIndex& time_index = recording.time_index;
+            header.sections[SECTION_TIME_BUCKETS] = write_section(out, time_index.buckets().data(), time_index.buckets().size() * sizeof(uint64_t));
+            header.sections[SECTION_TIME_OFFSETS] = write_section(out, time_index.offsets().data(), n * sizeof(uint16_t));
+            // セクション表が確定したのでヘッダを書き直す
+            out.seekp(0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (!out) throw std::runtime_error("write failed for " + tmp_path.string());
+        }
+        // 書き込み途中のファイルを他の起動が開かないよう、完成してから置き換える
+        fs::rename(tmp_path, path);
+        evict(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Could not write event cache: " << e.what() << std::endl;
+        // 書きかけのファイルは evict() の対象にならないので、ここで消す
+        if (!tmp_path.empty()) {
+            std::error_code ec;
+            fs::remove(tmp_path, ec);
+        }
+    }
+}
+
+void EventCache::evict(const fs::path& keep) const {
+    if (m_config.max_size_bytes == 0) return;
+
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type last_used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(m_config.directory, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != CACHE_EXTENSION) continue;
+        Entry e{entry.path(), entry.file_size(), entry.last_write_time()};
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+    if (total <= m_config.max_size_bytes) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+    for (const Entry& e : entries) {
+        if (total <= m_config.max_size_bytes) break;
+        if (e.path == keep) continue;
+        if (fs::remove(e.path, ec)) {
+            total -= e.size;
+            std::cout << "--- Evicted event cache: " << e.path.string() << " ---" << std::endl;
+        }
+    }
+}
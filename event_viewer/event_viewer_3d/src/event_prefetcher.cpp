@@ -0,0 +1,160 @@
+#include "event_prefetcher.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// ホスト側で1イベントが使うバイト数 (x, y: uint16, p: uint8, t: int64)
+constexpr size_t HOST_BYTES_PER_EVENT = 2 * sizeof(uint16_t) + sizeof(uint8_t) + sizeof(int64_t);
+// 表示中のウィンドウと先読みの最低限を確保するためのセグメント数の下限
+constexpr size_t MIN_SEGMENTS = 4;
+// 読むべきセグメントが無いときに再生位置の変化を待つ間隔
+constexpr auto IDLE_WAIT = std::chrono::milliseconds(1);
+// 先読みの展開に使うスレッド数 (残りは描画スレッドの並列処理に空けておく)
+const size_t DECODE_THREADS = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+} // namespace
+
+EventPrefetcher::EventPrefetcher(std::unique_ptr<EventSource> source, const PrefetchConfig& config)
+    : m_source(std::move(source)), m_config(config), m_decode_pool(DECODE_THREADS) {
+    m_config.segment_events = std::max<size_t>(1, m_config.segment_events);
+    m_config.stride = std::max<size_t>(1, m_config.stride);
+
+    m_num_events = m_source->num_events();
+    m_t_offset = m_source->load_t_offset();
+    if (m_num_events > 0) {
+        m_t_first = m_source->read_events(0, 1, EVENT_COLUMN_T).t.front();
+        m_t_last = m_source->read_events(m_num_events - 1, 1, EVENT_COLUMN_T).t.front();
+    }
+    size_t span = m_config.segment_events * m_config.stride;
+    m_num_segments = (m_num_events + span - 1) / span;
+    m_live.assign(m_num_segments, false);
+
+    size_t pool_size = m_config.max_buffer_bytes / (m_config.segment_events * HOST_BYTES_PER_EVENT);
+    pool_size = std::min(std::max(pool_size, MIN_SEGMENTS), std::max<size_t>(1, m_num_segments));
+    for (size_t i = 0; i < pool_size; ++i) {
+        m_pool.push_back(std::make_unique<EventSegment>());
+        m_free.push_back(m_pool.back().get());
+    }
+    // プール内のセグメントしか流れないので、キューが満杯になることはない
+    m_ready = std::make_unique<SpscQueue<EventSegment*>>(pool_size);
+    m_released = std::make_unique<SpscQueue<EventSegment*>>(pool_size);
+
+    std::cout << "--- Streaming " << m_num_events << " events: " << pool_size << " segments x "
+              << m_config.segment_events << " events, lookahead " << m_config.lookahead_ms << " ms ---" << std::endl;
+    m_worker = std::thread(&EventPrefetcher::worker_loop, this);
+}
+
+EventPrefetcher::~EventPrefetcher() {
+    m_stop.store(true, std::memory_order_relaxed);
+    if (m_worker.joinable()) m_worker.join();
+}
+
+void EventPrefetcher::update(const PlaybackRequest& request) {
+    m_playhead_us.store(request.playhead_us, std::memory_order_relaxed);
+    m_window_us.store(request.window_us, std::memory_order_relaxed);
+    m_speed.store(request.speed, std::memory_order_relaxed);
+    m_reversed.store(request.reversed, std::memory_order_relaxed);
+}
+
+EventSegment* EventPrefetcher::poll() {
+    if (m_failed.load(std::memory_order_acquire)) std::rethrow_exception(m_error);
+    EventSegment* segment = nullptr;
+    m_ready->try_pop(segment);
+    return segment;
+}
+
+void EventPrefetcher::release(EventSegment* segment) {
+    m_released->try_push(segment);
+}
+
+TimeRange EventPrefetcher::wanted_range(const PlaybackRequest& request) const {
+    int64_t ahead_us = static_cast<int64_t>(m_config.lookahead_ms * 1000.0 * std::abs(request.speed));
+    int64_t window_begin = request.playhead_us - request.window_us;
+    if (request.reversed) return {window_begin - ahead_us, request.playhead_us};
+    return {window_begin, request.playhead_us + ahead_us};
+}
+
+void EventPrefetcher::worker_loop() {
+    ThreadPool::Scope decode_scope(m_decode_pool);
+    try {
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            EventSegment* returned = nullptr;
+            while (m_released->try_pop(returned)) {
+                m_live[returned->index] = false;
+                returned->events.clear();
+                m_free.push_back(returned);
+            }
+
+            PlaybackRequest request;
+            request.playhead_us = m_playhead_us.load(std::memory_order_relaxed);
+            request.window_us = m_window_us.load(std::memory_order_relaxed);
+            request.speed = m_speed.load(std::memory_order_relaxed);
+            request.reversed = m_reversed.load(std::memory_order_relaxed);
+
+            size_t index = 0;
+            if (m_free.empty() || !next_segment(request, index)) {
+                std::this_thread::sleep_for(IDLE_WAIT);
+                continue;
+            }
+            EventSegment* segment = m_free.back();
+            m_free.pop_back();
+            load_segment(index, *segment);
+            m_live[index] = true;
+            m_ready->try_push(segment);
+        }
+    } catch (...) {
+        m_error = std::current_exception();
+        m_failed.store(true, std::memory_order_release);
+    }
+}
+
+bool EventPrefetcher::next_segment(const PlaybackRequest& request, size_t& index) {
+    if (m_num_segments == 0) return false;
+    TimeRange range = wanted_range(request);
+    // 再生位置が変わったときだけ時刻からセグメント番号を引き直す
+    if (!m_plan.valid || m_plan.range.begin != range.begin || m_plan.range.end != range.end ||
+        m_plan.playhead_us != request.playhead_us) {
+        size_t lo = m_source->find_event_index(range.begin);
+        size_t hi = m_source->find_event_index(range.end);
+        size_t play = m_source->find_event_index(request.playhead_us);
+        size_t span = m_config.segment_events * m_config.stride;
+        m_plan.valid = true;
+        m_plan.range = range;
+        m_plan.playhead_us = request.playhead_us;
+        m_plan.empty = (lo >= hi);
+        if (!m_plan.empty) {
+            m_plan.first = lo / span;
+            m_plan.last = (hi - 1) / span;
+            // 再生位置の直前 (表示中のウィンドウの最新側) のセグメントから読み始める
+            m_plan.anchor = std::clamp<size_t>(play > 0 ? (play - 1) / span : 0, m_plan.first, m_plan.last);
+        }
+    }
+    if (m_plan.empty) return false;
+    size_t first = m_plan.first;
+    size_t last = m_plan.last;
+    size_t anchor = m_plan.anchor;
+
+    // 1. 表示中のウィンドウ (逆再生ではその先の先読み範囲も) を新しい側から
+    for (size_t s = anchor + 1; s-- > first;) {
+        if (!m_live[s]) { index = s; return true; }
+    }
+    // 2. 順再生の先読み範囲を近い側から
+    for (size_t s = anchor + 1; s <= last; ++s) {
+        if (!m_live[s]) { index = s; return true; }
+    }
+    return false;
+}
+
+void EventPrefetcher::load_segment(size_t index, EventSegment& segment) {
+    size_t span = m_config.segment_events * m_config.stride;
+    size_t begin = index * span;
+    size_t count = std::min(span, m_num_events - begin);
+    segment.index = index;
+    segment.events = m_source->read_events(begin, count, EVENT_COLUMNS_ALL, m_config.stride);
+    const EventStore& events = segment.events;
+    segment.t_first = events.empty() ? 0 : events.t.front();
+    segment.t_last = events.empty() ? 0 : events.t.back();
+}
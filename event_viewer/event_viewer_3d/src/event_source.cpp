@@ -0,0 +1,188 @@
+#include "event_source.h"
+#include "aedat4_reader.h"
+#include "arrow_ipc.h"
+#include "hdf5_loader.h"
+#include "event_file.h"
+#include "numpy_reader.h"
+#include "prophesee_raw.h"
+#include "text_event_reader.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// µs を ms に切り捨てる (負の値でも床関数になるようにする)
+int64_t floor_to_ms(int64_t t_us) {
+    return (t_us >= 0) ? t_us / 1000 : -((-t_us + 999) / 1000);
+}
+
+std::string lower_extension(const std::string& filepath) {
+    std::string ext = std::filesystem::path(filepath).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+} // namespace
+
+unsigned event_column_from_name(const std::string& name) {
+    std::string n = name;
+    std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (n == "x") return EVENT_COLUMN_X;
+    if (n == "y") return EVENT_COLUMN_Y;
+    if (n == "p" || n == "pol" || n == "polarity" || n == "polarities") return EVENT_COLUMN_P;
+    if (n == "t" || n == "ts" || n == "timestamp" || n == "timestamps" || n == "time") return EVENT_COLUMN_T;
+    return 0;
+}
+
+std::unique_ptr<EventSource> open_event_source(const std::string& filepath, const HDF5Schema& hdf5_schema) {
+    std::string ext = lower_extension(filepath);
+    if (ext == ".h5" || ext == ".hdf5" || ext == ".hdf") {
+        return std::make_unique<HDF5Loader>(filepath, hdf5_schema);
+    }
+    if (ext == EventFileReader::EXTENSION) {
+        return std::make_unique<EventFileReader>(filepath);
+    }
+    if (ext == PropheseeRawReader::EXTENSION) {
+        return std::make_unique<PropheseeRawReader>(filepath);
+    }
+    if (ext == Aedat4Reader::EXTENSION) {
+        return std::make_unique<Aedat4Reader>(filepath);
+    }
+    if (ext == NumpyReader::NPY_EXTENSION || ext == NumpyReader::NPZ_EXTENSION) {
+        return std::make_unique<NumpyReader>(filepath);
+    }
+    if (ext == TextEventReader::EXTENSION) {
+        return std::make_unique<TextEventReader>(filepath);
+    }
+    if (ext == ArrowEventReader::EXTENSION || ext == ArrowEventReader::FEATHER_EXTENSION || ext == ArrowEventReader::IPC_EXTENSION) {
+        return std::make_unique<ArrowEventReader>(filepath);
+    }
+    throw std::runtime_error("Unsupported event file format: " + filepath);
+}
+
+std::vector<RGBFrame> load_embedded_frames(const std::string& filepath) {
+    std::string ext = lower_extension(filepath);
+    if (ext == Aedat4Reader::EXTENSION) {
+        return Aedat4Reader::load_frames(filepath);
+    }
+    if (ext == NumpyReader::NPY_EXTENSION || ext == NumpyReader::NPZ_EXTENSION) {
+        return NumpyReader::load_frames(filepath);
+    }
+    return {};
+}
+
+EventStore EventSource::load_all_events(unsigned columns) {
+    size_t total = num_events();
+    if (total == 0) {
+        std::cout << "イベントデータが空です。" << std::endl;
+        EventStore empty;
+        empty.columns = columns;
+        return empty;
+    }
+    std::cout << "--- " << total << " 個のイベントを読み込み開始..." << std::endl;
+    EventStore events = read_events(0, total, columns);
+    std::cout << "--- 読み込み完了 ---" << std::endl;
+    return events;
+}
+
+size_t EventSource::find_event_index(int64_t t) {
+    load_time_index();
+    size_t total = num_events();
+    if (total == 0) return 0;
+
+    // t が属するミリ秒バケット [lo, hi) を O(1) で求める
+    int64_t ms = floor_to_ms(t) - m_index_base_ms;
+    if (ms < 0) return 0;
+    if (static_cast<uint64_t>(ms) >= m_ms_to_idx.size()) return total;
+    size_t lo = m_ms_to_idx[ms];
+    size_t hi = (static_cast<uint64_t>(ms) + 1 < m_ms_to_idx.size()) ? m_ms_to_idx[ms + 1] : total;
+    if (lo >= hi || t == (ms + m_index_base_ms) * 1000) return lo;
+
+    // バケット内のタイムスタンプだけを1回で読み込んで二分探索する
+    const EventStore bucket = read_events(lo, hi - lo, EVENT_COLUMN_T);
+    return lo + (std::lower_bound(bucket.t.begin(), bucket.t.end(), t) - bucket.t.begin());
+}
+
+const std::vector<uint64_t>& EventSource::ms_to_idx() {
+    load_time_index();
+    return m_ms_to_idx;
+}
+
+int64_t EventSource::time_index_base_ms() {
+    load_time_index();
+    return m_index_base_ms;
+}
+
+void EventSource::load_time_index() {
+    if (m_time_index_ready) return;
+    m_time_index_ready = true;
+    build_time_index();
+}
+
+void EventSource::build_time_index() {
+    m_ms_to_idx.clear();
+    m_index_base_ms = 0;
+    size_t total = num_events();
+    if (total == 0) return;
+
+    std::cout << "--- 時間インデックスを構築中..." << std::endl;
+    int64_t first_t = read_events(0, 1, EVENT_COLUMN_T).t.front();
+    int64_t last_t = read_events(total - 1, 1, EVENT_COLUMN_T).t.front();
+    // DSECと同様に t=0 基準とし、tが絶対時刻のファイルのみ先頭ミリ秒を基準にする
+    m_index_base_ms = (first_t >= 0 && static_cast<uint64_t>(first_t / 1000) < MAX_TIME_INDEX_ENTRIES) ? 0 : floor_to_ms(first_t);
+    uint64_t span_ms = static_cast<uint64_t>(floor_to_ms(last_t) - m_index_base_ms) + 1;
+    if (last_t < first_t || span_ms > MAX_TIME_INDEX_ENTRIES) {
+        throw std::runtime_error("Timestamps are not monotonic or span too long to index.");
+    }
+    m_ms_to_idx.reserve(span_ms);
+
+    int64_t next_ms = 0;
+    for (size_t begin = 0; begin < total; begin += DEFAULT_CHUNK_SIZE) {
+        // t 列だけを読み込めばよいので x/y/p には触れない
+        const ColumnBuffer<int64_t> t_vec = read_events(begin, DEFAULT_CHUNK_SIZE, EVENT_COLUMN_T).t;
+        for (size_t i = 0; i < t_vec.size(); ++i) {
+            int64_t ms = floor_to_ms(t_vec[i]) - m_index_base_ms;
+            while (next_ms <= ms) {
+                m_ms_to_idx.push_back(begin + i);
+                ++next_ms;
+            }
+        }
+    }
+    std::cout << "--- 時間インデックスを構築しました (" << m_ms_to_idx.size() << " ms) ---" << std::endl;
+}
+
+EventStore EventSource::read_range(int64_t t_begin, int64_t t_end, unsigned columns) {
+    if (t_end <= t_begin) {
+        EventStore empty;
+        empty.columns = columns;
+        return empty;
+    }
+    size_t begin = find_event_index(t_begin);
+    size_t end = find_event_index(t_end);
+    return read_events(begin, end - begin, columns);
+}
+
+EventChunkIterator EventSource::chunks(size_t chunk_size, int64_t t_begin, int64_t t_end, unsigned columns) {
+    size_t begin = (t_begin == std::numeric_limits<int64_t>::min()) ? 0 : find_event_index(t_begin);
+    size_t end = (t_end == std::numeric_limits<int64_t>::max()) ? num_events() : find_event_index(t_end);
+    return EventChunkIterator(*this, begin, std::max(begin, end), chunk_size, columns);
+}
+
+// --- EventChunkIterator ---
+
+EventChunkIterator::EventChunkIterator(EventSource& source, size_t begin, size_t end, size_t chunk_size, unsigned columns)
+    : m_source(source), m_pos(begin), m_end(end), m_chunk_size(std::max<size_t>(1, chunk_size)), m_columns(columns) {}
+
+bool EventChunkIterator::next(EventStore& chunk) {
+    if (m_pos >= m_end) {
+        chunk.clear();
+        return false;
+    }
+    size_t count = std::min(m_chunk_size, m_end - m_pos);
+    chunk = m_source.read_events(m_pos, count, m_columns);
+    m_pos += count;
+    return !chunk.empty();
+}
@@ -1,11 +1,247 @@
 #include "hdf5_loader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <cmath>
+#include <future>
+#include <type_traits>
 #include <H5DataSpace.h>
 #include <H5DataType.h>
 
-HDF5Loader::HDF5Loader(const std::string& filepath)
-    : file(filepath, H5F_ACC_RDONLY) {
-    std::cout << "HDF5Loader: " << filepath << " を開きました。" << std::endl;
+namespace {
+
+// 1次元データセットの begin から stride 個おきに count 要素をハイパースラブ選択で dst に読み込む
+void read_hyperslab(const H5::DataSet& dset, const H5::PredType& mem_type, void* dst, size_t begin, size_t count, size_t stride = 1) {
+    H5::DataSpace file_space = dset.getSpace();
+    hsize_t offset[1] = {static_cast<hsize_t>(begin)};
+    hsize_t dims[1] = {static_cast<hsize_t>(count)};
+    hsize_t step[1] = {static_cast<hsize_t>(stride)};
+    file_space.selectHyperslab(H5S_SELECT_SET, dims, offset, step);
+    H5::DataSpace mem_space(1, dims);
+    dset.read(dst, mem_type, mem_space, file_space);
+}
+
+// これ未満のイベント数の読み込みは HDF5 のチャンクキャッシュが効く通常経路の方が速い
+constexpr size_t PARALLEL_READ_MIN_EVENTS = size_t(1) << 18;
+
+// 並列チャンク展開を試し、使えなければ通常のハイパースラブ読み込みを行う
+template <typename T>
+void read_column(const H5::DataSet& dset, const HDF5ChunkReader& reader, const H5::PredType& mem_type, T* dst, size_t begin, size_t count, size_t stride) {
+    if (stride == 1 && count >= PARALLEL_READ_MIN_EVENTS && reader.read(dst, begin, count)) {
+        return;
+    }
+    read_hyperslab(dset, mem_type, dst, begin, count, stride);
+}
+
+// 連続配置・フィルタなし・メモリ上と同じ型のデータセットなら、ファイル上のバイト列をそのまま mmap する
+// 条件を満たさなければ nullptr を返し、通常の読み込みを使う
+std::shared_ptr<MappedFile> map_contiguous_dataset(const H5::H5File& file, const std::string& filepath,
+                                                   const H5::DataSet& dset, const H5::PredType& mem_type) {
+    // H5Dget_offset が実ファイル上のバイト位置になるのは既定の sec2 ドライバのときだけ
+    if (file.getAccessPlist().getDriver() != H5FD_SEC2) return nullptr;
+    H5::DSetCreatPropList plist = dset.getCreatePlist();
+    if (plist.getLayout() != H5D_CONTIGUOUS || plist.getNfilters() != 0) return nullptr;
+    if (!(dset.getDataType() == mem_type)) return nullptr;
+
+    haddr_t offset = H5Dget_offset(dset.getId());
+    if (offset == HADDR_UNDEF) return nullptr; // 領域が未割り当て
+    size_t elem_size = mem_type.getSize();
+    if (offset % elem_size != 0) return nullptr; // 要素境界に揃っていなければ直接参照できない
+    size_t num_elements = dset.getSpace().getSelectNpoints();
+    if (dset.getStorageSize() != num_elements * elem_size) return nullptr;
+    return MappedFile::open(filepath, offset, num_elements * elem_size);
+}
+
+// mmap 済みの列はビューとして返し (ストライドなしの場合)、それ以外は読み込む
+template <typename T>
+void load_column(ColumnBuffer<T>& column, const std::shared_ptr<MappedFile>& mapped, const H5::DataSet& dset,
+                 const HDF5ChunkReader& reader, const H5::PredType& mem_type, size_t begin, size_t count, size_t stride) {
+    if (mapped && stride == 1) {
+        column.assign_view(reinterpret_cast<const T*>(mapped->data()) + begin, count, mapped);
+        return;
+    }
+    column.resize(count);
+    read_column(dset, reader, mem_type, column.data(), begin, count, stride);
+}
+
+// --- ファイル上の型ごとに特殊化した変換 ---
+// ファイル上の型・時刻の単位の組み合わせごとにループを実体化し、データセットを開いたときに関数ポインタとして選ぶ
+// (HDF5 の汎用の型変換を通さず、読み込みは memcpy と単純な変換ループだけになる)
+
+enum class ColumnRole { COORD, POLARITY, TIME };
+
+template <typename Src, TimeUnit UNIT>
+inline int64_t to_microseconds(Src value) {
+    if constexpr (std::is_floating_point_v<Src>) {
+        constexpr double scale = UNIT == TimeUnit::SECONDS ? 1e6 : UNIT == TimeUnit::MILLISECONDS ? 1e3 :
+                                 UNIT == TimeUnit::MICROSECONDS ? 1.0 : 1e-3;
+        return static_cast<int64_t>(std::llround(static_cast<double>(value) * scale));
+    } else if constexpr (UNIT == TimeUnit::SECONDS) {
+        return static_cast<int64_t>(value) * 1000000;
+    } else if constexpr (UNIT == TimeUnit::MILLISECONDS) {
+        return static_cast<int64_t>(value) * 1000;
+    } else if constexpr (UNIT == TimeUnit::NANOSECONDS) {
+        return static_cast<int64_t>(value) / 1000;
+    } else {
+        return static_cast<int64_t>(value);
+    }
+}
+
+// stride バイトおきに並んだ Src 型の値 n 個を列の型 Dst に変換する
+template <typename Src, typename Dst, ColumnRole ROLE, TimeUnit UNIT>
+void decode_values(const uint8_t* src, size_t stride, size_t n, Dst* dst) {
+    for (size_t i = 0; i < n; ++i) {
+        Src value;
+        std::memcpy(&value, src + i * stride, sizeof(Src));
+        if constexpr (ROLE == ColumnRole::POLARITY) {
+            dst[i] = value > 0 ? 1 : 0; // 0 / 1 と -1 / 1 のどちらも正を ON とする
+        } else if constexpr (ROLE == ColumnRole::TIME) {
+            dst[i] = to_microseconds<Src, UNIT>(value);
+        } else {
+            dst[i] = static_cast<Dst>(value);
+        }
+    }
+}
+
+template <typename Dst>
+using DecodeFn = void (*)(const uint8_t* src, size_t stride, size_t n, Dst* dst);
+
+// メモリ上の (ネイティブの) 型 type に対応する変換を選ぶ。数値型でなければ nullptr
+template <typename Dst, ColumnRole ROLE, TimeUnit UNIT>
+DecodeFn<Dst> select_decoder(hid_t type) {
+    size_t size = H5Tget_size(type);
+    switch (H5Tget_class(type)) {
+    case H5T_INTEGER: {
+        bool is_signed = H5Tget_sign(type) == H5T_SGN_2;
+        switch (size) {
+        case 1: return is_signed ? &decode_values<int8_t, Dst, ROLE, UNIT> : &decode_values<uint8_t, Dst, ROLE, UNIT>;
+        case 2: return is_signed ? &decode_values<int16_t, Dst, ROLE, UNIT> : &decode_values<uint16_t, Dst, ROLE, UNIT>;
+        case 4: return is_signed ? &decode_values<int32_t, Dst, ROLE, UNIT> : &decode_values<uint32_t, Dst, ROLE, UNIT>;
+        case 8: return is_signed ? &decode_values<int64_t, Dst, ROLE, UNIT> : &decode_values<uint64_t, Dst, ROLE, UNIT>;
+        default: return nullptr;
+        }
+    }
+    case H5T_FLOAT:
+        if (size == sizeof(float)) return &decode_values<float, Dst, ROLE, UNIT>;
+        if (size == sizeof(double)) return &decode_values<double, Dst, ROLE, UNIT>;
+        return nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+DecodeFn<int64_t> select_time_decoder(hid_t type, TimeUnit unit) {
+    switch (unit) {
+    case TimeUnit::SECONDS: return select_decoder<int64_t, ColumnRole::TIME, TimeUnit::SECONDS>(type);
+    case TimeUnit::MILLISECONDS: return select_decoder<int64_t, ColumnRole::TIME, TimeUnit::MILLISECONDS>(type);
+    case TimeUnit::MICROSECONDS: return select_decoder<int64_t, ColumnRole::TIME, TimeUnit::MICROSECONDS>(type);
+    case TimeUnit::NANOSECONDS: return select_decoder<int64_t, ColumnRole::TIME, TimeUnit::NANOSECONDS>(type);
+    }
+    return nullptr;
+}
+
+// path のオブジェクトがあるか (途中のグループが無くても例外にしない)
+bool path_exists(const H5::H5File& file, const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        if (!file.nameExists(path.substr(0, slash))) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+// H5Tget_native_type などで得た型IDを閉じる
+struct NativeType {
+    hid_t id = H5I_INVALID_HID;
+    explicit NativeType(hid_t type) : id(type) {}
+    NativeType(const NativeType&) = delete;
+    NativeType& operator=(const NativeType&) = delete;
+    ~NativeType() {
+        if (id >= 0) H5Tclose(id);
+    }
+};
+
+// compound のレコードを一度に読み込む数 (読み込みと展開を2つのバッファで交互に行う)
+constexpr size_t COMPOUND_BLOCK_RECORDS = size_t(1) << 20;
+// 展開を1スレッドに割り当てる単位 (レコード数)
+constexpr size_t DECODE_BLOCK = size_t(1) << 16;
+
+// 1次元データセットの begin から stride 個おきに count 要素を、メモリ上の型 mem_type のまま dst に読み込む
+void read_raw(hid_t dset, hid_t mem_type, void* dst, size_t begin, size_t count, size_t stride) {
+    hid_t file_space = H5Dget_space(dset);
+    hsize_t offset[1] = {static_cast<hsize_t>(begin)};
+    hsize_t dims[1] = {static_cast<hsize_t>(count)};
+    hsize_t step[1] = {static_cast<hsize_t>(stride)};
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset, step, dims, nullptr);
+    hid_t mem_space = H5Screate_simple(1, dims, nullptr);
+    herr_t status = H5Dread(dset, mem_type, mem_space, file_space, H5P_DEFAULT, dst);
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+    if (status < 0) throw std::runtime_error("H5Dread failed");
+}
+
+// ms_to_idx サイドカーファイルのヘッダ
+struct TimeIndexSidecarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_events;
+    int64_t base_ms;
+    uint64_t count;
+    uint64_t schema_hash;   // 構築に使ったスキーマ (HDF5Schema::describe()) の FNV-1a
+};
+constexpr char TIME_INDEX_MAGIC[8] = {'E', 'V', 'M', 'S', 'I', 'D', 'X', '\0'};
+constexpr uint32_t TIME_INDEX_VERSION = 2;
+// スキーマを変えて開き直したとき (別の t データセット・時刻の単位など) に古いインデックスを使わないための値
+uint64_t schema_hash(const HDF5Schema& schema) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : schema.describe()) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+std::string time_index_sidecar_path(const std::string& filepath) {
+    return filepath + ".ms_to_idx";
+}
+
+} // namespace
+
+struct HDF5Loader::CompoundLayout {
+    NativeType record_type;  // ファイル上のレコードに対応するメモリ上の型
+    size_t record_size = 0;
+    size_t x_offset = 0, y_offset = 0, p_offset = 0, t_offset = 0;
+    DecodeFn<uint16_t> x = nullptr;
+    DecodeFn<uint16_t> y = nullptr;
+    DecodeFn<uint8_t> p = nullptr;
+    DecodeFn<int64_t> t = nullptr;
+
+    explicit CompoundLayout(hid_t type) : record_type(type) {}
+};
+
+struct HDF5Loader::TimeConversion {
+    NativeType file_type;  // t のデータセットに対応するメモリ上の型
+    DecodeFn<int64_t> decode = nullptr;
+
+    explicit TimeConversion(hid_t type) : file_type(type) {}
+};
+
+HDF5Loader::HDF5Loader(const std::string& filepath, const HDF5Schema& schema)
+    : m_filepath(filepath), file(filepath, H5F_ACC_RDONLY), m_schema(schema) {
+    if (m_schema.layout == HDF5Schema::Layout::AUTO) {
+        if (path_exists(file, "/events/x")) {
+            m_schema = HDF5Schema::dsec();
+        } else if (path_exists(file, "/CD/events")) {
+            m_schema = HDF5Schema::metavision();
+        } else {
+            throw std::runtime_error("HDF5 file has neither /events/{x,y,p,t} nor /CD/events (set hdf5_schema in the config): " + filepath);
+        }
+    }
+    std::cout << "HDF5Loader: " << filepath << " を開きました ("
+              << (m_schema.layout == HDF5Schema::Layout::COMPOUND ? "compound: " + m_schema.events : "列ごとのデータセット") << ")。" << std::endl;
 }
 
 HDF5Loader::~HDF5Loader() {
@@ -13,8 +249,9 @@ HDF5Loader::~HDF5Loader() {
 }
 
 int64_t HDF5Loader::load_t_offset() {
+    if (m_schema.t_offset.empty() || !path_exists(file, m_schema.t_offset)) return 0;
     try {
-        H5::DataSet dset = file.openDataSet("/t_offset");
+        H5::DataSet dset = file.openDataSet(m_schema.t_offset);
         int64_t offset = 0;
         dset.read(&offset, H5::PredType::NATIVE_INT64);
         std::cout << "--- t_offset: " << offset << " を読み込みました ---" << std::endl;
@@ -25,10 +262,46 @@ int64_t HDF5Loader::load_t_offset() {
     }
 }
 
-std::vector<EventCD> HDF5Loader::load_all_events() {
+std::optional<Resolution> HDF5Loader::resolution() {
+    // 整数の属性 name を読む (無い、または整数でなければ 0)
+    auto read_attribute = [](const H5::H5Object& object, const char* name) -> long long {
+        if (!object.attrExists(name)) return 0;
+        H5::Attribute attribute = object.openAttribute(name);
+        if (attribute.getTypeClass() != H5T_INTEGER || attribute.getSpace().getSimpleExtentNpoints() != 1) return 0;
+        long long value = 0;
+        attribute.read(H5::PredType::NATIVE_LLONG, &value);
+        return value;
+    };
+    std::string events = m_schema.layout == HDF5Schema::Layout::COMPOUND ? m_schema.events : m_schema.x;
+    size_t slash = events.find_last_of('/');
+    std::string group = slash == std::string::npos || slash == 0 ? "/" : events.substr(0, slash);
+    try {
+        for (const std::string& path : {events, group, std::string("/")}) {
+            if (path.empty() || (path != "/" && !path_exists(file, path))) continue;
+            long long width = 0;
+            long long height = 0;
+            if (path != "/" && file.childObjType(path) == H5O_TYPE_DATASET) {
+                H5::DataSet dset = file.openDataSet(path);
+                width = read_attribute(dset, "width");
+                height = read_attribute(dset, "height");
+            } else {
+                H5::Group object = file.openGroup(path);
+                width = read_attribute(object, "width");
+                height = read_attribute(object, "height");
+            }
+            if (width > 0 && height > 0 && width <= 65536 && height <= 65536) {
+                return Resolution{static_cast<int>(width), static_cast<int>(height)};
+            }
+        }
+    } catch (H5::Exception&) {
+        // 属性が読めなければ記録されていないものとして扱う
+    }
+    return std::nullopt;
+}
+
+EventStore HDF5Loader::load_all_events(unsigned columns) {
     try {
-        H5::DataSet x_dset = file.openDataSet("/events/x");
-        size_t num_events = x_dset.getSpace().getSelectNpoints();
+        size_t num_events = this->num_events();
 
         if (num_events == 0) {
             std::cout << "イベントデータが空です。" << std::endl;
@@ -36,22 +309,8 @@ std::vector<EventCD> HDF5Loader::load_all_events() {
         }
 
         std::cout << "--- " << num_events << " 個のイベントを読み込み開始..." << std::endl;
-        std::vector<uint16_t> x_vec(num_events), y_vec(num_events);
-        std::vector<uint32_t> t_vec(num_events);
-        std::vector<uint8_t> p_vec(num_events);
-
-        x_dset.read(x_vec.data(), H5::PredType::NATIVE_UINT16);
-        file.openDataSet("/events/y").read(y_vec.data(), H5::PredType::NATIVE_UINT16);
-        file.openDataSet("/events/t").read(t_vec.data(), H5::PredType::NATIVE_UINT32);
-        file.openDataSet("/events/p").read(p_vec.data(), H5::PredType::NATIVE_UINT8);
+        EventStore events = read_events(0, num_events, columns);
         std::cout << "--- HDF5からの読み込み完了 ---" << std::endl;
-
-        std::vector<EventCD> events(num_events);
-        for (size_t i = 0; i < num_events; ++i) {
-            events[i] = {x_vec[i], y_vec[i], p_vec[i], t_vec[i]};
-        }
-        
-        std::cout << "--- イベントデータを構造体にまとめました ---" << std::endl;
         return events;
 
     } catch (H5::Exception& err) {
@@ -59,4 +318,250 @@ std::vector<EventCD> HDF5Loader::load_all_events() {
         err.printErrorStack();
         return {};
     }
-}
\ No newline at end of file
+}
+
+void HDF5Loader::open_event_datasets() {
+    if (m_datasets_open) return;
+    if (m_schema.layout == HDF5Schema::Layout::COMPOUND) {
+        open_compound_dataset();
+        return;
+    }
+    m_x_dset = file.openDataSet(m_schema.x);
+    m_y_dset = file.openDataSet(m_schema.y);
+    m_t_dset = file.openDataSet(m_schema.t);
+    m_p_dset = file.openDataSet(m_schema.p);
+    m_num_events = m_x_dset.getSpace().getSelectNpoints();
+
+    // t が µs の整数でなければ、ファイル上の型と単位に合った変換を選んでおく
+    if (m_t_dset.getTypeClass() != H5T_INTEGER || m_schema.time_unit != TimeUnit::MICROSECONDS) {
+        m_t_conversion = std::make_unique<TimeConversion>(H5Tget_native_type(m_t_dset.getDataType().getId(), H5T_DIR_ASCEND));
+        m_t_conversion->decode = select_time_decoder(m_t_conversion->file_type.id, m_schema.time_unit);
+        if (!m_t_conversion->decode) throw std::runtime_error("Unsupported data type for t: " + m_schema.t);
+    }
+    m_x_reader = std::make_unique<HDF5ChunkReader>(m_x_dset);
+    m_y_reader = std::make_unique<HDF5ChunkReader>(m_y_dset);
+    m_t_reader = std::make_unique<HDF5ChunkReader>(m_t_dset);
+    m_p_reader = std::make_unique<HDF5ChunkReader>(m_p_dset);
+    m_datasets_open = true;
+
+    // 非圧縮の連続データセットはファイルを直接 mmap し、読み込みもコピーも行わない
+    try {
+        m_x_map = map_contiguous_dataset(file, m_filepath, m_x_dset, H5::PredType::NATIVE_UINT16);
+        m_y_map = map_contiguous_dataset(file, m_filepath, m_y_dset, H5::PredType::NATIVE_UINT16);
+        if (!m_t_conversion) m_t_map = map_contiguous_dataset(file, m_filepath, m_t_dset, H5::PredType::NATIVE_INT64);
+        m_p_map = map_contiguous_dataset(file, m_filepath, m_p_dset, H5::PredType::NATIVE_UINT8);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: mmap に失敗したため通常の読み込みを使います: " << e.what() << std::endl;
+        m_x_map = m_y_map = m_t_map = m_p_map = nullptr;
+    }
+
+    if (is_memory_mapped(EVENT_COLUMNS_ALL)) {
+        std::cout << "--- 読み込み: mmap (ゼロコピー) ---" << std::endl;
+        return;
+    }
+    bool all_parallel = m_x_reader->supported() && m_y_reader->supported() && m_t_reader->supported() && m_p_reader->supported();
+    std::cout << "--- チャンク展開: " << (all_parallel ? "並列 (H5Dread_chunk)" : "HDF5フィルタパイプライン") << " ---" << std::endl;
+}
+
+void HDF5Loader::open_compound_dataset() {
+    m_events_dset = file.openDataSet(m_schema.events);
+    if (m_events_dset.getTypeClass() != H5T_COMPOUND) throw std::runtime_error("Not a compound dataset: " + m_schema.events);
+    m_num_events = m_events_dset.getSpace().getSelectNpoints();
+
+    // ファイル上のレコードをそのまま (バイト順だけネイティブにして) 読み込む型と、メンバの位置・変換を求める
+    auto layout = std::make_unique<CompoundLayout>(H5Tget_native_type(m_events_dset.getDataType().getId(), H5T_DIR_ASCEND));
+    hid_t record = layout->record_type.id;
+    layout->record_size = H5Tget_size(record);
+    auto find_member = [&](const std::string& name, size_t& offset) {
+        int index = H5Tget_member_index(record, name.c_str());
+        if (index < 0) throw std::runtime_error("Compound dataset " + m_schema.events + " has no member '" + name + "'");
+        offset = H5Tget_member_offset(record, static_cast<unsigned>(index));
+        return std::make_shared<NativeType>(H5Tget_member_type(record, static_cast<unsigned>(index)));
+    };
+    auto x_type = find_member(m_schema.x, layout->x_offset);
+    auto y_type = find_member(m_schema.y, layout->y_offset);
+    auto p_type = find_member(m_schema.p, layout->p_offset);
+    auto t_type = find_member(m_schema.t, layout->t_offset);
+    layout->x = select_decoder<uint16_t, ColumnRole::COORD, TimeUnit::MICROSECONDS>(x_type->id);
+    layout->y = select_decoder<uint16_t, ColumnRole::COORD, TimeUnit::MICROSECONDS>(y_type->id);
+    layout->p = select_decoder<uint8_t, ColumnRole::POLARITY, TimeUnit::MICROSECONDS>(p_type->id);
+    layout->t = select_time_decoder(t_type->id, m_schema.time_unit);
+    if (!layout->x || !layout->y || !layout->p || !layout->t) {
+        throw std::runtime_error("Unsupported member data type in compound dataset " + m_schema.events);
+    }
+    m_compound = std::move(layout);
+    m_datasets_open = true;
+    std::cout << "--- 読み込み: compound (" << m_compound->record_size << " バイト/イベント) ---" << std::endl;
+}
+
+bool HDF5Loader::is_memory_mapped(unsigned columns) {
+    open_event_datasets();
+    if (m_compound) return false;
+    return (!(columns & EVENT_COLUMN_X) || m_x_map) && (!(columns & EVENT_COLUMN_Y) || m_y_map) &&
+           (!(columns & EVENT_COLUMN_P) || m_p_map) && (!(columns & EVENT_COLUMN_T) || m_t_map);
+}
+
+size_t HDF5Loader::num_events() {
+    open_event_datasets();
+    return m_num_events;
+}
+
+EventStore HDF5Loader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    open_event_datasets();
+    EventStore events;
+    events.columns = columns;
+    if (begin >= m_num_events) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, m_num_events - begin);
+    size_t out_count = (count + stride - 1) / stride;
+    if (out_count == 0) return events;
+
+    if (m_compound) {
+        read_compound(begin, out_count, stride, events);
+        return events;
+    }
+
+    // 各列をそのまま読み込む (mmap 可能な列はビューを返す)。t はファイル上の型に関係なく64bitに変換される
+    if (events.has(EVENT_COLUMN_X)) load_column(events.x, m_x_map, m_x_dset, *m_x_reader, H5::PredType::NATIVE_UINT16, begin, out_count, stride);
+    if (events.has(EVENT_COLUMN_Y)) load_column(events.y, m_y_map, m_y_dset, *m_y_reader, H5::PredType::NATIVE_UINT16, begin, out_count, stride);
+    if (events.has(EVENT_COLUMN_P)) load_column(events.p, m_p_map, m_p_dset, *m_p_reader, H5::PredType::NATIVE_UINT8, begin, out_count, stride);
+    if (events.has(EVENT_COLUMN_T)) {
+        if (m_t_conversion) {
+            read_converted_time(events.t, begin, out_count, stride);
+        } else {
+            load_column(events.t, m_t_map, m_t_dset, *m_t_reader, H5::PredType::NATIVE_INT64, begin, out_count, stride);
+        }
+    }
+    return events;
+}
+
+void HDF5Loader::read_converted_time(ColumnBuffer<int64_t>& column, size_t begin, size_t count, size_t stride) {
+    size_t elem_size = H5Tget_size(m_t_conversion->file_type.id);
+    std::vector<uint8_t> raw(count * elem_size);
+    read_raw(m_t_dset.getId(), m_t_conversion->file_type.id, raw.data(), begin, count, stride);
+    column.resize(count);
+    int64_t* dst = column.data();
+    ThreadPool::shared().parallel_for((count + DECODE_BLOCK - 1) / DECODE_BLOCK, [&](size_t b) {
+        size_t lo = b * DECODE_BLOCK;
+        size_t hi = std::min(count, lo + DECODE_BLOCK);
+        m_t_conversion->decode(raw.data() + lo * elem_size, elem_size, hi - lo, dst + lo);
+    });
+}
+
+void HDF5Loader::read_compound(size_t begin, size_t count, size_t stride, EventStore& events) {
+    const CompoundLayout& layout = *m_compound;
+    const size_t record_size = layout.record_size;
+    events.resize(count);
+    uint16_t* x = events.has(EVENT_COLUMN_X) ? events.x.data() : nullptr;
+    uint16_t* y = events.has(EVENT_COLUMN_Y) ? events.y.data() : nullptr;
+    uint8_t* p = events.has(EVENT_COLUMN_P) ? events.p.data() : nullptr;
+    int64_t* t = events.has(EVENT_COLUMN_T) ? events.t.data() : nullptr;
+
+    // 次のブロックの読み込み (HDF5) と現在のブロックの展開を重ねて実行する
+    // HDF5 を呼ぶのは常に読み込み側の1スレッドだけなので、スレッドセーフでないビルドでも問題ない
+    const hid_t dset = m_events_dset.getId();
+    const hid_t record_type = layout.record_type.id;
+    std::vector<uint8_t> current(std::min(count, COMPOUND_BLOCK_RECORDS) * record_size);
+    std::vector<uint8_t> next(current.size());
+    read_raw(dset, record_type, current.data(), begin, std::min(count, COMPOUND_BLOCK_RECORDS), stride);
+    for (size_t done = 0; done < count; done += COMPOUND_BLOCK_RECORDS) {
+        size_t n = std::min(COMPOUND_BLOCK_RECORDS, count - done);
+        size_t next_done = done + n;
+        std::future<void> reading;
+        if (next_done < count) {
+            size_t next_n = std::min(COMPOUND_BLOCK_RECORDS, count - next_done);
+            reading = std::async(std::launch::async, [&, next_done, next_n] {
+                read_raw(dset, record_type, next.data(), begin + next_done * stride, next_n, stride);
+            });
+        }
+        const uint8_t* records = current.data();
+        ThreadPool::shared().parallel_for((n + DECODE_BLOCK - 1) / DECODE_BLOCK, [&](size_t b) {
+            size_t lo = b * DECODE_BLOCK;
+            size_t len = std::min(n, lo + DECODE_BLOCK) - lo;
+            const uint8_t* src = records + lo * record_size;
+            size_t out = done + lo;
+            if (x) layout.x(src + layout.x_offset, record_size, len, x + out);
+            if (y) layout.y(src + layout.y_offset, record_size, len, y + out);
+            if (p) layout.p(src + layout.p_offset, record_size, len, p + out);
+            if (t) layout.t(src + layout.t_offset, record_size, len, t + out);
+        });
+        if (reading.valid()) reading.get();
+        std::swap(current, next);
+    }
+}
+
+void HDF5Loader::load_time_index() {
+    if (m_time_index_ready) return;
+    open_event_datasets();
+    m_time_index_ready = true;
+
+    // 1. DSECファイルに含まれる /ms_to_idx を使う (時刻が µs の場合のみ)
+    if (!m_schema.ms_to_idx.empty() && m_schema.time_unit == TimeUnit::MICROSECONDS && path_exists(file, m_schema.ms_to_idx)) {
+        H5::DataSet dset = file.openDataSet(m_schema.ms_to_idx);
+        m_ms_to_idx.resize(dset.getSpace().getSelectNpoints());
+        if (!m_ms_to_idx.empty()) {
+            dset.read(m_ms_to_idx.data(), H5::PredType::NATIVE_UINT64);
+        }
+        m_index_base_ms = 0;
+        std::cout << "--- " << m_schema.ms_to_idx << " を読み込みました (" << m_ms_to_idx.size() << " ms) ---" << std::endl;
+        return;
+    }
+
+    // 2. 以前に構築したサイドカーファイルを使う
+    if (load_time_index_sidecar()) {
+        std::cout << "--- サイドカーの時間インデックスを読み込みました (" << m_ms_to_idx.size() << " ms) ---" << std::endl;
+        return;
+    }
+
+    // 3. タイムスタンプを1パスで走査して構築し、次回のために保存する
+    build_time_index();
+    save_time_index_sidecar();
+}
+
+bool HDF5Loader::load_time_index_sidecar() {
+    namespace fs = std::filesystem;
+    std::string path = time_index_sidecar_path(m_filepath);
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return false;
+    // 元ファイルの方が新しければ古いインデックスとみなす
+    if (fs::last_write_time(path, ec) < fs::last_write_time(m_filepath, ec)) return false;
+
+    std::ifstream in(path, std::ios::binary);
+    TimeIndexSidecarHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, TIME_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TIME_INDEX_VERSION || header.num_events != m_num_events ||
+        header.schema_hash != schema_hash(m_schema) || header.count > MAX_TIME_INDEX_ENTRIES) {
+        return false;
+    }
+    std::vector<uint64_t> index(header.count);
+    if (!in.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(uint64_t))) return false;
+
+    m_ms_to_idx = std::move(index);
+    m_index_base_ms = header.base_ms;
+    return true;
+}
+
+void HDF5Loader::save_time_index_sidecar() const {
+    std::string path = time_index_sidecar_path(m_filepath);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Warning: 時間インデックスを保存できませんでした: " << path << std::endl;
+        return;
+    }
+    TimeIndexSidecarHeader header{};
+    std::memcpy(header.magic, TIME_INDEX_MAGIC, sizeof(header.magic));
+    header.version = TIME_INDEX_VERSION;
+    header.num_events = m_num_events;
+    header.base_ms = m_index_base_ms;
+    header.count = m_ms_to_idx.size();
+    header.schema_hash = schema_hash(m_schema);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(m_ms_to_idx.data()), m_ms_to_idx.size() * sizeof(uint64_t));
+    if (!out) {
+        std::cerr << "Warning: 時間インデックスの書き込みに失敗しました: " << path << std::endl;
+        out.close();
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+}
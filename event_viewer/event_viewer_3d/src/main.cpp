@@ -1,7 +1,13 @@
-#include "hdf5_loader.h"
+#include "event_source.h"
+#include "event_cache.h"
+#include "time_index.h"
+#include "compressed_event_store.h"
+#include "event_prefetcher.h"
 #include "renderer.h"
+#include "vertex_processor.h"
 #include "image_loader.h"
 #include "yaml-cpp/yaml.h"
+#include <H5Cpp.h>
 #include "types.h"
 #include <iostream>
 #include <string>
@@ -9,9 +15,9 @@
 #include <stdexcept>
 #include <algorithm>
 #include <filesystem>
+#include <optional>
 
 // 必要な前方宣言や構造体定義
-struct EventCD;
 struct RGBFrame;
 
 namespace fs = std::filesystem;
@@ -24,11 +30,32 @@ struct CLIConfig {
     int downsample_factor = 1;
 };
 
+// 読み込んだイベントと描画に必要なメタデータ
+struct LoadedEvents {
+    EventStore events;
+    TimeIndex time_index; // キャッシュから読んだとき・読み込みながら圧縮したときだけ持つ (空ならレンダラが頂点化と同時に作る)
+    int64_t t_offset = 0;
+    Resolution resolution;
+    std::optional<CompressedEventStore> compressed; // 読み込みながらチャンクごとに圧縮した場合のイベント (events は空)
+};
+
 // --- 関数のプロトタイプ宣言 ---
 
 CLIConfig parse_arguments(int argc, char* argv[]);
-std::vector<EventCD> downsample_events(const std::vector<EventCD>& all_events, int factor);
-Resolution calculate_resolution(const std::vector<EventCD>& events);
+EventCacheConfig load_cache_config(const YAML::Node& master_config, const fs::path& config_dir);
+HDF5Schema load_hdf5_schema(const YAML::Node& master_config);
+std::optional<PrefetchConfig> load_prefetch_config(const YAML::Node& master_config, int factor);
+LoadedEvents load_events(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const EventCacheConfig& cache_config, int factor, bool compress);
+bool load_events_compressed(EventSource& source, int factor, LoadedEvents& loaded);
+std::optional<Resolution> load_streaming_resolution(const YAML::Node& master_config);
+std::unique_ptr<EventPrefetcher> open_streaming(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const PrefetchConfig& prefetch_config, const std::optional<Resolution>& configured, Resolution& resolution);
+EventStore load_events_downsampled(EventSource& source, int factor);
+EventStore downsample_events(EventStore events, int factor);
+Resolution calculate_resolution(const EventStore& events);
+Resolution estimate_resolution(EventSource& source);
+bool compression_requested(const YAML::Node& master_config);
+bool should_compress_events(const YAML::Node& master_config, const EventStore& events);
+CompressedEventStore compress_events(const EventStore& events);
 
 
 // --- main関数 ---
@@ -68,30 +95,41 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        // 3. HDF5ファイルパスをYAMLから取得し、イベントを読み込む
+        // 頂点の生成に使うバックエンド (auto / cpu / cuda)
+        if (master_config["rendering"] && master_config["rendering"]["vertex_backend"]) {
+            std::optional<VertexBackend> backend = parse_vertex_backend(master_config["rendering"]["vertex_backend"].as<std::string>());
+            if (!backend) throw std::runtime_error("'rendering.vertex_backend' must be auto, cpu or cuda.");
+            set_vertex_backend(*backend);
+        }
+
+        // 3. イベントファイル (HDF5、.evb、Prophesee の .raw、AEDAT4、NumPy の .npy / .npz、events.txt または Arrow の .arrow / .feather) のパスをYAMLから取得
         if (!master_config["event_file"]) {
             throw std::runtime_error("'event_file' not found in master config.");
         }
-        fs::path h5_filepath = cli_config.config_filepath.parent_path() / master_config["event_file"].as<std::string>();
+        fs::path event_filepath = cli_config.config_filepath.parent_path() / master_config["event_file"].as<std::string>();
         
-        HDF5Loader h5_loader(h5_filepath.string());
-        int64_t t_offset = h5_loader.load_t_offset();
-        std::vector<EventCD> all_events = h5_loader.load_all_events();
+        // 4. キャッシュがあれば mmap で開き、なければファイルから列ごとに読み込む (必要に応じてダウンサンプリング)
+        //    ストリーミング再生ではファイルを開くだけで、イベントは再生しながら先読みする
+        //    HDF5 は 'hdf5_schema' の配置で読む (無ければ DSEC形式か Metavision かを判定する)
+        std::optional<PrefetchConfig> prefetch_config = load_prefetch_config(master_config, cli_config.downsample_factor);
+        HDF5Schema hdf5_schema = load_hdf5_schema(master_config);
+        std::unique_ptr<EventPrefetcher> prefetcher;
+        LoadedEvents loaded;
+        if (prefetch_config) {
+            prefetcher = open_streaming(event_filepath, hdf5_schema, *prefetch_config, load_streaming_resolution(master_config), loaded.resolution);
+        } else {
+            EventCacheConfig cache_config = load_cache_config(master_config, cli_config.config_filepath.parent_path());
+            cache_config.source_variant = hdf5_schema.describe();
+            loaded = load_events(event_filepath, hdf5_schema, cache_config, cli_config.downsample_factor, compression_requested(master_config));
 
-        if (all_events.empty()) {
-            std::cerr << "Error: No events found in the HDF5 file." << std::endl;
-            return -1;
-        }
-
-        // 4. イベントデータをダウンサンプリング
-        std::vector<EventCD> events_to_render = downsample_events(all_events, cli_config.downsample_factor);
-
-        if (events_to_render.empty()) {
-             std::cerr << "Error: No events to render after downsampling." << std::endl;
-             return -1;
+            if (loaded.compressed ? loaded.compressed->empty() : loaded.events.empty()) {
+                 std::cerr << "Error: No events to render after downsampling." << std::endl;
+                 return -1;
+            }
         }
 
         // 5. RGB画像データを読み込み (YAMLに 'rgb_images' セクションが指定されていれば)
+        //    指定が無ければ、イベントファイルに埋め込まれた画像 (AEDAT4 の APS フレーム、.npz の frames) を使う
         std::vector<RGBFrame> all_images;
         if (master_config["rgb_images"]) {
             YAML::Node rgb_config_node = master_config["rgb_images"];
@@ -107,14 +145,26 @@ int main(int argc, char* argv[]) {
             // 組み立てた設定を渡してImageLoaderを初期化
             ImageLoader image_loader(image_loader_config);
             all_images = image_loader.load_image_data();
+        } else {
+            all_images = load_embedded_frames(event_filepath.string());
         }
 
-        // 6. データからセンサーの解像度を計算
-        Resolution resolution = calculate_resolution(events_to_render);
+        // 6. センサーの解像度 (キャッシュのメタデータ、またはデータから計算したもの)
+        const Resolution& resolution = loaded.resolution;
         std::cout << "--- Detected resolution: " << resolution.width << "x" << resolution.height << " ---" << std::endl;
 
-        // 7. レンダラーを実行
-        run_renderer(events_to_render, all_images, resolution.width, resolution.height, t_offset, color_config);
+        // 7. レンダラーを実行 (設定に応じてイベントを圧縮表現で保持する)
+        if (prefetcher) {
+            run_renderer(*prefetcher, all_images, resolution.width, resolution.height, color_config);
+        } else if (loaded.compressed) {
+            run_renderer(*loaded.compressed, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, color_config);
+        } else if (should_compress_events(master_config, loaded.events)) {
+            CompressedEventStore compressed = compress_events(loaded.events);
+            loaded.events.clear();
+            run_renderer(compressed, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, color_config);
+        } else {
+            run_renderer(loaded.events, std::move(loaded.time_index), all_images, resolution.width, resolution.height, loaded.t_offset, color_config);
+        }
 
 
     } catch (const H5::Exception& err) {
@@ -154,28 +204,275 @@ CLIConfig parse_arguments(int argc, char* argv[]) {
     return config;
 }
 
-std::vector<EventCD> downsample_events(const std::vector<EventCD>& all_events, int factor) {
+EventCacheConfig load_cache_config(const YAML::Node& master_config, const fs::path& config_dir) {
+    EventCacheConfig config;
+    if (!master_config["cache"]) {
+        return config;
+    }
+    YAML::Node cache_node = master_config["cache"];
+    if (cache_node["enabled"]) config.enabled = cache_node["enabled"].as<bool>();
+    if (cache_node["directory"]) {
+        std::string directory = cache_node["directory"].as<std::string>();
+        // 相対パスはYAMLファイルからの相対パスとして扱う
+        if (!directory.empty()) config.directory = config_dir / directory;
+    }
+    if (cache_node["max_size_gb"]) {
+        config.max_size_bytes = static_cast<uint64_t>(cache_node["max_size_gb"].as<double>() * (1ull << 30));
+    }
+    return config;
+}
+
+HDF5Schema load_hdf5_schema(const YAML::Node& master_config) {
+    if (!master_config["hdf5_schema"]) {
+        return {};
+    }
+    YAML::Node schema_node = master_config["hdf5_schema"];
+    // 配置ごとの既定値から始め、指定された項目だけを上書きする
+    std::string layout = schema_node["layout"] ? schema_node["layout"].as<std::string>()
+                                               : (schema_node["events"] ? "compound" : "columns");
+    HDF5Schema schema;
+    if (layout == "columns") {
+        schema = HDF5Schema::dsec();
+    } else if (layout == "compound") {
+        schema = HDF5Schema::metavision();
+    } else {
+        throw std::runtime_error("'hdf5_schema.layout' must be 'columns' or 'compound'.");
+    }
+    auto set = [&](const char* key, std::string& value) {
+        if (schema_node[key]) value = schema_node[key].as<std::string>();
+    };
+    set("events", schema.events);
+    set("x", schema.x);
+    set("y", schema.y);
+    set("p", schema.p);
+    set("t", schema.t);
+    set("t_offset", schema.t_offset);
+    set("ms_to_idx", schema.ms_to_idx);
+    if (schema_node["time_unit"]) {
+        std::optional<TimeUnit> unit = parse_time_unit(schema_node["time_unit"].as<std::string>());
+        if (!unit) throw std::runtime_error("'hdf5_schema.time_unit' must be one of s, ms, us, ns.");
+        schema.time_unit = *unit;
+    }
+    return schema;
+}
+
+std::optional<PrefetchConfig> load_prefetch_config(const YAML::Node& master_config, int factor) {
+    if (!master_config["streaming"] || !master_config["streaming"]["enabled"] ||
+        !master_config["streaming"]["enabled"].as<bool>()) {
+        return std::nullopt;
+    }
+    YAML::Node streaming_node = master_config["streaming"];
+    PrefetchConfig config;
+    if (streaming_node["lookahead_ms"]) config.lookahead_ms = streaming_node["lookahead_ms"].as<double>();
+    if (streaming_node["buffer_mb"]) {
+        config.max_buffer_bytes = static_cast<size_t>(streaming_node["buffer_mb"].as<double>() * (1ull << 20));
+    }
+    config.stride = static_cast<size_t>(factor);
+    return config;
+}
+
+// streaming.resolution ([幅, 高さ]) の指定があれば返す
+std::optional<Resolution> load_streaming_resolution(const YAML::Node& master_config) {
+    if (!master_config["streaming"] || !master_config["streaming"]["resolution"]) {
+        return std::nullopt;
+    }
+    YAML::Node node = master_config["streaming"]["resolution"];
+    Resolution resolution{node[0].as<int>(), node[1].as<int>()};
+    if (resolution.width <= 0 || resolution.height <= 0) {
+        throw std::runtime_error("'streaming.resolution' must be [width, height].");
+    }
+    return resolution;
+}
+
+std::unique_ptr<EventPrefetcher> open_streaming(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const PrefetchConfig& prefetch_config, const std::optional<Resolution>& configured, Resolution& resolution) {
+    std::unique_ptr<EventSource> source = open_event_source(event_filepath.string(), hdf5_schema);
+    if (source->num_events() == 0) {
+        throw std::runtime_error("No events found in the event file.");
+    }
+    // 設定、ファイルに記録された解像度の順に使い、どちらも無ければ一部のイベントから推定する (ファイル全体は走査しない)
+    std::optional<Resolution> stored = configured ? configured : source->resolution();
+    resolution = stored ? *stored : estimate_resolution(*source);
+    return std::make_unique<EventPrefetcher>(std::move(source), prefetch_config);
+}
+
+LoadedEvents load_events(const fs::path& event_filepath, const HDF5Schema& hdf5_schema, const EventCacheConfig& cache_config, int factor, bool compress) {
+    LoadedEvents loaded;
+    EventCache cache(cache_config);
+
+    if (std::optional<CachedRecording> cached = cache.open(event_filepath)) {
+        std::cout << "--- Original event count: " << cached->events.size() << std::endl;
+        loaded.events = downsample_events(std::move(cached->events), factor);
+        if (factor <= 1) loaded.time_index = std::move(cached->time_index);
+        loaded.t_offset = cached->t_offset;
+        loaded.resolution = cached->resolution;
+        return loaded;
+    }
+
+    std::unique_ptr<EventSource> source = open_event_source(event_filepath.string(), hdf5_schema);
+    loaded.t_offset = source->load_t_offset();
+    if (source->num_events() == 0) {
+        throw std::runtime_error("No events found in the event file.");
+    }
+
+    // 圧縮表現で保持する設定なら、チャンクごとに圧縮して非圧縮の全イベントをメモリに置かない
+    // (ネイティブキャッシュはメモリ上の全イベントから書き出すため、この場合は作らない)
+    if (compress && load_events_compressed(*source, factor, loaded)) return loaded;
+
+    // キャッシュは HDF5 のように読み込みが遅い形式にだけ作る
+    // (非圧縮の連続データセットは元ファイルを直接 mmap できるため対象外)
+    if (!cache.enabled() || !source->benefits_from_cache() || source->is_memory_mapped()) {
+        loaded.events = load_events_downsampled(*source, factor);
+        std::optional<Resolution> stored = source->resolution();
+        loaded.resolution = stored ? *stored : calculate_resolution(loaded.events);
+        return loaded;
+    }
+
+    // キャッシュには常に全イベントを保存し、ダウンサンプリングは読み込み後に行う
+    CachedRecording recording;
+    recording.events = load_events_downsampled(*source, 1);
+    recording.ms_to_idx = source->ms_to_idx();
+    recording.index_base_ms = source->time_index_base_ms();
+    recording.t_offset = loaded.t_offset;
+    // const 参照で読む (キャッシュから mmap した t 列をコピーしない)
+    const EventStore& events = recording.events;
+    recording.time_index = TimeIndex::build(events.t.data(), events.size(), recording.t_offset);
+    std::optional<Resolution> stored = source->resolution();
+    recording.resolution = stored ? *stored : calculate_resolution(recording.events);
+    cache.store(event_filepath, recording);
+
+    loaded.events = downsample_events(std::move(recording.events), factor);
+    if (factor <= 1) loaded.time_index = std::move(recording.time_index);
+    loaded.resolution = recording.resolution;
+    return loaded;
+}
+
+bool load_events_compressed(EventSource& source, int factor, LoadedEvents& loaded) {
+    size_t total = source.num_events();
+    size_t stride = static_cast<size_t>(std::max(1, factor));
+    size_t count = (total + stride - 1) / stride;
+    std::cout << "--- Original event count: " << total << std::endl;
+    std::cout << "--- イベントを読み込みながら圧縮中..." << std::endl;
+
+    // チャンクは圧縮ブロックの整数倍なので、前のチャンクのブロックの続きとして追加できる
+    constexpr size_t CHUNK_EVENTS = EventSource::DEFAULT_CHUNK_SIZE;
+    static_assert(CHUNK_EVENTS % CompressedEventStore::BLOCK_SIZE == 0, "chunks must be whole compression blocks");
+    CompressedEventStore compressed;
+    compressed.reserve(count);
+    int64_t t_first = source.read_events(0, 1, EVENT_COLUMN_T).t.front();
+    int64_t t_last = source.read_events((count - 1) * stride, 1, EVENT_COLUMN_T).t.front();
+    TimeIndex time_index(loaded.t_offset + t_first, loaded.t_offset + t_last, count);
+    std::optional<Resolution> stored = source.resolution();
+    uint16_t max_x = 0;
+    uint16_t max_y = 0;
+    for (size_t out = 0; out < count; out += CHUNK_EVENTS) {
+        size_t begin = out * stride;
+        const EventStore chunk = source.read_events(begin, std::min(CHUNK_EVENTS * stride, total - begin), EVENT_COLUMNS_ALL, stride);
+        if (!CompressedEventStore::can_encode(chunk)) {
+            std::cerr << "Warning: 座標が15bitを超えるか極性が0/1でないため、イベントを圧縮せずに読み込みます。" << std::endl;
+            return false;
+        }
+        compressed.append(chunk);
+        time_index.append(chunk.t.data(), chunk.size(), loaded.t_offset);
+        if (!stored && !chunk.empty()) {
+            max_x = std::max(max_x, *std::max_element(chunk.x.begin(), chunk.x.end()));
+            max_y = std::max(max_y, *std::max_element(chunk.y.begin(), chunk.y.end()));
+        }
+    }
+    loaded.resolution = stored ? *stored : Resolution{static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
+    loaded.time_index = std::move(time_index);
+    std::cout << "--- " << compressed.size() << " 個のイベントを " << compressed.memory_bytes() / (1024 * 1024) << " MB に圧縮しました ("
+              << static_cast<double>(compressed.memory_bytes()) / std::max<size_t>(1, compressed.size()) << " B/event) ---" << std::endl;
+    loaded.compressed = std::move(compressed);
+    return true;
+}
+
+EventStore load_events_downsampled(EventSource& source, int factor) {
+    size_t total = source.num_events();
+    std::cout << "--- Original event count: " << total << std::endl;
+    if (factor > 1) {
+        std::cout << "--- Downsampling by a factor of " << factor << "..." << std::endl;
+    }
+
+    // ストライド付きで出力の各列へ直接読み込むため、
+    // ダウンサンプリング時もフル解像度のコピーを作らずに済む
+    EventStore events = source.read_events(0, total, EVENT_COLUMNS_ALL, factor);
+    std::cout << "--- Loaded event count: " << events.size() << std::endl;
+    return events;
+}
+
+EventStore downsample_events(EventStore events, int factor) {
     if (factor <= 1) {
-        return all_events;
+        // 列はコピーせず共有する (mmap したキャッシュのビューのまま描画に渡す)
+        return events;
     }
-    std::cout << "--- Original event count: " << all_events.size() << std::endl;
     std::cout << "--- Downsampling by a factor of " << factor << "..." << std::endl;
-    std::vector<EventCD> downsampled;
-    downsampled.reserve(all_events.size() / factor + 1);
-    for (size_t i = 0; i < all_events.size(); i += factor) {
-        downsampled.push_back(all_events[i]);
+    size_t count = (events.size() + factor - 1) / factor;
+    // const 参照で読む (非 const の要素アクセスは mmap した列をヒープにコピーしてしまう)
+    const EventStore& source = events;
+    EventStore sampled;
+    sampled.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t src = i * factor;
+        sampled.x[i] = source.x[src];
+        sampled.y[i] = source.y[src];
+        sampled.p[i] = source.p[src];
+        sampled.t[i] = source.t[src];
     }
-    std::cout << "--- Downsampled event count: " << downsampled.size() << std::endl;
-    return downsampled;
+    std::cout << "--- Loaded event count: " << sampled.size() << std::endl;
+    return sampled;
 }
 
-Resolution calculate_resolution(const std::vector<EventCD>& events) {
+Resolution calculate_resolution(const EventStore& events) {
+    if (events.empty()) {
+        return {0, 0};
+    }
+    std::cout << "--- Calculating sensor resolution from data..." << std::endl;
+    uint16_t max_x = *std::max_element(events.x.begin(), events.x.end());
+    uint16_t max_y = *std::max_element(events.y.begin(), events.y.end());
+    return {static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
+}
+
+Resolution estimate_resolution(EventSource& source) {
+    std::cout << "--- データの一部からセンサー解像度を推定します (streaming.resolution を指定すると省略できます)..." << std::endl;
+    // ファイル全体にわたって等間隔に、決まった数のブロックの x/y 列だけを読む (読む量はファイルの長さによらない)
+    constexpr size_t SAMPLE_BLOCKS = 64;
+    constexpr size_t SAMPLE_BLOCK_EVENTS = size_t(1) << 16;
+    size_t num_events = source.num_events();
+    size_t block = std::min(SAMPLE_BLOCK_EVENTS, num_events);
+    size_t blocks = std::min(SAMPLE_BLOCKS, (num_events + block - 1) / block);
     uint16_t max_x = 0;
     uint16_t max_y = 0;
-    std::cout << "--- Calculating sensor resolution from data..." << std::endl;
-    for (const auto& event : events) {
-        max_x = std::max(max_x, event.x);
-        max_y = std::max(max_y, event.y);
+    for (size_t i = 0; i < blocks; ++i) {
+        size_t begin = blocks > 1 ? (num_events - block) / (blocks - 1) * i : 0;
+        const EventStore columns = source.read_events(begin, block, EVENT_COLUMN_X | EVENT_COLUMN_Y);
+        if (columns.empty()) continue;
+        max_x = std::max(max_x, *std::max_element(columns.x.begin(), columns.x.end()));
+        max_y = std::max(max_y, *std::max_element(columns.y.begin(), columns.y.end()));
     }
     return {static_cast<int>(max_x + 1), static_cast<int>(max_y + 1)};
-}
\ No newline at end of file
+}
+
+// memory.compress_events が有効か
+bool compression_requested(const YAML::Node& master_config) {
+    return master_config["memory"] && master_config["memory"]["compress_events"] &&
+           master_config["memory"]["compress_events"].as<bool>();
+}
+
+bool should_compress_events(const YAML::Node& master_config, const EventStore& events) {
+    if (!compression_requested(master_config)) {
+        return false;
+    }
+    if (!CompressedEventStore::can_encode(events)) {
+        std::cerr << "Warning: 座標が15bitを超えるか極性が0/1でないため、イベントを圧縮せずに保持します。" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CompressedEventStore compress_events(const EventStore& events) {
+    std::cout << "--- イベントを圧縮中..." << std::endl;
+    CompressedEventStore compressed = CompressedEventStore::encode(events);
+    std::cout << "--- " << compressed.size() << " 個のイベントを " << compressed.memory_bytes() / (1024 * 1024) << " MB に圧縮しました ("
+              << static_cast<double>(compressed.memory_bytes()) / std::max<size_t>(1, compressed.size()) << " B/event) ---" << std::endl;
+    return compressed;
+}
@@ -0,0 +1,60 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    struct stat st {};
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot stat file for mapping: " + path + " (" + std::strerror(errno) + ")");
+    }
+    return open(path, 0, static_cast<size_t>(st.st_size));
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path, uint64_t offset, size_t length) {
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    if (length == 0) return mapped;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file for mapping: " + path + " (" + std::strerror(errno) + ")");
+    }
+    // mmap のオフセットはページ境界に揃える必要がある
+    uint64_t aligned_offset = offset - offset % page_size();
+    size_t lead = static_cast<size_t>(offset - aligned_offset);
+    void* base = ::mmap(nullptr, length + lead, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(aligned_offset));
+    ::close(fd); // マップはファイルディスクリプタを閉じても有効
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("mmap failed for " + path + " (" + std::strerror(errno) + ")");
+    }
+
+    mapped->m_base = base;
+    mapped->m_mapped_length = length + lead;
+    mapped->m_data = static_cast<const uint8_t*>(base) + lead;
+    mapped->m_size = length;
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (m_base) {
+        ::munmap(m_base, m_mapped_length);
+    }
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+    if (!m_base || offset >= m_size) return;
+    length = std::min(length, m_size - offset);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(m_data + offset);
+    uintptr_t aligned_begin = begin - begin % page_size();
+    ::madvise(reinterpret_cast<void*>(aligned_begin), length + (begin - aligned_begin), MADV_WILLNEED);
+}
+
+size_t MappedFile::page_size() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
@@ -2,17 +2,43 @@
 #include <stb_image.h>
 
 #include "renderer.h"
-#include "cuda_processor.h"
+#include "vertex_processor.h"
 #include <iostream>
 #include <cstdio>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+
+namespace {
+// 頂点の生成とGPUへの転送はこのイベント数ずつ行い、一時バッファの大きさを抑える
+constexpr size_t UPLOAD_SLICE_EVENTS = size_t(1) << 22;
+// 前のフレームがそのまま使える間は入力が来るまで待つ。先読みしたセグメントを受け取るため、この間隔で起きる
+constexpr double IDLE_WAIT_S = 0.1;
+}
 
 // グローバルスコープにあった関数は、このラッパー関数に置き換わる
-void run_renderer(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors) {
+void run_renderer(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors) {
+    try {
+        Renderer app(1280, 720, "Event Viewer");
+        app.run(all_events, std::move(time_index), all_images, width, height, t_offset, colors);
+    } catch (const std::exception& e) {
+        std::cerr << "A critical error occurred: " << e.what() << std::endl;
+    }
+}
+
+void run_renderer(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int width, int height, int64_t t_offset, const ColorConfig& colors) {
+    try {
+        Renderer app(1280, 720, "Event Viewer");
+        app.run(all_events, std::move(time_index), all_images, width, height, t_offset, colors);
+    } catch (const std::exception& e) {
+        std::cerr << "A critical error occurred: " << e.what() << std::endl;
+    }
+}
+
+void run_renderer(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int width, int height, const ColorConfig& colors) {
     try {
         Renderer app(1280, 720, "Event Viewer");
-        app.run(all_events, all_images, width, height, t_offset, colors);
+        app.run(prefetcher, all_images, width, height, colors);
     } catch (const std::exception& e) {
         std::cerr << "A critical error occurred: " << e.what() << std::endl;
     }
@@ -42,7 +68,7 @@ void Renderer::init() {
     glfwSetWindowUserPointer(m_window, this);
 
     if (glewInit() != GLEW_OK) { throw std::runtime_error("Failed to initialize GLEW"); }
-    init_cuda_for_gl();
+    init_vertex_processor();
 
     glViewport(0, 0, m_width, m_height);
     glEnable(GL_DEPTH_TEST);
@@ -55,7 +81,7 @@ void Renderer::init() {
     std::cout << "\n--- Viewer Controls ---\n"
               << "Mouse Drag: Orbit camera | Mouse Wheel: Zoom\n"
               << "B: Toggle bounding box | M: Cycle display mode\n"
-              << "SPACE: Pause/Resume | LEFT/RIGHT: Speed | UP/DOWN: Depth\n"
+              << "SPACE: Pause/Resume | LEFT/RIGHT: Speed | R: Reverse | UP/DOWN: Depth\n"
               << "[ / ]: Image Alpha | , / .: Time Window\n"
               << "ESC: Exit\n" << std::endl;
 }
@@ -74,34 +100,67 @@ void Renderer::setupCallbacks() {
     glfwSetScrollCallback(m_window, [](GLFWwindow* w, double x, double y) {
         static_cast<Renderer*>(glfwGetWindowUserPointer(w))->onScroll(x, y);
     });
+    // ウィンドウが隠れていた部分を描き直すよう求められたとき
+    glfwSetWindowRefreshCallback(m_window, [](GLFWwindow* w) {
+        static_cast<Renderer*>(glfwGetWindowUserPointer(w))->m_frame_dirty = true;
+    });
 }
 
-void Renderer::run(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
+void Renderer::run(const EventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
+    EventSliceReader read_slice = [&](size_t begin, size_t count) { return all_events.slice(begin, count); };
+    start(all_events.size(), read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset, colors);
+}
+
+void Renderer::run(const CompressedEventStore& all_events, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
+    EventSliceReader read_slice = [&](size_t begin, size_t count) { return all_events.decode(begin, count); };
+    start(all_events.size(), read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset, colors);
+}
+
+void Renderer::run(EventPrefetcher& prefetcher, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, const ColorConfig& colors) {
+    m_prefetcher = &prefetcher;
+    start(0, EventSliceReader(), TimeIndex(), all_images, sensor_width, sensor_height, prefetcher.t_offset(), colors);
+}
+
+void Renderer::start(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
     m_colors = colors;
     init();
     setupCallbacks();
-    loadData(all_events, all_images, sensor_width, sensor_height, t_offset, colors);
+    loadData(num_events, read_slice, std::move(time_index), all_images, sensor_width, sensor_height, t_offset, colors);
     mainLoop();
 }
 
 void Renderer::mainLoop() {
     double last_frame_time = glfwGetTime();
+    bool idle = false;
 
     while (!glfwWindowShouldClose(m_window)) {
+        if (idle) {
+            glfwWaitEventsTimeout(IDLE_WAIT_S);
+        } else {
+            glfwPollEvents();
+        }
+
         double current_frame_time = glfwGetTime();
         double delta_time = current_frame_time - last_frame_time;
         last_frame_time = current_frame_time;
 
-        glfwPollEvents();
-
         if (!m_state.is_paused) {
-            m_current_time_us += delta_time * 1000000.0 * m_state.playback_speed;
+            double direction = m_state.is_reversed ? -1.0 : 1.0;
+            m_current_time_us = std::max(m_base_time, m_current_time_us + direction * delta_time * 1000000.0 * m_state.playback_speed);
         }
 
+        if (m_prefetcher) streamEvents();
+
+        // 時刻・カメラ・表示設定・データのどれも変わっていなければ、前のフレームをそのまま表示し続ける
+        idle = !m_frame_dirty && m_current_time_us == m_drawn_time_us;
+        if (idle) continue;
+
         glClearColor(m_colors.background.r, m_colors.background.g, m_colors.background.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         renderScene();
+        m_frame_dirty = false;
+        m_drawn_time_us = m_current_time_us;
 
         glfwSwapBuffers(m_window);
     }
@@ -113,17 +172,29 @@ void Renderer::renderScene() {
     glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, m_state.depth_scale));
 
     // イベント描画
-    if (m_point_count > 0 && m_state.display_mode != DisplayMode::RGB_ONLY) {
+    if (!m_point_batches.empty() && m_state.display_mode != DisplayMode::RGB_ONLY) {
         m_point_shader->use();
         m_point_shader->setMat4("projection", projection);
         m_point_shader->setMat4("view", view);
         m_point_shader->setMat4("model", model);
-        m_point_shader->setFloat("u_time", static_cast<float>(m_current_time_us - m_base_time));
+        float end_time = static_cast<float>(m_current_time_us - m_base_time);
+        m_point_shader->setFloat("u_time", end_time);
         m_point_shader->setFloat("u_max_age", (float)m_state.time_window_us);
 
+        // タイムウィンドウ [u_time - u_max_age, u_time] に入る頂点だけを描画する
+        // 範囲は絶対時刻 (µs) で索引から求めるので、記録が長くても正確に決まる
+        // (頂点シェーダーの判定はそのまま残し、範囲の端で同じ条件を満たさない頂点を捨てる)
+        int64_t end_t = static_cast<int64_t>(m_current_time_us);
+        int64_t start_t = end_t - static_cast<int64_t>(m_state.time_window_us);
         glDisable(GL_BLEND);
         glBindVertexArray(m_point_vao);
-        glDrawArrays(GL_POINTS, 0, m_point_count);
+        for (const PointBatch& batch : m_point_batches) {
+            size_t first = batch.time_index.lower_bound(start_t);
+            size_t last = std::min(batch.time_index.upper_bound(end_t), batch.count);
+            if (last > first) {
+                glDrawArrays(GL_POINTS, static_cast<GLint>(batch.first_vertex + first), static_cast<GLsizei>(last - first));
+            }
+        }
     }
 
     // 画像フレーム描画
@@ -137,9 +208,10 @@ void Renderer::renderScene() {
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glBindVertexArray(m_quad_vao);
 
-        for (size_t i = 0; i < m_all_images_ptr->size(); ++i) {
-            if (i >= m_image_textures.size()) continue;
-
+        // 経過時間が (0, time_window) のフレーム: 時刻が (現在 - time_window, 現在) の範囲を索引で求める
+        size_t first = m_image_index.upper_bound(static_cast<int64_t>(std::floor(m_current_time_us - m_state.time_window_us)));
+        size_t last = std::min(m_image_index.lower_bound(static_cast<int64_t>(std::ceil(m_current_time_us))), m_image_textures.size());
+        for (size_t i = first; i < last; ++i) {
             double image_age = m_current_time_us - (*m_all_images_ptr)[i].timestamp;
             if (image_age > 0 && image_age < m_state.time_window_us) {
                 float normalized_age = static_cast<float>(image_age / m_state.time_window_us);
@@ -193,25 +265,40 @@ void Renderer::cleanup() {
     glfwTerminate();
 }
 
-void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
+void Renderer::loadData(size_t num_events, const EventSliceReader& read_slice, TimeIndex time_index, const std::vector<RGBFrame>& all_images, int sensor_width, int sensor_height, int64_t t_offset, const ColorConfig& colors) {
     // イベントデータ
-    if (!all_events.empty()) {
-        m_base_time = static_cast<double>(t_offset) + all_events[0].t;
+    m_sensor_width = sensor_width;
+    m_sensor_height = sensor_height;
+    m_t_offset = t_offset;
+    if (m_prefetcher) {
+        // ストリーミング: セグメント1つ分ずつのスロットを確保しておき、再生しながら埋める
+        m_base_time = static_cast<double>(t_offset) + m_prefetcher->t_first();
         m_current_time_us = m_base_time;
-
-        glGenBuffers(1, &m_point_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, m_point_vbo);
-        glBufferData(GL_ARRAY_BUFFER, all_events.size() * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
-        register_gl_buffer(m_point_vbo);
-        m_point_count = process_all_events(all_events, sensor_width, sensor_height, t_offset, m_base_time, colors);
-
-        glGenVertexArrays(1, &m_point_vao);
-        glBindVertexArray(m_point_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, m_point_vbo);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+        createPointBuffer(m_prefetcher->max_segments() * m_prefetcher->segment_events());
+        for (size_t slot = m_prefetcher->max_segments(); slot-- > 0;) {
+            m_free_slots.push_back(slot * m_prefetcher->segment_events());
+        }
+    } else if (num_events > 0) {
+        m_base_time = static_cast<double>(t_offset) + read_slice(0, 1).t[0];
+        m_current_time_us = m_base_time;
+        createPointBuffer(num_events);
+
+        // 一定数ずつ取り出して頂点化する (圧縮表現の場合もここで展開される)
+        // 時刻の索引はキャッシュに無ければ同時に作る
+        PointBatch batch;
+        bool build_index = time_index.size() != num_events;
+        if (build_index) {
+            int64_t t_last = t_offset + read_slice(num_events - 1, 1).t[0];
+            batch.time_index = TimeIndex(static_cast<int64_t>(m_base_time), t_last, num_events);
+        } else {
+            batch.time_index = std::move(time_index);
+        }
+        for (size_t begin = 0; begin < num_events; begin += UPLOAD_SLICE_EVENTS) {
+            const EventStore slice = read_slice(begin, std::min(UPLOAD_SLICE_EVENTS, num_events - begin));
+            if (build_index) batch.time_index.append(slice.t.data(), slice.size(), t_offset);
+            batch.count += process_all_events(slice, batch.count, sensor_width, sensor_height, t_offset, m_base_time, colors);
+        }
+        m_point_batches.push_back(std::move(batch));
     }
 
     // バウンディングボックス
@@ -246,11 +333,17 @@ void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vecto
 
     // 画像テクスチャ
     m_all_images_ptr = &all_images;
+    std::vector<int64_t> frame_times(all_images.size());
+    for (size_t i = 0; i < all_images.size(); ++i) frame_times[i] = all_images[i].timestamp;
+    m_image_index = TimeIndex::build(frame_times.data(), frame_times.size(), 0, TimeIndex::FRAME_BUCKET_SHIFT);
     if (!all_images.empty()) {
         stbi_set_flip_vertically_on_load(true);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 幅が奇数の RGB 画像は行が4バイト境界に揃わない
         for (const auto& frame : all_images) {
-            int w, h, ch;
-            unsigned char* data = stbi_load(frame.image_path.c_str(), &w, &h, &ch, 0);
+            // イベントファイルに埋め込まれた画像 (AEDAT4 の APS フレーム) は展開済みの RGB (下の行から順)
+            int w = frame.width, h = frame.height, ch = 3;
+            unsigned char* file_data = frame.pixels ? nullptr : stbi_load(frame.image_path.c_str(), &w, &h, &ch, 0);
+            const unsigned char* data = frame.pixels ? frame.pixels->data() : file_data;
             if (data) {
                 GLuint texID;
                 glGenTextures(1, &texID);
@@ -263,15 +356,69 @@ void Renderer::loadData(const std::vector<EventCD>& all_events, const std::vecto
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                 m_image_textures.push_back(texID);
-                stbi_image_free(data);
             }
+            if (file_data) stbi_image_free(file_data);
         }
     }
     glBindVertexArray(0);
 }
 
+void Renderer::createPointBuffer(size_t capacity) {
+    glGenBuffers(1, &m_point_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_point_vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+    register_gl_buffer(m_point_vbo);
+
+    glGenVertexArrays(1, &m_point_vao);
+    glBindVertexArray(m_point_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_point_vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+}
+
+void Renderer::streamEvents() {
+    PlaybackRequest request;
+    request.playhead_us = static_cast<int64_t>(m_current_time_us) - m_t_offset;
+    request.window_us = static_cast<int64_t>(m_state.time_window_us);
+    request.speed = m_state.playback_speed;
+    request.reversed = m_state.is_reversed;
+    m_prefetcher->update(request);
+
+    // タイムウィンドウと先読み範囲から外れたセグメントを先読みスレッドに返す
+    TimeRange wanted = m_prefetcher->wanted_range(request);
+    for (auto it = m_point_batches.begin(); it != m_point_batches.end();) {
+        if (it->segment->t_last < wanted.begin || it->segment->t_first >= wanted.end) {
+            m_free_slots.push_back(it->first_vertex);
+            m_prefetcher->release(it->segment);
+            it = m_point_batches.erase(it);
+            m_frame_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+
+    // 読み込み済みのセグメントを空きスロットに頂点化する (スロット数はプールと同じなので必ず空きがある)
+    while (!m_free_slots.empty()) {
+        EventSegment* segment = m_prefetcher->poll();
+        if (!segment) break;
+        // const 参照で読む (非 const のアクセスは mmap した列をヒープにコピーしてしまう)
+        const EventStore& events = segment->events;
+        PointBatch batch;
+        batch.first_vertex = m_free_slots.back();
+        batch.segment = segment;
+        m_free_slots.pop_back();
+        batch.count = process_all_events(events, batch.first_vertex, m_sensor_width, m_sensor_height, m_t_offset, m_base_time, m_colors);
+        batch.time_index = TimeIndex::build(events.t.data(), events.size(), m_t_offset);
+        m_point_batches.push_back(std::move(batch));
+        m_frame_dirty = true;
+    }
+}
+
 // --- コールバックハンドラの実装 ---
 void Renderer::onKey(int key, int scancode, int action, int mods) {
+    if (action != GLFW_RELEASE) m_frame_dirty = true;
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(m_window, true);
     if (key == GLFW_KEY_B && action == GLFW_PRESS) m_state.show_bounding_box = !m_state.show_bounding_box;
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
@@ -303,11 +450,12 @@ void Renderer::onKey(int key, int scancode, int action, int mods) {
             case GLFW_KEY_LEFT: m_state.playback_speed /= 1.2f; updated = true; break;
             case GLFW_KEY_UP: m_state.depth_scale *= 1.2f; updated = true; break;
             case GLFW_KEY_DOWN: m_state.depth_scale = std::max(0.01f, m_state.depth_scale / 1.2f); updated = true; break;
+            case GLFW_KEY_R: if (action == GLFW_PRESS) { m_state.is_reversed = !m_state.is_reversed; updated = true; } break;
         }
 
         if (updated) {
-            printf("Speed: %.2fx, Depth: %.2f, Alpha: %.2f, Window: %.2fs\n",
-                m_state.playback_speed, m_state.depth_scale, m_state.image_alpha, m_state.time_window_us / 1e6);
+            printf("Speed: %s%.2fx, Depth: %.2f, Alpha: %.2f, Window: %.2fs\n",
+                m_state.is_reversed ? "-" : "", m_state.playback_speed, m_state.depth_scale, m_state.image_alpha, m_state.time_window_us / 1e6);
         }
     }
 }
@@ -330,8 +478,10 @@ void Renderer::onCursorPosition(double xpos, double ypos) {
     m_last_x = xpos;
     m_last_y = ypos;
     m_camera.processMouseMovement(xoffset, yoffset);
+    m_frame_dirty = true;
 }
 
 void Renderer::onScroll(double xoffset, double yoffset) {
     m_camera.processMouseScroll(static_cast<float>(yoffset));
+    m_frame_dirty = true;
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "text_event_reader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// 1区間の最小サイズ (これより小さいファイルは分割しない)
+constexpr size_t MIN_PIECE_BYTES = size_t(4) << 20;
+// スレッド数に対する区間数の倍率 (区間ごとの行の長さのばらつきを均す)
+constexpr size_t PIECES_PER_THREAD = 4;
+// ns から µs への換算を1スレッドに割り当てる単位 (イベント数)
+constexpr size_t CONVERT_BLOCK = size_t(1) << 20;
+// 整数の時刻をこの範囲 (µs として約27.8時間) より広い、または Unix 時刻の ns 相当に大きければ ns とみなす
+constexpr int64_t MAX_US_SPAN = int64_t(100000) * 1000000;
+constexpr int64_t MIN_NS_VALUE = int64_t(100000000) * 1000000000; // 1973年の Unix 時刻 (ns)
+
+enum class TimeFormat { SECONDS, INTEGER };
+
+inline bool is_separator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+inline const char* skip_separators(const char* p, const char* end) {
+    while (p < end && is_separator(*p)) ++p;
+    return p;
+}
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// イベントの行か (空行と '#' / '%' のコメント行以外)
+inline bool is_event_line(const char* line, const char* eol) {
+    const char* p = skip_separators(line, eol);
+    return p < eol && *p != '#' && *p != '%';
+}
+
+inline const char* line_end(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+// 秒 (小数) を µs に換算する。小数部は7桁目で丸め、double を経由しないので桁落ちしない
+// 指数表記 (1.5e-3 など) のときだけ double で解釈する
+bool parse_seconds(const char*& p, const char* end, int64_t& us) {
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (negative) ++p;
+    int64_t seconds = 0;
+    bool has_digits = false;
+    while (p < end && is_digit(*p)) {
+        seconds = seconds * 10 + (*p++ - '0');
+        has_digits = true;
+    }
+    int64_t fraction = 0;
+    int digits = 0;
+    bool round_up = false;
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && is_digit(*p); ++p, has_digits = true) {
+            if (digits < 6) {
+                fraction = fraction * 10 + (*p - '0');
+                ++digits;
+            } else if (digits == 6) {
+                round_up = *p >= '5';
+                ++digits;
+            }
+        }
+    }
+    if (!has_digits) return false;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        double value = 0.0;
+        auto result = std::from_chars(start, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        us = static_cast<int64_t>(std::llround(value * 1e6));
+        return true;
+    }
+    for (int d = std::min(digits, 6); d < 6; ++d) fraction *= 10;
+    us = seconds * 1000000 + fraction + (round_up ? 1 : 0);
+    if (negative) us = -us;
+    return true;
+}
+
+template <typename T>
+inline bool parse_integer(const char*& p, const char* end, T& value) {
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+// 1行 "t x y p" を解釈する
+bool parse_event(const char* p, const char* eol, TimeFormat format,
+                 int64_t& t, uint16_t& x, uint16_t& y, uint8_t& polarity) {
+    p = skip_separators(p, eol);
+    if (format == TimeFormat::SECONDS ? !parse_seconds(p, eol, t) : !parse_integer(p, eol, t)) return false;
+    p = skip_separators(p, eol);
+    if (!parse_integer(p, eol, x)) return false;
+    p = skip_separators(p, eol);
+    if (!parse_integer(p, eol, y)) return false;
+    p = skip_separators(p, eol);
+    int pol = 0;
+    if (!parse_integer(p, eol, pol)) return false;
+    polarity = pol > 0 ? 1 : 0;
+    const char* rest = skip_separators(p, eol);
+    return rest == eol || *rest == '#';
+}
+
+std::string excerpt(const char* line, const char* eol) {
+    return std::string(line, std::min<size_t>(eol - line, 80));
+}
+
+} // namespace
+
+TextEventReader::TextEventReader(const std::string& filepath) : m_filepath(filepath) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(filepath);
+    const char* data = reinterpret_cast<const char*>(file->data());
+    const char* end = data + file->size();
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. 先頭のコメント・列名・"width height" の行を読み飛ばし、最初のイベントの行から時刻の形式を決める
+    const char* body = data;
+    while (body < end) {
+        const char* eol = line_end(body, end);
+        const char* p = skip_separators(body, eol);
+        if (p < eol && *p != '#' && *p != '%' && (is_digit(*p) || *p == '-' || *p == '.')) {
+            int values[3];
+            int n = 0;
+            while (p < eol && n < 3 && parse_integer(p, eol, values[n])) {
+                ++n;
+                p = skip_separators(p, eol);
+            }
+            if (n == 2 && p == eol) {
+                m_resolution = Resolution{values[0], values[1]};
+            } else {
+                break;
+            }
+        }
+        body = std::min(end, eol + 1);
+    }
+    TimeFormat format = TimeFormat::INTEGER;
+    if (body < end) {
+        const char* eol = line_end(body, end);
+        const char* p = skip_separators(body, eol);
+        const char* token_end = p;
+        while (token_end < eol && !is_separator(*token_end)) ++token_end;
+        if (std::find_if(p, token_end, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) != token_end) {
+            format = TimeFormat::SECONDS;
+        }
+    }
+
+    // 2. 改行位置で区間に分ける
+    ThreadPool& pool = ThreadPool::shared();
+    size_t bytes = end - body;
+    size_t num_pieces = std::clamp<size_t>(bytes / MIN_PIECE_BYTES, 1, pool.concurrency() * PIECES_PER_THREAD);
+    std::vector<const char*> bounds(num_pieces + 1, end);
+    bounds[0] = body;
+    for (size_t i = 1; i < num_pieces; ++i) {
+        const char* nominal = std::max(bounds[i - 1], body + bytes * i / num_pieces);
+        bounds[i] = nominal < end ? std::min(end, line_end(nominal, end) + 1) : end;
+    }
+
+    // 3. 区間ごとのイベント数を数える
+    std::vector<size_t> counts(num_pieces, 0);
+    pool.parallel_for(num_pieces, [&](size_t i) {
+        size_t n = 0;
+        for (const char* line = bounds[i]; line < bounds[i + 1];) {
+            const char* eol = line_end(line, bounds[i + 1]);
+            if (is_event_line(line, eol)) ++n;
+            line = eol + 1;
+        }
+        counts[i] = n;
+    });
+    std::vector<size_t> first(num_pieces, 0);
+    size_t total = 0;
+    for (size_t i = 0; i < num_pieces; ++i) {
+        first[i] = total;
+        total += counts[i];
+    }
+
+    // 4. 出力の列に直接書き込む
+    auto events = std::make_shared<EventStore>();
+    events->resize(total);
+    pool.parallel_for(num_pieces, [&](size_t i) {
+        size_t n = first[i];
+        uint16_t* x = events->x.data();
+        uint16_t* y = events->y.data();
+        uint8_t* p = events->p.data();
+        int64_t* t = events->t.data();
+        for (const char* line = bounds[i]; line < bounds[i + 1];) {
+            const char* eol = line_end(line, bounds[i + 1]);
+            if (is_event_line(line, eol)) {
+                if (!parse_event(line, eol, format, t[n], x[n], y[n], p[n])) {
+                    throw std::runtime_error("Malformed event line '" + excerpt(line, eol) + "' (expected \"t x y p\"): " + filepath);
+                }
+                ++n;
+            }
+            line = eol + 1;
+        }
+    });
+
+    // 5. 整数の時刻が ns で書かれていれば µs に直す
+    const char* unit = "秒";
+    if (format == TimeFormat::INTEGER) {
+        unit = "µs";
+        if (total > 0) {
+            const EventStore& parsed = *events;
+            int64_t t_first = parsed.t[0];
+            int64_t t_last = parsed.t[total - 1];
+            if (t_last - t_first > MAX_US_SPAN || std::max(std::abs(t_first), std::abs(t_last)) >= MIN_NS_VALUE) {
+                unit = "ns";
+                int64_t* t = events->t.data();
+                size_t blocks = (total + CONVERT_BLOCK - 1) / CONVERT_BLOCK;
+                pool.parallel_for(blocks, [&](size_t b) {
+                    size_t hi = std::min(total, (b + 1) * CONVERT_BLOCK);
+                    for (size_t k = b * CONVERT_BLOCK; k < hi; ++k) t[k] /= 1000;
+                });
+            }
+        }
+    }
+    m_events = std::move(events);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "TextEventReader: " << filepath << " を解釈しました (" << total << " イベント, 時刻の単位: "
+              << unit << ", " << seconds << " 秒)。" << std::endl;
+}
+
+TextEventReader::~TextEventReader() = default;
+
+size_t TextEventReader::num_events() {
+    return m_events->size();
+}
+
+EventStore TextEventReader::read_events(size_t begin, size_t count, unsigned columns, size_t stride) {
+    EventStore events;
+    events.columns = columns;
+    size_t total = m_events->size();
+    if (begin >= total) return events;
+    stride = std::max<size_t>(1, stride);
+    count = std::min(count, total - begin);
+    const EventStore& all = *m_events;
+
+    if (stride == 1) {
+        if (events.has(EVENT_COLUMN_X)) events.x.assign_view(all.x.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_Y)) events.y.assign_view(all.y.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_P)) events.p.assign_view(all.p.data() + begin, count, m_events);
+        if (events.has(EVENT_COLUMN_T)) events.t.assign_view(all.t.data() + begin, count, m_events);
+        return events;
+    }
+
+    size_t out_count = (count + stride - 1) / stride;
+    events.resize(out_count);
+    auto gather = [&](auto& dst, const auto& src) {
+        auto* out = dst.data();
+        for (size_t i = 0, j = begin; i < out_count; ++i, j += stride) out[i] = src[j];
+    };
+    if (events.has(EVENT_COLUMN_X)) gather(events.x, all.x);
+    if (events.has(EVENT_COLUMN_Y)) gather(events.y, all.y);
+    if (events.has(EVENT_COLUMN_P)) gather(events.p, all.p);
+    if (events.has(EVENT_COLUMN_T)) gather(events.t, all.t);
+    return events;
+}
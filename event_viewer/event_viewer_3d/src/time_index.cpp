@@ -0,0 +1,99 @@
+#include "time_index.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// 1スレッドに割り当てる要素数 (ストリーミングの1セグメント程度なら呼び出しスレッドだけで済ませる)
+constexpr size_t APPEND_BLOCK = size_t(1) << 20;
+// バケット数がこれと要素数の大きい方 (+1) を超えるなら、バケットを広げる
+constexpr size_t MIN_BUCKET_LIMIT = size_t(1) << 16;
+
+// 幅 2^shift のバケット内の差を16bitに収めるための右シフト量
+int offset_shift(int shift) {
+    return std::max(0, shift - TimeIndex::OFFSET_BITS);
+}
+
+size_t bucket_count(int64_t span, int shift) {
+    return span <= 0 ? 1 : static_cast<size_t>(span >> shift) + 1;
+}
+
+} // namespace
+
+TimeIndex::TimeIndex(int64_t t_first, int64_t t_last, size_t size, int bucket_shift)
+    : m_t_base(t_first), m_bucket_shift(std::clamp(bucket_shift, 0, MAX_BUCKET_SHIFT)) {
+    int64_t span = t_last - t_first;
+    size_t limit = std::max(size, MIN_BUCKET_LIMIT) + 1;
+    while (m_bucket_shift < MAX_BUCKET_SHIFT && bucket_count(span, m_bucket_shift) > limit) ++m_bucket_shift;
+    // まだ埋めていないバケットは末尾を指すようにしておく
+    m_buckets = std::vector<uint64_t>(bucket_count(span, m_bucket_shift), size);
+    m_offsets.resize(size);
+}
+
+TimeIndex::TimeIndex(int64_t t_base, int bucket_shift, ColumnBuffer<uint64_t> buckets, ColumnBuffer<uint16_t> offsets)
+    : m_t_base(t_base), m_bucket_shift(bucket_shift), m_buckets(std::move(buckets)), m_offsets(std::move(offsets)) {
+    m_filled = m_offsets.size();
+}
+
+void TimeIndex::append(const int64_t* t, size_t count, int64_t t_offset) {
+    if (count > m_offsets.size() - m_filled) {
+        throw std::length_error("TimeIndex: more elements than reserved");
+    }
+    const int shift = m_bucket_shift;
+    const int quantum = offset_shift(shift);
+    const int64_t base = m_t_base - t_offset;
+    const int64_t last_bucket = static_cast<int64_t>(m_buckets.size()) - 1;
+    // 範囲外の時刻 (並びの乱れ) は端のバケットに寄せ、索引の外に書き込まないようにする
+    auto bucket_of = [&](int64_t time) { return std::clamp((time - base) >> shift, int64_t(0), last_bucket); };
+    uint64_t* buckets = m_buckets.data();
+    uint16_t* offsets = m_offsets.data() + m_filled;
+    const size_t first = m_filled;
+    const int64_t prev_bucket = m_last_bucket;
+
+    size_t blocks = (count + APPEND_BLOCK - 1) / APPEND_BLOCK;
+    auto append_block = [&](size_t b) {
+        size_t lo = b * APPEND_BLOCK;
+        size_t hi = std::min(count, lo + APPEND_BLOCK);
+        int64_t prev = lo == 0 ? prev_bucket : bucket_of(t[lo - 1]);
+        for (size_t i = lo; i < hi; ++i) {
+            int64_t k = bucket_of(t[i]);
+            int64_t delta = std::clamp(t[i] - base - (k << shift), int64_t(0), (int64_t(1) << shift) - 1);
+            offsets[i] = static_cast<uint16_t>(delta >> quantum);
+            // バケットの境界をまたいだ要素が、その間のバケットの先頭になる (ブロックごとに書くバケットは重ならない)
+            for (int64_t j = prev + 1; j <= k; ++j) buckets[j] = first + i;
+            prev = std::max(prev, k);
+        }
+    };
+    if (blocks > 1) {
+        ThreadPool::shared().parallel_for(blocks, append_block);
+    } else if (blocks == 1) {
+        append_block(0);
+    }
+
+    if (count > 0) m_last_bucket = std::max(m_last_bucket, bucket_of(t[count - 1]));
+    m_filled += count;
+}
+
+TimeIndex TimeIndex::build(const int64_t* t, size_t count, int64_t t_offset, int bucket_shift) {
+    if (count == 0) return TimeIndex();
+    TimeIndex index(t_offset + t[0], t_offset + t[count - 1], count, bucket_shift);
+    index.append(t, count, t_offset);
+    return index;
+}
+
+size_t TimeIndex::find(int64_t t, bool upper) const {
+    size_t n = m_offsets.size();
+    if (n == 0 || t < m_t_base) return 0;
+    uint64_t rel = static_cast<uint64_t>(t - m_t_base);
+    uint64_t k = rel >> m_bucket_shift;
+    if (k >= m_buckets.size()) return n;
+
+    size_t lo = m_buckets[k];
+    size_t hi = k + 1 < m_buckets.size() ? m_buckets[k + 1] : n;
+    uint16_t delta = static_cast<uint16_t>((rel - (k << m_bucket_shift)) >> offset_shift(m_bucket_shift));
+    const uint16_t* begin = m_offsets.data();
+    const uint16_t* it = upper ? std::upper_bound(begin + lo, begin + hi, delta) : std::lower_bound(begin + lo, begin + hi, delta);
+    return static_cast<size_t>(it - begin);
+}
@@ -0,0 +1,142 @@
+#include "vertex_processor.h"
+#include "thread_pool.h"
+#ifdef EV_HAVE_CUDA
+#include "cuda_processor.h"
+#endif
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// 1スレッドに割り当てるイベント数 (座標の一時配列がL1/L2に収まる大きさ)
+constexpr size_t VERTEX_BLOCK = 4096;
+
+VertexBackend requested_backend = VertexBackend::AUTO;
+bool use_cuda = false;
+GLuint cpu_vbo = 0;
+
+struct Rgba {
+    uint8_t r, g, b, a;
+};
+
+Rgba to_rgba(const glm::vec3& color) {
+    return {static_cast<uint8_t>(color.r * 255.0f), static_cast<uint8_t>(color.g * 255.0f),
+            static_cast<uint8_t>(color.b * 255.0f), 255};
+}
+
+} // namespace
+
+std::optional<VertexBackend> parse_vertex_backend(const std::string& name) {
+    if (name == "auto") return VertexBackend::AUTO;
+    if (name == "cpu") return VertexBackend::CPU;
+    if (name == "cuda") return VertexBackend::CUDA;
+    return std::nullopt;
+}
+
+void set_vertex_backend(VertexBackend backend) {
+    requested_backend = backend;
+}
+
+void init_vertex_processor() {
+    use_cuda = false;
+#ifdef EV_HAVE_CUDA
+    if (requested_backend != VertexBackend::CPU) {
+        use_cuda = init_cuda_for_gl();
+        if (!use_cuda && requested_backend == VertexBackend::CUDA) {
+            std::cerr << "Warning: CUDA デバイスが使えないため、CPU で頂点を生成します。" << std::endl;
+        }
+    }
+#else
+    if (requested_backend == VertexBackend::CUDA) {
+        std::cerr << "Warning: CUDA なしでビルドされているため、CPU で頂点を生成します。" << std::endl;
+    }
+#endif
+    if (!use_cuda) {
+        std::cout << "--- 頂点の生成: CPU (" << ThreadPool::shared().concurrency() << " スレッド) ---" << std::endl;
+    }
+}
+
+void register_gl_buffer(GLuint vbo) {
+#ifdef EV_HAVE_CUDA
+    if (use_cuda) {
+        cuda_register_gl_buffer(vbo);
+        return;
+    }
+#endif
+    cpu_vbo = vbo;
+}
+
+void unregister_gl_buffer() {
+#ifdef EV_HAVE_CUDA
+    if (use_cuda) {
+        cuda_unregister_gl_buffer();
+        return;
+    }
+#endif
+    cpu_vbo = 0;
+}
+
+unsigned int process_all_events(const EventStore& all_events, size_t vertex_offset, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors) {
+#ifdef EV_HAVE_CUDA
+    if (use_cuda) return cuda_process_all_events(all_events, vertex_offset, width, height, t_offset, base_time, colors);
+#endif
+    if (all_events.empty() || cpu_vbo == 0) return 0;
+
+    // 書き込む範囲だけを写像し、スレッドから直接頂点を書き込む (以前の内容は捨ててよい)
+    size_t n = all_events.size();
+    glBindBuffer(GL_ARRAY_BUFFER, cpu_vbo);
+    void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, static_cast<GLintptr>(vertex_offset * sizeof(Vertex)),
+                                    static_cast<GLsizeiptr>(n * sizeof(Vertex)), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (!mapped) {
+        std::cerr << "Failed to map the point buffer (glMapBufferRange)." << std::endl;
+        return 0;
+    }
+    events_to_vertices_cpu(all_events, static_cast<Vertex*>(mapped), width, height, t_offset, base_time, colors);
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) != GL_TRUE) {
+        // 写像中にバッファの内容が失われた (画面モードの切り替えなど)。次のアップロードで書き直される
+        std::cerr << "Point buffer contents were lost while mapped." << std::endl;
+        return 0;
+    }
+    return static_cast<unsigned int>(n);
+}
+
+void events_to_vertices_cpu(const EventStore& events, Vertex* out, int width, int height, int64_t t_offset, double base_time, const ColorConfig& colors) {
+    size_t n = events.size();
+    // CUDA カーネルと同じ変換: x = (x / width - 0.5) * 2, y = (y / height - 0.5) * -2, z = t_offset + t - base_time
+    const float scale_x = 2.0f / static_cast<float>(width);
+    const float scale_y = -2.0f / static_cast<float>(height);
+    const double t_base = base_time - static_cast<double>(t_offset);
+    const Rgba color_on = to_rgba(colors.event_on);
+    const Rgba color_off = to_rgba(colors.event_off);
+    const uint16_t* xs = events.x.data();
+    const uint16_t* ys = events.y.data();
+    const uint8_t* ps = events.p.data();
+    const int64_t* ts = events.t.data();
+
+    size_t blocks = (n + VERTEX_BLOCK - 1) / VERTEX_BLOCK;
+    ThreadPool::shared().parallel_for(blocks, [&](size_t b) {
+        size_t lo = b * VERTEX_BLOCK;
+        size_t count = std::min(VERTEX_BLOCK, n - lo);
+        float fx[VERTEX_BLOCK], fy[VERTEX_BLOCK], fz[VERTEX_BLOCK];
+        for (size_t i = 0; i < count; ++i) fx[i] = static_cast<float>(xs[lo + i]) * scale_x - 1.0f;
+        for (size_t i = 0; i < count; ++i) fy[i] = static_cast<float>(ys[lo + i]) * scale_y + 1.0f;
+        for (size_t i = 0; i < count; ++i) fz[i] = static_cast<float>(static_cast<double>(ts[lo + i]) - t_base);
+
+        // 写像したバッファは書き込み結合のメモリであることが多いので、頂点を先頭から順に丸ごと書く
+        Vertex* dst = out + lo;
+        for (size_t i = 0; i < count; ++i) {
+            const Rgba& color = ps[lo + i] == 1 ? color_on : color_off;
+            Vertex v;
+            v.x = fx[i];
+            v.y = fy[i];
+            v.z = fz[i];
+            v.r = color.r;
+            v.g = color.g;
+            v.b = color.b;
+            v.a = color.a;
+            v.timestamp = fz[i];
+            std::memcpy(dst + i, &v, sizeof(Vertex));
+        }
+    });
+}